@@ -0,0 +1,297 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <analyses/BasicBlockGraph.hh>
+
+#include <algorithm>
+#include <cassert>
+#include <kernel/annotations/SolvedJmpAnnotation.hh>
+
+using namespace std;
+
+typedef BasicBlockGraph::block_id block_id;
+
+const block_id BasicBlockGraph::NO_BLOCK;
+
+static void
+s_add_target (const Microcode *prog, const MicrocodeAddress &tgt,
+	      vector<MicrocodeNode *> &result)
+{
+  try
+    {
+      result.push_back (prog->get_node (tgt));
+    }
+  catch (GetNodeNotFoundExc &)
+    {
+    }
+}
+
+static void
+s_get_successors (const Microcode *prog, const MicrocodeNode *node,
+		  vector<MicrocodeNode *> &result)
+{
+  result.clear ();
+  MicrocodeNode_iterate_successors (*node, succ)
+    {
+      StmtArrow *a = *succ;
+
+      if (a->is_static ())
+	s_add_target (prog, ((StaticArrow *) a)->get_target (), result);
+      else if (a->has_annotation (SolvedJmpAnnotation::ID))
+	{
+	  SolvedJmpAnnotation *sja = (SolvedJmpAnnotation *)
+	    a->get_annotation (SolvedJmpAnnotation::ID);
+
+	  for (SolvedJmpAnnotation::const_iterator i = sja->begin ();
+	       i != sja->end (); i++)
+	    s_add_target (prog, *i, result);
+	}
+    }
+}
+
+static uint32_t
+s_rank (const vector<MicrocodeNode *> &nodes, const MicrocodeNode *n)
+{
+  return lower_bound (nodes.begin (), nodes.end (), n) - nodes.begin ();
+}
+
+BasicBlockGraph::BasicBlockGraph (const Microcode *prog,
+				  const MicrocodeAddress &start)
+  : nodes (), node_offsets (), succ_offsets (), succs (), pred_offsets (),
+    preds (), program_nodes (), blocks ()
+{
+  node_offsets.push_back (0);
+  succ_offsets.push_back (0);
+  if (! prog->has_node_at (start))
+    return;
+
+  /* Nodes are identified by their rank in the sorted array of the
+   * nodes of the program; it is cheaper than hashing them. */
+  program_nodes.assign (prog->begin_nodes (), prog->end_nodes ());
+  sort (program_nodes.begin (), program_nodes.end ());
+
+  /* Number reachable nodes in breadth-first order and record their
+   * successors. */
+  vector<uint32_t> index (program_nodes.size (), (uint32_t) -1);
+  vector<uint32_t> order;
+  vector<uint32_t> nsucc_offsets (1, 0);
+  vector<uint32_t> nsuccs;
+  vector<uint32_t> nb_preds;
+  vector<MicrocodeNode *> tmp;
+
+  order.push_back (s_rank (program_nodes, prog->get_node (start)));
+  index[order.back ()] = 0;
+  nb_preds.push_back (0);
+  for (size_t n = 0; n < order.size (); n++)
+    {
+      s_get_successors (prog, program_nodes[order[n]], tmp);
+      for (size_t s = 0; s < tmp.size (); s++)
+	{
+	  uint32_t r = s_rank (program_nodes, tmp[s]);
+	  if (index[r] == (uint32_t) -1)
+	    {
+	      index[r] = order.size ();
+	      order.push_back (r);
+	      nb_preds.push_back (0);
+	    }
+	  nsuccs.push_back (index[r]);
+	  nb_preds[index[r]]++;
+	}
+      nsucc_offsets.push_back (nsuccs.size ());
+    }
+
+  /* Leaders */
+  size_t N = order.size ();
+  vector<bool> leader (N, false);
+
+  leader[0] = true;
+  for (size_t n = 0; n < N; n++)
+    {
+      uint32_t nb = nsucc_offsets[n + 1] - nsucc_offsets[n];
+      for (uint32_t s = nsucc_offsets[n]; s < nsucc_offsets[n + 1]; s++)
+	if (nb != 1 || nb_preds[nsuccs[s]] != 1)
+	  leader[nsuccs[s]] = true;
+    }
+
+  /* Blocks are numbered in the order of their leaders, so block 0
+   * starts with the start node. */
+  vector<block_id> block_of (N, NO_BLOCK);
+  vector<uint32_t> exit_of;
+
+  blocks.assign (program_nodes.size (), NO_BLOCK);
+
+  for (size_t n = 0; n < N; n++)
+    {
+      if (! leader[n])
+	continue;
+
+      block_id b = exit_of.size ();
+      uint32_t m = n;
+      for (;;)
+	{
+	  block_of[m] = b;
+	  nodes.push_back (program_nodes[order[m]]);
+	  blocks[order[m]] = b;
+	  if (nsucc_offsets[m + 1] - nsucc_offsets[m] != 1 ||
+	      leader[nsuccs[nsucc_offsets[m]]])
+	    break;
+	  m = nsuccs[nsucc_offsets[m]];
+	}
+      exit_of.push_back (m);
+      node_offsets.push_back (nodes.size ());
+    }
+
+  /* Edges */
+  size_t B = exit_of.size ();
+  vector<uint32_t> nb_block_preds (B + 1, 0);
+
+  for (block_id b = 0; b < B; b++)
+    {
+      uint32_t m = exit_of[b];
+      for (uint32_t s = nsucc_offsets[m]; s < nsucc_offsets[m + 1]; s++)
+	{
+	  block_id t = block_of[nsuccs[s]];
+	  succs.push_back (t);
+	  nb_block_preds[t + 1]++;
+	}
+      succ_offsets.push_back (succs.size ());
+    }
+
+  pred_offsets.resize (B + 1);
+  pred_offsets[0] = 0;
+  for (block_id b = 0; b < B; b++)
+    pred_offsets[b + 1] = pred_offsets[b] + nb_block_preds[b + 1];
+  preds.resize (succs.size ());
+
+  vector<uint32_t> fill (pred_offsets.begin (), pred_offsets.end () - 1);
+  for (block_id b = 0; b < B; b++)
+    for (uint32_t s = succ_offsets[b]; s < succ_offsets[b + 1]; s++)
+      preds[fill[succs[s]]++] = b;
+}
+
+BasicBlockGraph::~BasicBlockGraph ()
+{
+}
+
+size_t
+BasicBlockGraph::get_number_of_blocks () const
+{
+  return node_offsets.size () - 1;
+}
+
+size_t
+BasicBlockGraph::get_number_of_edges () const
+{
+  return succs.size ();
+}
+
+block_id
+BasicBlockGraph::get_block (const MicrocodeNode *n) const
+{
+  vector<MicrocodeNode *>::const_iterator i =
+    lower_bound (program_nodes.begin (), program_nodes.end (), n);
+
+  if (i == program_nodes.end () || *i != n)
+    return NO_BLOCK;
+
+  return blocks[i - program_nodes.begin ()];
+}
+
+BasicBlockGraph::node_iterator
+BasicBlockGraph::nodes_begin (block_id b) const
+{
+  assert (b < get_number_of_blocks ());
+
+  return nodes.data () + node_offsets[b];
+}
+
+BasicBlockGraph::node_iterator
+BasicBlockGraph::nodes_end (block_id b) const
+{
+  assert (b < get_number_of_blocks ());
+
+  return nodes.data () + node_offsets[b + 1];
+}
+
+MicrocodeNode *
+BasicBlockGraph::get_entry_node (block_id b) const
+{
+  return *nodes_begin (b);
+}
+
+MicrocodeNode *
+BasicBlockGraph::get_exit_node (block_id b) const
+{
+  return *(nodes_end (b) - 1);
+}
+
+BasicBlockGraph::block_iterator
+BasicBlockGraph::successors_begin (block_id b) const
+{
+  assert (b < get_number_of_blocks ());
+
+  return succs.data () + succ_offsets[b];
+}
+
+BasicBlockGraph::block_iterator
+BasicBlockGraph::successors_end (block_id b) const
+{
+  assert (b < get_number_of_blocks ());
+
+  return succs.data () + succ_offsets[b + 1];
+}
+
+BasicBlockGraph::block_iterator
+BasicBlockGraph::predecessors_begin (block_id b) const
+{
+  assert (b < get_number_of_blocks ());
+
+  return preds.data () + pred_offsets[b];
+}
+
+BasicBlockGraph::block_iterator
+BasicBlockGraph::predecessors_end (block_id b) const
+{
+  assert (b < get_number_of_blocks ());
+
+  return preds.data () + pred_offsets[b + 1];
+}
+
+size_t
+BasicBlockGraph::get_memory_size () const
+{
+  return (sizeof (*this) +
+	  nodes.capacity () * sizeof (MicrocodeNode *) +
+	  (node_offsets.capacity () + succ_offsets.capacity () +
+	   pred_offsets.capacity ()) * sizeof (uint32_t) +
+	  (succs.capacity () + preds.capacity ()) * sizeof (block_id) +
+	  program_nodes.capacity () * sizeof (MicrocodeNode *) +
+	  blocks.capacity () * sizeof (block_id));
+}
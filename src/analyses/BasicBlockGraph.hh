@@ -0,0 +1,102 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef ANALYSES_BASIC_BLOCK_GRAPH_HH
+# define ANALYSES_BASIC_BLOCK_GRAPH_HH
+
+# include <stdint.h>
+# include <vector>
+# include <kernel/Microcode.hh>
+
+/*****************************************************************************/
+/*! \brief Basic blocks of the part of a program reachable from a given
+ *  address.
+ *
+ *  Blocks are identified by their index; block 0 contains the start
+ *  node. A node starts a block if it is the start node, if it has not
+ *  exactly one predecessor or if its predecessor has several
+ *  successors. Successors of a node are the targets of its static
+ *  arrows and the targets of its dynamic arrows that have a
+ *  SolvedJmpAnnotation; targets missing from the program are ignored.
+ *
+ *  The nodes of a block and the successors and predecessors of blocks
+ *  are stored as compressed sparse rows. The graph is built in time
+ *  linear in the number of reachable arrows. It refers to the nodes of
+ *  the program which must outlive it. */
+/*****************************************************************************/
+class BasicBlockGraph
+{
+public:
+  typedef uint32_t block_id;
+  typedef const block_id *block_iterator;
+  typedef MicrocodeNode * const *node_iterator;
+
+  /*! \brief Result of unsuccessful lookups */
+  static const block_id NO_BLOCK = (block_id) -1;
+
+  BasicBlockGraph (const Microcode *prog, const MicrocodeAddress &start);
+  ~BasicBlockGraph ();
+
+  std::size_t get_number_of_blocks () const;
+  std::size_t get_number_of_edges () const;
+
+  /*! \brief Block containing n or NO_BLOCK if n is not reachable. */
+  block_id get_block (const MicrocodeNode *n) const;
+
+  node_iterator nodes_begin (block_id b) const;
+  node_iterator nodes_end (block_id b) const;
+  MicrocodeNode *get_entry_node (block_id b) const;
+  MicrocodeNode *get_exit_node (block_id b) const;
+
+  /*! \brief Successors and predecessors, with one entry per edge in
+   * the order of the arrows of the exit node of the source block. */
+  block_iterator successors_begin (block_id b) const;
+  block_iterator successors_end (block_id b) const;
+  block_iterator predecessors_begin (block_id b) const;
+  block_iterator predecessors_end (block_id b) const;
+
+  std::size_t get_memory_size () const;
+
+private:
+  BasicBlockGraph (const BasicBlockGraph &);
+  BasicBlockGraph &operator= (const BasicBlockGraph &);
+
+  std::vector<MicrocodeNode *> nodes;
+  std::vector<uint32_t> node_offsets;
+  std::vector<uint32_t> succ_offsets;
+  std::vector<block_id> succs;
+  std::vector<uint32_t> pred_offsets;
+  std::vector<block_id> preds;
+  /* Nodes of the program sorted by address in memory, and the block of
+   * each of them (NO_BLOCK if unreachable). */
+  std::vector<MicrocodeNode *> program_nodes;
+  std::vector<block_id> blocks;
+};
+
+#endif /* ! ANALYSES_BASIC_BLOCK_GRAPH_HH */
@@ -30,7 +30,7 @@
 #include "CFG.hh"
 
 #include <algorithm>
-#include <kernel/annotations/SolvedJmpAnnotation.hh>
+#include <analyses/BasicBlockGraph.hh>
 #include <analyses/slicing/Slicing.hh>
 
 using namespace std;
@@ -73,126 +73,8 @@ struct CFG_BasicBlockImpl : public CFG_BasicBlock
 };
 
 
-static vector<MicrocodeNode *> *
-s_build_successors (const Microcode *prog, const MicrocodeNode *node)
-{
-  vector<MicrocodeNode *> *result = new vector<MicrocodeNode *> ();
-
-  MicrocodeNode_iterate_successors (*node, succ)
-    {
-      StmtArrow *a = *succ;
-
-      if (a->is_static ())
-	{
-	  StaticArrow *sa = (StaticArrow *) a;
-	  MicrocodeAddress tgt = sa->get_target ();
-
-	  result->push_back (prog->get_node (tgt));
-	}
-      else if (a->has_annotation (SolvedJmpAnnotation::ID))
-	{
-	  SolvedJmpAnnotation *sja = (SolvedJmpAnnotation *)
-	    a->get_annotation (SolvedJmpAnnotation::ID);
-
-	  for (SolvedJmpAnnotation::const_iterator i = sja->begin ();
-	       i != sja->end (); i++)
-	    result->push_back (prog->get_node (*i));
-	}
-    }
-
-  return result;
-}
-
-static CFG_BasicBlockImpl *
-s_split_basic_block (CFG *cfg, CFG_BasicBlockImpl *bb, MicrocodeNode *new_ep,
-		     map<MicrocodeNode *, CFG_BasicBlock *> &done)
-{
-  vector<MicrocodeNode *>::size_type i;
-  CFG_BasicBlockImpl *result = (CFG_BasicBlockImpl *) cfg->new_node (new_ep);
-
-  for (i = 0; i < bb->nodes.size () && bb->nodes.at (i) != new_ep; i++)
-    /* nop */;
-  int eppos = i;
-  for (i++; i < bb->nodes.size (); i++)
-    {
-      MicrocodeNode *n = bb->nodes.at (i);
-      result->nodes.push_back (n);
-      done[n] = result;
-    }
-  assert (eppos > 0);
-  bb->nodes.resize (eppos);
-
-  // change src of out edges to point to new bb and add these edges to result's
-  // output list
-  for (list<CFG_EdgeImpl *>::iterator e = bb->out.begin ();
-       e !=  bb->out.end (); e++)
-    {
-      (*e)->src = result;
-      result->out.push_back (*e);
-    }
-
-  // create new edge between splitted parts of bb
-  bb->out.clear ();
-  cfg->add_edge (bb, result);
-
-  return result;
-}
-
-static void
-s_add_successor (CFG *cfg, CFG_BasicBlockImpl *&bb, MicrocodeNode *s,
-		 bool merge,
-		 list<CFG_BasicBlockImpl *> &todo,
-		 map<MicrocodeNode *, CFG_BasicBlock *> &done)
-{
-  map<MicrocodeNode *, CFG_BasicBlock *>::iterator sp = done.find (s);
-  CFG_BasicBlockImpl *sbb = NULL;
-
-  if (sp == done.end ())
-    {
-      if (! merge)
-	{
-	  sbb = (CFG_BasicBlockImpl *) cfg->new_node (s);
-	  cfg->add_edge (bb, sbb);
-	  todo.push_back (sbb);
-	}
-      else
-	{
-	  bb->nodes.push_back (s);
-	  done[s] = bb;
-	  todo.push_back (bb);
-	}
-    }
-  else
-    {
-      sbb = (CFG_BasicBlockImpl *) sp->second;
-
-      if (sbb->nodes.at (0) != s)
-	{
-	  // we point in the middle of a BB; split it.
-	  CFG_BasicBlockImpl *nbb = s_split_basic_block (cfg, sbb, s, done);
-	  if (find (todo.begin (), todo.end (), sbb) != todo.end ())
-	    {
-	      todo.remove (sbb);
-	      todo.push_back (nbb);
-	    }
-
-	  if (sbb == bb)
-	    {
-	      cfg->add_edge (nbb, nbb);
-	      bb = nbb;
-	    }
-	  else
-	    cfg->add_edge (bb, nbb);
-	}
-      else
-	{
-	  cfg->add_edge (bb, sbb);
-	}
-    }
-}
-
 CFG::CFG () : GraphInterface<CFG_BasicBlock, CFG_Edge, CFG_NodeStore> (),
-	      nodes (), node2bb ()
+	      nodes ()
 {
 }
 
@@ -209,31 +91,23 @@ CFG::createFromMicrocode (const Microcode *prog, const MicrocodeAddress &start,
 {
   CFG *result = new CFG ();
 
-  MicrocodeNode *ep = prog->get_node (start);
-  CFG_BasicBlockImpl *bb = (CFG_BasicBlockImpl *) result->new_node (ep);
-  result->entrypoint = bb;
-  list<CFG_BasicBlockImpl *> todo;
+  /* throws GetNodeNotFoundExc if start is not in the program */
+  prog->get_node (start);
 
-  result->node2bb[ep] = bb;
-  todo.push_back (bb);
+  BasicBlockGraph graph (prog, start);
+  vector<CFG_BasicBlockImpl *> bbs (graph.get_number_of_blocks ());
 
-  while (! todo.empty())
+  for (BasicBlockGraph::block_id b = 0; b < bbs.size (); b++)
     {
-      bb = *todo.begin ();
-      todo.pop_front();
-
-      ep = bb->nodes.at (bb->nodes.size () - 1);
-      vector<MicrocodeNode *> *succ = s_build_successors (prog, ep);
-
-      for (vector<MicrocodeNode *>::size_type i = 0; i < succ->size (); i++)
-	{
-	  MicrocodeNode *s = succ->at (i);
-	  s_add_successor (result, bb, s, succ->size () == 1, todo,
-			   result->node2bb);
-	}
-
-      delete succ;
+      bbs[b] = (CFG_BasicBlockImpl *)
+	result->new_node (graph.get_entry_node (b));
+      bbs[b]->nodes.assign (graph.nodes_begin (b), graph.nodes_end (b));
     }
+  for (BasicBlockGraph::block_id b = 0; b < bbs.size (); b++)
+    for (BasicBlockGraph::block_iterator s = graph.successors_begin (b);
+	 s != graph.successors_end (b); s++)
+      result->add_edge (bbs[b], bbs[*s]);
+  result->entrypoint = bbs[0];
 
   if (trim)
     {
@@ -357,7 +231,6 @@ CFG::new_node (MicrocodeNode *entry)
 
   result->nodes.push_back (entry);
   nodes.push_back (result);
-  node2bb[entry] = result;
 
   return result;
 }
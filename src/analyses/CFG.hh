@@ -97,7 +97,6 @@ public:
 
 private:
   store_type nodes;
-  std::map<MicrocodeNode *, CFG_BasicBlock *> node2bb;
   node_type *entrypoint;
 };
 
@@ -0,0 +1,318 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <analyses/Dominators.hh>
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+typedef DominatorTree::block_id block_id;
+
+const block_id DominatorTree::NO_BLOCK;
+
+namespace {
+
+/* Graph walked by the algorithm: the block graph itself, or for
+ * post-dominators the reversed graph completed with a virtual exit
+ * node numbered after the blocks. */
+class Walk
+{
+public:
+  Walk (const BasicBlockGraph &g, bool post)
+    : g (g), post (post), exit (g.get_number_of_blocks ()), sinks ()
+  {
+    if (post)
+      for (block_id b = 0; b < exit; b++)
+	if (g.successors_begin (b) == g.successors_end (b))
+	  sinks.push_back (b);
+  }
+
+  size_t size () const { return post ? exit + 1 : exit; }
+
+  block_id root () const { return post ? exit : 0; }
+
+  const block_id *next_begin (block_id b) const {
+    if (! post)
+      return g.successors_begin (b);
+    return b == exit ? sinks.data () : g.predecessors_begin (b);
+  }
+
+  const block_id *next_end (block_id b) const {
+    if (! post)
+      return g.successors_end (b);
+    return b == exit ? sinks.data () + sinks.size () : g.predecessors_end (b);
+  }
+
+  const block_id *prev_begin (block_id b) const {
+    if (! post)
+      return g.predecessors_begin (b);
+    if (b == exit)
+      return &exit;
+    const block_id *s = g.successors_begin (b);
+    return s == g.successors_end (b) ? &exit : s;
+  }
+
+  const block_id *prev_end (block_id b) const {
+    if (! post)
+      return g.predecessors_end (b);
+    if (b == exit)
+      return &exit;
+    const block_id *s = g.successors_end (b);
+    return s == g.successors_begin (b) ? &exit + 1 : s;
+  }
+
+private:
+  const BasicBlockGraph &g;
+  bool post;
+  block_id exit;
+  vector<block_id> sinks;
+};
+
+}
+
+static block_id
+s_intersect (block_id b1, block_id b2, const vector<block_id> &idom,
+	     const vector<uint32_t> &rpo_index)
+{
+  while (b1 != b2)
+    {
+      while (rpo_index[b1] > rpo_index[b2])
+	b1 = idom[b1];
+      while (rpo_index[b2] > rpo_index[b1])
+	b2 = idom[b2];
+    }
+
+  return b1;
+}
+
+DominatorTree::DominatorTree (const BasicBlockGraph &graph, bool post)
+  : post (post), idom (), rpo (), pre (), last (), depth (),
+    children_offsets (), children ()
+{
+  Walk W (graph, post);
+  size_t N = W.size ();
+  size_t B = graph.get_number_of_blocks ();
+
+  idom.assign (N, NO_BLOCK);
+  if (B == 0)
+    {
+      children_offsets.assign (1, 0);
+      return;
+    }
+
+  /* Reverse post-order from the root */
+  vector<uint32_t> rpo_index (N, (uint32_t) -1);
+  vector<pair<block_id, const block_id *> > stack;
+  vector<block_id> order;
+  vector<bool> visited (N, false);
+
+  visited[W.root ()] = true;
+  stack.push_back (make_pair (W.root (), W.next_begin (W.root ())));
+  while (! stack.empty ())
+    {
+      block_id b = stack.back ().first;
+      const block_id *&s = stack.back ().second;
+
+      if (s == W.next_end (b))
+	{
+	  order.push_back (b);
+	  stack.pop_back ();
+	  continue;
+	}
+
+      block_id t = *(s++);
+      if (! visited[t])
+	{
+	  visited[t] = true;
+	  stack.push_back (make_pair (t, W.next_begin (t)));
+	}
+    }
+  reverse (order.begin (), order.end ());
+  for (size_t i = 0; i < order.size (); i++)
+    rpo_index[order[i]] = i;
+
+  /* Cooper, Harvey and Kennedy's fixpoint */
+  bool changed = true;
+
+  idom[W.root ()] = W.root ();
+  while (changed)
+    {
+      changed = false;
+      for (size_t i = 1; i < order.size (); i++)
+	{
+	  block_id b = order[i];
+	  block_id new_idom = NO_BLOCK;
+
+	  for (const block_id *p = W.prev_begin (b); p != W.prev_end (b); p++)
+	    {
+	      if (idom[*p] == NO_BLOCK)
+		continue;
+	      if (new_idom == NO_BLOCK)
+		new_idom = *p;
+	      else
+		new_idom = s_intersect (*p, new_idom, idom, rpo_index);
+	    }
+	  if (idom[b] != new_idom)
+	    {
+	      idom[b] = new_idom;
+	      changed = true;
+	    }
+	}
+    }
+
+  /* Drop the virtual exit and the self-loop of the root */
+  idom[W.root ()] = NO_BLOCK;
+  idom.resize (B);
+  for (size_t i = 0; i < order.size (); i++)
+    if (order[i] < B)
+      rpo.push_back (order[i]);
+  if (post)
+    for (block_id b = 0; b < B; b++)
+      if (idom[b] == W.root ())
+	idom[b] = NO_BLOCK;
+
+  /* Children, depths and interval numbering of the tree */
+  vector<uint32_t> nb_children (B + 1, 0);
+  vector<block_id> roots;
+
+  for (size_t i = 0; i < rpo.size (); i++)
+    {
+      block_id b = rpo[i];
+      if (idom[b] == NO_BLOCK)
+	roots.push_back (b);
+      else
+	nb_children[idom[b] + 1]++;
+    }
+  children_offsets.assign (B + 1, 0);
+  for (block_id b = 0; b < B; b++)
+    children_offsets[b + 1] = children_offsets[b] + nb_children[b + 1];
+  children.resize (children_offsets[B]);
+
+  vector<uint32_t> fill (children_offsets.begin (),
+			 children_offsets.end () - 1);
+  for (size_t i = 0; i < rpo.size (); i++)
+    if (idom[rpo[i]] != NO_BLOCK)
+      children[fill[idom[rpo[i]]]++] = rpo[i];
+
+  pre.assign (B, (uint32_t) -1);
+  last.assign (B, 0);
+  depth.assign (B, -1);
+
+  uint32_t counter = 0;
+  vector<pair<block_id, uint32_t> > tstack;
+  for (size_t r = 0; r < roots.size (); r++)
+    {
+      pre[roots[r]] = counter++;
+      depth[roots[r]] = 0;
+      tstack.push_back (make_pair (roots[r], children_offsets[roots[r]]));
+      while (! tstack.empty ())
+	{
+	  block_id b = tstack.back ().first;
+	  uint32_t &c = tstack.back ().second;
+
+	  if (c == children_offsets[b + 1])
+	    {
+	      last[b] = counter - 1;
+	      tstack.pop_back ();
+	      continue;
+	    }
+
+	  block_id t = children[c++];
+	  pre[t] = counter++;
+	  depth[t] = depth[b] + 1;
+	  tstack.push_back (make_pair (t, children_offsets[t]));
+	}
+    }
+}
+
+DominatorTree::~DominatorTree ()
+{
+}
+
+bool
+DominatorTree::is_post_dominator_tree () const
+{
+  return post;
+}
+
+bool
+DominatorTree::is_reachable (block_id b) const
+{
+  return b < pre.size () && pre[b] != (uint32_t) -1;
+}
+
+block_id
+DominatorTree::get_immediate_dominator (block_id b) const
+{
+  assert (b < idom.size ());
+
+  return idom[b];
+}
+
+int
+DominatorTree::get_depth (block_id b) const
+{
+  assert (b < depth.size ());
+
+  return depth[b];
+}
+
+bool
+DominatorTree::dominates (block_id a, block_id b) const
+{
+  if (! is_reachable (a) || ! is_reachable (b))
+    return false;
+
+  return pre[a] <= pre[b] && pre[b] <= last[a];
+}
+
+DominatorTree::block_iterator
+DominatorTree::children_begin (block_id b) const
+{
+  assert (b + 1 < children_offsets.size ());
+
+  return children.data () + children_offsets[b];
+}
+
+DominatorTree::block_iterator
+DominatorTree::children_end (block_id b) const
+{
+  assert (b + 1 < children_offsets.size ());
+
+  return children.data () + children_offsets[b + 1];
+}
+
+const vector<block_id> &
+DominatorTree::get_reverse_post_order () const
+{
+  return rpo;
+}
@@ -0,0 +1,99 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef ANALYSES_DOMINATORS_HH
+# define ANALYSES_DOMINATORS_HH
+
+# include <vector>
+# include <analyses/BasicBlockGraph.hh>
+
+/*****************************************************************************/
+/*! \brief Dominator or post-dominator tree of a BasicBlockGraph.
+ *
+ *  Immediate dominators are computed with the iterative algorithm of
+ *  Cooper, Harvey and Kennedy ("A Simple, Fast Dominance Algorithm")
+ *  on the reverse post-order of the graph; dominance queries then take
+ *  constant time using the pre- and post-order numbers of the tree.
+ *
+ *  The root of the dominator tree is block 0. Post-dominators are
+ *  computed on the reversed graph from a virtual exit that succeeds
+ *  every block without successors; blocks immediately post-dominated
+ *  by this exit are roots of the post-dominator tree (their immediate
+ *  dominator is NO_BLOCK). Blocks that cannot reach the root (e.g.
+ *  blocks of an infinite loop for post-dominators) are not in the
+ *  tree. */
+/*****************************************************************************/
+class DominatorTree
+{
+public:
+  typedef BasicBlockGraph::block_id block_id;
+  typedef BasicBlockGraph::block_iterator block_iterator;
+
+  static const block_id NO_BLOCK = BasicBlockGraph::NO_BLOCK;
+
+  DominatorTree (const BasicBlockGraph &graph, bool post = false);
+  ~DominatorTree ();
+
+  bool is_post_dominator_tree () const;
+
+  /*! \brief true if b belongs to the tree. */
+  bool is_reachable (block_id b) const;
+
+  /*! \brief NO_BLOCK for roots and blocks out of the tree. */
+  block_id get_immediate_dominator (block_id b) const;
+
+  /*! \brief Depth of b in the tree; roots have depth 0. */
+  int get_depth (block_id b) const;
+
+  /*! \brief true if a (post-)dominates b; a block dominates itself.
+   *  Always false if one of the blocks is not in the tree. */
+  bool dominates (block_id a, block_id b) const;
+
+  block_iterator children_begin (block_id b) const;
+  block_iterator children_end (block_id b) const;
+
+  /*! \brief Blocks of the tree in reverse post-order of the (reversed
+   *  for post-dominators) graph. */
+  const std::vector<block_id> &get_reverse_post_order () const;
+
+private:
+  DominatorTree (const DominatorTree &);
+  DominatorTree &operator= (const DominatorTree &);
+
+  bool post;
+  std::vector<block_id> idom;
+  std::vector<block_id> rpo;
+  std::vector<uint32_t> pre;
+  std::vector<uint32_t> last;
+  std::vector<int> depth;
+  std::vector<uint32_t> children_offsets;
+  std::vector<block_id> children;
+};
+
+#endif /* ! ANALYSES_DOMINATORS_HH */
@@ -0,0 +1,213 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <analyses/LoopNestingForest.hh>
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+typedef LoopNestingForest::block_id block_id;
+typedef LoopNestingForest::loop_id loop_id;
+
+const loop_id LoopNestingForest::NO_LOOP;
+
+namespace {
+
+struct DeeperHeader
+{
+  DeeperHeader (const DominatorTree &dom) : dom (dom) { }
+
+  bool operator () (block_id a, block_id b) const {
+    return dom.get_depth (a) > dom.get_depth (b);
+  }
+
+  const DominatorTree &dom;
+};
+
+}
+
+static loop_id
+s_outermost (vector<loop_id> &outer, loop_id l)
+{
+  while (outer[l] != l)
+    {
+      outer[l] = outer[outer[l]];
+      l = outer[l];
+    }
+
+  return l;
+}
+
+LoopNestingForest::LoopNestingForest (const BasicBlockGraph &graph,
+				      const DominatorTree &dom)
+  : dom (dom), headers (), parents (), depths (),
+    loop_of (graph.get_number_of_blocks (), NO_LOOP)
+{
+  assert (! dom.is_post_dominator_tree ());
+
+  const vector<block_id> &rpo = dom.get_reverse_post_order ();
+  for (size_t i = 0; i < rpo.size (); i++)
+    {
+      block_id h = rpo[i];
+      for (BasicBlockGraph::block_iterator p = graph.predecessors_begin (h);
+	   p != graph.predecessors_end (h); p++)
+	if (dom.dominates (h, *p))
+	  {
+	    headers.push_back (h);
+	    break;
+	  }
+    }
+
+  /* Inner headers are strictly dominated by outer ones, so loops are
+   * built from the deepest headers in the dominator tree. */
+  stable_sort (headers.begin (), headers.end (), DeeperHeader (dom));
+  parents.assign (headers.size (), NO_LOOP);
+
+  vector<loop_id> outer;
+  vector<block_id> todo;
+
+  for (loop_id l = 0; l < headers.size (); l++)
+    {
+      block_id h = headers[l];
+
+      outer.push_back (l);
+      loop_of[h] = l;
+      for (BasicBlockGraph::block_iterator p = graph.predecessors_begin (h);
+	   p != graph.predecessors_end (h); p++)
+	if (*p != h && dom.dominates (h, *p))
+	  todo.push_back (*p);
+
+      while (! todo.empty ())
+	{
+	  block_id b = todo.back ();
+	  todo.pop_back ();
+
+	  if (loop_of[b] == NO_LOOP)
+	    loop_of[b] = l;
+	  else
+	    {
+	      loop_id o = s_outermost (outer, loop_of[b]);
+	      if (o == l)
+		continue;
+	      /* b is in an inner loop; continue from its header. */
+	      parents[o] = l;
+	      outer[o] = l;
+	      b = headers[o];
+	    }
+
+	  for (BasicBlockGraph::block_iterator p = graph.predecessors_begin (b);
+	       p != graph.predecessors_end (b); p++)
+	    if (dom.dominates (h, *p))
+	      todo.push_back (*p);
+	}
+    }
+
+  depths.assign (headers.size (), 1);
+  for (loop_id l = headers.size (); l-- > 0; )
+    if (parents[l] != NO_LOOP)
+      depths[l] = depths[parents[l]] + 1;
+}
+
+LoopNestingForest::~LoopNestingForest ()
+{
+}
+
+size_t
+LoopNestingForest::get_number_of_loops () const
+{
+  return headers.size ();
+}
+
+block_id
+LoopNestingForest::get_header (loop_id l) const
+{
+  assert (l < headers.size ());
+
+  return headers[l];
+}
+
+loop_id
+LoopNestingForest::get_parent (loop_id l) const
+{
+  assert (l < parents.size ());
+
+  return parents[l];
+}
+
+int
+LoopNestingForest::get_depth (loop_id l) const
+{
+  assert (l < depths.size ());
+
+  return depths[l];
+}
+
+loop_id
+LoopNestingForest::get_loop (block_id b) const
+{
+  assert (b < loop_of.size ());
+
+  return loop_of[b];
+}
+
+int
+LoopNestingForest::get_loop_depth (block_id b) const
+{
+  loop_id l = get_loop (b);
+
+  return l == NO_LOOP ? 0 : depths[l];
+}
+
+bool
+LoopNestingForest::contains (loop_id l, block_id b) const
+{
+  /* Parents have greater indexes than their children. */
+  for (loop_id m = get_loop (b); m != NO_LOOP && m <= l; m = parents[m])
+    if (m == l)
+      return true;
+
+  return false;
+}
+
+bool
+LoopNestingForest::is_header (block_id b) const
+{
+  loop_id l = get_loop (b);
+
+  return l != NO_LOOP && headers[l] == b;
+}
+
+bool
+LoopNestingForest::is_back_edge (block_id src, block_id tgt) const
+{
+  return is_header (tgt) && dom.dominates (tgt, src);
+}
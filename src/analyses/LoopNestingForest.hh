@@ -0,0 +1,98 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef ANALYSES_LOOP_NESTING_FOREST_HH
+# define ANALYSES_LOOP_NESTING_FOREST_HH
+
+# include <vector>
+# include <analyses/BasicBlockGraph.hh>
+# include <analyses/Dominators.hh>
+
+/*****************************************************************************/
+/*! \brief Natural loops of a BasicBlockGraph and their nesting.
+ *
+ *  A block h is a loop header if it dominates one of its predecessors
+ *  (a back edge). The loop of h gathers h and the blocks dominated by
+ *  h that reach a back edge to h without going through h. Each block
+ *  belongs to its innermost loop; the parent of a loop is the
+ *  innermost loop that contains its header. Retreating edges that are
+ *  not back edges (irreducible control flow) do not create loops.
+ *
+ *  Loops are numbered from the innermost ones, so the parent of a loop
+ *  has a greater index. The forest is computed in time roughly linear
+ *  in the size of the graph. */
+/*****************************************************************************/
+class LoopNestingForest
+{
+public:
+  typedef BasicBlockGraph::block_id block_id;
+  typedef uint32_t loop_id;
+
+  static const loop_id NO_LOOP = (loop_id) -1;
+
+  /*! \brief 'dom' must be the dominator tree of 'graph' (not the
+   *  post-dominator tree). */
+  LoopNestingForest (const BasicBlockGraph &graph, const DominatorTree &dom);
+  ~LoopNestingForest ();
+
+  std::size_t get_number_of_loops () const;
+
+  block_id get_header (loop_id l) const;
+
+  /*! \brief NO_LOOP for outermost loops. */
+  loop_id get_parent (loop_id l) const;
+
+  /*! \brief Outermost loops have depth 1. */
+  int get_depth (loop_id l) const;
+
+  /*! \brief Innermost loop containing b or NO_LOOP. */
+  loop_id get_loop (block_id b) const;
+
+  /*! \brief Number of loops containing b. */
+  int get_loop_depth (block_id b) const;
+
+  bool contains (loop_id l, block_id b) const;
+
+  bool is_header (block_id b) const;
+
+  /*! \brief true if the edge src -> tgt goes back to the header tgt. */
+  bool is_back_edge (block_id src, block_id tgt) const;
+
+private:
+  LoopNestingForest (const LoopNestingForest &);
+  LoopNestingForest &operator= (const LoopNestingForest &);
+
+  const DominatorTree &dom;
+  std::vector<block_id> headers;
+  std::vector<loop_id> parents;
+  std::vector<int> depths;
+  std::vector<loop_id> loop_of;
+};
+
+#endif /* ! ANALYSES_LOOP_NESTING_FOREST_HH */
@@ -0,0 +1,716 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <analyses/MicrocodeOptimizer.hh>
+
+#include <cassert>
+#include <stdint.h>
+#include <vector>
+#include <kernel/Expressions.hh>
+#include <kernel/expressions/BottomUpApplyVisitor.hh>
+#include <kernel/expressions/ExprRewritingRule.hh>
+#include <kernel/expressions/exprutils.hh>
+#include <utils/stats.hh>
+#include <utils/unordered11.hh>
+
+using namespace std;
+
+static stats::Timer optimizer_timer ("optimizer.run");
+static stats::Counter removed_arrows ("optimizer.removed-arrows");
+static stats::Counter dead_assignments ("optimizer.dead-assignments");
+static stats::Counter propagated_values ("optimizer.propagated-values");
+
+typedef uint64_t s_bits;
+
+static s_bits
+s_mask (int offset, int size)
+{
+  s_bits m = (size >= 64) ? ~((s_bits) 0) : (((s_bits) 1 << size) - 1);
+
+  return m << offset;
+}
+
+/*****************************************************************************/
+// Expression helpers
+/*****************************************************************************/
+
+namespace {
+
+struct RegisterUse
+{
+  const RegisterDesc *reg;
+  int offset;
+  int size;
+};
+
+/* Registers read by an expression, with repetitions. */
+class CollectUses : public ConstBottomUpApplyVisitor
+{
+public:
+  CollectUses (vector<RegisterUse> &uses)
+    : ConstBottomUpApplyVisitor (), uses (uses), reads_memory (false) { }
+
+  virtual void apply (const Expr *e) {
+    if (e->is_RegisterExpr ())
+      {
+	const RegisterExpr *r = (const RegisterExpr *) e;
+	RegisterUse u = { r->get_descriptor (), r->get_bv_offset (),
+			  r->get_bv_size () };
+	uses.push_back (u);
+      }
+    else if (e->is_MemCell ())
+      reads_memory = true;
+  }
+
+  vector<RegisterUse> &uses;
+  bool reads_memory;
+};
+
+/* Replace the bits [offset, offset + size) of 'reg' with 'value'. Every
+ * occurrence of reg must lie within these bits. */
+class SubstituteRegister : public ExprRewritingRule
+{
+public:
+  SubstituteRegister (const RegisterDesc *reg, int offset,
+		      const Expr *value)
+    : ExprRewritingRule (), reg (reg), offset (offset), value (value) { }
+
+  virtual Expr *rewrite (const Expr *F) {
+    if (! F->is_RegisterExpr () ||
+	((const RegisterExpr *) F)->get_descriptor () != reg)
+      return F->ref ();
+    return value->extract_bit_vector (F->get_bv_offset () - offset,
+				      F->get_bv_size ());
+  }
+
+private:
+  const RegisterDesc *reg;
+  int offset;
+  const Expr *value;
+};
+
+/*****************************************************************************/
+// Program representation used by the passes
+/*****************************************************************************/
+
+/* Working copy of the expressions of an arrow; the original program is
+ * left untouched until the optimized one is built. */
+struct Arrow
+{
+  StmtArrow *arrow;
+  int src;
+  /* -1 for dynamic arrows and targets out of the program */
+  int tgt;
+  Expr *guard;
+  /* Assignment */
+  LValue *lval;
+  Expr *rval;
+  /* Jump statement or target of a dynamic arrow */
+  Expr *target;
+  bool dead;
+};
+
+struct Node
+{
+  MicrocodeNode *node;
+  vector<int> succs;
+  vector<int> preds;
+  bool removed;
+};
+
+class Optimizer
+{
+public:
+  Optimizer (const Microcode *mc, const MicrocodeArchitecture *arch);
+  ~Optimizer ();
+
+  void propagate_values ();
+  void eliminate_dead_assignments ();
+  void fold_constants ();
+  void remove_skips ();
+  Microcode *build () const;
+
+  MicrocodeOptimizerReport report;
+
+private:
+  bool is_tmp (const RegisterDesc *reg) const;
+  int get_candidate (const RegisterDesc *reg) const;
+  void add_uses (const Expr *e, vector<s_bits> &live) const;
+  void transfer (const Arrow &a, const vector<s_bits> &out,
+		 vector<s_bits> &live) const;
+  bool defines (const Arrow &a, const RegisterDesc *reg) const;
+  void propagate (int a);
+  void substitute (Expr **e, const RegisterDesc *reg, int offset,
+		   const Expr *value);
+  int resolve (int n) const;
+
+  const Microcode *mc;
+  const MicrocodeArchitecture *arch;
+  vector<Node> nodes;
+  vector<Arrow> arrows;
+  unordered_map<const MicrocodeNode *, int> node_index;
+
+  /* Registers tracked by the liveness analysis. */
+  unordered_map<const RegisterDesc *, int> candidates;
+  vector<s_bits> exit_live;
+};
+
+}
+
+/*****************************************************************************/
+
+Optimizer::Optimizer (const Microcode *mc, const MicrocodeArchitecture *arch)
+  : mc (mc), arch (arch)
+{
+  report.nb_removed_arrows = 0;
+  report.nb_dead_assignments = 0;
+  report.nb_propagated_values = 0;
+
+  for (Microcode::const_node_iterator n = mc->begin_nodes ();
+       n != mc->end_nodes (); n++)
+    {
+      Node N;
+      N.node = *n;
+      N.removed = false;
+      node_index[*n] = nodes.size ();
+      nodes.push_back (N);
+    }
+
+  for (size_t n = 0; n < nodes.size (); n++)
+    {
+      MicrocodeNode_iterate_successors (*nodes[n].node, succ)
+	{
+	  StmtArrow *sa = *succ;
+	  Statement *st = sa->get_stmt ();
+	  Arrow A;
+
+	  A.arrow = sa;
+	  A.src = n;
+	  A.tgt = -1;
+	  A.guard = sa->get_condition ()->ref ();
+	  A.lval = NULL;
+	  A.rval = NULL;
+	  A.target = NULL;
+	  A.dead = false;
+
+	  if (sa->is_static ())
+	    {
+	      MicrocodeNode *tgt = mc->get_target (sa);
+	      if (tgt != NULL)
+		A.tgt = node_index[tgt];
+	    }
+	  else
+	    A.target = ((DynamicArrow *) sa)->get_target ()->ref ();
+
+	  if (st->is_Assignment ())
+	    {
+	      Assignment *as = (Assignment *) st;
+	      A.lval = (LValue *) as->get_lval ()->ref ();
+	      A.rval = as->get_rval ()->ref ();
+	    }
+	  else if (st->is_Jump () && A.target == NULL)
+	    A.target = ((Jump *) st)->get_target ()->ref ();
+
+	  nodes[n].succs.push_back (arrows.size ());
+	  if (A.tgt >= 0)
+	    nodes[A.tgt].preds.push_back (arrows.size ());
+	  arrows.push_back (A);
+	}
+    }
+
+  /* Candidates of dead assignment elimination are the registers
+   * assigned a 1-bit value somewhere (the flags, whether they are
+   * registers or windows of a status register) and temporaries. */
+  unordered_map<string, int> by_label;
+  for (size_t a = 0; a < arrows.size (); a++)
+    {
+      const LValue *lv = arrows[a].lval;
+
+      if (lv == NULL || ! lv->is_RegisterExpr ())
+	continue;
+
+      const RegisterDesc *reg = ((const RegisterExpr *) lv)->get_descriptor ();
+      if (candidates.find (reg) != candidates.end ())
+	continue;
+      if (reg->get_register_size () > 64 ||
+	  ! (lv->get_bv_size () == 1 || is_tmp (reg)))
+	continue;
+
+      unordered_map<string, int>::const_iterator i =
+	by_label.find (reg->get_label ());
+      if (i != by_label.end ())
+	candidates[reg] = i->second;
+      else
+	{
+	  int c = exit_live.size ();
+	  by_label[reg->get_label ()] = c;
+	  candidates[reg] = c;
+	  exit_live.push_back (is_tmp (reg) ? 0 :
+			       s_mask (0, reg->get_register_size ()));
+	}
+    }
+}
+
+Optimizer::~Optimizer ()
+{
+  for (vector<Arrow>::iterator a = arrows.begin (); a != arrows.end (); a++)
+    {
+      a->guard->deref ();
+      if (a->lval != NULL)
+	a->lval->deref ();
+      if (a->rval != NULL)
+	a->rval->deref ();
+      if (a->target != NULL)
+	a->target->deref ();
+    }
+}
+
+bool
+Optimizer::is_tmp (const RegisterDesc *reg) const
+{
+  return arch->has_tmp_register (reg->get_label ());
+}
+
+int
+Optimizer::get_candidate (const RegisterDesc *reg) const
+{
+  unordered_map<const RegisterDesc *, int>::const_iterator i =
+    candidates.find (reg);
+
+  return i == candidates.end () ? -1 : i->second;
+}
+
+/*****************************************************************************/
+// Liveness of candidate registers
+/*****************************************************************************/
+
+void
+Optimizer::add_uses (const Expr *e, vector<s_bits> &live) const
+{
+  if (e == NULL)
+    return;
+
+  vector<RegisterUse> uses;
+  CollectUses collect (uses);
+  e->acceptVisitor (collect);
+
+  for (size_t i = 0; i < uses.size (); i++)
+    {
+      int c = get_candidate (uses[i].reg);
+      if (c >= 0)
+	live[c] |= s_mask (uses[i].offset, uses[i].size);
+    }
+}
+
+void
+Optimizer::transfer (const Arrow &a, const vector<s_bits> &out,
+		     vector<s_bits> &live) const
+{
+  live = out;
+  if (a.dead)
+    {
+      add_uses (a.guard, live);
+      return;
+    }
+
+  if (a.lval != NULL)
+    {
+      if (a.lval->is_RegisterExpr ())
+	{
+	  int c = get_candidate (((RegisterExpr *) a.lval)->get_descriptor ());
+	  if (c >= 0)
+	    live[c] &= ~s_mask (a.lval->get_bv_offset (),
+				a.lval->get_bv_size ());
+	}
+      else if (a.lval->is_MemCell ())
+	add_uses (((MemCell *) a.lval)->get_addr (), live);
+    }
+  add_uses (a.guard, live);
+  add_uses (a.rval, live);
+  add_uses (a.target, live);
+}
+
+void
+Optimizer::eliminate_dead_assignments ()
+{
+  vector<s_bits> live_in (nodes.size () * exit_live.size (), 0);
+  vector<s_bits> out;
+  vector<s_bits> tmp;
+  size_t K = exit_live.size ();
+  bool changed = (K > 0);
+
+  /* Liveness and elimination are iterated since removing an assignment
+   * may kill the registers it was reading. */
+  while (changed)
+    {
+      vector<int> todo;
+      vector<bool> pending (nodes.size (), true);
+
+      for (int n = 0; n < (int) nodes.size (); n++)
+	todo.push_back (n);
+
+      while (! todo.empty ())
+	{
+	  int n = todo.back ();
+	  todo.pop_back ();
+	  pending[n] = false;
+
+	  vector<s_bits> in (K, 0);
+	  if (nodes[n].succs.empty ())
+	    in = exit_live;
+
+	  for (size_t s = 0; s < nodes[n].succs.size (); s++)
+	    {
+	      const Arrow &a = arrows[nodes[n].succs[s]];
+	      if (a.tgt < 0)
+		out = exit_live;
+	      else
+		out.assign (live_in.begin () + a.tgt * K,
+			    live_in.begin () + (a.tgt + 1) * K);
+	      if (a.arrow->get_stmt ()->is_External ())
+		for (size_t c = 0; c < K; c++)
+		  out[c] |= exit_live[c];
+	      transfer (a, out, tmp);
+	      for (size_t c = 0; c < K; c++)
+		in[c] |= tmp[c];
+	    }
+
+	  if (equal (in.begin (), in.end (), live_in.begin () + n * K))
+	    continue;
+	  copy (in.begin (), in.end (), live_in.begin () + n * K);
+	  for (size_t p = 0; p < nodes[n].preds.size (); p++)
+	    {
+	      int src = arrows[nodes[n].preds[p]].src;
+	      if (! pending[src])
+		{
+		  pending[src] = true;
+		  todo.push_back (src);
+		}
+	    }
+	}
+
+      changed = false;
+      for (size_t i = 0; i < arrows.size (); i++)
+	{
+	  Arrow &a = arrows[i];
+	  if (a.dead || a.tgt < 0 || a.lval == NULL ||
+	      ! a.lval->is_RegisterExpr ())
+	    continue;
+
+	  int c = get_candidate (((RegisterExpr *) a.lval)->get_descriptor ());
+	  if (c < 0 || (live_in[a.tgt * K + c] &
+			s_mask (a.lval->get_bv_offset (),
+				a.lval->get_bv_size ())) != 0)
+	    continue;
+	  a.dead = true;
+	  changed = true;
+	  report.nb_dead_assignments++;
+	}
+    }
+}
+
+/*****************************************************************************/
+// Propagation of temporaries
+/*****************************************************************************/
+
+bool
+Optimizer::defines (const Arrow &a, const RegisterDesc *reg) const
+{
+  return (a.lval != NULL && a.lval->is_RegisterExpr () &&
+	  (((RegisterExpr *) a.lval)->get_descriptor ()->get_label () ==
+	   reg->get_label ()));
+}
+
+void
+Optimizer::substitute (Expr **e, const RegisterDesc *reg, int offset,
+		       const Expr *value)
+{
+  if (*e == NULL)
+    return;
+
+  SubstituteRegister rule (reg, offset, value);
+  exprutils::bottom_up_rewrite_and_assign (e, rule);
+}
+
+void
+Optimizer::propagate (int ai)
+{
+  const Arrow &A = arrows[ai];
+  const RegisterExpr *t = (const RegisterExpr *) A.lval;
+  const RegisterDesc *reg = t->get_descriptor ();
+  s_bits defined = s_mask (t->get_bv_offset (), t->get_bv_size ());
+  vector<RegisterUse> value_uses;
+  CollectUses value_collect (value_uses);
+
+  A.rval->acceptVisitor (value_collect);
+  for (size_t i = 0; i < value_uses.size (); i++)
+    if (value_uses[i].reg->get_label () == reg->get_label ())
+      return;
+
+  /* Collect the arrows reading the temporary along the straight-line
+   * sequence of nodes starting at the target of A. */
+  vector<int> sites;
+  size_t nb_uses = 0;
+  int n = A.tgt;
+
+  while (n >= 0 && n != A.src && nodes[n].preds.size () == 1 &&
+	 nodes[n].node->get_loc ().getLocal () != 0)
+    {
+      bool stop = false;
+
+      for (size_t s = 0; s < nodes[n].succs.size (); s++)
+	{
+	  const Arrow &B = arrows[nodes[n].succs[s]];
+	  if (B.dead)
+	    continue;
+
+	  vector<RegisterUse> uses;
+	  CollectUses collect (uses);
+	  size_t nb = 0;
+
+	  B.guard->acceptVisitor (collect);
+	  if (B.rval != NULL)
+	    B.rval->acceptVisitor (collect);
+	  if (B.target != NULL)
+	    B.target->acceptVisitor (collect);
+	  if (B.lval != NULL && B.lval->is_MemCell ())
+	    ((MemCell *) B.lval)->get_addr ()->acceptVisitor (collect);
+
+	  for (size_t i = 0; i < uses.size (); i++)
+	    {
+	      if (uses[i].reg->get_label () != reg->get_label ())
+		continue;
+	      s_bits m = s_mask (uses[i].offset, uses[i].size);
+	      if ((m & defined) != m)
+		return;
+	      nb++;
+	    }
+	  if (nb > 0)
+	    sites.push_back (nodes[n].succs[s]);
+	  nb_uses += nb;
+
+	  /* Values read by an arrow are those before its assignment */
+	  if (defines (B, reg))
+	    stop = true;
+	  for (size_t i = 0; i < value_uses.size () && ! stop; i++)
+	    stop = defines (B, value_uses[i].reg);
+	  if (value_collect.reads_memory && B.lval != NULL &&
+	      B.lval->is_MemCell ())
+	    stop = true;
+	}
+
+      if (stop || nodes[n].succs.size () != 1)
+	break;
+      n = arrows[nodes[n].succs[0]].tgt;
+    }
+
+  bool is_copy = A.rval->is_RegisterExpr () || A.rval->is_Constant ();
+  if (sites.empty () || (! is_copy && nb_uses > 1))
+    return;
+
+  int offset = t->get_bv_offset ();
+  for (size_t i = 0; i < sites.size (); i++)
+    {
+      Arrow &B = arrows[sites[i]];
+      substitute (&B.guard, reg, offset, A.rval);
+      substitute (&B.rval, reg, offset, A.rval);
+      substitute (&B.target, reg, offset, A.rval);
+      if (B.lval != NULL && B.lval->is_MemCell ())
+	substitute ((Expr **) &B.lval, reg, offset, A.rval);
+    }
+  report.nb_propagated_values++;
+}
+
+void
+Optimizer::propagate_values ()
+{
+  for (size_t a = 0; a < arrows.size (); a++)
+    {
+      const Arrow &A = arrows[a];
+
+      if (! A.dead && A.tgt >= 0 && A.lval != NULL &&
+	  A.lval->is_RegisterExpr () &&
+	  is_tmp (((RegisterExpr *) A.lval)->get_descriptor ()))
+	propagate (a);
+    }
+}
+
+/*****************************************************************************/
+// Constant folding and clean-up
+/*****************************************************************************/
+
+void
+Optimizer::fold_constants ()
+{
+  for (size_t a = 0; a < arrows.size (); a++)
+    {
+      Arrow &A = arrows[a];
+
+      if (A.dead)
+	continue;
+      exprutils::simplify (&A.guard);
+      if (A.rval != NULL)
+	exprutils::simplify (&A.rval);
+    }
+}
+
+void
+Optimizer::remove_skips ()
+{
+  for (size_t n = 0; n < nodes.size (); n++)
+    {
+      Node &N = nodes[n];
+
+      if (N.node->get_loc ().getLocal () == 0 || N.node->is_annotated () ||
+	  N.node->get_loc ().equals (mc->entry_point ()) ||
+	  N.preds.size () != 1 || N.succs.size () != 1)
+	continue;
+
+      const Arrow &in = arrows[N.preds[0]];
+      const Arrow &out = arrows[N.succs[0]];
+      if (out.tgt < 0 || out.tgt == (int) n || out.arrow->is_annotated () ||
+	  ! (out.dead || out.arrow->get_stmt ()->is_Skip ()) ||
+	  ! out.guard->is_TrueFormula () ||
+	  in.arrow->get_src ()->get_loc ().getGlobal () !=
+	  N.node->get_loc ().getGlobal ())
+	continue;
+      N.removed = true;
+    }
+
+  /* A cycle made only of removed nodes is unreachable; keep one of its
+   * nodes so that resolve () terminates. */
+  for (size_t n = 0; n < nodes.size (); n++)
+    {
+      int m = n;
+      size_t steps = 0;
+
+      while (nodes[m].removed && steps++ <= nodes.size ())
+	m = arrows[nodes[m].succs[0]].tgt;
+      if (nodes[m].removed)
+	nodes[m].removed = false;
+    }
+
+  for (size_t n = 0; n < nodes.size (); n++)
+    if (nodes[n].removed)
+      report.nb_removed_arrows++;
+}
+
+int
+Optimizer::resolve (int n) const
+{
+  while (n >= 0 && nodes[n].removed)
+    n = arrows[nodes[n].succs[0]].tgt;
+
+  return n;
+}
+
+/*****************************************************************************/
+
+static void
+s_copy_annotations (Annotable *dst, const Annotable *src)
+{
+  for (Annotable::annotation_iterator i = src->begin_annotations ();
+       i != src->end_annotations (); i++)
+    dst->add_annotation (i->first, (Annotation *) i->second->clone ());
+}
+
+Microcode *
+Optimizer::build () const
+{
+  Microcode *result = new Microcode ();
+
+  for (size_t n = 0; n < nodes.size (); n++)
+    {
+      if (nodes[n].removed)
+	continue;
+      MicrocodeNode *src = result->get_or_create_node (nodes[n].node->get_loc ());
+      s_copy_annotations (src, nodes[n].node);
+
+      for (size_t s = 0; s < nodes[n].succs.size (); s++)
+	{
+	  const Arrow &a = arrows[nodes[n].succs[s]];
+	  Statement *orig = a.arrow->get_stmt ();
+	  Statement *st;
+	  StmtArrow *na;
+
+	  if (a.dead || orig->is_Skip ())
+	    st = new Skip ();
+	  else if (orig->is_Assignment ())
+	    st = new Assignment ((LValue *) a.lval->ref (), a.rval->ref ());
+	  else if (orig->is_Jump ())
+	    st = new Jump (a.target->ref ());
+	  else
+	    st = orig->clone ();
+
+	  if (a.arrow->is_dynamic ())
+	    na = src->add_successor (a.guard->ref (), a.target->ref (), st);
+	  else
+	    {
+	      int tgt = resolve (a.tgt);
+	      MicrocodeAddress loc = (tgt >= 0) ?
+		nodes[tgt].node->get_loc () :
+		((StaticArrow *) a.arrow)->get_target ();
+	      na = src->add_successor (a.guard->ref (),
+				       result->get_or_create_node (loc), st);
+	    }
+	  s_copy_annotations (na, a.arrow);
+	}
+    }
+  result->set_entry_point (mc->entry_point ());
+
+  return result;
+}
+
+/*****************************************************************************/
+
+Microcode *
+microcode_optimize (const Microcode *mc, const MicrocodeArchitecture *arch,
+		    MicrocodeOptimizerReport *report)
+{
+  stats::Scope scope (optimizer_timer);
+  Optimizer O (mc, arch);
+
+  /* Dead flags are removed first since they are the main readers of
+   * temporaries. */
+  O.eliminate_dead_assignments ();
+  O.propagate_values ();
+  O.eliminate_dead_assignments ();
+  O.fold_constants ();
+  O.remove_skips ();
+  Microcode *result = O.build ();
+
+  removed_arrows.add (O.report.nb_removed_arrows);
+  dead_assignments.add (O.report.nb_dead_assignments);
+  propagated_values.add (O.report.nb_propagated_values);
+  if (report != NULL)
+    *report = O.report;
+
+  return result;
+}
@@ -0,0 +1,71 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef ANALYSES_MICROCODE_OPTIMIZER_HH
+# define ANALYSES_MICROCODE_OPTIMIZER_HH
+
+# include <cstddef>
+# include <kernel/Microcode.hh>
+# include <kernel/microcode/MicrocodeArchitecture.hh>
+
+/*! \brief Post-decoding clean-up of a recovered program.
+ *
+ *  Decoders assign every flag an instruction may modify, and most of
+ *  these assignments are overwritten by the next instruction before
+ *  being read. The optimizer:
+ *  - propagates the value of temporary registers into the arrows that
+ *    read them within a straight-line sequence of nodes (copies always,
+ *    other values only when read once);
+ *  - turns into skips the assignments of flags (1-bit registers or
+ *    1-bit windows of a register) and of temporary registers whose
+ *    value is never read. Liveness is computed on the whole program;
+ *    every flag is live at dynamic jumps and sink nodes, temporary
+ *    registers are not;
+ *  - removes the nodes inside an instruction (local address != 0) that
+ *    are left with a single incoming arrow and a single unguarded skip;
+ *  - folds constants in guards and right-hand sides with simplify_expr.
+ *
+ *  Nodes at instruction addresses, annotated nodes and arrows, guards
+ *  and jump targets are kept, so the program has the same instruction
+ *  level control flow. Only the values of dead flags and temporaries
+ *  differ. */
+struct MicrocodeOptimizerReport
+{
+  std::size_t nb_removed_arrows;
+  std::size_t nb_dead_assignments;
+  std::size_t nb_propagated_values;
+};
+
+/*! \brief Return an optimized copy of mc. 'arch' tells which registers
+ *  are temporaries. 'report' may be NULL. */
+extern Microcode *
+microcode_optimize (const Microcode *mc, const MicrocodeArchitecture *arch,
+		    MicrocodeOptimizerReport *report = NULL);
+
+#endif /* ! ANALYSES_MICROCODE_OPTIMIZER_HH */
@@ -29,13 +29,20 @@
  */
 #include <analyses/Wp.hh>
 
+#include <cassert>
 #include <list>
+#include <map>
 #include <set>
+#include <sstream>
+#include <stdint.h>
+#include <vector>
+#include <kernel/expressions/ExprRewritingRule.hh>
 #include <kernel/expressions/exprutils.hh>
 #include <kernel/microcode/MicrocodeNode.hh>
 #include <kernel/Microcode.hh>
 #include <utils/graph.hh>
 #include <utils/logs.hh>
+#include <utils/unordered11.hh>
 
 using namespace std;
 using namespace exprutils;
@@ -311,3 +318,614 @@ list<MCPath> sequencialize(Microcode * prg)
   prg->depth_first_run(prg->get_node(prg->entry_point()), v);
   return v.segments;
 }
+
+/*****************************************************************************/
+// Path-merging verification conditions
+/*****************************************************************************/
+
+namespace {
+
+/* The memory is the initial one updated by a sequence of writes; at join
+ * points the memories of the incoming arrows are merged. */
+struct MemoryState
+{
+  enum Kind { INITIAL, WRITE, JOIN } kind;
+  /* WRITE */
+  const Expr *addr;
+  const Expr *value;
+  int offset;
+  int size;
+  const MemoryState *prev;
+  /* JOIN: exclusive conditions of the incoming arrows and their memory */
+  vector<const Expr *> guards;
+  vector<const MemoryState *> states;
+};
+
+/* Current value of the registers, as expressions over the initial
+ * registers and the fresh variables; missing registers are unchanged. */
+typedef map<const RegisterDesc *, const Expr *> RegisterState;
+
+struct State
+{
+  const Expr *reach;
+  RegisterState regs;
+  const MemoryState *mem;
+};
+
+struct ReadKey
+{
+  const MemoryState *mem;
+  const Expr *addr;
+  int offset;
+  int size;
+
+  bool operator< (const ReadKey &o) const {
+    if (mem != o.mem)
+      return mem < o.mem;
+    if (addr != o.addr)
+      return addr < o.addr;
+    if (offset != o.offset)
+      return offset < o.offset;
+    return size < o.size;
+  }
+};
+
+class VCGenerator
+{
+public:
+  VCGenerator ();
+  ~VCGenerator ();
+
+  Expr *compute (const Microcode *prg, const MicrocodeAddress &entry,
+		 const MicrocodeAddress &final, const Expr *post);
+
+  /* rvalue e evaluated in state s (new reference) */
+  Expr *evaluate (const Expr *e, const State &s);
+  /* value of the cell (addr, offset, size) in memory m (new reference) */
+  Expr *read (const MemoryState *m, const Expr *addr, int offset, int size);
+
+private:
+  VCGenerator (const VCGenerator &);
+  VCGenerator &operator= (const VCGenerator &);
+
+  /* the expressions built by the generator are kept in 'pool' until its
+   * destruction; the other containers borrow them. */
+  const Expr *keep (Expr *e);
+  const Expr *fresh (const string &base, int size);
+  void define (const Expr *guard, const Expr *var, const Expr *value);
+  const Expr *land (const Expr *a, const Expr *b);
+  const Expr *lor (const Expr *a, const Expr *b);
+  const Expr *lnot (const Expr *a);
+  const Expr *register_value (const RegisterState &regs,
+			      const RegisterDesc *r);
+  MemoryState *new_memory (MemoryState::Kind kind);
+
+  void merge (const vector<State> &in, State &result);
+  void run (StmtArrow *a, const State &s, State &result);
+  Expr *conjunction (size_t from, size_t to) const;
+
+  vector<Expr *> pool;
+  vector<MemoryState *> memories;
+  vector<const Expr *> definitions;
+  map<ReadKey, const Expr *> reads;
+  int nb_variables;
+};
+
+/* Replace registers and memory cells by their value in a state. */
+class EvaluateInState : public ExprRewritingRule
+{
+public:
+  EvaluateInState (VCGenerator &gen, const State &s)
+    : ExprRewritingRule (), gen (gen), s (s) { }
+
+  virtual Expr *rewrite (const Expr *F) {
+    if (F->is_RegisterExpr ())
+      {
+	const RegisterExpr *r = (const RegisterExpr *) F;
+	RegisterState::const_iterator i = s.regs.find (r->get_descriptor ());
+	if (i == s.regs.end ())
+	  return F->ref ();
+	return i->second->extract_bit_vector (F->get_bv_offset (),
+					      F->get_bv_size ());
+      }
+    if (F->is_MemCell ())
+      return gen.read (s.mem, ((const MemCell *) F)->get_addr (),
+		       F->get_bv_offset (), F->get_bv_size ());
+    return F->ref ();
+  }
+
+private:
+  VCGenerator &gen;
+  const State &s;
+};
+
+}
+
+/* Split e into base + delta; base is NULL for constants. */
+static const Expr *
+s_split_address (const Expr *e, constant_t &delta)
+{
+  if (e->is_Constant ())
+    {
+      delta = ((const Constant *) e)->get_val ();
+      return NULL;
+    }
+  if (e->is_BinaryApp ())
+    {
+      const BinaryApp *ba = (const BinaryApp *) e;
+      if (ba->get_arg2 ()->is_Constant () &&
+	  (ba->get_op () == BV_OP_ADD || ba->get_op () == BV_OP_SUB))
+	{
+	  delta = ((const Constant *) ba->get_arg2 ())->get_val ();
+	  if (ba->get_op () == BV_OP_SUB)
+	    delta = -delta;
+	  return ba->get_arg1 ();
+	}
+    }
+  delta = 0;
+
+  return e;
+}
+
+/* Set d to b - a, as a signed number, when it does not depend on the
+ * values of the registers and memory. */
+static bool
+s_address_difference (const Expr *a, const Expr *b, int64_t &d)
+{
+  constant_t da, db;
+  if (a->get_bv_size () != b->get_bv_size () || a->get_bv_size () > 64 ||
+      s_split_address (a, da) != s_split_address (b, db))
+    return false;
+
+  int size = a->get_bv_size ();
+  uint64_t diff = (uint64_t) (db - da);
+  if (size < 64)
+    {
+      diff &= (((uint64_t) 1) << size) - 1;
+      if (diff & (((uint64_t) 1) << (size - 1)))
+	diff |= ~((((uint64_t) 1) << size) - 1);
+    }
+  d = (int64_t) diff;
+
+  return true;
+}
+
+VCGenerator::VCGenerator ()
+  : pool (), memories (), definitions (), reads (), nb_variables (0)
+{
+}
+
+VCGenerator::~VCGenerator ()
+{
+  for (size_t i = 0; i < pool.size (); i++)
+    pool[i]->deref ();
+  for (size_t i = 0; i < memories.size (); i++)
+    delete memories[i];
+}
+
+const Expr *
+VCGenerator::keep (Expr *e)
+{
+  pool.push_back (e);
+
+  return e;
+}
+
+const Expr *
+VCGenerator::fresh (const string &base, int size)
+{
+  ostringstream oss;
+  oss << base << "!" << nb_variables++;
+
+  return keep (Variable::create (oss.str (), size));
+}
+
+void
+VCGenerator::define (const Expr *guard, const Expr *var, const Expr *value)
+{
+  const Expr *eq =
+    keep (Expr::createEquality (var->ref (), value->ref ()));
+
+  if (guard == NULL || guard->is_TrueFormula ())
+    definitions.push_back (eq);
+  else
+    definitions.push_back (keep (Expr::createImplies (guard->ref (),
+						      eq->ref ())));
+}
+
+const Expr *
+VCGenerator::land (const Expr *a, const Expr *b)
+{
+  if (a->is_TrueFormula ())
+    return b;
+  if (b->is_TrueFormula ())
+    return a;
+
+  return keep (Expr::createLAnd (a->ref (), b->ref ()));
+}
+
+const Expr *
+VCGenerator::lor (const Expr *a, const Expr *b)
+{
+  if (a->is_TrueFormula () || b->is_TrueFormula ())
+    return keep (Constant::True ());
+
+  return keep (Expr::createLOr (a->ref (), b->ref ()));
+}
+
+const Expr *
+VCGenerator::lnot (const Expr *a)
+{
+  return keep (Expr::createLNot (a->ref ()));
+}
+
+const Expr *
+VCGenerator::register_value (const RegisterState &regs, const RegisterDesc *r)
+{
+  RegisterState::const_iterator i = regs.find (r);
+  if (i != regs.end ())
+    return i->second;
+
+  return keep (RegisterExpr::create ((RegisterDesc *) r));
+}
+
+MemoryState *
+VCGenerator::new_memory (MemoryState::Kind kind)
+{
+  MemoryState *m = new MemoryState ();
+  m->kind = kind;
+  m->addr = m->value = NULL;
+  m->offset = m->size = 0;
+  m->prev = NULL;
+  memories.push_back (m);
+
+  return m;
+}
+
+Expr *
+VCGenerator::evaluate (const Expr *e, const State &s)
+{
+  EvaluateInState r (*this, s);
+
+  return exprutils::bottom_up_rewrite (e, r);
+}
+
+Expr *
+VCGenerator::read (const MemoryState *m, const Expr *addr, int offset,
+		   int size)
+{
+  if (m->kind == MemoryState::INITIAL)
+    return MemCell::create (addr->ref (), offset, size);
+
+  ReadKey k = { m, addr, offset, size };
+  map<ReadKey, const Expr *>::const_iterator i = reads.find (k);
+  if (i != reads.end ())
+    return i->second->ref ();
+
+  const Expr *result;
+  if (m->kind == MemoryState::JOIN)
+    {
+      result = fresh ("mem", size);
+      for (size_t s = 0; s < m->states.size (); s++)
+	{
+	  const Expr *v = keep (read (m->states[s], addr, offset, size));
+	  define (m->guards[s], result, v);
+	}
+    }
+  else
+    {
+      bool same_window = (m->offset == offset && m->size == size);
+      int64_t d;
+
+      if (s_address_difference (m->addr, addr, d))
+	{
+	  int64_t wbytes = (m->offset + m->size + 7) / 8;
+	  int64_t rbytes = (offset + size + 7) / 8;
+
+	  if (d == 0 && same_window)
+	    result = m->value;
+	  else if (d >= wbytes || -d >= rbytes)
+	    result = keep (read (m->prev, addr, offset, size));
+	  else
+	    /* the cells overlap partially: the value is unknown */
+	    result = fresh ("mem", size);
+	}
+      else
+	{
+	  const Expr *prev = keep (read (m->prev, addr, offset, size));
+	  const Expr *eq =
+	    keep (Expr::createEquality (addr->ref (), m->addr->ref ()));
+
+	  result = fresh ("mem", size);
+	  if (same_window)
+	    define (eq, result, m->value);
+	  define (lnot (eq), result, prev);
+	}
+    }
+  keep (addr->ref ());
+  reads[k] = result;
+
+  return result->ref ();
+}
+
+void
+VCGenerator::merge (const vector<State> &in, State &result)
+{
+  if (in.size () == 1)
+    {
+      result = in[0];
+      return;
+    }
+
+  /* the first arrow whose condition holds is taken, so that the
+   * definitions are never contradictory. */
+  vector<const Expr *> guards;
+  const Expr *taken = in[0].reach;
+  guards.push_back (in[0].reach);
+  for (size_t i = 1; i < in.size (); i++)
+    {
+      guards.push_back (land (in[i].reach, lnot (taken)));
+      taken = lor (taken, in[i].reach);
+    }
+
+  result.reach = fresh ("reach", 1);
+  define (NULL, result.reach, taken);
+
+  result.regs.clear ();
+  for (size_t i = 0; i < in.size (); i++)
+    for (RegisterState::const_iterator r = in[i].regs.begin ();
+	 r != in[i].regs.end (); r++)
+      {
+	if (result.regs.find (r->first) != result.regs.end ())
+	  continue;
+
+	vector<const Expr *> values;
+	bool same = true;
+	for (size_t j = 0; j < in.size (); j++)
+	  {
+	    values.push_back (register_value (in[j].regs, r->first));
+	    same = same && values[j] == values[0];
+	  }
+	if (same)
+	  {
+	    result.regs[r->first] = values[0];
+	    continue;
+	  }
+
+	const Expr *v = fresh (r->first->get_label (),
+			       r->first->get_register_size ());
+	for (size_t j = 0; j < in.size (); j++)
+	  define (guards[j], v, values[j]);
+	result.regs[r->first] = v;
+      }
+
+  bool same = true;
+  for (size_t i = 1; i < in.size (); i++)
+    same = same && in[i].mem == in[0].mem;
+  if (same)
+    result.mem = in[0].mem;
+  else
+    {
+      MemoryState *m = new_memory (MemoryState::JOIN);
+      m->guards = guards;
+      for (size_t i = 0; i < in.size (); i++)
+	m->states.push_back (in[i].mem);
+      result.mem = m;
+    }
+}
+
+void
+VCGenerator::run (StmtArrow *a, const State &s, State &result)
+{
+  result = s;
+  result.reach = land (s.reach, keep (evaluate (a->get_condition (), s)));
+
+  Statement *st = a->get_stmt ();
+  if (st->is_External ())
+    throw WpException ("verification_condition: external statement at " +
+		       a->get_origin ().to_string ());
+  if (! st->is_Assignment ())
+    return;
+
+  Assignment *as = (Assignment *) st;
+  const Expr *value = keep (evaluate (as->get_rval (), s));
+  const LValue *lv = as->get_lval ();
+
+  if (lv->is_MemCell ())
+    {
+      MemoryState *m = new_memory (MemoryState::WRITE);
+      m->addr = keep (evaluate (((const MemCell *) lv)->get_addr (), s));
+      m->value = value;
+      m->offset = lv->get_bv_offset ();
+      m->size = lv->get_bv_size ();
+      m->prev = s.mem;
+      result.mem = m;
+      return;
+    }
+
+  assert (lv->is_RegisterExpr ());
+  const RegisterDesc *r = ((const RegisterExpr *) lv)->get_descriptor ();
+  int rsize = r->get_register_size ();
+  int off = lv->get_bv_offset ();
+  int size = lv->get_bv_size ();
+
+  if (off != 0 || size != rsize)
+    {
+      /* the other bits of the register are kept */
+      const Expr *old = register_value (s.regs, r);
+      Expr *v = value->ref ();
+
+      if (off > 0)
+	v = Expr::createConcat (v, old->extract_bit_vector (0, off));
+      if (off + size < rsize)
+	v = Expr::createConcat (old->extract_bit_vector (off + size,
+							 rsize - off - size),
+				v);
+      value = keep (v);
+    }
+
+  if (value->is_Constant () || value->is_Variable () ||
+      value->is_RegisterExpr ())
+    result.regs[r] = value;
+  else
+    {
+      const Expr *v = fresh (r->get_label (), rsize);
+      define (NULL, v, value);
+      result.regs[r] = v;
+    }
+}
+
+/* balanced, to keep the depth of the formula logarithmic */
+Expr *
+VCGenerator::conjunction (size_t from, size_t to) const
+{
+  if (from == to)
+    return Constant::True ();
+  if (from + 1 == to)
+    return definitions[from]->ref ();
+
+  size_t mid = from + (to - from) / 2;
+
+  return Expr::createLAnd (conjunction (from, mid), conjunction (mid, to));
+}
+
+Expr *
+VCGenerator::compute (const Microcode *prg, const MicrocodeAddress &entry,
+		      const MicrocodeAddress &final, const Expr *post)
+{
+  if (! prg->has_node_at (entry) || ! prg->has_node_at (final))
+    return Constant::True ();
+
+  /* Nodes reachable from entry without going through final, and the
+   * static arrows between them. */
+  vector<MicrocodeNode *> nodes;
+  vector< vector< pair<StmtArrow *, int> > > succs;
+  vector< vector<int> > preds;
+  unordered_map<const MicrocodeNode *, int> index;
+
+  nodes.push_back (prg->get_node (entry));
+  index[nodes[0]] = 0;
+  for (size_t n = 0; n < nodes.size (); n++)
+    {
+      succs.push_back (vector< pair<StmtArrow *, int> > ());
+      preds.resize (nodes.size ());
+      if (nodes[n]->get_loc ().equals (final))
+	continue;
+      MicrocodeNode_iterate_successors (*nodes[n], succ)
+	{
+	  if (! (*succ)->is_static ())
+	    continue;
+	  MicrocodeNode *t = prg->get_target (*succ);
+	  if (t == NULL)
+	    continue;
+	  if (index.find (t) == index.end ())
+	    {
+	      index[t] = nodes.size ();
+	      nodes.push_back (t);
+	      preds.resize (nodes.size ());
+	    }
+	  succs[n].push_back (make_pair (*succ, index[t]));
+	  preds[index[t]].push_back (n);
+	}
+    }
+
+  unordered_map<const MicrocodeNode *, int>::const_iterator f =
+    index.find (prg->get_node (final));
+  if (f == index.end ())
+    return Constant::True ();
+
+  /* Keep the nodes from which final is reachable and sort them in
+   * topological order. */
+  vector<bool> useful (nodes.size (), false);
+  vector<int> todo (1, f->second);
+  useful[f->second] = true;
+  while (! todo.empty ())
+    {
+      int n = todo.back ();
+      todo.pop_back ();
+      for (size_t p = 0; p < preds[n].size (); p++)
+	if (! useful[preds[n][p]])
+	  {
+	    useful[preds[n][p]] = true;
+	    todo.push_back (preds[n][p]);
+	  }
+    }
+
+  vector<int> nb_preds (nodes.size (), 0);
+  for (size_t n = 0; n < nodes.size (); n++)
+    if (useful[n])
+      for (size_t s = 0; s < succs[n].size (); s++)
+	if (useful[succs[n][s].second])
+	  nb_preds[succs[n][s].second]++;
+
+  vector< vector<State> > incoming (nodes.size ());
+  vector<int> ready (1, 0);
+  size_t nb_done = 0;
+  State result;
+
+  incoming[0].push_back (State ());
+  incoming[0][0].reach = keep (Constant::True ());
+  incoming[0][0].mem = new_memory (MemoryState::INITIAL);
+  while (! ready.empty ())
+    {
+      int n = ready.back ();
+      ready.pop_back ();
+      nb_done++;
+
+      State s;
+      merge (incoming[n], s);
+      vector<State> ().swap (incoming[n]);
+      if (n == f->second)
+	{
+	  result = s;
+	  continue;
+	}
+
+      for (size_t i = 0; i < succs[n].size (); i++)
+	{
+	  int t = succs[n][i].second;
+	  if (! useful[t])
+	    continue;
+	  incoming[t].push_back (State ());
+	  run (succs[n][i].first, s, incoming[t].back ());
+	  if (--nb_preds[t] == 0)
+	    ready.push_back (t);
+	}
+    }
+
+  size_t nb_useful = 0;
+  for (size_t n = 0; n < nodes.size (); n++)
+    nb_useful += useful[n] ? 1 : 0;
+  if (nb_done != nb_useful)
+    throw WpException ("verification_condition: cycle between " +
+		       entry.to_string () + " and " + final.to_string ());
+
+  Expr *ok = evaluate (post, result);
+  if (! result.reach->is_TrueFormula ())
+    ok = Expr::createImplies (result.reach->ref (), ok);
+  if (definitions.empty ())
+    return ok;
+
+  return Expr::createImplies (conjunction (0, definitions.size ()), ok);
+}
+
+Expr *
+verification_condition (const Microcode *prg, const MicrocodeAddress &entry,
+			const MicrocodeAddress &final, const Expr *post)
+  throw (WpException)
+{
+  VCGenerator gen;
+
+  return gen.compute (prg, entry, final, post);
+}
+
+ExprSolver::Result
+check_verification_condition (ExprSolver *solver, const Expr *vc)
+  throw (ExprSolver::UnexpectedResponseException)
+{
+  Expr *neg = Expr::createLNot (vc->ref ());
+  ExprSolver::Result result = solver->check_sat (neg, true);
+  neg->deref ();
+
+  return result;
+}
@@ -31,7 +31,15 @@
 #define WP_HH
 
 #include <list>
+#include <stdexcept>
 #include <kernel/Microcode.hh>
+#include <kernel/expressions/ExprSolver.hh>
+
+class WpException : public std::runtime_error
+{
+public:
+  WpException (const std::string &msg) : std::runtime_error (msg) { }
+};
 
 /*! \brief Compute the weakest precondition for the current formula
  *  by reversing the statement.
@@ -51,6 +59,34 @@ weakest_precondition(Expr * post, StmtArrow *arrow);
 Expr *
 weakest_precondition(Expr * post, MCPath &p);
 
+/*! \brief Verification condition stating that post holds whenever an
+ *  execution starting at entry reaches final.
+ *
+ *  The paths from entry to final are not enumerated: the nodes between
+ *  them are processed once, in topological order. Each assignment
+ *  introduces a fresh variable defined by an equality (passification);
+ *  at join points the values coming from the incoming arrows are merged
+ *  into fresh variables, guarded by the condition of each arrow. The
+ *  size of the result is thus linear in the number of arrows, whereas
+ *  the paths may be exponentially many.
+ *
+ *  The result is valid if and only if post holds at final on every
+ *  path; its fresh variables are implicitly universally quantified.
+ *  Only static arrows are followed. Like weakest_precondition, two
+ *  memory cells are considered as aliases only when their addresses are
+ *  equal. A cycle between entry and final or an External statement
+ *  raises WpException. */
+Expr *
+verification_condition (const Microcode *prg, const MicrocodeAddress &entry,
+			const MicrocodeAddress &final, const Expr *post)
+  throw (WpException);
+
+/*! \brief Submit the negation of vc to solver. UNSAT means that vc is
+ *  valid; SAT means that some path violates the postcondition. */
+ExprSolver::Result
+check_verification_condition (ExprSolver *solver, const Expr *vc)
+  throw (ExprSolver::UnexpectedResponseException);
+
 /*! Sequencialisation of the program */
 std::list< MCPath >
 sequencialize (Microcode * prg);
@@ -2,11 +2,15 @@
 # define ABSTRACTMEMORYTRAVERSAL_HH
 
 # include <list>
+# include <set>
+# include <string>
+# include <ctime>
 # include <decoders/Decoder.hh>
 # include <utils/logs.hh>
 # include <kernel/Microcode.hh>
 # include <kernel/annotations/AsmAnnotation.hh>
 # include <kernel/annotations/NextInstAnnotation.hh>
+# include <io/expressions/expr-binary.hh>
 # include <utils/unordered11.hh>
 
 template<typename AlgoSpec>
@@ -19,7 +23,14 @@ class AbstractMemoryTraversal
   ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (bool, warn_on_unsolved_dynamic_jumps, \
 				      false)				\
   ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (bool, warn_skipped_dynamic_jumps, false) \
-  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, number_of_visits_per_address, 1)
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, number_of_visits_per_address, 1) \
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (std::string, checkpoint_filename, "") \
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, checkpoint_period, 0)	\
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, max_time, 0)			\
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, max_states, 0)		\
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, max_expressions, 0)		\
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, max_rss, 0)			\
+  ABSTRACT_MEMORY_TRAVERSAL_PROPERTY (int, max_solver_calls, 0)
 # undef ABSTRACT_MEMORY_TRAVERSAL_PROPERTY
 
 public:
@@ -46,6 +57,35 @@ public:
   void compute (const std::list<ConcreteAddress> &entrypoints,
 		Microcode *result);
 
+  /*! \brief Continue the computation saved in the checkpoint file
+   *  'filename'. The partial program stored in the checkpoint is added to
+   *  'result' which should be empty.
+   *
+   *  The checkpoint may also come from a completed computation that is
+   *  extended incrementally: states already explored are kept in the state
+   *  space and decoded instructions are reused, so only arrows reachable
+   *  from new states are traversed. New 'entrypoints' are explored from
+   *  their initial state. If 'stubs' is not NULL and its stubs are missing
+   *  from the checkpoint, they are added and every dynamic jump already
+   *  reached is examined again since its targets may now be stubbed. */
+  void resume (const std::string &filename,
+	       const std::list<ConcreteAddress> &entrypoints,
+	       const Microcode *stubs, Microcode *result)
+    throw (BinaryReader::Exception);
+
+  /*! \brief Write the worklist, the visits counters, the state space and
+   *  the program computed so far into the file 'filename'. */
+  void save_checkpoint (const std::string &filename) const;
+
+  /*! \brief Name of the budget (time, states, ...) that has stopped the
+   *  last computation or an empty string if none has been exceeded. Budgets
+   *  are given by the max_* properties; 0 means unbounded. */
+  const std::string &get_exhausted_budget () const;
+
+  /*! \brief Fill 'result' with the addresses that remain to be explored:
+   *  sources of pending arrows and entrypoints not yet processed. */
+  void get_pending_addresses (std::set<address_t> &result) const;
+
 protected:
   virtual MicrocodeNode *get_node (const ProgramPoint *pp)
     throw (Decoder::Exception);
@@ -57,6 +97,13 @@ protected:
   virtual void computePendingArrowsFor (State *s)
     throw (Decoder::Exception);
 private:
+  void run ();
+  bool check_budgets (bool all);
+  void load_checkpoint (const std::string &filename)
+    throw (BinaryReader::Exception);
+  bool add_stubs (const Microcode *stubs);
+  void requeue_dynamic_jumps ();
+
   ConcreteMemory *memory;
   std::list<PendingArrow> worklist;
   Stepper *stepper;
@@ -64,7 +111,12 @@ private:
   Microcode *program;
   StateSpace *states;
   std::unordered_map<address_t,int> visits;
+  std::list<ConcreteAddress> pending_entrypoints;
   bool stop_computation;
+  time_t next_checkpoint;
+  time_t start_time;
+  std::size_t start_solver_calls;
+  std::string exhausted_budget;
 
 # define ABSTRACT_MEMORY_TRAVERSAL_PROPERTY(type_, name_, defval_)	\
   private: type_ name_; \
@@ -50,6 +50,13 @@ public:
     traversal->set_warn_on_unsolved_dynamic_jumps (F->get_warn_on_unsolved_dynamic_jumps ());
     traversal->set_warn_skipped_dynamic_jumps (F->get_warn_skipped_dynamic_jumps ());
     traversal->set_number_of_visits_per_address (F->get_max_number_of_visits_per_address ());
+    traversal->set_checkpoint_filename (F->get_checkpoint_filename ());
+    traversal->set_checkpoint_period (F->get_checkpoint_period ());
+    traversal->set_max_time (F->get_max_time ());
+    traversal->set_max_states (F->get_max_states ());
+    traversal->set_max_expressions (F->get_max_expressions ());
+    traversal->set_max_rss (F->get_max_rss ());
+    traversal->set_max_solver_calls (F->get_max_solver_calls ());
   }
 
   virtual void setup (AlgorithmFactory *factory)
@@ -68,6 +75,12 @@ public:
     traversal->compute (entrypoints, result);
   }
 
+  virtual void resume (const std::string &checkpoint,
+		       const std::list<ConcreteAddress> &ca,
+		       const Microcode *stubs, Microcode *result) {
+    traversal->resume (checkpoint, ca, stubs, result);
+  }
+
 private:
   friend class AlgorithmFactory;
   Stepper *stepper;
@@ -160,6 +173,7 @@ GenAlgorithm<SymbolicSimulator>::setup_stepper (AlgorithmFactory *F)
     }
   stepper->set_dynamic_jump_threshold (F->get_dynamic_jumps_threshold ());
   stepper->set_map_dynamic_jumps_to_memory (F->get_map_dynamic_jumps_to_memory ());
+  stepper->set_array_memory_model (F->get_array_memory_model ());
 }
 
 AlgorithmFactory::Algorithm *
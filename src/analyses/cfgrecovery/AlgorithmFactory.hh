@@ -2,6 +2,7 @@
 # define ALGORITHMFACTORY_HH
 
 # include <stdexcept>
+# include <string>
 # include <kernel/Microcode.hh>
 # include <decoders/Decoder.hh>
 
@@ -17,7 +18,15 @@ class AlgorithmFactory
   ALGORITHM_FACTORY_PROPERTY (bool, warn_skipped_dynamic_jumps, false)	\
   ALGORITHM_FACTORY_PROPERTY (bool, map_dynamic_jumps_to_memory, false)	\
   ALGORITHM_FACTORY_PROPERTY (int, dynamic_jumps_threshold, 1000) 	\
-  ALGORITHM_FACTORY_PROPERTY (int, max_number_of_visits_per_address, 1)
+  ALGORITHM_FACTORY_PROPERTY (bool, array_memory_model, false)		\
+  ALGORITHM_FACTORY_PROPERTY (int, max_number_of_visits_per_address, 1) \
+  ALGORITHM_FACTORY_PROPERTY (std::string, checkpoint_filename, "")	\
+  ALGORITHM_FACTORY_PROPERTY (int, checkpoint_period, 0)		\
+  ALGORITHM_FACTORY_PROPERTY (int, max_time, 0)				\
+  ALGORITHM_FACTORY_PROPERTY (int, max_states, 0)			\
+  ALGORITHM_FACTORY_PROPERTY (int, max_expressions, 0)			\
+  ALGORITHM_FACTORY_PROPERTY (int, max_rss, 0)				\
+  ALGORITHM_FACTORY_PROPERTY (int, max_solver_calls, 0)
 
 public:
   class Exception : public std::runtime_error {
@@ -41,6 +50,9 @@ public:
     virtual void stop () = 0;
     virtual void compute (const std::list<ConcreteAddress> &ca,
 			  Microcode *result) = 0;
+    virtual void resume (const std::string &checkpoint,
+			 const std::list<ConcreteAddress> &ca,
+			 const Microcode *stubs, Microcode *result) = 0;
   };
 
   AlgorithmFactory ();
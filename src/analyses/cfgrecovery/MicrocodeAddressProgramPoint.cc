@@ -54,3 +54,20 @@ MicrocodeAddressProgramPoint::output_text (std::ostream &out) const
 {
   out << address;
 }
+
+void
+MicrocodeAddressProgramPoint::save (ExprBinaryWriter &out) const
+{
+  out.write_uint (address.getGlobal ());
+  out.write_uint (address.getLocal ());
+}
+
+MicrocodeAddressProgramPoint *
+MicrocodeAddressProgramPoint::restore (ExprBinaryReader &in)
+  throw (BinaryReader::Exception)
+{
+  address_t global = in.read_uint ();
+  address_t local = in.read_uint ();
+
+  return new MicrocodeAddressProgramPoint (MicrocodeAddress (global, local));
+}
@@ -2,6 +2,7 @@
 # define MICROCODEADDRESSPROGRAMPOINT_HH
 
 # include <analyses/cfgrecovery/AbstractProgramPoint.hh>
+# include <io/expressions/expr-binary.hh>
 
 class MicrocodeAddressProgramPoint
   : public AbstractProgramPoint<MicrocodeAddressProgramPoint>
@@ -23,6 +24,10 @@ public:
 
   virtual void output_text (std::ostream &out) const;
 
+  void save (ExprBinaryWriter &out) const;
+  static MicrocodeAddressProgramPoint *restore (ExprBinaryReader &in)
+    throw (BinaryReader::Exception);
+
 private:
   MicrocodeAddress address;
 };
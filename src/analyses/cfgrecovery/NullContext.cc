@@ -26,3 +26,15 @@ NullContext::output_text (std::ostream &out) const
 {
   out << "null context";
 }
+
+void
+NullContext::save (ExprBinaryWriter &) const
+{
+}
+
+NullContext *
+NullContext::restore (ExprBinaryReader &, const ConcreteMemory *)
+  throw (BinaryReader::Exception)
+{
+  return new NullContext ();
+}
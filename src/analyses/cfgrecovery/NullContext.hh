@@ -2,6 +2,8 @@
 # define NULLCONTEXT_HH
 
 # include <analyses/cfgrecovery/AbstractContext.hh>
+# include <domains/concrete/ConcreteMemory.hh>
+# include <io/expressions/expr-binary.hh>
 
 class NullContext : public AbstractContext
 {
@@ -14,6 +16,11 @@ public:
   virtual std::size_t hashcode () const;
 
   virtual void output_text (std::ostream &out) const;
+
+  void save (ExprBinaryWriter &out) const;
+  static NullContext *restore (ExprBinaryReader &in,
+			       const ConcreteMemory *base)
+    throw (BinaryReader::Exception);
 };
 
 #endif /* ! NULLCONTEXT_HH */
@@ -32,6 +32,10 @@ public:
     virtual std::size_t hashcode () const;
     virtual void output_text (std::ostream &out) const;
 
+    void save (ExprBinaryWriter &out) const;
+    static Context *restore (ExprBinaryReader &in, const ConcreteMemory *base)
+      throw (BinaryReader::Exception);
+
   private:
     CallStack stack;
     std::size_t hvalue;
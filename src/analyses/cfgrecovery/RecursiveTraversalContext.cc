@@ -88,3 +88,25 @@ RecursiveTraversal::Context::compute_hvalue ()
        i++)
     hvalue = (hvalue << 3) + 13 * (i->get_address ());
 }
+
+void
+RecursiveTraversal::Context::save (ExprBinaryWriter &out) const
+{
+  out.write_uint (stack.size ());
+  for (CallStack::const_iterator i = stack.begin (); i != stack.end (); i++)
+    out.write_uint (i->get_address ());
+}
+
+RecursiveTraversal::Context *
+RecursiveTraversal::Context::restore (ExprBinaryReader &in,
+				      const ConcreteMemory *)
+  throw (BinaryReader::Exception)
+{
+  CallStack cs;
+  uint64_t size = in.read_uint ();
+
+  for (uint64_t i = 0; i < size; i++)
+    cs.push_back (ConcreteAddress (in.read_uint ()));
+
+  return new Context (cs);
+}
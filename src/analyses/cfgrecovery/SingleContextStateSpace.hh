@@ -9,8 +9,12 @@
 template <typename State>
 class SingleContextStateSpace : public AbstractStateSpace<State>
 {
+  typedef std::unordered_set<State *, HashPtrFunctor<State>,
+  			     EqualsPtrFunctor<State> > StateTable;
 
 public:
+  typedef typename StateTable::const_iterator const_iterator;
+
   SingleContextStateSpace ();
 
   virtual ~SingleContextStateSpace ();
@@ -18,10 +22,10 @@ public:
   virtual State *find_or_add_state (State *s);
   virtual std::size_t size () const;
 
-private:
-  typedef std::unordered_set<State *, HashPtrFunctor<State>,
-  			     EqualsPtrFunctor<State> > StateTable;
+  virtual const_iterator begin () const;
+  virtual const_iterator end () const;
 
+private:
   StateTable states;
 };
 
@@ -29,12 +29,15 @@
  */
 
 #include <kernel/annotations/SolvedJmpAnnotation.hh>
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <stdio.h>
 #include <utils/tools.hh>
 #include <kernel/Expressions.hh>
 #include <kernel/expressions/ConditionalSet.hh>
 #include <kernel/expressions/exprutils.hh>
+#include <kernel/microcode/FrozenMicrocode.hh>
 #include "Slicing.hh"
 
 using namespace std;
@@ -408,7 +411,8 @@ DataDependencyLocalContext::run_backward (StaticArrow *arr)
 	Expr::createEquality(ConditionalSet::EltSymbol (lval->get_bv_size ()), lval->ref ());
 
       // The variable TMP is used to hide form EltSymbol = lval when one replaces lval by rval.
-      Variable *tmp = Variable::create ("TMP", BV_DEFAULT_SIZE);
+      // It stands for a formula, hence its size.
+      Variable *tmp = Variable::create ("TMP", 1);
       bottom_up_rewrite_pattern_and_assign (&(new_context->the_lvalues),
 					    reg_pattern, VarList (), tmp);
       reg_pattern->deref ();
@@ -502,6 +506,283 @@ bool DataDependencyLocalContext::merge(DataDependencyLocalContext *other)
   return ConditionalSet::cs_union(&(the_lvalues), other->the_lvalues);
 }
 
+/*****************************************************************************/
+// SimpleDataDependency implementation
+/*****************************************************************************/
+
+#define WORD_BITS 64
+
+static bool
+s_test (const vector<uint64_t> &set, int i)
+{
+  size_t w = i / WORD_BITS;
+
+  return w < set.size () && (set[w] >> (i % WORD_BITS)) & 1;
+}
+
+static bool
+s_set (vector<uint64_t> &set, int i)
+{
+  size_t w = i / WORD_BITS;
+  uint64_t bit = (uint64_t) 1 << (i % WORD_BITS);
+
+  if (w >= set.size ())
+    set.resize (w + 1, 0);
+  if (set[w] & bit)
+    return false;
+  set[w] |= bit;
+
+  return true;
+}
+
+/* set |= other - { except } */
+static bool
+s_union (vector<uint64_t> &set, const vector<uint64_t> &other, int except)
+{
+  bool changed = false;
+
+  if (set.size () < other.size ())
+    set.resize (other.size (), 0);
+  for (size_t w = 0; w < other.size (); w++)
+    {
+      uint64_t bits = other[w];
+
+      if (except >= 0 && w == (size_t) except / WORD_BITS)
+	bits &= ~((uint64_t) 1 << (except % WORD_BITS));
+      if ((set[w] | bits) != set[w])
+	{
+	  set[w] |= bits;
+	  changed = true;
+	}
+    }
+
+  return changed;
+}
+
+SimpleDataDependency::SimpleDataDependency (const Microcode *prg,
+					    const list<LocatedLValue> &seeds)
+  : program (new FrozenMicrocode (prg)), failed (false)
+{
+  typedef FrozenMicrocode::node_id node_id;
+  size_t nb_nodes = program->get_number_of_nodes ();
+
+  sets.resize (nb_nodes);
+  pending.assign (nb_nodes, false);
+
+  /* Post-order numbering; nodes that cannot be reached from the entry
+   * point are numbered from the lowest address. */
+  rank.assign (nb_nodes, FrozenMicrocode::NO_NODE);
+  order.reserve (nb_nodes);
+  vector<pair<node_id, FrozenMicrocode::arrow_iterator> > stack;
+  node_id entry = program->get_entry_point ();
+
+  for (node_id root = 0; root <= nb_nodes; root++)
+    {
+      node_id n = (root == 0) ? entry : root - 1;
+
+      if (n == FrozenMicrocode::NO_NODE || rank[n] != FrozenMicrocode::NO_NODE)
+	continue;
+      rank[n] = 0;
+      stack.push_back (make_pair (n, program->successors_begin (n)));
+      while (! stack.empty ())
+	{
+	  node_id m = stack.back ().first;
+	  FrozenMicrocode::arrow_iterator &a = stack.back ().second;
+
+	  if (a == program->successors_end (m))
+	    {
+	      rank[m] = order.size ();
+	      order.push_back (m);
+	      stack.pop_back ();
+	      continue;
+	    }
+	  node_id t = (a++)->tgt;
+	  if (t != FrozenMicrocode::NO_NODE &&
+	      rank[t] == FrozenMicrocode::NO_NODE)
+	    {
+	      rank[t] = 0;
+	      stack.push_back (make_pair (t, program->successors_begin (t)));
+	    }
+	}
+    }
+
+  for (list<LocatedLValue>::const_iterator llv = seeds.begin ();
+       ! failed && llv != seeds.end (); llv++)
+    {
+      node_id n =
+	program->find_node (llv->get_ProgramPoint ().to_MicrocodeAddress ());
+      int i = get_index (llv->get_LValue ());
+
+      if (n == FrozenMicrocode::NO_NODE || i < 0)
+	failed = true;
+      else
+	{
+	  s_set (sets[n], i);
+	  push (n);
+	}
+    }
+}
+
+SimpleDataDependency::~SimpleDataDependency ()
+{
+  for (size_t i = 0; i < lvalues.size (); i++)
+    lvalues[i]->deref ();
+  delete program;
+}
+
+bool
+SimpleDataDependency::is_simple (const Expr *lv)
+{
+  return (lv->is_RegisterExpr () ||
+	  (lv->is_MemCell () &&
+	   ((const MemCell *) lv)->get_addr ()->is_Constant ()));
+}
+
+int
+SimpleDataDependency::get_index (const LValue *lv)
+{
+  unordered_map<const Expr *, int>::const_iterator i = indices.find (lv);
+
+  if (i != indices.end ())
+    return i->second;
+  if (! is_simple (lv))
+    return -1;
+
+  int result = lvalues.size ();
+  lvalues.push_back ((LValue *) lv->ref ());
+  indices[lv] = result;
+
+  return result;
+}
+
+bool
+SimpleDataDependency::get_rval_dependencies (uint32_t a, vector<int> &deps)
+{
+  list<const LValue *> depends =
+    dependencies (program->get_rval (program->get_arrow (a)));
+
+  deps.clear ();
+  for (list<const LValue *>::iterator d = depends.begin ();
+       d != depends.end (); d++)
+    {
+      int i = get_index (*d);
+      if (i < 0)
+	return false;
+      deps.push_back (i);
+    }
+
+  return true;
+}
+
+bool
+SimpleDataDependency::run_backward (uint32_t a)
+{
+  const FrozenMicrocode::Arrow &arrow = program->get_arrow (a);
+  const bitset_type &in = sets[arrow.tgt];
+  bitset_type &out = sets[arrow.src];
+
+  if (arrow.kind != FrozenMicrocode::ASSIGNMENT)
+    return s_union (out, in, -1);
+
+  /* The lvalue is replaced by the dependencies of the rvalue when it
+   * is watched. A write at a symbolic address may modify any watched
+   * cell of the same size; such cells are kept. */
+  const LValue *lv = program->get_lval (arrow);
+  int kill = -1;
+  bool gen = false;
+
+  if (is_simple (lv))
+    {
+      unordered_map<const Expr *, int>::const_iterator i = indices.find (lv);
+      if (i != indices.end () && s_test (in, i->second))
+	{
+	  kill = i->second;
+	  gen = true;
+	}
+    }
+  else
+    {
+      for (size_t i = 0; ! gen && i < lvalues.size (); i++)
+	gen = (s_test (in, i) && lvalues[i]->is_MemCell () &&
+	       lvalues[i]->get_bv_offset () == lv->get_bv_offset () &&
+	       lvalues[i]->get_bv_size () == lv->get_bv_size ());
+    }
+
+  if (! gen)
+    return s_union (out, in, -1);
+
+  vector<int> deps;
+  if (! get_rval_dependencies (a, deps))
+    {
+      failed = true;
+      return false;
+    }
+
+  bool changed = s_union (out, in, kill);
+  for (size_t d = 0; d < deps.size (); d++)
+    changed = s_set (sets[arrow.src], deps[d]) || changed;
+
+  return changed;
+}
+
+void
+SimpleDataDependency::push (uint32_t node)
+{
+  if (pending[node])
+    return;
+  pending[node] = true;
+  worklist.push_back (rank[node]);
+  push_heap (worklist.begin (), worklist.end (), greater<uint32_t> ());
+}
+
+bool
+SimpleDataDependency::compute (int max_step_nb)
+{
+  while (! failed && ! worklist.empty () && max_step_nb-- > 0)
+    {
+      pop_heap (worklist.begin (), worklist.end (), greater<uint32_t> ());
+      uint32_t n = order[worklist.back ()];
+      worklist.pop_back ();
+      pending[n] = false;
+
+      for (FrozenMicrocode::pred_iterator p = program->predecessors_begin (n);
+	   ! failed && p != program->predecessors_end (n); p++)
+	{
+	  if (run_backward (*p))
+	    push (program->get_arrow (*p).src);
+	}
+    }
+
+  return ! failed;
+}
+
+bool
+SimpleDataDependency::has_failed () const
+{
+  return failed;
+}
+
+bool
+SimpleDataDependency::is_fixpoint_reached () const
+{
+  return worklist.empty ();
+}
+
+vector<Expr *>
+SimpleDataDependency::get_dependencies (const MicrocodeAddress &a) const
+{
+  vector<Expr *> result;
+  FrozenMicrocode::node_id n = program->find_node (a);
+
+  if (n == FrozenMicrocode::NO_NODE)
+    return result;
+  for (size_t i = 0; i < lvalues.size (); i++)
+    if (s_test (sets[n], i))
+      result.push_back (lvalues[i]->ref ());
+
+  return result;
+}
+
 /*****************************************************************************/
 
 DataDependencyLocalContext *
@@ -545,10 +826,29 @@ DataDependency::update_from_program_point (const MicrocodeAddressProgramPoint &p
 DataDependency::DataDependency (Microcode *prg,
 				const list<LocatedLValue> &seeds) :
   the_program (prg),
-  fixpoint_reached (false)
+  fixpoint_reached (false),
+  simple_sets (NULL),
+  seeds (seeds)
 {
   prg->regular_form ();
 
+  if (OnlySimpleSets () && ! logs::debug_is_on)
+    {
+      simple_sets = new SimpleDataDependency (prg, seeds);
+      if (simple_sets->has_failed ())
+	{
+	  delete simple_sets;
+	  simple_sets = NULL;
+	}
+    }
+
+  if (simple_sets == NULL)
+    init_formula_sets ();
+}
+
+void
+DataDependency::init_formula_sets ()
+{
   for (list<LocatedLValue>::const_iterator llv = seeds.begin ();
        llv != seeds.end (); llv++)
     {
@@ -576,6 +876,7 @@ DataDependency::~DataDependency()
     the_fixpoint.end ();
   for (; i != end; i++)
     delete (*i).second;
+  delete simple_sets;
 }
 
 /*****************************************************************************/
@@ -678,6 +979,21 @@ bool DataDependency::InverseStep()
 void
 DataDependency::ComputeFixpoint (int max_step_nb)
 {
+  if (simple_sets != NULL)
+    {
+      if (simple_sets->compute (max_step_nb))
+	{
+	  fixpoint_reached = simple_sets->is_fixpoint_reached ();
+	  return;
+	}
+
+      logs::debug << "DataDependency: symbolic lvalue, "
+		  << "using formula sets" << endl;
+      delete simple_sets;
+      simple_sets = NULL;
+      init_formula_sets ();
+    }
+
   while (!fixpoint_reached && max_step_nb--)
     InverseStep ();
 
@@ -689,6 +1005,23 @@ Expr *
 DataDependency::get_dependencies (const MicrocodeAddressProgramPoint &pp,
 				  int max_step_nb)
 {
+  if (simple_sets != NULL)
+    {
+      ComputeFixpoint (max_step_nb);
+      if (simple_sets != NULL)
+	{
+	  std::vector<Expr *> deps =
+	    simple_sets->get_dependencies (pp.to_MicrocodeAddress ());
+	  Expr *result = Constant::False ();
+	  for (size_t i = 0; i < deps.size (); i++)
+	    {
+	      ConditionalSet::cs_add (&result, deps[i]);
+	      deps[i]->deref ();
+	    }
+	  return result;
+	}
+    }
+
   Expr *result;
   DataDependencyLocalContext *ctxt = get_local_context (pp);
 
@@ -706,6 +1039,13 @@ std::vector<Expr*>
 DataDependency::get_simple_dependencies(const MicrocodeAddressProgramPoint &pp,
 					int max_step_nb)
 {
+  if (simple_sets != NULL)
+    {
+      ComputeFixpoint (max_step_nb);
+      if (simple_sets != NULL)
+	return simple_sets->get_dependencies (pp.to_MicrocodeAddress ());
+    }
+
   Expr *result = get_dependencies (pp, max_step_nb);
   std::vector<Expr*> simple_result =
     ConditionalSet::cs_possible_values (result);
@@ -742,59 +1082,58 @@ DataDependency::slice_it(Microcode *prg,
   vector<StmtArrow*> result;
 
   if (logs::debug_is_on)
-    {
-      logs::debug << logs::separator << endl
-		 << "Dependencies:" << endl;
+    logs::debug << logs::separator << endl
+		<< "Dependencies:" << endl;
 
-      for (Microcode::const_node_iterator n = prg->begin_nodes ();
-	   n != prg->end_nodes (); n++)
+  for (Microcode::const_node_iterator n = prg->begin_nodes ();
+       n != prg->end_nodes (); n++)
+    {
+      if (logs::debug_is_on)
 	{
 	  logs::debug << (*n)->get_loc() << " <== ";
 	  std::vector<Expr*> deps =
 	    invfix.get_simple_dependencies((*n)->get_loc(), max_step_nb);
 	  print_expressions(& deps, 2);
 	  logs::debug << endl;
+	}
 
-	  std::vector<LValue*> lv_deps;
-
-	  std::vector<StmtArrow *> * succs = (*n)->get_successors();
-	  for (int s=0; s<(int) succs->size(); s++)
+      std::vector<StmtArrow *> * succs = (*n)->get_successors();
+      for (int s=0; s<(int) succs->size(); s++)
+	{
+	  if (! (*succs)[s]->get_stmt()->is_Assignment())
+	    continue;
+
+	  const LValue * the_lv =
+	    ((Assignment *) (*succs)[s]->get_stmt())->get_lval();
+	  Option<MicrocodeAddress> tgtopt = (*succs)[s]->extract_target();
+	  if (!tgtopt.hasValue())
+	    continue;
+
+	  MicrocodeAddress addr = tgtopt.getValue();
+	  std::vector<Expr*> tgt_deps =
+	    invfix.get_simple_dependencies (addr, max_step_nb);
+	  bool influence = false;
+	  for (int d=0; d<(int) tgt_deps.size(); d++)
 	    {
-	      if (! (*succs)[s]->get_stmt()->is_Assignment())
-		continue;
-
-	      const LValue * the_lv =
-		((Assignment *) (*succs)[s]->get_stmt())->get_lval();
-	      Option<MicrocodeAddress> tgtopt = (*succs)[s]->extract_target();
-	      if (!tgtopt.hasValue())
-		continue;
-
-	      MicrocodeAddress addr = tgtopt.getValue();
-	      std::vector<Expr*> tgt_deps =
-		invfix.get_simple_dependencies (addr, max_step_nb);
-	      bool influence = false;
-	      for (int d=0; d<(int) tgt_deps.size(); d++)
-		{
-		  // Case 1: one dependency contains the modified lv
-		  if ((tgt_deps[d]->contains(the_lv)) ||
-		  // Case 2: the modified lv is a memory reference and
-		  // there is a memory reference in the dependency (brutal!)
-		      (tgt_deps[d]->is_MemCell() && the_lv->is_MemCell()))
-		    { influence = true; break; }
-		}
-	      for (int d=0; d<(int) tgt_deps.size(); d++)
-		tgt_deps[d]->deref ();
-	      if (influence) {
-		logs::debug <<  (*succs)[s]->pp() << endl;
-		result.push_back((*succs)[s]);
-	      }
-	      else
-		logs::debug << (*succs)[s]->pp() << endl;
+	      // Case 1: one dependency contains the modified lv
+	      if ((tgt_deps[d]->contains(the_lv)) ||
+	      // Case 2: the modified lv is a memory reference and
+	      // there is a memory reference in the dependency (brutal!)
+		  (tgt_deps[d]->is_MemCell() && the_lv->is_MemCell()))
+		{ influence = true; break; }
 	    }
+	  for (int d=0; d<(int) tgt_deps.size(); d++)
+	    tgt_deps[d]->deref ();
+	  if (influence)
+	    result.push_back((*succs)[s]);
+	  if (logs::debug_is_on)
+	    logs::debug << (*succs)[s]->pp() << endl;
 	}
-      logs::debug << logs::separator << endl;
     }
 
+  if (logs::debug_is_on)
+    logs::debug << logs::separator << endl;
+
   return result;
 }
 
@@ -33,6 +33,8 @@
 
 #include <list>
 #include <map>
+#include <vector>
+#include <stdint.h>
 #include <analyses/cfgrecovery/MicrocodeAddressProgramPoint.hh>
 #include <kernel/Architecture.hh>
 #include <kernel/Microcode.hh>
@@ -40,8 +42,10 @@
 #include <kernel/microcode/MicrocodeNode.hh>
 #include <utils/Option.hh>
 #include <utils/map-helpers.hh>
+#include <utils/unordered11.hh>
 
 
+class FrozenMicrocode;
 class DataDependency;
 class DataDependencyLocalContext;
 class LocatedLValue;
@@ -105,6 +109,63 @@ public:
   const LValue *get_LValue () const;
 };
 
+/*! Gen/kill engine used by DataDependency in OnlySimpleSets mode. The
+ * watched lvalues are registers and memory cells at constant addresses;
+ * each one gets a dense index the first time it is watched and the set
+ * of a program point is a bitvector of these indices. Program points
+ * are processed in post-order, with a worklist, so that the targets of
+ * an arrow are usually stable when its origin is computed.
+ *
+ * A memory cell with a symbolic address cannot be tracked this way
+ * since its address changes along the arrows. When such a cell should
+ * be watched the computation is abandoned (has_failed() becomes true)
+ * and DataDependency uses formula sets instead. */
+class SimpleDataDependency {
+public:
+  SimpleDataDependency (const Microcode *prg,
+			const std::list<LocatedLValue> &seeds);
+  ~SimpleDataDependency ();
+
+  /*! Process at most max_step_nb program points, i.e. run backward the
+   * arrows entering each of them. Returns false if the sets cannot be
+   * represented with bitvectors. */
+  bool compute (int max_step_nb);
+  bool has_failed () const;
+  bool is_fixpoint_reached () const;
+
+  /*! The lvalues watched at address a (new references). */
+  std::vector<Expr *> get_dependencies (const MicrocodeAddress &a) const;
+
+  /*! Registers and memory cells at a constant address. */
+  static bool is_simple (const Expr *lv);
+
+private:
+  typedef std::vector<uint64_t> bitset_type;
+
+  SimpleDataDependency (const SimpleDataDependency &);
+  SimpleDataDependency &operator= (const SimpleDataDependency &);
+
+  /* index of lv, created if needed; -1 if lv is not simple */
+  int get_index (const LValue *lv);
+  /* indices of the dependencies of the rvalue of arrow a */
+  bool get_rval_dependencies (uint32_t a, std::vector<int> &deps);
+  /* merge the set obtained by running arrow a backward into the set of
+   * its origin; returns true if the latter changed. */
+  bool run_backward (uint32_t a);
+  void push (uint32_t node);
+
+  FrozenMicrocode *program;
+  std::vector<LValue *> lvalues;
+  std::unordered_map<const Expr *, int> indices;
+  std::vector<bitset_type> sets;
+  /* post-order number of each node and its inverse */
+  std::vector<uint32_t> rank;
+  std::vector<uint32_t> order;
+  std::vector<bool> pending;
+  std::vector<uint32_t> worklist;
+  bool failed;
+};
+
 class DataDependency {
 
 private:
@@ -113,6 +174,12 @@ private:
 	   LessThanFunctor<MicrocodeAddressProgramPoint> > the_fixpoint;
   std::list<StaticArrow *> pending_arrows;
   bool fixpoint_reached;
+  /* bitvector sets, NULL when formula sets are used */
+  SimpleDataDependency *simple_sets;
+  std::list<LocatedLValue> seeds;
+
+  /*! Put the seeds into the fixpoint map of formula sets. */
+  void init_formula_sets ();
 
   /*! Realise an inverse step:
    * - pick an arrow in the pending arrow list
@@ -137,7 +204,10 @@ public:
 
   /*! Initializes the fixpoint calculus:
    * - puts the seeds into the fixpoint map
-   * - puts the inverse arrows into the pending arrow list. */
+   * - puts the inverse arrows into the pending arrow list.
+   * In OnlySimpleSets mode, and unless debug traces are enabled (they
+   * show the formula of each step), bitvector sets are used as long as
+   * no memory cell with a symbolic address has to be watched. */
   DataDependency(Microcode *prg, const std::list<LocatedLValue> &seeds);
   ~DataDependency();
   /* Iterates InverseStep until reaching the fixpoint (or max step nb reached). */
@@ -73,6 +73,12 @@ Decoder::get_arch () const
   return arch;
 }
 
+MicrocodeArchitecture *
+Decoder::get_arch ()
+{
+  return arch;
+}
+
 ConcreteMemoryReader::ConcreteMemoryReader (const ConcreteMemory *M)
   : memory (M)
 {
@@ -139,6 +139,7 @@ public:
   void set_memory(const ConcreteMemory *memory);
 
   const MicrocodeArchitecture *get_arch () const;
+  MicrocodeArchitecture *get_arch ();
 
 protected:
   /* Constructor is protected to enforce to use the DecoderFactory */
@@ -14,3 +14,16 @@ ConcreteContext::clone () const
 {
   return new ConcreteContext (memory->clone ());
 }
+
+void
+ConcreteContext::save (ExprBinaryWriter &out) const
+{
+  memory->save (out);
+}
+
+ConcreteContext *
+ConcreteContext::restore (ExprBinaryReader &in, const ConcreteMemory *base)
+  throw (BinaryReader::Exception)
+{
+  return new ConcreteContext (ConcreteMemory::restore (in, base));
+}
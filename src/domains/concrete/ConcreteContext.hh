@@ -3,6 +3,7 @@
 
 # include <analyses/cfgrecovery/AbstractDomainContext.hh>
 # include <domains/concrete/ConcreteMemory.hh>
+# include <io/expressions/expr-binary.hh>
 
 class ConcreteContext : public AbstractDomainContext<ConcreteMemory>
 {
@@ -11,6 +12,11 @@ public:
   virtual ~ConcreteContext ();
 
   virtual ConcreteContext *clone () const ;
+
+  void save (ExprBinaryWriter &out) const;
+  static ConcreteContext *restore (ExprBinaryReader &in,
+				   const ConcreteMemory *base)
+    throw (BinaryReader::Exception);
 };
 
 #endif /* ! CONCRETECONTEXT_HH */
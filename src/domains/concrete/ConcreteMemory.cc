@@ -40,30 +40,46 @@
 
 #include <domains/concrete/ConcreteAddress.hh>
 
+#include <io/expressions/expr-binary.hh>
+
 #include <utils/bv-manip.hh>
 
 
 using namespace std;
 
+static size_t
+s_memcell_hash (address_t a, uint8_t v)
+{
+  return hash_mix (19 * (size_t) a + v);
+}
+
+static size_t
+s_register_hash (const RegisterDesc *r, const ConcreteValue &v)
+{
+  return hash_mix (19 * (size_t) r + (size_t) v.get ());
+}
+
 /*****************************************************************************/
 /* Constructors                                                              */
 /*****************************************************************************/
 
 ConcreteMemory::ConcreteMemory() :
   Memory<ConcreteAddress, ConcreteValue>(), RegisterMap<ConcreteValue>(),
-  base (NULL), memory (), minaddr (MAX_ADDRESS), maxaddr (NULL_ADDRESS)
+  base (NULL), memory (), minaddr (MAX_ADDRESS), maxaddr (NULL_ADDRESS),
+  memory_hash (0), registers_hash (0)
 {
 }
 
 ConcreteMemory::ConcreteMemory(const ConcreteMemory &m) :
   Memory<ConcreteAddress,ConcreteValue> (m), RegisterMap<ConcreteValue> (m),
-  base (m.base), memory (m.memory), minaddr (m.minaddr), maxaddr (m.maxaddr)
+  base (m.base), memory (m.memory), minaddr (m.minaddr), maxaddr (m.maxaddr),
+  memory_hash (m.memory_hash), registers_hash (m.registers_hash)
 {
 }
 
 ConcreteMemory::ConcreteMemory(const ConcreteMemory *base) :
   Memory<ConcreteAddress,ConcreteValue> (), RegisterMap<ConcreteValue> (),
-  base (base)
+  base (base), memory_hash (0), registers_hash (0)
 {
   if (base)
     base->get_address_range (minaddr, maxaddr);
@@ -100,13 +116,13 @@ ConcreteMemory::get(const ConcreteAddress &addr,
 
       if (!is_defined (ConcreteAddress (cur)))
 	throw UndefinedValueException("at address " + addr.to_string ());
-      MemoryMap::const_iterator ci = memory.find (cur);
-      if (ci != memory.end ())
-	byte = ci->second;
+      const uint8_t *pb = memory.find (cur);
+      if (pb != NULL)
+	byte = *pb;
       else
 	{
-	  assert (base->is_defined (addr));
-	  byte = base->get (addr, 1, e).get ();
+	  assert (base->is_defined (ConcreteAddress (cur)));
+	  byte = base->get (ConcreteAddress (cur), 1, e).get ();
 	}
 
       res = (res << 8) | byte;
@@ -134,7 +150,12 @@ ConcreteMemory::put(const ConcreteAddress &addr,
       address_t cur =
 	(e == Architecture::BigEndian ? a + size - i - 1 : a + i);
 
-      memory[cur] = v & 0xff;
+      uint8_t byte = v & 0xff;
+      uint8_t old;
+
+      if (memory.put (cur, byte, &old))
+	memory_hash -= s_memcell_hash (cur, old);
+      memory_hash += s_memcell_hash (cur, byte);
       v >>= 8;
     }
 
@@ -144,10 +165,28 @@ ConcreteMemory::put(const ConcreteAddress &addr,
     maxaddr = a;
 }
 
+void
+ConcreteMemory::put(const RegisterDesc *r, ConcreteValue v)
+{
+  if (RegisterMap<ConcreteValue>::is_defined (r))
+    registers_hash -= s_register_hash (r, RegisterMap<ConcreteValue>::get (r));
+  RegisterMap<ConcreteValue>::put (r, v);
+  registers_hash += s_register_hash (r, v);
+}
+
+void
+ConcreteMemory::clear(const RegisterDesc *r)
+{
+  if (! RegisterMap<ConcreteValue>::is_defined (r))
+    return;
+  registers_hash -= s_register_hash (r, RegisterMap<ConcreteValue>::get (r));
+  RegisterMap<ConcreteValue>::clear (r);
+}
+
 bool
 ConcreteMemory::is_defined(const ConcreteAddress &a) const
 {
-  return (memory.find(a.get_address()) != memory.end() ||
+  return (memory.find (a.get_address ()) != NULL ||
 	  (base && base->is_defined (a)));
 }
 
@@ -185,13 +224,18 @@ ConcreteMemory::get(const RegisterDesc * r) const
 bool
 ConcreteMemory::equals (const ConcreteMemory &mem) const
 {
-  if (memory.size () != mem.memory.size ())
+  if (memory.size () != mem.memory.size () ||
+      RegisterMap<ConcreteValue>::size () !=
+      mem.RegisterMap<ConcreteValue>::size ())
     return false;
 
   if (base != mem.base)
     return false;
 
-  for (MemoryMap::const_iterator i = memory.begin (); i != memory.end (); i++)
+  if (hashcode () != mem.hashcode ())
+    return false;
+
+  for (const_memcell_iterator i = memory.begin (); i != memory.end (); i++)
     {
       if (! mem.is_defined (i->first) ||
 	  ! (mem.get (i->first, 1,
@@ -211,24 +255,14 @@ ConcreteMemory::equals (const ConcreteMemory &mem) const
 std::size_t
 ConcreteMemory::hashcode () const
 {
-  std::size_t result = 0;
-
-  for (MemoryMap::const_iterator i = memory.begin (); i != memory.end (); i++)
-    result = ((result << 3) + 19 * i->second);
-
-  for (RegisterMap<ConcreteValue>::const_reg_iterator i = regs_begin ();
-       i != regs_end (); i++) {
-    result = ((result << 3) + 19 * (intptr_t) i->second.get ());
-  }
-
-  return result;
+  return 13 * memory_hash + 141 * registers_hash;
 }
 
 void
 ConcreteMemory::output_text(ostream &os) const
 {
   os << "Memory: " << endl;
-  for (MemoryMap::const_iterator mem = memory.begin(); mem != memory.end();
+  for (const_memcell_iterator mem = memory.begin(); mem != memory.end();
        mem++)
     os << "[ 0x" << hex << setfill('0')
        << nouppercase << setw(4) << (int) mem->first
@@ -247,6 +281,8 @@ ConcreteMemory::get_address_range (address_t &min, address_t &max) const
   max = maxaddr;
 }
 
+/* The cells are shared with the clone until one of them writes into
+ * their page; the registers are copied. */
 ConcreteMemory *
 ConcreteMemory::clone () const
 {
@@ -265,3 +301,64 @@ ConcreteMemory::end () const
 {
   return memory.end ();
 }
+
+void
+ConcreteMemory::save (ExprBinaryWriter &out) const
+{
+  out.write_uint (minaddr);
+  out.write_uint (maxaddr);
+  out.write_uint (memory.size ());
+  for (const_memcell_iterator i = memory.begin (); i != memory.end (); i++)
+    {
+      out.write_uint (i->first);
+      out.write_byte (i->second);
+    }
+
+  out.write_uint (RegisterMap<ConcreteValue>::size ());
+  for (const_reg_iterator i = regs_begin (); i != regs_end (); i++)
+    {
+      out.write_register (i->first);
+      out.write_uint (i->second.get_size ());
+      out.write_int (i->second.get ());
+    }
+}
+
+ConcreteMemory *
+ConcreteMemory::restore (ExprBinaryReader &in, const ConcreteMemory *base)
+  throw (BinaryReader::Exception)
+{
+  ConcreteMemory *result = new ConcreteMemory (base);
+
+  try
+    {
+      result->minaddr = in.read_uint ();
+      result->maxaddr = in.read_uint ();
+
+      uint64_t nb_cells = in.read_uint ();
+      for (uint64_t i = 0; i < nb_cells; i++)
+	{
+	  address_t a = in.read_uint ();
+	  uint8_t byte = in.read_byte ();
+
+	  result->memory.put (a, byte);
+	  result->memory_hash += s_memcell_hash (a, byte);
+	}
+
+      uint64_t nb_regs = in.read_uint ();
+      for (uint64_t i = 0; i < nb_regs; i++)
+	{
+	  const RegisterDesc *r = in.read_register ();
+	  int size = in.read_uint ();
+	  word_t val = in.read_int ();
+
+	  result->put (r, ConcreteValue (size, val));
+	}
+    }
+  catch (BinaryReader::Exception &)
+    {
+      delete result;
+      throw;
+    }
+
+  return result;
+}
@@ -43,19 +43,23 @@
 #include <kernel/Memory.hh>
 #include <kernel/RegisterMap.hh>
 
+#include <utils/BinaryStream.hh>
 #include <utils/Object.hh>
+#include <utils/PagedMap.hh>
 #include <utils/tools.hh>
 #include <utils/unordered11.hh>
 
 /** \brief ConcreteMemory module which manage memory and also registers. */
+class ExprBinaryWriter;
+class ExprBinaryReader;
+
 class ConcreteMemory : public Memory<ConcreteAddress, ConcreteValue>,
 		       public RegisterMap<ConcreteValue>
 {
 public:
-  /** \brief Data structure used to encode the concrete memory. */
-  typedef std::unordered_map<address_t,
-				  uint8_t,
-				  std::hash<address_t> > MemoryMap;
+  /** \brief Data structure used to encode the concrete memory. Its
+   *  pages are shared by the clones of the memory. */
+  typedef PagedMap<uint8_t> MemoryMap;
   typedef MemoryMap::const_iterator const_memcell_iterator;
   typedef ConcreteValue Value;
   typedef ConcreteAddress Address;
@@ -103,8 +107,10 @@ public:
     throw (UndefinedValueException);
 
   /** \brief Put the value v into the register */
+  virtual void put(const RegisterDesc *, ConcreteValue);
 
-  using RegisterMap<ConcreteValue>::put;
+  /** \brief Remove the register from the memory */
+  virtual void clear(const RegisterDesc *);
 
   /** \brief Tells if the register has been written or not. */
   bool is_defined(const RegisterDesc *) const;
@@ -117,6 +123,10 @@ public:
   /* Utils                                                                   */
   /***************************************************************************/
   virtual bool equals (const ConcreteMemory &mem) const;
+
+  /** \brief Hash value of the memory. The hash is maintained
+   *  incrementally by put() and clear() as a sum of per-cell hashes
+   *  so this function runs in constant time. */
   virtual std::size_t hashcode () const;
   void output_text(std::ostream &) const;
   void get_address_range (address_t &min, address_t &max) const;
@@ -125,12 +135,25 @@ public:
   virtual const_memcell_iterator end () const;
   virtual ConcreteMemory *clone () const;
 
+  /** \brief Write the cells and the registers set in this memory. The
+   *  content of the base memory is not written. */
+  void save (ExprBinaryWriter &out) const;
+
+  /** \brief Rebuild on top of 'base' a memory written by save(). */
+  static ConcreteMemory *restore (ExprBinaryReader &in,
+				  const ConcreteMemory *base)
+    throw (BinaryReader::Exception);
+
 private:
   /** \brief The actual storage into memory. */
   const ConcreteMemory *base;
   MemoryMap memory;
   address_t minaddr;
   address_t maxaddr;
+  /** \brief Sum of the hashes of the memory cells stored in 'memory'. */
+  std::size_t memory_hash;
+  /** \brief Sum of the hashes of the registers stored in the map. */
+  std::size_t registers_hash;
 };
 
 #endif /* DOMAINS_CONCRETE_CONCRETEMEMORY_HH */
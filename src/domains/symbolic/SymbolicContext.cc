@@ -15,14 +15,16 @@ SymbolicContext::equals (const AbstractContext *ctx) const
 {
   const SymbolicContext *sctx = dynamic_cast<const SymbolicContext *> (ctx);
 
-  return (sctx != NULL && SType::equals ((const SType *) ctx) &&
-	  condition == sctx->condition);
+  return (sctx != NULL && condition == sctx->condition &&
+	  SType::equals ((const SType *) ctx));
 }
 
 std::size_t
 SymbolicContext::hashcode () const
 {
-  return (13 * SType::hashcode () + 141 * condition->hash ());
+  /* The path condition is hash-consed; its address is used instead of
+   * Expr::hash () which traverses the whole formula. */
+  return (13 * SType::hashcode () + 141 * (intptr_t) condition);
 }
 
 void
@@ -50,3 +52,35 @@ SymbolicContext::clone () const
 {
   return new SymbolicContext (memory->clone (), condition->ref ());
 }
+
+void
+SymbolicContext::save (ExprBinaryWriter &out) const
+{
+  memory->save (out);
+  out.write_expr (condition);
+}
+
+SymbolicContext *
+SymbolicContext::restore (ExprBinaryReader &in, const ConcreteMemory *base)
+  throw (BinaryReader::Exception)
+{
+  SymbolicMemory *mem = SymbolicMemory::restore (in, base);
+  Expr *cond;
+
+  try
+    {
+      cond = in.read_expr ();
+    }
+  catch (BinaryReader::Exception &)
+    {
+      delete mem;
+      throw;
+    }
+  if (cond == NULL)
+    {
+      delete mem;
+      throw BinaryReader::Exception ("missing path condition");
+    }
+
+  return new SymbolicContext (mem, cond);
+}
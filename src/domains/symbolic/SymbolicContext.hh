@@ -4,6 +4,7 @@
 # include <analyses/cfgrecovery/AbstractDomainContext.hh>
 # include <kernel/Expressions.hh>
 # include <domains/symbolic/SymbolicMemory.hh>
+# include <io/expressions/expr-binary.hh>
 
 class SymbolicContext : public AbstractDomainContext<SymbolicMemory>
 {
@@ -22,6 +23,11 @@ public:
   virtual void set_path_condition (Expr *cond);
   virtual SymbolicContext *clone () const;
 
+  void save (ExprBinaryWriter &out) const;
+  static SymbolicContext *restore (ExprBinaryReader &in,
+				   const ConcreteMemory *base)
+    throw (BinaryReader::Exception);
+
 protected:
   Expr *condition;
 };
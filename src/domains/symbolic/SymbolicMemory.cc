@@ -29,11 +29,150 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <kernel/expressions/exprutils.hh>
+#include <io/expressions/expr-binary.hh>
+#include <utils/tools.hh>
 #include "SymbolicMemory.hh"
 
+/* Expressions are hash-consed; hence their address identifies them. */
+static std::size_t
+s_memcell_hash (address_t a, const SymbolicMemory::Cell &c)
+{
+  return hash_mix (19 * (std::size_t) a + 177 * (intptr_t) c.value.get_Expr () +
+		   1031 * c.offset);
+}
+
+static std::size_t
+s_register_hash (const RegisterDesc *r, const SymbolicValue &v)
+{
+  return hash_mix (19 * (intptr_t) r + 177 * (intptr_t) v.get_Expr ());
+}
+
+static std::size_t
+s_symbolic_write_hash (std::size_t index, const SymbolicValue &a,
+		       const SymbolicValue &v)
+{
+  return hash_mix (19 * index + 177 * (intptr_t) a.get_Expr () +
+		   1031 * (intptr_t) v.get_Expr ());
+}
+
+/* Split a into a base expression, NULL for constants, and a constant
+ * offset. */
+static const Expr *
+s_split_address (const Expr *a, word_t &offset)
+{
+  const BinaryApp *ba = dynamic_cast<const BinaryApp *> (a);
+
+  offset = 0;
+  if (a->is_Constant ())
+    {
+      offset = dynamic_cast<const Constant *> (a)->get_val ();
+      return NULL;
+    }
+
+  if (ba != NULL &&
+      (ba->get_op () == BV_OP_ADD || ba->get_op () == BV_OP_SUB))
+    {
+      const Expr *base = ba->get_arg1 ();
+      const Constant *c = dynamic_cast<const Constant *> (ba->get_arg2 ());
+
+      if (c == NULL && ba->get_op () == BV_OP_ADD)
+	{
+	  base = ba->get_arg2 ();
+	  c = dynamic_cast<const Constant *> (ba->get_arg1 ());
+	}
+      if (c != NULL)
+	{
+	  offset = c->get_val ();
+	  if (ba->get_op () == BV_OP_SUB)
+	    offset = - offset;
+	  return base;
+	}
+    }
+
+  return a;
+}
+
+/* Whether the addresses a and b are equal, when it is known without the
+ * solver. */
+static Option<bool>
+s_same_address (const Expr *a, const Expr *b)
+{
+  word_t offa, offb;
+  const Expr *basea = s_split_address (a, offa);
+  const Expr *baseb = s_split_address (b, offb);
+  Option<bool> result;
+
+  if (basea == baseb)
+    {
+      int size = a->get_bv_size ();
+      word_t mask = size >= 64 ? ~(word_t) 0 : (((word_t) 1) << size) - 1;
+
+      result = ((offa - offb) & mask) == 0;
+    }
+  else
+    {
+      Expr *cond = Expr::createEquality (a->ref (), b->ref ());
+      exprutils::simplify (&cond);
+      result = cond->try_eval_level0 ();
+      cond->deref ();
+    }
+
+  return result;
+}
+
+/* The byte then_ if cond holds, else_ otherwise. */
+static Expr *
+s_select (Expr *cond, Expr *then_, Expr *else_)
+{
+  Expr *mask = Expr::createExtend (BV_OP_EXTEND_S, cond, 8);
+  Expr *result =
+    BinaryApp::create (BV_OP_OR,
+		       BinaryApp::create (BV_OP_AND, then_, mask->ref (), 0, 8),
+		       BinaryApp::create (BV_OP_AND, else_,
+					  UnaryApp::create (BV_OP_NOT, mask,
+							    0, 8), 0, 8),
+		       0, 8);
+  return result;
+}
+
+/* The nb bytes of v from the one of index offset, 0 being the least
+ * significant byte. */
+static Expr *
+s_extract (const SymbolicValue &v, int offset, int nb)
+{
+  if (offset == 0 && 8 * nb == v.get_size ())
+    return v.get_Expr ()->ref ();
+
+  Constant *e_off = Constant::create (8 * offset, 0, BV_DEFAULT_SIZE);
+  Constant *e_size = Constant::create (8 * nb, 0, BV_DEFAULT_SIZE);
+  Expr *result  =
+    TernaryApp::create (BV_OP_EXTRACT, v.get_Expr ()->ref (), e_off, e_size,
+			0, 8 * nb);
+  exprutils::simplify (&result);
+
+  return result;
+}
+
+/* The byte of v at offset i according to endianness e. */
+static int
+s_byte_index (const SymbolicValue &v, int i, Architecture::endianness_t e)
+{
+  if (e == Architecture::LittleEndian)
+    return i;
+  else /* BigEndian */
+    return v.get_size () / 8 - (i + 1);
+}
+
+static Expr *
+s_byte (const SymbolicValue &v, int i, Architecture::endianness_t e)
+{
+  return s_extract (v, s_byte_index (v, i, e), 1);
+}
+
 SymbolicMemory::SymbolicMemory (const ConcreteMemory *base)
   : Memory<ConcreteAddress, SymbolicValue> (), RegisterMap<SymbolicValue> (),
-    base (base), memory ()
+    base (base), memory (), symbolic_writes (), write_positions (),
+    memory_hash (0), registers_hash (0), symbolic_writes_hash (0)
 {
   base->get_address_range (minaddr, maxaddr);
 }
@@ -42,62 +181,94 @@ SymbolicMemory::~SymbolicMemory()
 {
 }
 
+/* The cells are read by chunks: the bytes of a same value written by
+ * put (), a run of bytes of the base memory or a single byte changed by
+ * symbolic writes. */
 SymbolicValue
 SymbolicMemory::get (const ConcreteAddress &a, int size_in_bytes,
 		     Architecture::endianness_t e) const
   throw (UndefinedValueException)
 {
   Expr *result = NULL;
+  int step = (e == Architecture::LittleEndian ? 1 : -1);
 
   assert (size_in_bytes > 0);
 
-  ConcreteAddress addr (a);
+  address_t addr = a.get_address ();
 
-  for (int i = 0; i < size_in_bytes && (i == 0 || result != NULL); i++, addr++)
+  for (int i = 0; i < size_in_bytes; )
     {
-      Expr *byte = NULL;
-      MemoryMap::const_iterator ci = memory.find (addr.get_address ());
-      if (ci != memory.end ())
-	byte = ci->second.get_Expr ()->ref ();
-      else if (base->is_defined (addr))
+      Expr *chunk = NULL;
+      int nb = 1;
+      const Cell *cell = memory.find (addr);
+      bool pending = has_pending_writes (addr);
+
+      if (cell != NULL && ! pending)
 	{
-	  ConcreteValue v = base->get (addr, 1, e);
-	  byte = Constant::create (v.get (), 0, 8);
-	}
+	  for (; i + nb < size_in_bytes; nb++)
+	    {
+	      const Cell *next = memory.find (addr + nb);
 
-      if (byte != NULL)
+	      if (next == NULL ||
+		  next->value.get_Expr () != cell->value.get_Expr () ||
+		  next->offset != cell->offset + nb * step ||
+		  has_pending_writes (addr + nb))
+		break;
+	    }
+	  chunk = s_extract (cell->value,
+			     step > 0 ? cell->offset : cell->offset - nb + 1,
+			     nb);
+	}
+      else if (cell == NULL && ! pending && base->is_defined (addr))
+	{
+	  for (; i + nb < size_in_bytes && nb < (int) sizeof (word_t); nb++)
+	    {
+	      if (memory.find (addr + nb) != NULL ||
+		  ! base->is_defined (addr + nb) ||
+		  has_pending_writes (addr + nb))
+		break;
+	    }
+	  ConcreteValue v = base->get (addr, nb, e);
+	  chunk = Constant::create (v.get (), 0, 8 * nb);
+	}
+      else
 	{
-	  assert (byte->get_bv_size () == 8);
-	  if (result == NULL)
-	    result = byte;
-	  else
+	  if (cell != NULL)
+	    chunk = s_extract (cell->value, cell->offset, 1);
+	  else if (base->is_defined (addr))
 	    {
-	      Expr *l;
-	      Expr *r;
-
-	      if (e == Architecture::LittleEndian)
-		{
-		  l = byte;
-		  r = result;
-		}
-	      else
-		{
-		  l = result;
-		  r = byte;
-		}
-	      assert (l->get_bv_size () + r->get_bv_size () == 8 * (i + 1));
-	      result = BinaryApp::create (BV_OP_CONCAT, l, r, 0, 8 * (i + 1));
+	      ConcreteValue v = base->get (addr, 1, e);
+	      chunk = Constant::create (v.get (), 0, 8);
+	    }
+
+	  if (chunk != NULL)
+	    {
+	      const std::size_t *first = write_positions.find (addr);
+	      Expr *ea = Constant::create (addr, 0,
+					   symbolic_writes[0].addr.get_size ());
+	      chunk = apply_symbolic_writes (ea, chunk, first ? *first : 0);
+	      ea->deref ();
 	    }
 	}
-      else if (result != NULL)
+
+      if (chunk == NULL)
 	{
-	  result->deref ();
-	  result = NULL;
+	  if (result != NULL)
+	    result->deref ();
+	  throw UndefinedValueException ("at address " +
+					 ConcreteAddress (addr).to_string ());
 	}
-    }
 
-  if (result == NULL)
-    throw UndefinedValueException ("at address " + addr.to_string ());
+      assert (chunk->get_bv_size () == 8 * nb);
+      i += nb;
+      addr += nb;
+      if (result == NULL)
+	result = chunk;
+      else if (e == Architecture::LittleEndian)
+	result = BinaryApp::create (BV_OP_CONCAT, chunk, result, 0, 8 * i);
+      else
+	result = BinaryApp::create (BV_OP_CONCAT, result, chunk, 0, 8 * i);
+    }
 
   SymbolicValue res (result);
   result->deref ();
@@ -105,40 +276,46 @@ SymbolicMemory::get (const ConcreteAddress &a, int size_in_bytes,
   return res;
 }
 
+/* Once an address that is not a constant has been written, the writes
+ * into the cells are also logged: reading through a symbolic address
+ * must see them after the older symbolic writes. */
 void
 SymbolicMemory::put (const ConcreteAddress &a, const SymbolicValue &v,
 		     Architecture::endianness_t e)
 {
-  int offset, inc;
+  if (! symbolic_writes.empty ())
+    {
+      Expr *addr = Constant::create (a.get_address (), 0,
+				     symbolic_writes[0].addr.get_size ());
+      log_write (addr, v, e);
+      addr->deref ();
+    }
+  put_cells (a, v, e);
+}
+
+void
+SymbolicMemory::put_cells (const ConcreteAddress &a, const SymbolicValue &v,
+			   Architecture::endianness_t e)
+{
   int size = v.get_size ();
   assert (size > 0 && size % 8 == 0);
 
   size /= 8;
 
-  if (e == Architecture::LittleEndian)
-    {
-      offset = 0;
-      inc = 8;
-    }
-  else /* BigEndian */
-    {
-      offset = v.get_size () - 8;
-      inc = -8;
-    }
-
-  const Expr *value = v.get_Expr ();
   address_t addr = a.get_address ();
+  Cell cell;
+  cell.value = v;
 
-  for (int i = 0; i < size; i++, addr++, offset += inc)
+  for (int i = 0; i < size; i++, addr++)
     {
-      Constant *e_off = Constant::create (offset, 0, BV_DEFAULT_SIZE);
-      Constant *e_size = Constant::create (8, 0, BV_DEFAULT_SIZE);
-      Expr *tmp  =
-	TernaryApp::create (BV_OP_EXTRACT, value->ref (), e_off, e_size, 0, 8);
-      exprutils::simplify (&tmp);
-
-      memory[addr] = SymbolicValue (tmp);
-      tmp->deref ();
+      cell.offset = s_byte_index (v, i, e);
+
+      Cell old;
+      if (memory.put (addr, cell, &old))
+	memory_hash -= s_memcell_hash (addr, old);
+      memory_hash += s_memcell_hash (addr, cell);
+      if (! symbolic_writes.empty ())
+	write_positions.put (addr, symbolic_writes.size ());
     }
 
   if (addr < minaddr)
@@ -150,11 +327,149 @@ SymbolicMemory::put (const ConcreteAddress &a, const SymbolicValue &v,
 bool
 SymbolicMemory::is_defined (const ConcreteAddress &a) const
 {
-  return ((memory.find (a.get_address ()) != memory.end ()) ||
+  return ((memory.find (a.get_address ()) != NULL) ||
 	  base->is_defined (a));
 }
 
 
+void
+SymbolicMemory::define (const ConcreteAddress &a, const SymbolicValue &v,
+			Architecture::endianness_t e)
+{
+  put_cells (a, v, e);
+  if (symbolic_writes.empty ())
+    return;
+
+  address_t addr = a.get_address ();
+  for (int i = 0; i < v.get_size () / 8; i++)
+    write_positions.put (addr + i, 0);
+}
+
+void
+SymbolicMemory::put_symbolic (const Expr *addr, const SymbolicValue &v,
+			      Architecture::endianness_t e)
+{
+  log_write (addr, v, e);
+}
+
+void
+SymbolicMemory::log_write (const Expr *addr, const SymbolicValue &v,
+			   Architecture::endianness_t e)
+{
+  int size = v.get_size ();
+  assert (size > 0 && size % 8 == 0);
+
+  size /= 8;
+
+  for (int i = 0; i < size; i++)
+    {
+      Expr *a =
+	BinaryApp::create (BV_OP_ADD, addr->ref (),
+			   Constant::create (i, 0, addr->get_bv_size ()),
+			   0, addr->get_bv_size ());
+      exprutils::simplify (&a);
+      Expr *tmp = s_byte (v, i, e);
+      SymbolicWrite w;
+      w.addr = SymbolicValue (a);
+      w.value = SymbolicValue (tmp);
+      a->deref ();
+      tmp->deref ();
+
+      symbolic_writes_hash +=
+	s_symbolic_write_hash (symbolic_writes.size (), w.addr, w.value);
+      symbolic_writes.push_back (w);
+    }
+}
+
+SymbolicValue
+SymbolicMemory::get_symbolic (const Expr *addr, int size_in_bytes,
+			      Architecture::endianness_t e) const
+{
+  Expr *result = NULL;
+
+  assert (size_in_bytes > 0);
+
+  for (int i = 0; i < size_in_bytes; i++)
+    {
+      Expr *a =
+	BinaryApp::create (BV_OP_ADD, addr->ref (),
+			   Constant::create (i, 0, addr->get_bv_size ()),
+			   0, addr->get_bv_size ());
+      exprutils::simplify (&a);
+      Expr *byte = apply_symbolic_writes (a, MemCell::create (a->ref (), 0, 8),
+					  0);
+      a->deref ();
+
+      if (result == NULL)
+	result = byte;
+      else if (e == Architecture::LittleEndian)
+	result = Expr::createConcat (byte, result);
+      else
+	result = Expr::createConcat (result, byte);
+    }
+
+  SymbolicValue res (result);
+  result->deref ();
+
+  return res;
+}
+
+/* The newest write that is known to hit addr hides the older ones; the
+ * alternatives are built from the oldest write. */
+Expr *
+SymbolicMemory::apply_symbolic_writes (const Expr *addr, Expr *byte,
+				       std::size_t first) const
+{
+  std::vector<std::pair<Expr *, const Expr *> > hits;
+
+  for (std::size_t i = symbolic_writes.size (); i > first; i--)
+    {
+      const SymbolicWrite &w = symbolic_writes[i - 1];
+
+      if (w.addr.get_Expr ()->get_bv_size () != addr->get_bv_size ())
+	continue;
+
+      Option<bool> hit = s_same_address (w.addr.get_Expr (), addr);
+
+      if (! hit.hasValue ())
+	{
+	  Expr *cond = Expr::createEquality (w.addr.get_Expr ()->ref (),
+					     addr->ref ());
+	  hits.push_back (std::make_pair (cond, w.value.get_Expr ()));
+	}
+      else if (hit.getValue ())
+	{
+	  byte->deref ();
+	  byte = w.value.get_Expr ()->ref ();
+	  break;
+	}
+    }
+
+  for (std::size_t i = hits.size (); i > 0; i--)
+    byte = s_select (hits[i - 1].first, hits[i - 1].second->ref (), byte);
+
+  return byte;
+}
+
+bool
+SymbolicMemory::has_symbolic_writes () const
+{
+  return ! symbolic_writes.empty ();
+}
+
+bool
+SymbolicMemory::has_pending_writes (address_t a) const
+{
+  if (symbolic_writes.empty ())
+    return false;
+
+  const std::size_t *first = write_positions.find (a);
+
+  return (first == NULL ? 0 : *first) < symbolic_writes.size ();
+}
+
+/* The cells are shared with the clone until one of them writes into
+ * their page; the registers are copied. */
 SymbolicMemory *
 SymbolicMemory::clone () const
 {
@@ -164,9 +479,11 @@ SymbolicMemory::clone () const
     result->put (i->first, i->second);
   }
 
-  for (MemoryMap::const_iterator i = memory.begin (); i != memory.end (); i++) {
-    result->memory[i->first] = i->second;
-  }
+  result->memory = memory;
+  result->memory_hash = memory_hash;
+  result->symbolic_writes = symbolic_writes;
+  result->write_positions = write_positions;
+  result->symbolic_writes_hash = symbolic_writes_hash;
   result->minaddr = minaddr;
   result->maxaddr = maxaddr;
 
@@ -180,6 +497,26 @@ SymbolicMemory::is_defined (const RegisterDesc *rdesc) const
 	  base->is_defined (rdesc));
 }
 
+void
+SymbolicMemory::put (const RegisterDesc *rdesc, SymbolicValue v)
+{
+  if (RegisterMap<SymbolicValue>::is_defined (rdesc))
+    registers_hash -=
+      s_register_hash (rdesc, RegisterMap<SymbolicValue>::get (rdesc));
+  RegisterMap<SymbolicValue>::put (rdesc, v);
+  registers_hash += s_register_hash (rdesc, v);
+}
+
+void
+SymbolicMemory::clear (const RegisterDesc *rdesc)
+{
+  if (! RegisterMap<SymbolicValue>::is_defined (rdesc))
+    return;
+  registers_hash -=
+    s_register_hash (rdesc, RegisterMap<SymbolicValue>::get (rdesc));
+  RegisterMap<SymbolicValue>::clear (rdesc);
+}
+
 SymbolicValue
 SymbolicMemory::get (const RegisterDesc *rdesc) const
   throw (UndefinedValueException)
@@ -203,10 +540,19 @@ void
 SymbolicMemory::output_text (std::ostream &out) const
 {
   out << "MemoryDump: " << std::endl;
-  for (MemoryMap::const_iterator i = memory.begin (); i != memory.end (); i++) {
-    out << std::hex << i->first << " " << i->second << std::endl;
+  for (const_memcell_iterator i = memory.begin (); i != memory.end (); i++) {
+    out << std::hex << i->first << " " << i->second.value << std::dec
+	<< " [" << i->second.offset << "]" << std::endl;
   }
 
+  if (! symbolic_writes.empty ())
+    {
+      out << "Symbolic writes: " << std::endl;
+      for (std::size_t i = 0; i < symbolic_writes.size (); i++)
+	out << symbolic_writes[i].addr << " " << symbolic_writes[i].value
+	    << std::endl;
+    }
+
   out << "Registers: " << std::endl;
   RegisterMap<SymbolicValue>::output_text (out);
 }
@@ -215,19 +561,25 @@ bool
 SymbolicMemory::equals (const SymbolicMemory &mem) const
 {
   if (memory.size () != mem.memory.size () ||
-      this->RegisterMap<SymbolicValue>::size () != mem.RegisterMap<SymbolicValue>::size ())
+      this->RegisterMap<SymbolicValue>::size () != mem.RegisterMap<SymbolicValue>::size () ||
+      symbolic_writes.size () != mem.symbolic_writes.size () ||
+      write_positions.size () != mem.write_positions.size ())
     return false;
 
   if (base != mem.base)
     return false;
 
+  if (hashcode () != mem.hashcode ())
+    return false;
+
   try
     {
-      for (MemoryMap::const_iterator i = memory.begin (); i != memory.end ();
+      for (const_memcell_iterator i = memory.begin (); i != memory.end ();
 	   i++)
 	{
-	  SymbolicValue v = mem.get (i->first, 1, Architecture::LittleEndian);
-	  if (! i->second.equals (v))
+	  const Cell *c = mem.memory.find (i->first);
+	  if (c == NULL || c->offset != i->second.offset ||
+	      ! i->second.value.equals (c->value))
 	    return false;
 	}
 
@@ -238,6 +590,19 @@ SymbolicMemory::equals (const SymbolicMemory &mem) const
 	  if (! i->second.equals (v))
 	    return false;
 	}
+
+      for (std::size_t i = 0; i < symbolic_writes.size (); i++)
+	if (! symbolic_writes[i].addr.equals (mem.symbolic_writes[i].addr) ||
+	    ! symbolic_writes[i].value.equals (mem.symbolic_writes[i].value))
+	  return false;
+
+      for (PagedMap<std::size_t>::const_iterator i = write_positions.begin ();
+	   i != write_positions.end (); i++)
+	{
+	  const std::size_t *p = mem.write_positions.find (i->first);
+	  if (p == NULL || *p != i->second)
+	    return false;
+	}
     }
   catch (UndefinedValueException&)
     {
@@ -249,20 +614,7 @@ SymbolicMemory::equals (const SymbolicMemory &mem) const
 std::size_t
 SymbolicMemory::hashcode () const
 {
-  std::size_t result = 0;
-
-  for (MemoryMap::const_iterator i = memory.begin (); i != memory.end (); i++) {
-    result = ((result << 3) + 19 * i->first +
-	      177 * (intptr_t) i->second.get_Expr ());
-  }
-
-  for (RegisterMap<SymbolicValue>::const_reg_iterator i = regs_begin ();
-       i != regs_end (); i++) {
-    result = ((result << 3) + 19 * (intptr_t) i->first +
-	      177 * (intptr_t) i->second.get_Expr ());
-  }
-
-  return result;
+  return 13 * memory_hash + 141 * registers_hash + 37 * symbolic_writes_hash;
 }
 
 void
@@ -283,3 +635,119 @@ SymbolicMemory::end () const
 {
   return memory.end ();
 }
+
+void
+SymbolicMemory::save (ExprBinaryWriter &out) const
+{
+  out.write_uint (minaddr);
+  out.write_uint (maxaddr);
+  out.write_uint (memory.size ());
+  for (const_memcell_iterator i = memory.begin (); i != memory.end (); i++)
+    {
+      out.write_uint (i->first);
+      out.write_expr (i->second.value.get_Expr ());
+      out.write_uint (i->second.offset);
+    }
+
+  out.write_uint (RegisterMap<SymbolicValue>::size ());
+  for (const_reg_iterator i = regs_begin (); i != regs_end (); i++)
+    {
+      out.write_register (i->first);
+      out.write_expr (i->second.get_Expr ());
+    }
+
+  out.write_uint (symbolic_writes.size ());
+  for (std::size_t i = 0; i < symbolic_writes.size (); i++)
+    {
+      out.write_expr (symbolic_writes[i].addr.get_Expr ());
+      out.write_expr (symbolic_writes[i].value.get_Expr ());
+    }
+  out.write_uint (write_positions.size ());
+  for (PagedMap<std::size_t>::const_iterator i = write_positions.begin ();
+       i != write_positions.end (); i++)
+    {
+      out.write_uint (i->first);
+      out.write_uint (i->second);
+    }
+}
+
+SymbolicMemory *
+SymbolicMemory::restore (ExprBinaryReader &in, const ConcreteMemory *base)
+  throw (BinaryReader::Exception)
+{
+  SymbolicMemory *result = new SymbolicMemory (base);
+
+  try
+    {
+      result->minaddr = in.read_uint ();
+      result->maxaddr = in.read_uint ();
+
+      uint64_t nb_cells = in.read_uint ();
+      for (uint64_t i = 0; i < nb_cells; i++)
+	{
+	  address_t a = in.read_uint ();
+	  Expr *e = in.read_expr ();
+
+	  if (e == NULL)
+	    throw BinaryReader::Exception ("undefined memory cell");
+	  Cell c;
+	  c.value = SymbolicValue (e);
+	  e->deref ();
+	  c.offset = in.read_uint ();
+	  if (c.offset < 0 || 8 * c.offset >= c.value.get_size ())
+	    throw BinaryReader::Exception ("bad offset of memory cell");
+	  result->memory.put (a, c);
+	  result->memory_hash += s_memcell_hash (a, c);
+	}
+
+      uint64_t nb_regs = in.read_uint ();
+      for (uint64_t i = 0; i < nb_regs; i++)
+	{
+	  const RegisterDesc *r = in.read_register ();
+	  Expr *e = in.read_expr ();
+
+	  if (e == NULL)
+	    throw BinaryReader::Exception ("undefined register value");
+	  result->put (r, SymbolicValue (e));
+	  e->deref ();
+	}
+
+      uint64_t nb_writes = in.read_uint ();
+      for (uint64_t i = 0; i < nb_writes; i++)
+	{
+	  Expr *a = in.read_expr ();
+	  Expr *v = in.read_expr ();
+
+	  if (a == NULL || v == NULL)
+	    {
+	      if (a != NULL)
+		a->deref ();
+	      if (v != NULL)
+		v->deref ();
+	      throw BinaryReader::Exception ("undefined symbolic write");
+	    }
+	  SymbolicWrite w;
+	  w.addr = SymbolicValue (a);
+	  w.value = SymbolicValue (v);
+	  a->deref ();
+	  v->deref ();
+	  result->symbolic_writes_hash +=
+	    s_symbolic_write_hash (i, w.addr, w.value);
+	  result->symbolic_writes.push_back (w);
+	}
+
+      uint64_t nb_positions = in.read_uint ();
+      for (uint64_t i = 0; i < nb_positions; i++)
+	{
+	  address_t a = in.read_uint ();
+	  result->write_positions.put (a, in.read_uint ());
+	}
+    }
+  catch (BinaryReader::Exception &)
+    {
+      delete result;
+      throw;
+    }
+
+  return result;
+}
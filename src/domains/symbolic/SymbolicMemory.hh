@@ -37,7 +37,13 @@
 # include <kernel/RegisterMap.hh>
 # include <domains/concrete/ConcreteMemory.hh>
 # include <domains/symbolic/SymbolicValue.hh>
+# include <utils/BinaryStream.hh>
+# include <utils/PagedMap.hh>
 # include <utils/unordered11.hh>
+# include <vector>
+
+class ExprBinaryWriter;
+class ExprBinaryReader;
 
 class SymbolicMemory
   : public Memory<ConcreteAddress, SymbolicValue>,
@@ -47,7 +53,17 @@ class SymbolicMemory
   address_t maxaddr;
 
 public:
-  typedef std::unordered_map<address_t, SymbolicValue> MemoryMap;
+  /* A byte of memory: the value given to put () and the index of the
+   * byte within it, 0 being the least significant byte. Reading the
+   * bytes of a same value in the order they were written returns this
+   * value, or an extraction of it, instead of a concatenation of
+   * bytes. */
+  struct Cell {
+    SymbolicValue value;
+    int offset;
+  };
+
+  typedef PagedMap<Cell> MemoryMap;
   typedef MemoryMap::const_iterator const_memcell_iterator;
   typedef ConcreteAddress Address;
   typedef SymbolicValue Value;
@@ -66,17 +82,50 @@ public:
 
   virtual bool is_defined(const ConcreteAddress &a) const;
 
+  /* Give its initial content to the cells at a, i.e. the one they had
+   * before the writes at symbolic addresses. */
+  void define (const ConcreteAddress &a, const SymbolicValue &v,
+	       Architecture::endianness_t e);
+
+  /* Writes at an address that is not a constant are logged, byte by
+   * byte, and applied when cells are read: get () returns the value of
+   * the cells with, for each logged write that follows the last write
+   * into the cell, an alternative on the equality of the addresses. A
+   * write that is shown to hit (or miss) the cell by simplification
+   * is folded without alternative. Once the log is not empty, put ()
+   * also logs the writes into the cells. */
+  void put_symbolic (const Expr *addr, const SymbolicValue &v,
+		     Architecture::endianness_t e);
+
+  /* Read through an address that is not a constant: the cells are
+   * MemCell expressions on which the logged writes are applied. */
+  SymbolicValue get_symbolic (const Expr *addr, int size_in_bytes,
+			      Architecture::endianness_t e) const;
+
+  bool has_symbolic_writes () const;
+
   virtual SymbolicMemory *clone () const;
 
+  /* Write the cells and the registers set in this memory; the content of
+   * the base memory is not written. */
+  void save (ExprBinaryWriter &out) const;
+  static SymbolicMemory *restore (ExprBinaryReader &in,
+				  const ConcreteMemory *base)
+    throw (BinaryReader::Exception);
+
   virtual bool is_defined(const RegisterDesc *rdesc) const;
   virtual SymbolicValue get(const RegisterDesc *rdesc) const
     throw (UndefinedValueException);
 
-  using RegisterMap<SymbolicValue>::put;
+  virtual void put (const RegisterDesc *rdesc, SymbolicValue v);
+  virtual void clear (const RegisterDesc *rdesc);
 
   virtual void output_text (std::ostream &out) const;
 
   virtual bool equals (const SymbolicMemory &mem) const;
+
+  /* The hash value is maintained incrementally by put () and clear ()
+   * hence this method runs in constant time. */
   virtual std::size_t hashcode () const;
 
 
@@ -85,8 +134,30 @@ public:
   virtual const_memcell_iterator end () const;
 
 private:
+  void put_cells (const ConcreteAddress &a, const SymbolicValue &v,
+		  Architecture::endianness_t e);
+  void log_write (const Expr *addr, const SymbolicValue &v,
+		  Architecture::endianness_t e);
+  Expr *apply_symbolic_writes (const Expr *addr, Expr *byte,
+			       std::size_t first) const;
+  /* Whether a symbolic write follows the last write into the cell. */
+  bool has_pending_writes (address_t a) const;
+
+  /* A byte written at an address that is not a constant. */
+  struct SymbolicWrite {
+    SymbolicValue addr;
+    SymbolicValue value;
+  };
+
   const ConcreteMemory *base;
   MemoryMap memory;
+  std::vector<SymbolicWrite> symbolic_writes;
+  /* Number of writes at symbolic addresses done before the last write
+   * into a cell; missing cells have none. */
+  PagedMap<std::size_t> write_positions;
+  std::size_t memory_hash;
+  std::size_t registers_hash;
+  std::size_t symbolic_writes_hash;
 };
 
 #endif /* ! SYMBOLICMEMORY_HH */
@@ -12,12 +12,22 @@ namespace SymbStepper {
     const SymbolicContext *ctx;
     const Architecture::endianness_t endianness;
     SymbolicStepper::UnknownGenerator *unkgen;
+    bool with_symbolic_writes;
 
 public:
     RewriteWithAssignedValues (const SymbolicContext *ctx,
 			       SymbolicStepper::UnknownGenerator *unkgen,
-			       Architecture::endianness_t e)
-      : ctx (ctx), endianness (e), unkgen (unkgen) {
+			       Architecture::endianness_t e,
+			       bool with_symbolic_writes = false)
+      : ctx (ctx), endianness (e), unkgen (unkgen),
+	with_symbolic_writes (with_symbolic_writes) {
+    }
+
+    /* Whether cells at symbolic addresses are read through the writes
+     * logged by the memory; this has to be done only for the cells of
+     * a statement, not for those found in the values of the memory. */
+    void set_with_symbolic_writes (bool value) {
+      with_symbolic_writes = value;
     }
 
     virtual Expr *rewrite (const Expr *F) {
@@ -61,11 +71,22 @@ public:
 	      else
 		{
 		  SymbolicValue v = unkgen->unknown_value (size * 8);
-		  ctx->get_memory ()->put (ConcreteAddress (c->get_val ()), v,
-					   endianness);
-		  val = v;
+		  ctx->get_memory ()->define (ConcreteAddress (c->get_val ()),
+					      v, endianness);
+		  if (ctx->get_memory ()->has_symbolic_writes ())
+		    val = ctx->get_memory ()->get (c->get_val (), size,
+						   endianness);
+		  else
+		    val = v;
 		}
 	    }
+	  else if (with_symbolic_writes &&
+		   ctx->get_memory ()->has_symbolic_writes ())
+	    {
+	      int size =
+		(mc->get_bv_offset() + mc->get_bv_size () - 1) / 8 + 1;
+	      val = ctx->get_memory ()->get_symbolic (addr, size, endianness);
+	    }
 	  addr->deref ();
 	}
 
@@ -89,7 +110,8 @@ using namespace SymbStepper;
 
 SymbolicStepper::SymbolicStepper (ConcreteMemory *memory,
 				  const MicrocodeArchitecture *arch)
-  : Super (arch->get_reference_arch ()), memory (memory)
+  : Super (arch->get_reference_arch ()), array_memory_model (false),
+    memory (memory)
 
 {
   solver = ExprSolver::create_default_solver (arch);
@@ -98,9 +120,17 @@ SymbolicStepper::SymbolicStepper (ConcreteMemory *memory,
 }
 
 SymbolicStepper::~SymbolicStepper () {
+  for (SatCache::iterator i = sat_cache.begin (); i != sat_cache.end (); i++)
+    i->first->deref ();
   delete solver;
 }
 
+void
+SymbolicStepper::set_array_memory_model (bool value)
+{
+  array_memory_model = value;
+}
+
 ConcreteValue
 SymbolicStepper::value_to_ConcreteValue (const Context *ctx, const Value &v,
 					 bool *is_unique)
@@ -125,7 +155,7 @@ SymbolicStepper::value_to_ConcreteValue (const Context *ctx, const Value &v,
     }
   exprutils::simplify (&f);
 
-  Expr *cond = sc->get_path_condition ()->ref ();
+  Expr *cond = exprutils::slice_conjunction (sc->get_path_condition (), f);
 
   std::vector<constant_t> *values =
     solver->evaluate (f, cond, is_unique ? 2 : 1);
@@ -233,6 +263,98 @@ s_expand_memcell_indexes (class ExprSolver *solver,
   return result;
 }
 
+/* Instead of expanding the indexes of the cells read by e, the content
+ * of the cells they may address under cond is returned in constraints on
+ * the memory of the solver. Returns false, and leaves constraints
+ * unchanged, if the address of a cell has more than jmpthreshold values
+ * or reads the memory. */
+static bool
+s_constrain_memcells (class ExprSolver *solver,
+		      SymbolicStepper::UnknownGenerator *unkgen,
+		      const Architecture *arch, const SymbolicContext *ctx,
+		      const Expr *e, const Expr *cond, Expr **constraints,
+		      int jmpthreshold)
+{
+  typedef std::list<const Expr *> ExprList;
+  ExprList cells =
+    exprutils::collect_subterms_of_type<ExprList, MemCell> (e, true);
+  Expr *cells_content = Constant::True ();
+  bool result = true;
+
+  for (ExprList::const_iterator i = cells.begin ();
+       result && i != cells.end (); i++)
+    {
+      const MemCell *mc = dynamic_cast<const MemCell *> (*i);
+      assert (mc != NULL);
+      const Expr *addr = mc->get_addr ();
+      int size = (mc->get_bv_offset() + mc->get_bv_size () - 1) / 8 + 1;
+
+      if (! exprutils::collect_subterms_of_type<ExprList, MemCell> (addr,
+								    true).empty ())
+	{
+	  result = false;
+	  break;
+	}
+
+      std::vector<constant_t> *addrs =
+	solver->evaluate (addr, cond, jmpthreshold);
+      if (jmpthreshold >= 0 && (int) addrs->size () > jmpthreshold)
+	result = false;
+
+      for (std::size_t k = 0; result && k < addrs->size (); k++)
+	{
+	  Expr *cell =
+	    MemCell::create (Constant::create (addrs->at (k), 0,
+					       addr->get_bv_size ()),
+			     0, 8 * size);
+	  RewriteWithAssignedValues r (ctx, unkgen, arch->get_endian ());
+	  cell->acceptVisitor (r);
+	  cells_content =
+	    Expr::createLAnd (cells_content,
+			      Expr::createEquality (cell, r.get_result ()));
+	}
+      delete addrs;
+    }
+
+  if (result)
+    *constraints = cells_content;
+  else
+    cells_content->deref ();
+
+  return result;
+}
+
+/* Rewrite e with the values assigned in the context of r until it does
+ * not change. */
+static Expr *
+s_rewrite (RewriteWithAssignedValues &r, Expr *e)
+{
+  for (;;)
+    {
+      e->acceptVisitor (r);
+      Expr *aux = r.get_result ();
+      e->deref ();
+      if (aux == e)
+	break;
+      e = aux;
+    }
+
+  return e;
+}
+
+/* The conjuncts of pc that e depends on, with in_range if it is not
+ * NULL. */
+static Expr *
+s_slice_path_condition (const Expr *pc, const Expr *e, const Expr *in_range)
+{
+  Expr *result = exprutils::slice_conjunction (pc, e);
+
+  if (in_range != NULL)
+    result = Expr::createLAnd (in_range->ref (), result);
+
+  return result;
+}
+
 std::vector<address_t> *
 SymbolicStepper::value_to_concrete_addresses (const Context *ctx,
 					      const Value &v)
@@ -244,43 +366,42 @@ SymbolicStepper::value_to_concrete_addresses (const Context *ctx,
   std::vector<address_t> *result = new std::vector<address_t> ();
   RewriteWithAssignedValues r (sc, unkgen, this->arch->get_endian ());
   const Expr *e = v.get_Expr ();
-  Expr *f = e->ref ();
-
-  for (;;)
-    {
-      f->acceptVisitor (r);
-      Expr *aux = r.get_result ();
-      f->deref ();
-      if (aux == f)
-	break;
-      f = aux;
-    }
+  Expr *f = s_rewrite (r, e->ref ());
 
   address_t range[2];
   sc->get_memory ()->get_address_range (range[0], range[1]);
-  Expr *cond = sc->get_path_condition ()->ref ();
+  Expr *pc = s_rewrite (r, sc->get_path_condition ()->ref ());
+  Expr *in_range = NULL;
 
   if (this->map_dynamic_jumps_to_memory)
-    cond = Expr::createLAnd (s_expr_in_range (e, range[0], range[1]), cond);
-
-  for (;;)
+    in_range = s_rewrite (r, s_expr_in_range (e, range[0], range[1]));
+
+  /* without symbolic writes the content of the cells is known and the
+   * expansion produces the same addresses with fewer checks */
+  Expr *cond = s_slice_path_condition (pc, f, in_range);
+  Expr *constraints = NULL;
+  std::vector<Expr *> *expaddr;
+  if (array_memory_model && sc->get_memory ()->has_symbolic_writes () &&
+      s_constrain_memcells (solver, unkgen, this->arch, sc, f, cond,
+			    &constraints, this->dynamic_jump_threshold))
     {
-      cond->acceptVisitor (r);
-      Expr *aux = r.get_result ();
-      cond->deref ();
-      if (aux == cond)
-	break;
-      cond = aux;
+      pc = Expr::createLAnd (pc, constraints);
+      expaddr = new std::vector<Expr *> (1, f->ref ());
     }
+  else
+    expaddr = s_expand_memcell_indexes (solver, unkgen, this->arch, sc, f,
+					cond, this->dynamic_jump_threshold);
+  cond->deref ();
 
-  std::vector<Expr *> *expaddr =
-    s_expand_memcell_indexes (solver, unkgen, this->arch, sc, f, cond,
-			      this->dynamic_jump_threshold);
+  /* the contents of the cells may read variables that f does not, hence
+   * the path condition is sliced again for each expanded address */
   for (std::vector<Expr *>::size_type i = 0; i < expaddr->size (); i++)
     {
       int th = this->dynamic_jump_threshold;
       Expr *aux = expaddr->at (i);
+      cond = s_slice_path_condition (pc, aux, in_range);
       std::vector<constant_t> *tmp = solver->evaluate (aux, cond, th);
+      cond->deref ();
       aux->deref ();
 
       if (th >= 0 && (int)tmp->size () >= th)
@@ -292,8 +413,10 @@ SymbolicStepper::value_to_concrete_addresses (const Context *ctx,
     }
   delete (expaddr);
 
+  if (in_range != NULL)
+    in_range->deref ();
+  pc->deref ();
   f->deref ();
-  cond->deref ();
 
   assert (result != NULL);
 
@@ -307,7 +430,8 @@ SymbolicStepper::eval (const Context *ctx, const Expr *e)
   SymbolicStepper::Value result;
   const SymbolicContext *sc = dynamic_cast<const SymbolicContext *> (ctx);
   assert (sc != NULL);
-  RewriteWithAssignedValues r (sc, unkgen, this->arch->get_endian ());
+  RewriteWithAssignedValues r (sc, unkgen, this->arch->get_endian (),
+			       array_memory_model);
   Expr *f = e->ref ();
 
   for (;;)
@@ -315,12 +439,15 @@ SymbolicStepper::eval (const Context *ctx, const Expr *e)
       f->acceptVisitor (r);
       Expr *aux = r.get_result ();
       f->deref ();
+      r.set_with_symbolic_writes (false);
       if (aux == f)
 	break;
       f = aux;
     }
   exprutils::simplify (&f);
-  Constant *c = solver->evaluate (f, sc->get_path_condition ());
+  Expr *cond = exprutils::slice_conjunction (sc->get_path_condition (), f);
+  Constant *c = solver->evaluate (f, cond);
+  cond->deref ();
   if (c != NULL)
     {
       f->deref ();
@@ -336,6 +463,33 @@ SymbolicStepper::eval (const Context *ctx, const Expr *e)
   return result;
 }
 
+void
+SymbolicStepper::exec (Context *newctx, const Statement *st)
+{
+  const Assignment *assign = dynamic_cast<const Assignment *> (st);
+
+  if (! array_memory_model || assign == NULL ||
+      ! assign->get_lval ()->is_MemCell ())
+    {
+      Super::exec (newctx, st);
+      return;
+    }
+
+  const MemCell *cell = dynamic_cast<const MemCell *> (assign->get_lval ());
+
+  assert (cell->get_bv_offset () == 0);
+  assert (cell->get_bv_size () == assign->get_rval ()->get_bv_size ());
+  Value va (eval (newctx, cell->get_addr ()));
+  Value v (eval (newctx, assign->get_rval ()));
+
+  if (va.get_Expr ()->is_Constant ())
+    newctx->get_memory ()->put (value_to_address (newctx, va), v,
+				this->arch->get_endian ());
+  else
+    newctx->get_memory ()->put_symbolic (va.get_Expr (), v,
+					 this->arch->get_endian ());
+}
+
 SymbolicStepper::Value
 SymbolicStepper::embed_eval (const SymbolicStepper::Value &v1,
 			     const SymbolicStepper::Value &v2,
@@ -345,65 +499,69 @@ SymbolicStepper::embed_eval (const SymbolicStepper::Value &v1,
 }
 
 
-static Option<bool>
-s_to_bool (ExprSolver *solver, SymbolicStepper::UnknownGenerator *unkgen,
-	   const Architecture *arch,
-	   const SymbolicContext *ctx, const Expr *e,
-	   Expr **symbval)
+/* Bound on the number of formulas kept by the satisfiability cache. */
+static const std::size_t SAT_CACHE_SIZE = 4096;
+
+ExprSolver::Result
+SymbolicStepper::check_sat (Expr *f)
 {
-  Option<bool> result;
-  RewriteWithAssignedValues r (ctx, unkgen, arch->get_endian ());
-  Expr *f = e->ref ();
-  f->acceptVisitor (r);
-  f->deref ();
-  f = r.get_result ();
+  SatCache::iterator i = sat_cache.find (f);
 
-  ExprSolver::Result sat = solver->check_sat (f, true);
-  if (sat == ExprSolver::SAT)
-    {
-      Expr *tmp = Expr::createLNot (f->ref ());
-      sat = solver->check_sat (tmp, true);
-      if (sat  == ExprSolver::UNSAT)
-	result = true;
-      tmp->deref ();
-    }
-  else if (sat == ExprSolver::UNSAT)
+  if (i != sat_cache.end ())
     {
-      result = false;
+      f->deref ();
+      return i->second;
     }
 
-  if (! result.hasValue () && symbval != NULL)
-    *symbval = f;
-  else
+  ExprSolver::Result result = solver->check_sat (f, true);
+  if (result == ExprSolver::UNKNOWN)
     f->deref ();
+  else
+    {
+      if (sat_cache.size () >= SAT_CACHE_SIZE)
+	{
+	  for (i = sat_cache.begin (); i != sat_cache.end (); i++)
+	    i->first->deref ();
+	  sat_cache.clear ();
+	}
+      sat_cache[f] = result;
+    }
 
   return result;
 }
 
+/* The path condition of a state is satisfiable; the conjuncts that are
+ * independent of cond can hence be left out of the checks. The
+ * condition is added to the path condition unless the latter implies
+ * it. */
 SymbolicStepper::Context *
 SymbolicStepper::restrict_to_condition (const Context *ctx, const Expr *cond)
 {
   const SymbolicContext *sc = dynamic_cast<const SymbolicContext *> (ctx);
   assert (sc != NULL);
   SymbolicContext *result = NULL;
-  Expr *e = Expr::createLAnd (sc->get_path_condition ()->ref (), cond->ref ());
-  Expr *val = NULL;
-  Option<bool> eval = s_to_bool (solver, unkgen, this->arch, sc, e, &val);
+  RewriteWithAssignedValues r (sc, unkgen, this->arch->get_endian ());
+  cond->acceptVisitor (r);
+  Expr *c = r.get_result ();
+  Expr *pc = sc->get_path_condition ()->ref ();
+  Expr *slice = exprutils::slice_conjunction (pc, c);
 
-  if (eval.hasValue ())
+  if (check_sat (Expr::createLAnd (slice->ref (), c->ref ())) !=
+      ExprSolver::UNSAT)
     {
-      assert (val == NULL);
-      if (eval.getValue ())
-	result = sc->clone ();
-    }
-  else
-    {
-      assert (val != NULL);
-      exprutils::simplify_level0 (&val);
       result = sc->clone ();
-      result->set_path_condition (val);
+      if (check_sat (Expr::createLAnd (slice->ref (),
+				       Expr::createLNot (c->ref ()))) !=
+	  ExprSolver::UNSAT)
+	{
+	  Expr *val = Expr::createLAnd (pc->ref (), c->ref ());
+	  exprutils::simplify_level0 (&val);
+	  result->set_path_condition (val);
+	}
     }
-  e->deref ();
+  slice->deref ();
+  pc->deref ();
+  c->deref ();
 
   return result;
 }
@@ -7,6 +7,8 @@
 # include <domains/symbolic/SymbolicMemory.hh>
 # include <domains/symbolic/SymbolicContext.hh>
 # include <domains/symbolic/SymbolicExprSemantics.hh>
+# include <kernel/expressions/ExprSolver.hh>
+# include <utils/unordered11.hh>
 
 
 class SymbolicStepper :
@@ -15,6 +17,13 @@ class SymbolicStepper :
 private:
   class ExprSolver *solver;
 
+  /* Satisfiability of the formulas built by restrict_to_condition ();
+   * they are hash-consed and kept referenced by the cache. */
+  typedef std::unordered_map<Expr *, ExprSolver::Result> SatCache;
+  SatCache sat_cache;
+
+  ExprSolver::Result check_sat (Expr *f);
+
 public:
   typedef AbstractDomainStepper<MicrocodeAddressProgramPoint,
 				SymbolicContext> Super;
@@ -45,10 +54,20 @@ public:
 
   virtual State *get_initial_state (const ConcreteAddress &entrypoint);
 
+  /* With the arrays memory model, writes at symbolic addresses are
+   * logged by the memory (see SymbolicMemory::put_symbolic) instead of
+   * being undefined, and the cells read by dynamic jumps are given to the
+   * solver as constraints on its memory instead of expanding the
+   * candidate addresses one by one. */
+  void set_array_memory_model (bool value);
+
 protected:
   virtual Context *
   restrict_to_condition (const Context *ctx, const Expr *cond);
 
+  virtual void exec (Context *newctx, const Statement *st);
+
+  bool array_memory_model;
   ConcreteMemory *memory;
 };
 
@@ -52,6 +52,11 @@ ConcreteAddress BinaryLoader::get_entrypoint() const
   return entrypoint;
 }
 
+const list<BinaryLoader::section_t> &BinaryLoader::get_sections() const
+{
+  return sections;
+}
+
 bool
 BinaryLoader::load_symbol_table (SymbolTable *) const
 {
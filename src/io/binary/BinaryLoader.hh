@@ -126,6 +126,7 @@ public:
 
   const Architecture * get_architecture() const;
   ConcreteAddress get_entrypoint() const;
+  const std::list<section_t> &get_sections() const;
 
   virtual bool load_symbol_table (SymbolTable *table) const;
   virtual bool load_memory (ConcreteMemory *memory) const;
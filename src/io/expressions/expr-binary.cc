@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "expr-binary.hh"
+
+#include <cassert>
+
+#include <utils/logs.hh>
+
+using namespace std;
+
+/* An expression reference is either NULL, a new definition or the index of
+ * an expression already defined on the stream (shifted by EXPR_REF_BASE). */
+enum ExprRef {
+  EXPR_REF_NULL = 0,
+  EXPR_REF_DEFINITION = 1,
+  EXPR_REF_BASE = 2
+};
+
+enum ExprKind {
+  EXPR_CONSTANT = 0,
+  EXPR_VARIABLE,
+  EXPR_RANDOM_VALUE,
+  EXPR_UNARY_APP,
+  EXPR_BINARY_APP,
+  EXPR_TERNARY_APP,
+  EXPR_MEMCELL,
+  EXPR_REGISTER,
+  EXPR_QUANTIFIED
+};
+
+ExprBinaryWriter::ExprBinaryWriter (ostream &out)
+  : BinaryWriter (out), exprs ()
+{
+}
+
+ExprBinaryWriter::~ExprBinaryWriter ()
+{
+}
+
+void
+ExprBinaryWriter::write_expr (const Expr *e)
+{
+  if (e == NULL)
+    {
+      write_uint (EXPR_REF_NULL);
+      return;
+    }
+
+  unordered_map<const Expr *, size_t>::const_iterator i = exprs.find (e);
+  if (i != exprs.end ())
+    {
+      write_uint (EXPR_REF_BASE + i->second);
+      return;
+    }
+
+  write_uint (EXPR_REF_DEFINITION);
+  if (e->is_Constant ())
+    {
+      write_uint (EXPR_CONSTANT);
+      write_uint ((uword_t) ((const Constant *) e)->get_not_truncated_value ());
+    }
+  else if (e->is_Variable ())
+    {
+      const Variable *v = (const Variable *) e;
+      write_uint (EXPR_VARIABLE);
+      write_string (v->get_id ());
+      write_uint (v->get_size ());
+    }
+  else if (e->is_RandomValue ())
+    {
+      write_uint (EXPR_RANDOM_VALUE);
+    }
+  else if (e->is_UnaryApp ())
+    {
+      const UnaryApp *u = (const UnaryApp *) e;
+      write_uint (EXPR_UNARY_APP);
+      write_uint (u->get_op ());
+      write_expr (u->get_arg1 ());
+    }
+  else if (e->is_BinaryApp ())
+    {
+      const BinaryApp *b = (const BinaryApp *) e;
+      write_uint (EXPR_BINARY_APP);
+      write_uint (b->get_op ());
+      write_expr (b->get_arg1 ());
+      write_expr (b->get_arg2 ());
+    }
+  else if (e->is_TernaryApp ())
+    {
+      const TernaryApp *t = (const TernaryApp *) e;
+      write_uint (EXPR_TERNARY_APP);
+      write_uint (t->get_op ());
+      write_expr (t->get_arg1 ());
+      write_expr (t->get_arg2 ());
+      write_expr (t->get_arg3 ());
+    }
+  else if (e->is_MemCell ())
+    {
+      const MemCell *m = (const MemCell *) e;
+      write_uint (EXPR_MEMCELL);
+      write_string (m->get_tag ());
+      write_expr (m->get_addr ());
+    }
+  else if (e->is_RegisterExpr ())
+    {
+      write_uint (EXPR_REGISTER);
+      write_register (((const RegisterExpr *) e)->get_descriptor ());
+    }
+  else if (e->is_QuantifiedFormula ())
+    {
+      const QuantifiedExpr *q = (const QuantifiedExpr *) e;
+      write_uint (EXPR_QUANTIFIED);
+      write_bool (q->is_exists ());
+      write_expr (q->get_variable ());
+      write_expr (q->get_body ());
+    }
+  else
+    {
+      logs::fatal_error ("ExprBinaryWriter: expr type unknown");
+    }
+
+  write_uint (e->get_bv_offset ());
+  write_uint (e->get_bv_size ());
+
+  /* Sub-expressions have been numbered first; the reader does the same. */
+  size_t index = exprs.size ();
+  exprs[e] = index;
+}
+
+void
+ExprBinaryWriter::write_register (const RegisterDesc *reg)
+{
+  write_string (reg->get_label ());
+}
+
+size_t
+ExprBinaryWriter::get_number_of_exprs () const
+{
+  return exprs.size ();
+}
+
+ExprBinaryReader::ExprBinaryReader (const char *data, size_t size,
+				    MicrocodeArchitecture *arch)
+  : BinaryReader (data, size), arch (arch), exprs ()
+{
+}
+
+ExprBinaryReader::~ExprBinaryReader ()
+{
+  for (vector<Expr *>::iterator i = exprs.begin (); i != exprs.end (); i++)
+    (*i)->deref ();
+}
+
+Expr *
+ExprBinaryReader::read_expr ()
+  throw (Exception)
+{
+  uint64_t ref = read_uint ();
+
+  if (ref == EXPR_REF_NULL)
+    return NULL;
+  if (ref == EXPR_REF_DEFINITION)
+    return read_expr_definition ()->ref ();
+  if (ref - EXPR_REF_BASE >= exprs.size ())
+    throw Exception ("invalid expression reference in binary data");
+
+  return exprs[ref - EXPR_REF_BASE]->ref ();
+}
+
+Expr *
+ExprBinaryReader::read_non_null_expr ()
+  throw (Exception)
+{
+  Expr *result = read_expr ();
+
+  if (result == NULL)
+    throw Exception ("unexpected null expression in binary data");
+
+  return result;
+}
+
+template <typename Op>
+static Op
+s_read_op (BinaryReader *in, Op last)
+  throw (BinaryReader::Exception)
+{
+  uint64_t op = in->read_uint ();
+
+  if (op >= (uint64_t) last)
+    throw BinaryReader::Exception ("invalid operator in binary data");
+
+  return (Op) op;
+}
+
+/* Sub-terms are defined inside the definition of their first user; they
+ * get their index before it, exactly as in ExprBinaryWriter::write_expr. */
+Expr *
+ExprBinaryReader::read_expr_definition ()
+  throw (Exception)
+{
+  Expr *args[3] = { NULL, NULL, NULL };
+  uint64_t kind = read_uint ();
+  constant_t val = 0;
+  string id;
+  uint64_t size = 0;
+  bool exists = false;
+  RegisterDesc *reg = NULL;
+  UnaryOp uop = BV_OP_NOT;
+  BinaryOp bop = BV_OP_ADD;
+  TernaryOp top = BV_OP_EXTRACT;
+  int bv_offset = 0;
+  int bv_size = 0;
+
+  try
+    {
+      switch (kind)
+	{
+	case EXPR_CONSTANT:
+	  val = (constant_t) read_uint ();
+	  break;
+	case EXPR_VARIABLE:
+	  id = read_string ();
+	  size = read_uint ();
+	  break;
+	case EXPR_RANDOM_VALUE:
+	  break;
+	case EXPR_UNARY_APP:
+	  uop = s_read_op (this, LAST_UNARY_OP);
+	  args[0] = read_non_null_expr ();
+	  break;
+	case EXPR_BINARY_APP:
+	  bop = s_read_op (this, LAST_BINARY_OP);
+	  args[0] = read_non_null_expr ();
+	  args[1] = read_non_null_expr ();
+	  break;
+	case EXPR_TERNARY_APP:
+	  top = s_read_op (this, LAST_TERNARY_OP);
+	  args[0] = read_non_null_expr ();
+	  args[1] = read_non_null_expr ();
+	  args[2] = read_non_null_expr ();
+	  break;
+	case EXPR_MEMCELL:
+	  id = read_string ();
+	  args[0] = read_non_null_expr ();
+	  break;
+	case EXPR_REGISTER:
+	  reg = read_register ();
+	  break;
+	case EXPR_QUANTIFIED:
+	  exists = read_bool ();
+	  args[0] = read_non_null_expr ();
+	  args[1] = read_non_null_expr ();
+	  if (! args[0]->is_Variable ())
+	    throw Exception ("quantified expression without variable "
+			     "in binary data");
+	  break;
+	default:
+	  throw Exception ("invalid expression kind in binary data");
+	}
+      bv_offset = read_uint ();
+      bv_size = read_uint ();
+    }
+  catch (Exception &)
+    {
+      for (int i = 0; i < 3; i++)
+	if (args[i] != NULL)
+	  args[i]->deref ();
+      throw;
+    }
+
+  /* From now on, the arguments are consumed by the creation functions. */
+  Expr *result = NULL;
+
+  switch (kind)
+    {
+    case EXPR_CONSTANT:
+      result = Constant::create (val, bv_offset, bv_size);
+      break;
+    case EXPR_VARIABLE:
+      result = Variable::create (id, size);
+      break;
+    case EXPR_RANDOM_VALUE:
+      result = RandomValue::create (bv_size);
+      break;
+    case EXPR_UNARY_APP:
+      result = UnaryApp::create (uop, args[0], bv_offset, bv_size);
+      break;
+    case EXPR_BINARY_APP:
+      result = BinaryApp::create (bop, args[0], args[1], bv_offset, bv_size);
+      break;
+    case EXPR_TERNARY_APP:
+      result = TernaryApp::create (top, args[0], args[1], args[2], bv_offset,
+				   bv_size);
+      break;
+    case EXPR_MEMCELL:
+      result = MemCell::create (args[0], id, bv_offset, bv_size);
+      break;
+    case EXPR_REGISTER:
+      result = RegisterExpr::create (reg, bv_offset, bv_size);
+      break;
+    case EXPR_QUANTIFIED:
+      result = QuantifiedExpr::create (exists, (Variable *) args[0], args[1]);
+      break;
+    }
+  assert (result != NULL);
+  exprs.push_back (result);
+
+  return result;
+}
+
+RegisterDesc *
+ExprBinaryReader::read_register ()
+  throw (Exception)
+{
+  string label = read_string ();
+
+  try
+    {
+      return arch->get_register (label);
+    }
+  catch (Architecture::RegisterDescNotFound &)
+    {
+      throw Exception ("unknown register '" + label + "' in binary data");
+    }
+}
+
+MicrocodeArchitecture *
+ExprBinaryReader::get_arch () const
+{
+  return arch;
+}
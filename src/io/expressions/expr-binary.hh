@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef IO_EXPRESSIONS_EXPR_BINARY_HH
+# define IO_EXPRESSIONS_EXPR_BINARY_HH
+
+# include <vector>
+# include <kernel/Expressions.hh>
+# include <kernel/microcode/MicrocodeArchitecture.hh>
+# include <utils/BinaryStream.hh>
+# include <utils/unordered11.hh>
+
+/*! \brief Binary output of expressions. Since expressions are hash-consed,
+ *  the writer emits each distinct expression only once, the first time it
+ *  is referenced; further occurrences are written as an index into the
+ *  expressions already sent on the stream. The size of the output is thus
+ *  linear in the size of the DAG and not in the size of the terms. */
+class ExprBinaryWriter : public BinaryWriter
+{
+public:
+  ExprBinaryWriter (std::ostream &out);
+  virtual ~ExprBinaryWriter ();
+
+  /*! \brief Write 'e' which may be NULL. */
+  void write_expr (const Expr *e);
+  void write_register (const RegisterDesc *reg);
+
+  std::size_t get_number_of_exprs () const;
+
+private:
+  std::unordered_map<const Expr *, std::size_t> exprs;
+};
+
+/*! \brief Reader of the expressions produced by ExprBinaryWriter. Registers
+ *  are retrieved by their label from the architecture given to the reader;
+ *  unknown ones raise an exception. */
+class ExprBinaryReader : public BinaryReader
+{
+public:
+  ExprBinaryReader (const char *data, std::size_t size,
+		    MicrocodeArchitecture *arch);
+  virtual ~ExprBinaryReader ();
+
+  /*! \brief Read the next expression. The caller gets a new reference on
+   *  the result, which may be NULL. */
+  Expr *read_expr () throw (Exception);
+  RegisterDesc *read_register () throw (Exception);
+
+  MicrocodeArchitecture *get_arch () const;
+
+private:
+  Expr *read_expr_definition () throw (Exception);
+  Expr *read_non_null_expr () throw (Exception);
+
+  MicrocodeArchitecture *arch;
+  std::vector<Expr *> exprs;
+};
+
+#endif /* ! IO_EXPRESSIONS_EXPR_BINARY_HH */
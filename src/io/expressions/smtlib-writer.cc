@@ -45,36 +45,52 @@ using namespace std;
 
 class SMTLibVisitor;
 
+/*! Subterms occurring several times in the formula are output once, in a
+ * let-binding, and then referred to by their symbol. Expressions are
+ * hash-consed, so occurrences are counted on the identity of the nodes.
+ *
+ * The bindings are nested in post-order (the subterms of a shared node are
+ * bound before it) and the sharing below a shared node is counted only
+ * once, since the node itself is output once. */
 class CountSharedSubFormulas : public ConstExprVisitor
 {
   struct DFScounters {
     int enter;
     int leave;
     int counter;
+    bool bound;
   };
 
   typedef std::unordered_map<const Expr *, DFScounters> Counters;
-  typedef std::unordered_set<const Expr *> Done;
 
   int max;
   int date;
+  int nb_left;
   Counters counters;
   list<const Expr *> shared;
-  Done done;
 
 public :
 
   CountSharedSubFormulas ()
-    : ConstExprVisitor (), max (0), date (0), counters (), shared (), done () {
+    : ConstExprVisitor (), max (0), date (0), nb_left (0), counters (),
+      shared () {
   }
 
   virtual ~CountSharedSubFormulas () {
   }
 
 
-  bool operator () (const Expr *e1, const Expr *e2) {
-    return  counters[e1].leave < counters[e2].leave;
-  }
+  /* list::sort copies its comparator, which must not hold the counters */
+  struct LeaveOrder {
+    const Counters &counters;
+
+    LeaveOrder (const Counters &c) : counters (c) { }
+
+    bool operator () (const Expr *e1, const Expr *e2) const {
+      return (counters.find (e1)->second.leave <
+	      counters.find (e2)->second.leave);
+    }
+  };
 
   const list<const Expr *> &get_shared () const {
     return shared;
@@ -93,9 +109,9 @@ public :
   }
 
   bool output_shared_expr (const Expr *e, std::ostream &out) {
-    if (done.find (e) == done.end ())
-      return false;
     Counters::const_iterator i = counters.find (e);
+    if (i == counters.end () || ! i->second.bound)
+      return false;
     output_shared_symbol (i->second, out);
 
     return true;
@@ -125,22 +141,31 @@ public :
   }
 
   virtual int update_counter (const Expr *e) {
-    if (counters.find (e) == counters.end ())
+    std::pair<Counters::iterator, bool> i =
+      counters.insert (Counters::value_type (e, DFScounters ()));
+    DFScounters &c = i.first->second;
+
+    if (i.second)
       {
 	date++;
-	counters[e].enter = date;
-	counters[e].counter = 1;
-	counters[e].leave = date;
+	c.enter = date;
+	c.leave = 0;
+	c.counter = 1;
+	c.bound = false;
       }
     else
       {
-	counters[e].counter++;
+	c.counter++;
       }
 
-    if (counters[e].counter > max)
-      max = counters[e].counter;
+    if (c.counter > max)
+      max = c.counter;
+
+    return c.counter;
+  }
 
-    return counters[e].counter;
+  void leave (const Expr *e) {
+    counters[e].leave = ++nb_left;
   }
 
   virtual void visit (const Constant *) { }
@@ -156,7 +181,7 @@ public :
     if (update_counter (e) > 1)
       return;
     e->get_arg1 ()->acceptVisitor (this);
-    counters[e].leave = date + 1;
+    leave (e);
   }
 
   virtual void visit (const BinaryApp *e) {
@@ -164,7 +189,7 @@ public :
       return;
     e->get_arg1 ()->acceptVisitor (this);
     e->get_arg2 ()->acceptVisitor (this);
-    counters[e].leave = date + 1;
+    leave (e);
   }
   virtual void visit (const TernaryApp *e) {
     if (update_counter (e) > 1)
@@ -172,14 +197,23 @@ public :
     e->get_arg1 ()->acceptVisitor (this);
     e->get_arg2 ()->acceptVisitor (this);
     e->get_arg3 ()->acceptVisitor (this);
-    counters[e].leave = date + 1;
+    leave (e);
   }
 
   virtual void visit (const MemCell *e) {
     if (update_counter (e) > 1)
       return;
     e->get_addr ()->acceptVisitor (this);
-    counters[e].leave = date + 1;
+
+    /* a cell which is not a single byte is output as a concatenation of
+     * bytes and its address is written once per byte. */
+    if (! (e->get_bv_size () == 8 && e->get_bv_offset () == 0))
+      {
+	int nb_bytes = (e->get_bv_offset () + e->get_bv_size () + 7) / 8;
+	for (int i = 1; i < nb_bytes; i++)
+	  e->get_addr ()->acceptVisitor (this);
+      }
+    leave (e);
   }
 
   virtual void visit (const RegisterExpr *) {
@@ -635,15 +669,16 @@ CountSharedSubFormulas::open_context (std::ostream &out,
       if (i->second.counter > 1)
 	shared.push_back (i->first);
     }
-  shared.sort (*this);
+  shared.sort (LeaveOrder (counters));
   for (list<const Expr *>::iterator i = shared.begin (); i != shared.end ();
        i++)
     {
+      DFScounters &c = counters[*i];
       out << "(let ((";
-      output_shared_symbol (counters[*i], out);
+      output_shared_symbol (c, out);
       out << " ";
       (*i)->acceptVisitor (sw);
       out << ")) ";
-      done.insert (*i);
+      c.bound = true;
     }
 }
@@ -33,8 +33,10 @@
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <fstream>
 #include <list>
 #include <algorithm>
+#include <stdexcept>
 #include <kernel/annotations/NextInstAnnotation.hh>
 #include <kernel/annotations/AsmAnnotation.hh>
 #include <kernel/annotations/StubAnnotation.hh>
@@ -44,15 +46,34 @@
 
 using namespace std;
 
+/* Instructions are formatted by chunks of this size, in parallel when
+ * OpenMP is enabled, and chunks are written in address order as soon as
+ * they are ready. */
+#define CHUNK_SIZE 4096
+
+/* Nodes of the program sorted by address, with the successor
+ * instructions of the nodes at the beginning of an instruction. */
+struct AsmProgram
+{
+  vector<MicrocodeNode *> nodes;
+  vector< vector<MicrocodeNode *> > succs;
+  SymbolTable *symbtable;
+};
+
 static string
 s_instruction_bytes (const ConcreteMemory *memory, const ConcreteAddress &start,
 		     const ConcreteAddress &next)
 {
   ostringstream result;
 
+  /* Undefined bytes must not throw since instructions may be formatted
+   * by several threads. */
   for (ConcreteAddress a = start; ! a.equals (next); a++)
-    result << hex << setfill('0') << setw (2)
-	   << memory->get (a, 1, Architecture::LittleEndian).get () << ' ';
+    if (memory->is_defined (a))
+      result << hex << setfill('0') << setw (2)
+	     << memory->get (a, 1, Architecture::LittleEndian).get () << ' ';
+    else
+      result << "?? ";
   return result.str ();
 }
 
@@ -79,9 +100,7 @@ s_is_next_instruction_addr (const MicrocodeNode *node, address_t a)
 }
 
 static SymbolTable *
-s_build_symbol_table (const Microcode *mc,
-		      const vector<MicrocodeNode *> &nodes,
-		      const SymbolTable *symboltable,
+s_build_symbol_table (const AsmProgram &P, const SymbolTable *symboltable,
 		      bool with_labels)
 {
   const char *label_prefix = "L";
@@ -92,29 +111,26 @@ s_build_symbol_table (const Microcode *mc,
   if (! with_labels)
     return result;
 
-  for (vector<MicrocodeNode *>::const_iterator pN = nodes.begin ();
-       pN != nodes.end (); pN++)
+  for (size_t i = 0; i < P.nodes.size (); i++)
     {
-      MicrocodeNode *N = *pN;
+      MicrocodeNode *N = P.nodes[i];
       MicrocodeAddress Nma = N->get_loc ();
 
       if (Nma.getLocal () != 0)
 	continue;
 
-      vector<MicrocodeNode *> *succinsts =
-	asm_get_successor_instructions (mc, N);
-      int nb_succ = succinsts->size ();
+      const vector<MicrocodeNode *> &succinsts = P.succs[i];
+      int nb_succ = succinsts.size ();
 
       for (int i = 0; i <nb_succ; i++)
 	{
-	  MicrocodeNode *succ = succinsts->at (i);
+	  MicrocodeNode *succ = succinsts[i];
 	  assert (succ->get_loc ().getLocal () == 0);
 
 	  address_t a = succ->get_loc ().getGlobal ();
 	  if (! result->has (a) && ! s_is_next_instruction_addr (N, a))
 	    addrtable.push_back (a);
 	}
-      delete succinsts;
     }
 
   char *tmpbuf = new char[::strlen (label_prefix) + 10];
@@ -178,122 +194,194 @@ s_sort_microcode (MicrocodeNode *e1, MicrocodeNode *e2)
   return (*e1) < (*e2);
 }
 
+static bool
+s_is_before (const MicrocodeNode *n, address_t a)
+{
+  return n->get_loc ().getGlobal () < a;
+}
+
+/* Programs are usually sorted by the caller (see Microcode::sort); the
+ * copy is then already in order. */
 static void
-s_write_asm (ostream &out, const Microcode *mc,
-	     const vector<MicrocodeNode *> &nodes,
-	     const ConcreteMemory *memory, const SymbolTable *symboltable,
-	     bool with_bytes, bool with_holes, bool with_labels,
-	     address_t addr, size_t nb)
+s_sort_nodes (const Microcode *mc, vector<MicrocodeNode *> &nodes)
 {
-  int nb_nodes = nodes.size ();
-  SymbolTable *symbtable =
-    s_build_symbol_table (mc, nodes, symboltable, with_labels);
-  int i = 0;
-  MicrocodeNode *lastnode = NULL;
+  nodes.assign (mc->begin_nodes (), mc->end_nodes ());
+  for (size_t i = 1; i < nodes.size (); i++)
+    {
+      if (s_sort_microcode (nodes[i - 1], nodes[i]))
+	continue;
+      std::sort (nodes.begin (), nodes.end (), s_sort_microcode);
+      break;
+    }
+}
+
+static void
+s_prepare_program (AsmProgram &P, const Microcode *mc,
+		   const SymbolTable *symboltable, bool with_labels)
+{
+  s_sort_nodes (mc, P.nodes);
+  P.succs.resize (P.nodes.size ());
+
+  long nb_nodes = P.nodes.size ();
+#ifdef _OPENMP
+# pragma omp parallel for schedule(dynamic, CHUNK_SIZE)
+#endif
+  for (long i = 0; i < nb_nodes; i++)
+    if (P.nodes[i]->get_loc ().getLocal () == 0)
+      asm_get_successor_instructions (mc, P.nodes[i], P.succs[i]);
+
+  P.symbtable = s_build_symbol_table (P, symboltable, with_labels);
+}
+
+static void
+s_write_instruction (ostream &out, const AsmProgram &P, size_t i,
+		     MicrocodeAddress &prev, const ConcreteMemory *memory,
+		     bool with_bytes, bool with_holes)
+{
+  MicrocodeNode *node = P.nodes[i];
+  SymbolTable *symbtable = P.symbtable;
+  MicrocodeAddress ma (node->get_loc ());
+
+  assert (ma.getLocal () == 0);
+
+  if (with_holes)
+    s_dump_memory_between (out, memory, prev.getGlobal (),
+			   ma.getGlobal () - 1);
+
+  if (symbtable->has (ma.getGlobal ()))
+    {
+      const std::list<std::string> &symbols =
+	symbtable->get (ma.getGlobal ());
+      for (std::list<std::string>::const_iterator s = symbols.begin ();
+	   s != symbols.end (); s++)
+	out << right << hex << setfill ('0')
+	    << setw (8)
+	    << ma.getGlobal ()
+	    << setw (0)
+	    << " <" << *s << ">: " << endl;
+    }
+  Option<address_t> next = next_instruction_addr (node);
+  if (next.hasValue ())
+    prev = next.getValue ();
+  out << right << hex << setw (8) << setfill (' ')
+      << node->get_loc ().getGlobal () << ":\t";
+  if (with_bytes)
+    {
+      string bytes;
+
+      if (next.hasValue ())
+	bytes =
+	  s_instruction_bytes (memory, ma.getGlobal (), next.getValue ());
+      else
+	bytes = "(unknown)";
+      out << left << setw (24) << setfill (' ') << bytes << "\t";
+    }
+  StringAnnotation *a;
+
+  if (node->has_annotation (StubAnnotation::ID))
+    a = (StringAnnotation *) node->get_annotation (StubAnnotation::ID);
+  else
+    a = (StringAnnotation *) node->get_annotation (AsmAnnotation::ID);
+
+  out << a->get_value ();
+  const vector<MicrocodeNode *> &succ = P.succs[i];
+  int nb_succ = succ.size ();
+  bool first = true;
+  for (int s = 0; s < nb_succ; s++)
+    {
+      MicrocodeNode *instr = succ[s];
+      address_t saddr = instr->get_loc ().getGlobal ();
+      if (next.hasValue () && next.getValue () == saddr)
+	continue;
+
+      if (symbtable->has (saddr))
+	{
+	  const std::list<std::string> &symbols = symbtable->get (saddr);
+
+	  for (std::list<std::string>::const_iterator s = symbols.begin ();
+	       s != symbols.end (); s++)
+	    {
+	      if (first) { out << " # jump to : " ; first = false; }
+	      else { out << ", "; }
+	      out << *s;
+	    }
+	}
+    }
+  out << endl;
+}
+
+/* Write at most nb instructions whose address lies in [addr, end). */
+static void
+s_write_asm (ostream &out, const AsmProgram &P, const ConcreteMemory *memory,
+	     bool with_bytes, bool with_holes, address_t addr, address_t end,
+	     size_t nb)
+{
+  const vector<MicrocodeNode *> &nodes = P.nodes;
+  size_t nb_nodes = nodes.size ();
+  size_t i = 0;
 
   while (i < nb_nodes && (! (nodes.at (i)->has_annotation (AsmAnnotation::ID) ||
 			     nodes.at (i)->has_annotation (StubAnnotation::ID))
 			  || nodes.at (i)->get_loc ().getGlobal() < addr))
     i++;
+
+  /* Select the instructions and the address following the previous
+   * instruction at the beginning of each chunk. */
+  vector<size_t> instrs;
+  vector<MicrocodeAddress> chunk_prev;
   MicrocodeAddress prev;
+
   if (i < nb_nodes)
     prev = nodes.at (i)->get_loc ();
-  for (; i < nb_nodes && nb; i++)
+  for (; i < nb_nodes && nb && nodes[i]->get_loc ().getGlobal () < end; i++)
     {
-      MicrocodeNode *node = nodes.at (i);
+      MicrocodeNode *node = nodes[i];
 
       if (! node->has_annotation (AsmAnnotation::ID))
 	continue;
 
-      MicrocodeAddress ma (node->get_loc ());
-
-      if (ma.getLocal () != 0)
+      if (node->get_loc ().getLocal () != 0)
 	{
 	  assert (node->has_annotation (StubAnnotation::ID));
 	  continue;
 	}
 
       nb--;
-      lastnode = node;
-
-      assert (ma.getLocal () == 0);
+      if (instrs.size () % CHUNK_SIZE == 0)
+	chunk_prev.push_back (prev);
+      instrs.push_back (i);
 
-      if (with_holes)
-	s_dump_memory_between (out, memory, prev.getGlobal (),
-			       ma.getGlobal () - 1);
-
-      if (symbtable->has (ma.getGlobal ()))
-	{
-	  const std::list<std::string> &symbols =
-	    symbtable->get (ma.getGlobal ());
-	  for (std::list<std::string>::const_iterator s = symbols.begin ();
-	       s != symbols.end (); s++)
-	    out << right << hex << setfill ('0')
-		<< setw (8)
-		<< ma.getGlobal ()
-		<< setw (0)
-		<< " <" << *s << ">: " << endl;
-	}
       Option<address_t> next = next_instruction_addr (node);
       if (next.hasValue ())
 	prev = next.getValue ();
-      out << right << hex << setw (8) << setfill (' ')
-	  << node->get_loc ().getGlobal () << ":\t";
-      if (with_bytes)
-	{
-	  string bytes;
-
-	  if (next.hasValue ())
-	    bytes =
-	      s_instruction_bytes (memory, ma.getGlobal (), next.getValue ());
-	  else
-	    bytes = "(unknown)";
-	  out << left << setw (24) << setfill (' ') << bytes << "\t";
-	}
-      StringAnnotation *a;
-
-      if (node->has_annotation (StubAnnotation::ID))
-	a = (StringAnnotation *) node->get_annotation (StubAnnotation::ID);
-      else
-	a = (StringAnnotation *) node->get_annotation (AsmAnnotation::ID);
-
-      out << a->get_value ();
-      vector<MicrocodeNode *> *succ =
-	asm_get_successor_instructions (mc, node);
-      int nb_succ = succ->size ();
-      bool first = true;
-      for (int s = 0; s < nb_succ; s++)
-	{
-	  MicrocodeNode *instr = succ->at (s);
-	  address_t saddr = instr->get_loc ().getGlobal ();
-	  if (next.hasValue () && next.getValue () == saddr)
-	    continue;
+    }
 
-	  if (symbtable->has (saddr))
-	    {
-	      const std::list<std::string> &symbols = symbtable->get (saddr);
-
-	      for (std::list<std::string>::const_iterator s = symbols.begin ();
-		   s != symbols.end (); s++)
-		{
-		  if (first) { out << " # jump to : " ; first = false; }
-		  else { out << ", "; }
-		  out << *s;
-		}
-	    }
-	}
-      delete succ;
-      out << endl;
+  long nb_chunks = chunk_prev.size ();
+#ifdef _OPENMP
+# pragma omp parallel for ordered schedule(dynamic, 1)
+#endif
+  for (long c = 0; c < nb_chunks; c++)
+    {
+      ostringstream oss;
+      MicrocodeAddress prev = chunk_prev[c];
+      size_t last = min (instrs.size (), (size_t) (c + 1) * CHUNK_SIZE);
+
+      for (size_t k = c * CHUNK_SIZE; k < last; k++)
+	s_write_instruction (oss, P, instrs[k], prev, memory, with_bytes,
+			     with_holes);
+#ifdef _OPENMP
+# pragma omp ordered
+#endif
+      out << oss.str ();
     }
 
-  if (lastnode != NULL)
+  if (! instrs.empty ())
     {
-      Option<address_t> next = next_instruction_addr (lastnode);
+      Option<address_t> next = next_instruction_addr (nodes[instrs.back ()]);
       if (next.hasValue ())
 	out << right << hex << setw (8) << setfill (' ')
 	    << next.getValue () << ":" << endl;
     }
-  delete symbtable;
 }
 
 void
@@ -301,15 +389,14 @@ asm_writer (ostream &out, const Microcode *mc,
 	    const ConcreteMemory *memory, const SymbolTable *symboltable,
 	    bool with_bytes, bool with_holes, bool with_labels)
 {
-  vector<MicrocodeNode *> nodes (mc->get_number_of_nodes ());
-  std::copy (mc->begin_nodes(), mc->end_nodes (), nodes.begin ());
-  if (nodes.empty ())
-    return;
-  std::sort (nodes.begin (), nodes.end (), s_sort_microcode);
-
-  s_write_asm (out, mc, nodes, memory, symboltable, with_bytes,
-	       with_holes, with_labels, nodes[0]->get_loc ().getGlobal (),
-	       nodes.size ());
+  AsmProgram P;
+
+  s_prepare_program (P, mc, symboltable, with_labels);
+  if (! P.nodes.empty ())
+    s_write_asm (out, P, memory, with_bytes, with_holes,
+		 P.nodes[0]->get_loc ().getGlobal (), (address_t) -1,
+		 P.nodes.size ());
+  delete P.symbtable;
 }
 
 void
@@ -318,59 +405,121 @@ asm_writer (ostream &out, const Microcode *mc,
 	    bool with_bytes, bool with_holes, bool with_labels,
 	    address_t addr, size_t nb)
 {
-  vector<MicrocodeNode *> nodes (mc->get_number_of_nodes ());
-  std::copy (mc->begin_nodes (), mc->end_nodes (), nodes.begin ());
+  AsmProgram P;
 
-  if (nodes.empty ())
-    return;
-  std::sort (nodes.begin (), nodes.end (), s_sort_microcode);
+  s_prepare_program (P, mc, symboltable, with_labels);
+  if (! P.nodes.empty ())
+    s_write_asm (out, P, memory, with_bytes, with_holes, addr,
+		 (address_t) -1, nb);
+  delete P.symbtable;
+}
+
+int
+asm_sections_writer (const string &prefix, const Microcode *mc,
+		     const ConcreteMemory *memory,
+		     const SymbolTable *symboltable,
+		     const list<BinaryLoader::section_t> &sections,
+		     bool with_bytes, bool with_holes, bool with_labels)
+{
+  AsmProgram P;
+  int result = 0;
+
+  s_prepare_program (P, mc, symboltable, with_labels);
+  for (list<BinaryLoader::section_t>::const_iterator s = sections.begin ();
+       s != sections.end (); s++)
+    {
+      address_t start = s->start.get_address ();
+      address_t end = start + s->size;
+      bool has_instructions = false;
+
+      for (vector<MicrocodeNode *>::const_iterator i =
+	     lower_bound (P.nodes.begin (), P.nodes.end (), start,
+			  s_is_before);
+	   i != P.nodes.end () && (*i)->get_loc ().getGlobal () < end &&
+	     ! has_instructions; i++)
+	has_instructions = (*i)->has_annotation (AsmAnnotation::ID);
+      if (! has_instructions)
+	continue;
+
+      string label = s->label;
+      label.erase (0, label.find_first_not_of ('.'));
+      string filename = prefix + "." + label;
+      ofstream out (filename.c_str ());
 
-  s_write_asm (out, mc, nodes, memory, symboltable, with_bytes,
-	       with_holes, with_labels, addr, nb);
+      if (! out.is_open ())
+	{
+	  delete P.symbtable;
+	  throw runtime_error ("cannot open '" + filename + "'");
+	}
+      s_write_asm (out, P, memory, with_bytes, with_holes, start, end,
+		   P.nodes.size ());
+      result++;
+    }
+  delete P.symbtable;
+
+  return result;
 }
 
-static void
-s_successor_instructions_rec (const Microcode *mc, const MicrocodeNode *node,
-			      set<MicrocodeNode *> &done,
-			      vector<MicrocodeNode *> *res)
+void
+asm_get_successor_instructions (const Microcode *mc, const MicrocodeNode *node,
+				vector<MicrocodeNode *> &result)
 {
-  MicrocodeNode_iterate_successors (*node, succ)
+  /* Depth-first walk of the nodes inside the instruction; targets are
+   * pushed in reverse order so that the result lists them in the order
+   * of the arrows. */
+  vector<MicrocodeAddress> todo;
+  vector<const MicrocodeNode *> done;
+  const MicrocodeNode *n = node;
+
+  result.clear ();
+  for (;;)
     {
-      list<MicrocodeAddress> addresses;
+      size_t top = todo.size ();
 
-      if ((*succ)->is_static ())
-	addresses.push_back (((StaticArrow *) *succ)->get_target ());
-      else if ((*succ)-> has_annotation (SolvedJmpAnnotation::ID))
+      MicrocodeNode_iterate_successors (*n, succ)
 	{
-	  SolvedJmpAnnotation *sja = (SolvedJmpAnnotation *)
-	    (*succ)->get_annotation (SolvedJmpAnnotation::ID);
-	  addresses = sja->get_value ();
+	  if ((*succ)->is_static ())
+	    todo.push_back (((StaticArrow *) *succ)->get_target ());
+	  else if ((*succ)-> has_annotation (SolvedJmpAnnotation::ID))
+	    {
+	      SolvedJmpAnnotation *sja = (SolvedJmpAnnotation *)
+		(*succ)->get_annotation (SolvedJmpAnnotation::ID);
+	      todo.insert (todo.end (), sja->begin (), sja->end ());
+	    }
 	}
+      std::reverse (todo.begin () + top, todo.end ());
 
-      for (list<MicrocodeAddress>::const_iterator i = addresses.begin ();
-	   i != addresses.end (); i++)
+      n = NULL;
+      while (n == NULL && ! todo.empty ())
 	{
-	  MicrocodeAddress tgt = *i;
-	  MicrocodeNode *n = mc->get_node (tgt);
+	  MicrocodeAddress tgt = todo.back ();
+
+	  todo.pop_back ();
+	  // targets out of the program are skipped; this function runs in
+	  // parallel regions where GetNodeNotFoundExc must not escape
+	  if (! mc->has_node_at (tgt))
+	    continue;
 
+	  MicrocodeNode *t = mc->get_node (tgt);
 	  if (tgt.getLocal () == 0)
-	    res->push_back (n);
-	  else if (done.find (n) == done.end ())
+	    result.push_back (t);
+	  else if (find (done.begin (), done.end (), t) == done.end ())
 	    {
-	      done.insert (n);
-	      s_successor_instructions_rec (mc, n, done, res);
+	      done.push_back (t);
+	      n = t;
 	    }
 	}
+      if (n == NULL)
+	break;
     }
 }
 
 vector<MicrocodeNode *> *
 asm_get_successor_instructions (const Microcode *mc, const MicrocodeNode *node)
 {
-  set<MicrocodeNode *> done;
   vector<MicrocodeNode *> *result = new vector<MicrocodeNode *> ();
 
-  s_successor_instructions_rec (mc, node, done, result);
+  asm_get_successor_instructions (mc, node, *result);
 
   return result;
 }
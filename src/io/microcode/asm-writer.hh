@@ -32,14 +32,23 @@
 # define ASM_WRITER_HH
 
 # include <iostream>
+# include <list>
+# include <string>
 # include <vector>
 # include <kernel/Microcode.hh>
 # include <io/binary/BinaryLoader.hh>
 
+/*! \brief Nodes at the beginning of an instruction (local address 0)
+ *  reached from node through nodes inside instructions. */
 extern std::vector<MicrocodeNode *> *
 asm_get_successor_instructions (const Microcode *mc,
 				const MicrocodeNode *node);
 
+extern void
+asm_get_successor_instructions (const Microcode *mc,
+				const MicrocodeNode *node,
+				std::vector<MicrocodeNode *> &result);
+
 extern Option<address_t>
 next_instruction_addr (const MicrocodeNode *node);
 
@@ -54,4 +63,17 @@ asm_writer (std::ostream &out, const Microcode *mc,
 	    bool with_bytes, bool with_holes, bool with_labels,
 	    address_t addr, size_t nb);
 
+/*! \brief Write the instructions of each section into the file
+ *  prefix.LABEL, where LABEL is the label of the section without its
+ *  leading dots. Sections without instructions are skipped. Labels and
+ *  successors are computed once for the whole program. Return the
+ *  number of files written; throw std::runtime_error if one of them
+ *  cannot be created. */
+extern int
+asm_sections_writer (const std::string &prefix, const Microcode *mc,
+		     const ConcreteMemory *memory,
+		     const SymbolTable *symboltable,
+		     const std::list<BinaryLoader::section_t> &sections,
+		     bool with_bytes, bool with_holes, bool with_labels);
+
 #endif /* ! ASM_WRITER_HH */
@@ -0,0 +1,658 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "binary-microcode.hh"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <utils/logs.hh>
+#include <utils/unordered11.hh>
+#include "xml_annotations.hh"
+
+using namespace std;
+
+enum StatementKind {
+  STMT_ASSIGNMENT = 0,
+  STMT_SKIP,
+  STMT_JUMP,
+  STMT_EXTERNAL
+};
+
+typedef BinaryReader::Exception Exception;
+
+#define MICROCODE_FILE_MAGIC "INSIGHT-MICROCODE"
+#define MICROCODE_FILE_VERSION 1
+
+/*
+ * OUTPUT
+ */
+static void
+s_write_address (ExprBinaryWriter &out, const MicrocodeAddress &ma)
+{
+  out.write_uint (ma.getGlobal ());
+  out.write_uint (ma.getLocal ());
+}
+
+static bool
+s_is_supported_annotation (const Annotable::AnnotationId &id)
+{
+  return (id == SolvedJmpAnnotation::ID || id == AsmAnnotation::ID ||
+	  id == CallRetAnnotation::ID || id == NextInstAnnotation::ID ||
+	  id == StubAnnotation::ID);
+}
+
+static void
+s_write_annotations (ExprBinaryWriter &out, const Annotable *annotable)
+{
+  vector<Annotable::AnnotationId> *ids =
+    annotable->get_sorted_annotation_ids ();
+  size_t nb_annotations = 0;
+
+  for (size_t i = 0; i < ids->size (); i++)
+    {
+      if (s_is_supported_annotation (ids->at (i)))
+	nb_annotations++;
+      else
+	logs::warning << "translation of annotation type " << ids->at (i)
+		      << " is not implemented. " << endl;
+    }
+
+  out.write_uint (nb_annotations);
+  for (size_t i = 0; i < ids->size (); i++)
+    {
+      const Annotable::AnnotationId &id = ids->at (i);
+      const Annotation *a = annotable->get_annotation (id);
+
+      if (! s_is_supported_annotation (id))
+	continue;
+
+      out.write_string (id);
+      if (id == SolvedJmpAnnotation::ID)
+	{
+	  const SolvedJmpAnnotation *sja = (const SolvedJmpAnnotation *) a;
+	  size_t nb_targets = 0;
+
+	  for (SolvedJmpAnnotation::const_iterator j = sja->begin ();
+	       j != sja->end (); j++)
+	    nb_targets++;
+	  out.write_uint (nb_targets);
+	  for (SolvedJmpAnnotation::const_iterator j = sja->begin ();
+	       j != sja->end (); j++)
+	    s_write_address (out, *j);
+	}
+      else if (id == AsmAnnotation::ID)
+	out.write_string (((const AsmAnnotation *) a)->get_value ());
+      else if (id == CallRetAnnotation::ID)
+	out.write_expr (((const CallRetAnnotation *) a)->get_target ());
+      else if (id == NextInstAnnotation::ID)
+	s_write_address (out, ((const NextInstAnnotation *) a)->get_value ());
+      else
+	out.write_string (((const StubAnnotation *) a)->get_value ());
+    }
+  delete ids;
+}
+
+static void
+s_write_statement (ExprBinaryWriter &out, Statement *stmt)
+{
+  if (stmt->is_Assignment ())
+    {
+      Assignment *a = (Assignment *) stmt;
+      out.write_uint (STMT_ASSIGNMENT);
+      out.write_expr (a->get_lval ());
+      out.write_expr (a->get_rval ());
+    }
+  else if (stmt->is_Skip ())
+    {
+      out.write_uint (STMT_SKIP);
+    }
+  else if (stmt->is_Jump ())
+    {
+      out.write_uint (STMT_JUMP);
+      out.write_expr (((Jump *) stmt)->get_target ());
+    }
+  else
+    {
+      assert (stmt->is_External ());
+      out.write_uint (STMT_EXTERNAL);
+      out.write_string (((External *) stmt)->get_id ());
+    }
+}
+
+static void
+s_write_arrow_body (ExprBinaryWriter &out, const StmtArrow *arrow)
+{
+  out.write_bool (arrow->is_dynamic ());
+  if (arrow->is_dynamic ())
+    out.write_expr (((const DynamicArrow *) arrow)->get_target ());
+  else
+    s_write_address (out, ((const StaticArrow *) arrow)->get_target ());
+  out.write_expr (arrow->get_condition ());
+  s_write_statement (out, arrow->get_stmt ());
+}
+
+static void
+s_write_arrow (ExprBinaryWriter &out, const StmtArrow *arrow)
+{
+  s_write_arrow_body (out, arrow);
+  s_write_annotations (out, arrow);
+}
+
+static void
+s_write_tmp_registers (ExprBinaryWriter &out,
+		       const MicrocodeArchitecture *mcarch)
+{
+  const RegisterSpecs *tmpregs = mcarch->get_tmp_registers ();
+  vector<const RegisterDesc *> regs;
+
+  for (RegisterSpecs::const_iterator r = tmpregs->begin ();
+       r != tmpregs->end (); r++)
+    if (! r->second->is_alias ())
+      regs.push_back (r->second);
+
+  out.write_uint (regs.size ());
+  for (size_t i = 0; i < regs.size (); i++)
+    {
+      out.write_string (regs[i]->get_label ());
+      out.write_uint (regs[i]->get_register_size ());
+    }
+}
+
+void
+binary_of_microcode (ExprBinaryWriter &out, const Microcode *prg,
+		     const MicrocodeArchitecture *mcarch)
+{
+  s_write_tmp_registers (out, mcarch);
+  s_write_address (out, prg->entry_point ());
+
+  /* All nodes are declared before the arrows such that the targets of
+   * static arrows are known when the program is read back. */
+  out.write_uint (prg->get_number_of_nodes ());
+  for (Microcode::const_node_iterator n = prg->begin_nodes ();
+       n != prg->end_nodes (); n++)
+    {
+      s_write_address (out, (*n)->get_loc ());
+      s_write_annotations (out, *n);
+    }
+
+  for (Microcode::const_node_iterator n = prg->begin_nodes ();
+       n != prg->end_nodes (); n++)
+    {
+      vector<StmtArrow *> *succs = (*n)->get_successors ();
+
+      out.write_uint (succs->size ());
+      for (size_t i = 0; i < succs->size (); i++)
+	s_write_arrow (out, succs->at (i));
+    }
+}
+
+/*
+ * The standalone file format is made of sections: a header, the table of
+ * the expressions used by the program, the nodes, the arrows and finally
+ * the annotations. Since every root expression is defined in the table,
+ * the other sections only contain indices into it.
+ */
+static void
+s_add_root (vector<const Expr *> &roots, unordered_set<const Expr *> &seen,
+	    const Expr *e)
+{
+  if (e != NULL && seen.insert (e).second)
+    roots.push_back (e);
+}
+
+static void
+s_add_annotation_roots (vector<const Expr *> &roots,
+			unordered_set<const Expr *> &seen,
+			const Annotable *annotable)
+{
+  if (annotable->has_annotation (CallRetAnnotation::ID))
+    s_add_root (roots, seen, ((const CallRetAnnotation *)
+			      annotable->get_annotation (CallRetAnnotation::ID))
+		->get_target ());
+}
+
+static void
+s_add_arrow_roots (vector<const Expr *> &roots,
+		   unordered_set<const Expr *> &seen, const StmtArrow *arrow)
+{
+  Statement *stmt = arrow->get_stmt ();
+
+  if (arrow->is_dynamic ())
+    s_add_root (roots, seen, ((const DynamicArrow *) arrow)->get_target ());
+  s_add_root (roots, seen, arrow->get_condition ());
+  if (stmt->is_Assignment ())
+    {
+      s_add_root (roots, seen, ((Assignment *) stmt)->get_lval ());
+      s_add_root (roots, seen, ((Assignment *) stmt)->get_rval ());
+    }
+  else if (stmt->is_Jump ())
+    s_add_root (roots, seen, ((Jump *) stmt)->get_target ());
+  s_add_annotation_roots (roots, seen, arrow);
+}
+
+void
+binary_file_of_microcode (ostream &output, const Microcode *prg,
+			  const MicrocodeArchitecture *mcarch)
+{
+  ExprBinaryWriter out (output);
+  vector<const Expr *> roots;
+  unordered_set<const Expr *> seen;
+  size_t nb_annotated_nodes = 0;
+  size_t nb_annotated_arrows = 0;
+
+  out.write_string (MICROCODE_FILE_MAGIC);
+  out.write_uint (MICROCODE_FILE_VERSION);
+  out.write_uint (mcarch->get_reference_arch ()->get_proc ());
+  s_write_tmp_registers (out, mcarch);
+  s_write_address (out, prg->entry_point ());
+
+  Microcode_iterate_nodes (*prg, n)
+    {
+      s_add_annotation_roots (roots, seen, *n);
+      if ((*n)->is_annotated ())
+	nb_annotated_nodes++;
+      MicrocodeNode_iterate_successors (**n, a)
+	{
+	  s_add_arrow_roots (roots, seen, *a);
+	  if ((*a)->is_annotated ())
+	    nb_annotated_arrows++;
+	}
+    }
+
+  out.write_uint (roots.size ());
+  for (size_t i = 0; i < roots.size (); i++)
+    out.write_expr (roots[i]);
+
+  out.write_uint (prg->get_number_of_nodes ());
+  Microcode_iterate_nodes (*prg, n)
+    s_write_address (out, (*n)->get_loc ());
+
+  Microcode_iterate_nodes (*prg, n)
+    {
+      vector<StmtArrow *> *succs = (*n)->get_successors ();
+
+      out.write_uint (succs->size ());
+      for (size_t i = 0; i < succs->size (); i++)
+	s_write_arrow_body (out, succs->at (i));
+    }
+
+  size_t index = 0;
+  out.write_uint (nb_annotated_nodes);
+  Microcode_iterate_nodes (*prg, n)
+    {
+      if ((*n)->is_annotated ())
+	{
+	  out.write_uint (index);
+	  s_write_annotations (out, *n);
+	}
+      index++;
+    }
+
+  index = 0;
+  out.write_uint (nb_annotated_arrows);
+  Microcode_iterate_nodes (*prg, n)
+    {
+      MicrocodeNode_iterate_successors (**n, a)
+	{
+	  if ((*a)->is_annotated ())
+	    {
+	      out.write_uint (index);
+	      s_write_annotations (out, *a);
+	    }
+	  index++;
+	}
+    }
+}
+
+/*
+ * INPUT
+ */
+static MicrocodeAddress
+s_read_address (ExprBinaryReader &in)
+  throw (Exception)
+{
+  address_t global = in.read_uint ();
+  address_t local = in.read_uint ();
+
+  return MicrocodeAddress (global, local);
+}
+
+static Expr *
+s_read_non_null_expr (ExprBinaryReader &in)
+  throw (Exception)
+{
+  Expr *result = in.read_expr ();
+
+  if (result == NULL)
+    throw Exception ("unexpected null expression in microcode");
+
+  return result;
+}
+
+static void
+s_read_annotations (ExprBinaryReader &in, Annotable *annotable)
+  throw (Exception)
+{
+  uint64_t nb_annotations = in.read_uint ();
+
+  for (uint64_t i = 0; i < nb_annotations; i++)
+    {
+      Annotable::AnnotationId id = in.read_string ();
+      Annotation *a;
+
+      if (id == SolvedJmpAnnotation::ID)
+	{
+	  SolvedJmpAnnotation *sja = new SolvedJmpAnnotation ();
+	  uint64_t nb_targets = in.read_uint ();
+
+	  try
+	    {
+	      for (uint64_t j = 0; j < nb_targets; j++)
+		sja->add (s_read_address (in));
+	    }
+	  catch (Exception &)
+	    {
+	      delete sja;
+	      throw;
+	    }
+	  a = sja;
+	}
+      else if (id == AsmAnnotation::ID)
+	a = new AsmAnnotation (in.read_string ());
+      else if (id == CallRetAnnotation::ID)
+	{
+	  Expr *tgt = in.read_expr ();
+
+	  if (tgt == NULL)
+	    a = CallRetAnnotation::create_ret ();
+	  else
+	    {
+	      a = CallRetAnnotation::create_call (tgt);
+	      tgt->deref ();
+	    }
+	}
+      else if (id == NextInstAnnotation::ID)
+	a = new NextInstAnnotation (s_read_address (in));
+      else if (id == StubAnnotation::ID)
+	a = new StubAnnotation (in.read_string ());
+      else
+	throw Exception ("unknown annotation '" + id.get_name () + "' in microcode");
+
+      if (annotable->has_annotation (id))
+	annotable->del_annotation (id);
+      annotable->add_annotation (id, a);
+    }
+}
+
+static Statement *
+s_read_statement (ExprBinaryReader &in)
+  throw (Exception)
+{
+  Statement *result = NULL;
+
+  switch (in.read_uint ())
+    {
+    case STMT_ASSIGNMENT:
+      {
+	Expr *lval = s_read_non_null_expr (in);
+	Expr *rval;
+
+	if (! lval->is_LValue ())
+	  {
+	    lval->deref ();
+	    throw Exception ("invalid lvalue in microcode");
+	  }
+	try
+	  {
+	    rval = s_read_non_null_expr (in);
+	  }
+	catch (Exception &)
+	  {
+	    lval->deref ();
+	    throw;
+	  }
+	result = new Assignment ((LValue *) lval, rval);
+      }
+      break;
+
+    case STMT_SKIP:
+      result = new Skip ();
+      break;
+
+    case STMT_JUMP:
+      result = new Jump (s_read_non_null_expr (in));
+      break;
+
+    case STMT_EXTERNAL:
+      result = new External (in.read_string ());
+      break;
+
+    default:
+      throw Exception ("invalid statement in microcode");
+    }
+
+  return result;
+}
+
+static StmtArrow *
+s_read_arrow_body (ExprBinaryReader &in, Microcode *mc, MicrocodeNode *src)
+  throw (Exception)
+{
+  bool is_dynamic = in.read_bool ();
+  Expr *target = NULL;
+  MicrocodeNode *tgt = NULL;
+
+  if (is_dynamic)
+    target = s_read_non_null_expr (in);
+  else
+    {
+      MicrocodeAddress ma = s_read_address (in);
+
+      if (! mc->has_node_at (ma))
+	throw Exception ("undeclared target node in microcode");
+      tgt = mc->get_node (ma);
+    }
+
+  Expr *cond = NULL;
+  Statement *stmt = NULL;
+
+  try
+    {
+      cond = in.read_expr ();
+      stmt = s_read_statement (in);
+    }
+  catch (Exception &)
+    {
+      if (target != NULL)
+	target->deref ();
+      if (cond != NULL)
+	cond->deref ();
+      throw;
+    }
+
+  if (is_dynamic)
+    return src->add_successor (cond, target, stmt);
+  else
+    return src->add_successor (cond, tgt, stmt);
+}
+
+static void
+s_read_arrow (ExprBinaryReader &in, Microcode *mc, MicrocodeNode *src)
+  throw (Exception)
+{
+  s_read_annotations (in, s_read_arrow_body (in, mc, src));
+}
+
+static void
+s_read_tmp_registers (ExprBinaryReader &in)
+  throw (Exception)
+{
+  MicrocodeArchitecture *mcarch = in.get_arch ();
+  uint64_t nb_regs = in.read_uint ();
+
+  for (uint64_t i = 0; i < nb_regs; i++)
+    {
+      string label = in.read_string ();
+      int size = in.read_uint ();
+
+      if (mcarch->has_tmp_register (label))
+	continue;
+      if (mcarch->get_reference_arch ()->has_register (label))
+	throw Exception ("temporary register '" + label +
+			 "' is an architecture register");
+      mcarch->add_tmp_register (label, size);
+    }
+}
+
+void
+binary_parse_microcode (ExprBinaryReader &in, Microcode *result)
+  throw (BinaryReader::Exception)
+{
+  s_read_tmp_registers (in);
+  result->set_entry_point (s_read_address (in));
+
+  uint64_t nb_nodes = in.read_uint ();
+  vector<MicrocodeNode *> nodes;
+
+  for (uint64_t i = 0; i < nb_nodes; i++)
+    {
+      MicrocodeNode *node = result->get_or_create_node (s_read_address (in));
+
+      s_read_annotations (in, node);
+      nodes.push_back (node);
+    }
+
+  for (uint64_t i = 0; i < nb_nodes; i++)
+    {
+      uint64_t nb_succs = in.read_uint ();
+
+      for (uint64_t j = 0; j < nb_succs; j++)
+	s_read_arrow (in, result, nodes[i]);
+    }
+}
+
+static void
+s_parse_file (ExprBinaryReader &in, Microcode *result)
+  throw (Exception)
+{
+  if (in.read_string () != MICROCODE_FILE_MAGIC)
+    throw Exception ("not a binary microcode file");
+  if (in.read_uint () != MICROCODE_FILE_VERSION)
+    throw Exception ("unsupported binary microcode version");
+  if (in.read_uint () != (uint64_t) in.get_arch ()->get_reference_arch ()
+      ->get_proc ())
+    throw Exception ("binary microcode for another architecture");
+
+  s_read_tmp_registers (in);
+  result->set_entry_point (s_read_address (in));
+
+  /* The reader keeps its own reference on each expression of the table. */
+  for (uint64_t n = in.read_uint (); n > 0; n--)
+    {
+      Expr *e = in.read_expr ();
+
+      if (e != NULL)
+	e->deref ();
+    }
+
+  uint64_t nb_nodes = in.read_uint ();
+  vector<MicrocodeNode *> nodes;
+
+  for (uint64_t i = 0; i < nb_nodes; i++)
+    nodes.push_back (result->get_or_create_node (s_read_address (in)));
+
+  vector<StmtArrow *> arrows;
+  for (uint64_t i = 0; i < nb_nodes; i++)
+    {
+      for (uint64_t n = in.read_uint (); n > 0; n--)
+	arrows.push_back (s_read_arrow_body (in, result, nodes[i]));
+    }
+
+  for (uint64_t n = in.read_uint (); n > 0; n--)
+    {
+      uint64_t index = in.read_uint ();
+
+      if (index >= nodes.size ())
+	throw Exception ("invalid node index in microcode annotations");
+      s_read_annotations (in, nodes[index]);
+    }
+
+  for (uint64_t n = in.read_uint (); n > 0; n--)
+    {
+      uint64_t index = in.read_uint ();
+
+      if (index >= arrows.size ())
+	throw Exception ("invalid arrow index in microcode annotations");
+      s_read_annotations (in, arrows[index]);
+    }
+}
+
+Microcode *
+binary_file_parse_microcode (const string &filename,
+			     MicrocodeArchitecture *arch)
+  throw (BinaryReader::Exception)
+{
+  MappedFile file (filename);
+  ExprBinaryReader in (file.get_data (), file.get_size (), arch);
+  Microcode *result = new Microcode ();
+
+  try
+    {
+      s_parse_file (in, result);
+    }
+  catch (Exception &)
+    {
+      delete result;
+      throw;
+    }
+  if (! in.at_end ())
+    logs::warning << "trailing data in binary microcode file '" << filename
+		  << "'" << endl;
+
+  return result;
+}
+
+bool
+is_binary_microcode_file (const string &filename)
+{
+  ifstream in (filename.c_str (), ios::in | ios::binary);
+  char magic[sizeof (MICROCODE_FILE_MAGIC)];
+  size_t len = sizeof (MICROCODE_FILE_MAGIC) - 1;
+
+  /* Strings are prefixed with their length, which fits in one byte. */
+  if (! in.read (magic, len + 1))
+    return false;
+
+  return (magic[0] == (char) len && memcmp (magic + 1, MICROCODE_FILE_MAGIC,
+					    len) == 0);
+}
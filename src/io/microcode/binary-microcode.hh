@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef IO_MICROCODE_BINARY_MICROCODE_HH
+# define IO_MICROCODE_BINARY_MICROCODE_HH
+
+# include <iostream>
+# include <string>
+# include <kernel/Microcode.hh>
+# include <kernel/microcode/MicrocodeArchitecture.hh>
+# include <io/expressions/expr-binary.hh>
+
+/*! \brief Write 'prg' on 'out'. Unlike the XML output, the encoding is
+ *  lossless: the order of nodes and of their successors is preserved and
+ *  expressions are shared with everything else written on 'out'. The
+ *  temporary registers of 'mcarch' are declared first. */
+extern void
+binary_of_microcode (ExprBinaryWriter &out, const Microcode *prg,
+		     const MicrocodeArchitecture *mcarch);
+
+/*! \brief Add to 'result' the program written by binary_of_microcode.
+ *  Missing temporary registers are added to the architecture of 'in'. */
+extern void
+binary_parse_microcode (ExprBinaryReader &in, Microcode *result)
+  throw (BinaryReader::Exception);
+
+/*! \brief Write 'prg' as a standalone and versioned binary file. The file
+ *  starts with a table of every expression of the program, shared as in
+ *  the expression store, followed by the nodes, the arrows and the
+ *  annotations. It is much smaller and faster to load than XML. */
+extern void
+binary_file_of_microcode (std::ostream &out, const Microcode *prg,
+			  const MicrocodeArchitecture *mcarch);
+
+/*! \brief Load a file written by binary_file_of_microcode. The file is
+ *  mapped in memory rather than read. */
+extern Microcode *
+binary_file_parse_microcode (const std::string &filename,
+			     MicrocodeArchitecture *arch)
+  throw (BinaryReader::Exception);
+
+/*! \brief Check whether 'filename' starts like a binary microcode file. */
+extern bool
+is_binary_microcode_file (const std::string &filename);
+
+#endif /* ! IO_MICROCODE_BINARY_MICROCODE_HH */
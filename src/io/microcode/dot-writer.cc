@@ -29,6 +29,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <set>
+#include <sstream>
 #include <vector>
 #include <list>
 #include <kernel/microcode/MicrocodeNode.hh>
@@ -36,6 +37,7 @@
 #include <kernel/annotations/StubAnnotation.hh>
 #include <kernel/annotations/SolvedJmpAnnotation.hh>
 #include <cstdlib>
+#include <utils/unordered11.hh>
 #include "asm-writer.hh"
 #include "dot-writer.hh"
 
@@ -43,6 +45,13 @@ using namespace std;
 
 #define NODE_PREFIX "BB_0x"
 
+/* Number of basic blocks formatted at once (see asm-writer.cc) */
+#define CHUNK_SIZE 1024
+
+struct basic_block_t;
+
+typedef unordered_map<MicrocodeNode *, basic_block_t> BasicBlockMap;
+
 struct basic_block_t
 {
   int ident;
@@ -59,13 +68,13 @@ s_sort_microcode (MicrocodeNode *e1, MicrocodeNode *e2)
 
 static void
 s_init_basic_block (const Microcode *mc, MicrocodeNode *n, basic_block_t &bb,
-		    int ident)
+		    int ident, vector<MicrocodeNode *> *succs = NULL)
 {
   bb.ident = ident;
   bb.in_degree = 0;
   bb.nodes = new vector<MicrocodeNode *> ();
   bb.nodes->push_back (n);
-  bb.succs = asm_get_successor_instructions (mc, n);
+  bb.succs = succs ? succs : asm_get_successor_instructions (mc, n);
 }
 
 static void
@@ -77,7 +86,7 @@ s_clear_basic_block (basic_block_t &bb)
 
 static vector<MicrocodeNode *> *
 s_compute_asm_nodes (const Microcode *mc,
-		     std::map<MicrocodeNode *, basic_block_t> &anodes,
+		     BasicBlockMap &anodes,
 		     const ConcreteAddress *start, const ConcreteAddress *end)
 {
   vector<MicrocodeNode *> *result = new vector<MicrocodeNode *> ();
@@ -104,11 +113,30 @@ s_compute_asm_nodes (const Microcode *mc,
 	  ! n->has_annotation (StubAnnotation::ID))
 	continue;
 
-      if (anodes.find (n) == anodes.end ())
-	s_init_basic_block (mc, n, anodes[n], anodes.size ());
       result->push_back (n);
+    }
+  std::sort (result->begin (), result->end (), s_sort_microcode);
 
-      basic_block_t &an = anodes[n];
+  /* Successor instructions are the costly part; they are computed in
+   * parallel before blocks are built. */
+  long nb_nodes = result->size ();
+  vector< vector<MicrocodeNode *> * > succs (nb_nodes);
+#ifdef _OPENMP
+# pragma omp parallel for schedule(dynamic, CHUNK_SIZE)
+#endif
+  for (long i = 0; i < nb_nodes; i++)
+    succs[i] = asm_get_successor_instructions (mc, result->at (i));
+
+  anodes.rehash (nb_nodes);
+  for (long i = 0; i < nb_nodes; i++)
+    {
+      MicrocodeNode *n = result->at (i);
+      s_init_basic_block (mc, n, anodes[n], anodes.size (), succs[i]);
+    }
+
+  for (long i = 0; i < nb_nodes; i++)
+    {
+      basic_block_t &an = anodes[result->at (i)];
       for (size_t s = 0; s < an.succs->size (); s++)
 	{
 	  MicrocodeNode *sn = an.succs->at (s);
@@ -117,14 +145,13 @@ s_compute_asm_nodes (const Microcode *mc,
 	  anodes[sn].in_degree++;
 	}
     }
-  std::sort (result->begin (), result->end (), s_sort_microcode);
 
   return result;
 }
 
 static void
 s_merge_bb_from (basic_block_t *entry,
-		 std::map<MicrocodeNode *, basic_block_t> &anodes,
+		 BasicBlockMap &anodes,
 		 MicrocodeNode *entrypoint, const SymbolTable *symboltable)
 {
   while (entry->succs->size () == 1)
@@ -157,7 +184,7 @@ s_merge_bb_from (basic_block_t *entry,
 
 static void
 s_merge_basic_blocks (vector<MicrocodeNode *> *nodes,
-		      std::map<MicrocodeNode *, basic_block_t> &anodes,
+		      BasicBlockMap &anodes,
 		      MicrocodeNode *entrypoint, const SymbolTable *symboltable)
 {
   size_t nb_nodes = nodes->size ();
@@ -185,6 +212,71 @@ s_light_color (int rgb)
   return rgb;
 }
 
+static void
+s_write_basic_block (ostream &out, const Microcode *mc,
+		     const BasicBlockMap &anodes, MicrocodeNode *n, int rgb,
+		     MicrocodeNode *entrynode, bool arrow_indexes)
+{
+  const basic_block_t &bb = anodes.find (n)->second;
+  MicrocodeAddress ma = n->get_loc ();
+
+  out << NODE_PREFIX << std::hex << ma.getGlobal ()
+      << "[shape=box,style=filled,fillcolor=\"#" << std::hex << rgb
+      << "\",justify=left,label=\"";
+  for (size_t inst = 0; inst < bb.nodes->size (); inst++)
+    {
+      MicrocodeNode *instn = bb.nodes->at (inst);
+      if (instn->has_annotation (AsmAnnotation::ID) ||
+	  instn->has_annotation (StubAnnotation::ID))
+	{
+	  out << setw(8) << hex << instn->get_loc ().getGlobal () << " : ";
+	  if(instn->has_annotation (StubAnnotation::ID))
+	    out << *(instn->get_annotation (StubAnnotation::ID)) << "\\l";
+	  else
+	    out << *(instn->get_annotation (AsmAnnotation::ID)) << "\\l";
+	}
+      else
+	out << instn->pp();
+    }
+  out << "\"";
+  if (n == entrynode)
+    out << ",entrypoint=1,color=red,peripheries=2";
+  else
+    out << ",entrypoint=0,color=\"#" << hex << rgb << "\"";
+  out << "];\n";
+
+  set<MicrocodeAddress,LessThanFunctor<MicrocodeAddress> > targets;
+  vector<MicrocodeNode *>::const_iterator s = bb.succs->begin ();
+  bool indexes = arrow_indexes && (bb.succs->size () > 1);
+  for (int i = 0; s != bb.succs->end (); s++, i++)
+    {
+      MicrocodeAddress tgt = (*s)->get_loc ();
+
+      if (targets.find (tgt) != targets.end ())
+	continue;
+
+      assert (tgt.getLocal () == 0);
+      targets.insert (tgt);
+
+      out << NODE_PREFIX << std::hex << ma.getGlobal ()
+	  << " -> " 
+	  << NODE_PREFIX << std::hex << tgt.getGlobal ();
+      out << " [";
+      if (indexes)
+	out << " label = \"#" << i << "\"";
+      out << "]; " << endl;
+
+      MicrocodeNode *tgtn = mc->get_node (tgt);
+      assert (anodes.find (tgtn) != anodes.end ());
+
+      const basic_block_t &tgtbb = anodes.find (tgtn)->second;
+      if (tgtbb.nodes->size () == 1 && tgtbb.succs->size () == 0)
+	out << NODE_PREFIX << std::hex << tgt.getGlobal () 
+	    << "[shape=oval,label=\"0x" << std::hex << tgt.getGlobal () 
+	    << "\"];";
+    }
+}
+
 void
 dot_writer (std::ostream &out, const Microcode *mc, bool asm_only,
 	    const std::string &graphlabel,
@@ -217,7 +309,8 @@ dot_asm_writer (std::ostream &out, const Microcode *mc, ConcreteAddress *start,
   if (! graphlabel.empty ())
     out << " label=\"" << graphlabel << "\"; " << endl;
 
-  std::map<MicrocodeNode *, basic_block_t> anodes;
+  BasicBlockMap anodes;
+  vector< pair<MicrocodeNode *, int> > blocks;
   vector<MicrocodeNode *> *nodes =
     s_compute_asm_nodes (mc, anodes, start, end);
 
@@ -237,10 +330,11 @@ dot_asm_writer (std::ostream &out, const Microcode *mc, ConcreteAddress *start,
        i != nodes->end (); i++)
     {
       MicrocodeNode *n = *i;
-      if (anodes.find (n) == anodes.end ())
+      BasicBlockMap::const_iterator bbi = anodes.find (n);
+      if (bbi == anodes.end ())
 	continue;
 
-      basic_block_t &bb = anodes[n];
+      const basic_block_t &bb = bbi->second;
       if (bb.nodes->size () == 1 && bb.succs->size () == 0)
 	continue;
 
@@ -274,63 +368,31 @@ dot_asm_writer (std::ostream &out, const Microcode *mc, ConcreteAddress *start,
 	  rgb = s_light_color (21933 * ma.getGlobal () ^ 11229331);
 	}
 
-      out << NODE_PREFIX << std::hex << ma.getGlobal ()
-	  << "[shape=box,style=filled,fillcolor=\"#" << std::hex << rgb
-	  << "\",justify=left,label=\"";
-      for (size_t inst = 0; inst < bb.nodes->size (); inst++)
-	{
-	  MicrocodeNode *instn = bb.nodes->at (inst);
-	  if (instn->has_annotation (AsmAnnotation::ID) ||
-	      instn->has_annotation (StubAnnotation::ID))
-	    {
-	      out << setw(8) << hex << instn->get_loc ().getGlobal () << " : ";
-	      if(instn->has_annotation (StubAnnotation::ID))
-		out << *(instn->get_annotation (StubAnnotation::ID)) << "\\l";
-	      else
-		out << *(instn->get_annotation (AsmAnnotation::ID)) << "\\l";
-	    }
-	  else
-	    out << instn->pp();
-	}
-      out << "\"";
-      if (n == entrynode)
-	out << ",entrypoint=1,color=red,peripheries=2";
-      else
-	out << ",entrypoint=0,color=\"#" << hex << rgb << "\"";
-      out << "];\n";
-
-      set<MicrocodeAddress,LessThanFunctor<MicrocodeAddress> > targets;
-      vector<MicrocodeNode *>::const_iterator s = bb.succs->begin ();
-      bool indexes = arrow_indexes && (bb.succs->size () > 1);
-      for (int i = 0; s != bb.succs->end (); s++, i++)
-	{
-	  MicrocodeAddress tgt = (*s)->get_loc ();
-
-	  if (targets.find (tgt) != targets.end ())
-	    continue;
-
-	  assert (tgt.getLocal () == 0);
-	  targets.insert (tgt);
-
-	  out << NODE_PREFIX << std::hex << ma.getGlobal ()
-	      << " -> " 
-	      << NODE_PREFIX << std::hex << tgt.getGlobal ();
-	  out << " [";
-	  if (indexes)
-	    out << " label = \"#" << i << "\"";
-	  out << "]; " << endl;
-
-	  MicrocodeNode *tgtn = mc->get_node (tgt);
-	  assert (anodes.find (tgtn) != anodes.end ());
-
-	  basic_block_t &tgtbb = anodes[tgtn];
-	  if (tgtbb.nodes->size () == 1 && tgtbb.succs->size () == 0)
-	    out << NODE_PREFIX << std::hex << tgt.getGlobal () 
-		<< "[shape=oval,label=\"0x" << std::hex << tgt.getGlobal () 
-		<< "\"];";
-	}
+      blocks.push_back (make_pair (n, rgb));
+    }
 
+  /* Blocks are formatted by chunks in parallel and output in address
+   * order. */
+  long nb_chunks = (blocks.size () + CHUNK_SIZE - 1) / CHUNK_SIZE;
+#ifdef _OPENMP
+# pragma omp parallel for ordered schedule(dynamic, 1)
+#endif
+  for (long c = 0; c < nb_chunks; c++)
+    {
+      ostringstream oss;
+      size_t last = min (blocks.size (), (size_t) (c + 1) * CHUNK_SIZE);
+
+      for (size_t k = c * CHUNK_SIZE; k < last; k++)
+	s_write_basic_block (oss, mc, anodes, blocks[k].first,
+			     blocks[k].second, entrynode, arrow_indexes);
+#ifdef _OPENMP
+# pragma omp ordered
+#endif
+      out << oss.str ();
     }
+  /* the symbol nodes below are numbered with the base the blocks left */
+  if (! blocks.empty ())
+    out << std::hex;
   out << " }" << endl;
   int k = 0;
   for (map<string,int>::const_iterator i = symbols.begin ();
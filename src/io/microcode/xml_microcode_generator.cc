@@ -30,7 +30,7 @@
 
 #include <sstream>
 #include <string>
-#include <libxml2/libxml/tree.h>
+#include <libxml2/libxml/xmlwriter.h>
 
 #include <kernel/Microcode.hh>
 #include <kernel/Expressions.hh>
@@ -39,8 +39,13 @@
 
 using namespace std;
 
-static xmlNodePtr
-xml_of_expr (const Expr *expr);
+/* The document is written with the streaming API of libxml2: each node is
+ * serialized as soon as it is reached, so that the memory used does not
+ * depend on the size of the program. */
+typedef xmlTextWriterPtr XmlWriter;
+
+static void
+s_write_expr (XmlWriter w, const Expr *expr);
 
 static string
 string_of_int(int n)
@@ -59,120 +64,118 @@ xml_of_mcaddress (const MicrocodeAddress &addr)
   return "x" + string(glob) + "-" + string(loc);
 }
 
+static void
+s_start_element (XmlWriter w, const char *name)
+{
+  xmlTextWriterStartElement (w, BAD_CAST name);
+}
 
 static void
-s_add_prop (xmlNodePtr node, const char *propid, const char *value)
+s_start_element (XmlWriter w, const string &name)
 {
-  xmlNewProp (node, BAD_CAST propid, BAD_CAST value);
+  s_start_element (w, name.c_str ());
 }
 
 static void
-s_add_prop (xmlNodePtr node, const char *propid, const string &value)
+s_end_element (XmlWriter w)
 {
-  s_add_prop (node, propid, value.c_str ());
+  xmlTextWriterEndElement (w);
 }
 
 static void
-s_add_prop (xmlNodePtr node, const char *propid, int value)
+s_add_prop (XmlWriter w, const char *propid, const char *value)
 {
-  s_add_prop (node, propid, string_of_int (value));
+  xmlTextWriterWriteAttribute (w, BAD_CAST propid, BAD_CAST value);
 }
 
 static void
-s_add_prop (xmlNodePtr node, const char *propid, bool value)
+s_add_prop (XmlWriter w, const char *propid, const string &value)
 {
-  s_add_prop (node, propid, value ? 1 : 0);
+  s_add_prop (w, propid, value.c_str ());
 }
 
 static void
-s_add_prop (xmlNodePtr node, const char *propid, const MicrocodeAddress &addr)
+s_add_prop (XmlWriter w, const char *propid, int value)
 {
-  s_add_prop (node, propid, xml_of_mcaddress (addr));
+  s_add_prop (w, propid, string_of_int (value));
 }
 
-/*
- * ANNOTATIONS
- */
-static xmlNodePtr
-s_new_annotation_node (const string &id)
+static void
+s_add_prop (XmlWriter w, const char *propid, bool value)
 {
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST id.c_str ());
+  s_add_prop (w, propid, value ? 1 : 0);
+}
 
-  return result;
+static void
+s_add_prop (XmlWriter w, const char *propid, const MicrocodeAddress &addr)
+{
+  s_add_prop (w, propid, xml_of_mcaddress (addr));
 }
 
-static xmlNodePtr
-s_annotation_to_xml (const SolvedJmpAnnotation *a)
+/*
+ * ANNOTATIONS
+ */
+static void
+s_annotation_to_xml (XmlWriter w, const SolvedJmpAnnotation *a)
 {
-  xmlNodePtr result = s_new_annotation_node (a->ID);
+  s_start_element (w, a->ID);
   for (SolvedJmpAnnotation::const_iterator i = a->begin (); i != a->end ();
        i++)
     {
-      xmlNodePtr jmp = xmlNewChild (result, NULL, BAD_CAST "addr", NULL);
       assert (i->getLocal () == 0);
-      s_add_prop (jmp, "value", *i);
+      s_start_element (w, "addr");
+      s_add_prop (w, "value", *i);
+      s_end_element (w);
     }
-
-  return result;
+  s_end_element (w);
 }
 
-static xmlNodePtr
-s_annotation_to_xml (const AsmAnnotation *a)
+static void
+s_annotation_to_xml (XmlWriter w, const AsmAnnotation *a)
 {
-  xmlNodePtr result = s_new_annotation_node (a->ID);
-  s_add_prop (result, "value", a->get_value ());
-
-  return result;
+  s_start_element (w, a->ID);
+  s_add_prop (w, "value", a->get_value ());
+  s_end_element (w);
 }
 
-static xmlNodePtr
-s_annotation_to_xml (const CallRetAnnotation *a)
+static void
+s_annotation_to_xml (XmlWriter w, const CallRetAnnotation *a)
 {
-  xmlNodePtr result = s_new_annotation_node (a->ID);
   bool is_call = a->is_call ();
 
-  s_add_prop (result, "is-call", is_call);
+  s_start_element (w, a->ID);
+  s_add_prop (w, "is-call", is_call);
   if (is_call)
-    {
-      xmlNodePtr target = xml_of_expr (a->get_target ());
-      xmlAddChild (result, target);
-    }
-
-  return result;
+    s_write_expr (w, a->get_target ());
+  s_end_element (w);
 }
 
-static xmlNodePtr
-s_annotation_to_xml (const NextInstAnnotation *a)
+static void
+s_annotation_to_xml (XmlWriter w, const NextInstAnnotation *a)
 {
-  xmlNodePtr result = s_new_annotation_node (a->ID);
-
-  s_add_prop (result, "value", a->get_value ());
-
-  return result;
+  s_start_element (w, a->ID);
+  s_add_prop (w, "value", a->get_value ());
+  s_end_element (w);
 }
 
-static xmlNodePtr
-s_annotation_to_xml (const StubAnnotation *a)
+static void
+s_annotation_to_xml (XmlWriter w, const StubAnnotation *a)
 {
-  xmlNodePtr result = s_new_annotation_node (a->ID);
-
-  s_add_prop (result, "value", a->get_value ());
-
-  return result;
+  s_start_element (w, a->ID);
+  s_add_prop (w, "value", a->get_value ());
+  s_end_element (w);
 }
 
 static void
-s_add_annotations (xmlNodePtr parent, const Annotable *annotable,
+s_add_annotations (XmlWriter w, const Annotable *annotable,
 		   const MicrocodeAddress *location = NULL)
 {
-  const Annotable::AnnotationMap *annotations = annotable->get_annotations ();
-
-  if (annotations->size () == 0)
+  if (! annotable->is_annotated ())
     return;
 
-  xmlNodePtr root = xmlNewChild (parent, NULL, BAD_CAST "annotations", NULL);
+  s_start_element (w, "annotations");
   if (location != NULL)
-    s_add_prop (root, "addr", *location);
+    s_add_prop (w, "addr", *location);
 
   vector<Annotable::AnnotationId> *ids = annotable->get_sorted_annotation_ids();
   for (vector<Annotable::AnnotationId>::const_iterator i = ids->begin();
@@ -180,77 +183,40 @@ s_add_annotations (xmlNodePtr parent, const Annotable *annotable,
     {
       Annotable::AnnotationId id = *i;
       const Annotation *a = annotable->get_annotation(id);
-      xmlNodePtr annotation;
 
       if (id == SolvedJmpAnnotation::ID)
-	annotation =
-	  s_annotation_to_xml (dynamic_cast<const SolvedJmpAnnotation *> (a));
+	s_annotation_to_xml (w, dynamic_cast<const SolvedJmpAnnotation *> (a));
       else if (id == AsmAnnotation::ID)
-	annotation =
-	  s_annotation_to_xml (dynamic_cast<const AsmAnnotation *> (a));
+	s_annotation_to_xml (w, dynamic_cast<const AsmAnnotation *> (a));
       else if (id == CallRetAnnotation::ID)
-	annotation =
-	  s_annotation_to_xml (dynamic_cast<const CallRetAnnotation *> (a));
+	s_annotation_to_xml (w, dynamic_cast<const CallRetAnnotation *> (a));
       else if (id == NextInstAnnotation::ID)
-	annotation =
-	  s_annotation_to_xml (dynamic_cast<const NextInstAnnotation *> (a));
+	s_annotation_to_xml (w, dynamic_cast<const NextInstAnnotation *> (a));
       else if (id == StubAnnotation::ID)
-	annotation =
-	  s_annotation_to_xml (dynamic_cast<const StubAnnotation *> (a));
+	s_annotation_to_xml (w, dynamic_cast<const StubAnnotation *> (a));
       else
-	{
-	  logs::warning << "translation of annotation type " << id << " is not "
-			<< "implemented. " << endl;
-	  continue;
-	}
-      xmlAddChild (root, annotation);
+	logs::warning << "translation of annotation type " << id << " is not "
+		      << "implemented. " << endl;
     }
   delete ids;
+  s_end_element (w);
 }
 
 static void
-s_generate_annotations_for_nodes (xmlNodePtr root, const Microcode *prg)
+s_generate_annotations_for_nodes (XmlWriter w, const Microcode *prg)
 {
-  xmlNodePtr annotations =
-    xmlNewChild (root, NULL, BAD_CAST "nodes-annotations", NULL);
-
+  s_start_element (w, "nodes-annotations");
   for (Microcode::const_node_iterator n = prg->begin_nodes ();
        n != prg->end_nodes (); n++)
-    s_add_annotations (annotations, *n, &((*n)->get_loc ()));
+    s_add_annotations (w, *n, &((*n)->get_loc ()));
+  s_end_element (w);
 }
 
 /*
  * EXPRESSIONS
  */
-static xmlNodePtr
-xml_of_constant (const Constant *c)
-{
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "const");
-  int val = c->get_not_truncated_value ();
-  xmlNodeAddContent (result, BAD_CAST string_of_int(val).c_str ());
-
-  return result;
-}
-
-static xmlNodePtr
-xml_of_random_value (const RandomValue *)
-{
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "random");
-
-  return result;
-}
-
-static xmlNodePtr
-xml_of_variable (const Variable *v)
-{
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "formalvar");
-  s_add_prop (result, "id", v->get_id ());
-
-  return result;
-}
-
-static xmlNodePtr
-xml_of_ternary_op (TernaryOp op)
+static const char *
+s_ternary_op_name (TernaryOp op)
 {
   const char *opname;
 
@@ -263,27 +229,11 @@ xml_of_ternary_op (TernaryOp op)
   if (opname == NULL)
     logs::fatal_error("xml_of_ternary_op:: operator not supported");
 
-  return xmlNewNode (NULL, BAD_CAST opname);
-}
-
-static xmlNodePtr
-xml_of_ternaryapp(const TernaryApp *b)
-{
-  xmlNodePtr arg1 = xml_of_expr (b->get_arg1 ());
-  xmlNodePtr arg2 = xml_of_expr (b->get_arg2 ());
-  xmlNodePtr arg3 = xml_of_expr (b->get_arg3 ());
-  xmlNodePtr op = xml_of_ternary_op (b->get_op ());
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "apply");
-  xmlAddChild (result, op);
-  xmlAddChild (result, arg1);
-  xmlAddChild (result, arg2);
-  xmlAddChild (result, arg3);
-
-  return result;
+  return opname;
 }
 
-static xmlNodePtr
-xml_of_binary_op (BinaryOp op)
+static const char *
+s_binary_op_name (BinaryOp op)
 {
   const char *opname;
 
@@ -321,26 +271,11 @@ xml_of_binary_op (BinaryOp op)
   if (opname == NULL)
     logs::fatal_error("xml_of_binary_op:: operator not supported");
 
-  return xmlNewNode (NULL, BAD_CAST opname);
+  return opname;
 }
 
-
-static xmlNodePtr
-xml_of_binaryapp(const BinaryApp *b)
-{
-  xmlNodePtr arg1 = xml_of_expr(b->get_arg1());
-  xmlNodePtr arg2 = xml_of_expr(b->get_arg2());
-  xmlNodePtr op = xml_of_binary_op (b->get_op ());
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "apply");
-  xmlAddChild (result, op);
-  xmlAddChild (result, arg1);
-  xmlAddChild (result, arg2);
-
-  return result;
-}
-
-static xmlNodePtr
-xml_of_unary_op (UnaryOp op)
+static const char *
+s_unary_op_name (UnaryOp op)
 {
   const char *opname;
 
@@ -352,162 +287,160 @@ xml_of_unary_op (UnaryOp op)
     }
   if (opname == NULL)
     logs::fatal_error("xml_of_unary_op:: operator not supported");
-  return xmlNewNode (NULL, BAD_CAST opname);
-}
-
-static xmlNodePtr
-xml_of_unaryapp (const UnaryApp *u)
-{
-  xmlNodePtr arg1 = xml_of_expr (u->get_arg1 ());
-  xmlNodePtr op = xml_of_unary_op (u->get_op ());
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "apply");
-  xmlAddChild (result, op);
-  xmlAddChild (result, arg1);
 
-  return result;
+  return opname;
 }
 
-static xmlNodePtr
-xml_of_register (const RegisterExpr *reg)
+static void
+s_write_operator (XmlWriter w, const char *opname)
 {
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "var");
-
-  assert (reg->get_name().length () > 0);
-  s_add_prop (result, "name", reg->get_descriptor()->get_label ());
-
-  return result;
+  s_start_element (w, opname);
+  s_end_element (w);
 }
 
-static xmlNodePtr
-xml_of_memcell (const MemCell *m)
+/* Attributes must be written before the children of an element; so the
+ * bit-vector attributes of 'e' are added here, once the element specific
+ * ones have been written. */
+static void
+s_add_bv_props (XmlWriter w, const Expr *e)
 {
-  xmlNodePtr result = xmlNewNode (NULL, BAD_CAST "memref");
-  xmlNodePtr addr = xml_of_expr (m->get_addr());
-
-  xmlAddChild (result, addr);
-  string mem = string (m->get_tag ());
-
-  if (mem.length() > 0)
-    s_add_prop (result, "mem", mem);
-
-  return result;
+  s_add_prop (w, "size", e->get_bv_size ());
+  s_add_prop (w, "offset", e->get_bv_offset ());
 }
 
-static xmlNodePtr
-xml_of_lvalue (const Expr *lv, bool with_bv = false)
+static void
+s_write_expr (XmlWriter w, const Expr *e)
 {
-  xmlNodePtr result;
-
-  if (lv->is_MemCell ())
-    result =  xml_of_memcell ((const MemCell *) lv);
-  else if (lv->is_RegisterExpr ())
-    result = xml_of_register ((const RegisterExpr *) lv);
-  else
-    result = NULL;
-
-  if (with_bv)
+  if (e->is_Variable ())
     {
-      s_add_prop (result, "size", lv->get_bv_size ());
-      s_add_prop (result, "offset", lv->get_bv_offset ());
+      s_start_element (w, "formalvar");
+      s_add_prop (w, "id", ((const Variable *) e)->get_id ());
+      s_add_bv_props (w, e);
     }
-  if (result == NULL)
-    logs::fatal_error("xml_of_lvalue:: lvalue type unknown");
-
-  return result;
-}
-
-static xmlNodePtr
-xml_of_expr (const Expr *e)
-{
-  xmlNodePtr result;
-
-  if (e->is_Variable ())
-    result = xml_of_variable ((const Variable *) e);
   else if (e->is_Constant ())
-    result = xml_of_constant ((const Constant *) e);
+    {
+      int val = ((const Constant *) e)->get_not_truncated_value ();
+
+      s_start_element (w, "const");
+      s_add_bv_props (w, e);
+      xmlTextWriterWriteString (w, BAD_CAST string_of_int (val).c_str ());
+    }
   else if (e->is_RandomValue ())
-    result = xml_of_random_value ((const RandomValue *) e);
+    {
+      s_start_element (w, "random");
+      s_add_bv_props (w, e);
+    }
   else if (e->is_UnaryApp ())
-    result = xml_of_unaryapp ((const UnaryApp *) e);
+    {
+      const UnaryApp *u = (const UnaryApp *) e;
+
+      s_start_element (w, "apply");
+      s_add_bv_props (w, e);
+      s_write_operator (w, s_unary_op_name (u->get_op ()));
+      s_write_expr (w, u->get_arg1 ());
+    }
   else if (e->is_BinaryApp ())
-    result = xml_of_binaryapp ((const BinaryApp *) e);
-  else if (e->is_LValue ())
-    result = xml_of_lvalue ((const LValue *) e);
+    {
+      const BinaryApp *b = (const BinaryApp *) e;
+
+      s_start_element (w, "apply");
+      s_add_bv_props (w, e);
+      s_write_operator (w, s_binary_op_name (b->get_op ()));
+      s_write_expr (w, b->get_arg1 ());
+      s_write_expr (w, b->get_arg2 ());
+    }
+  else if (e->is_MemCell ())
+    {
+      const MemCell *m = (const MemCell *) e;
+      string mem = string (m->get_tag ());
+
+      s_start_element (w, "memref");
+      if (mem.length() > 0)
+	s_add_prop (w, "mem", mem);
+      s_add_bv_props (w, e);
+      s_write_expr (w, m->get_addr ());
+    }
+  else if (e->is_RegisterExpr ())
+    {
+      const RegisterExpr *reg = (const RegisterExpr *) e;
+
+      assert (reg->get_name().length () > 0);
+      s_start_element (w, "var");
+      s_add_prop (w, "name", reg->get_descriptor()->get_label ());
+      s_add_bv_props (w, e);
+    }
   else if (e->is_TernaryApp ())
-    result = xml_of_ternaryapp ((const TernaryApp *) e);
+    {
+      const TernaryApp *t = (const TernaryApp *) e;
+
+      s_start_element (w, "apply");
+      s_add_bv_props (w, e);
+      s_write_operator (w, s_ternary_op_name (t->get_op ()));
+      s_write_expr (w, t->get_arg1 ());
+      s_write_expr (w, t->get_arg2 ());
+      s_write_expr (w, t->get_arg3 ());
+    }
   else
-    result = NULL;
-  s_add_prop (result, "size", e->get_bv_size ());
-  s_add_prop (result, "offset", e->get_bv_offset ());
-
-  if (result == NULL)
     logs::fatal_error ("xml_of_expr:: expr type unknown");
-
-  return result;
+  s_end_element (w);
 }
 
 static void
-xml_of_stmtarrow (xmlNodePtr root, const StmtArrow *arr)
+s_write_stmtarrow (XmlWriter w, const StmtArrow *arr)
 {
-  xmlNodePtr xarrow = NULL;
-  string new_stmtarrow("");
-
   if (!(arr->is_dynamic()))
     {
       StaticArrow *sarr = (StaticArrow *) arr;
 
       if (sarr->get_stmt()->is_Assignment())
-	{
-	  xmlNodePtr lv =
-	    xml_of_lvalue (((Assignment *) sarr->get_stmt())->get_lval(), true);
-
-	  xmlNodePtr v =
-	    xml_of_expr (((Assignment *) sarr->get_stmt ())->get_rval ());
-	  xarrow = xmlNewChild (root, NULL, BAD_CAST "assign", NULL);
-	  xmlAddChild (xarrow, lv);
-	  xmlAddChild (xarrow, v);
-	}
+	s_start_element (w, "assign");
       else if (sarr->get_stmt()->is_Skip())
-	{
-	  xarrow = xmlNewChild (root, NULL, BAD_CAST "skip", NULL);
-	}
-      else if (sarr->get_stmt ()->is_Jump ())
+	s_start_element (w, "skip");
+      else
 	logs::fatal_error ("xml_of_stmtarrow:: static jump statement "
 			   "not supported");
-      s_add_prop (xarrow, "next", sarr->get_target());
+      s_add_prop (w, "next", sarr->get_target());
+      s_add_prop (w, "id", arr->get_origin());
+      if (sarr->get_stmt()->is_Assignment())
+	{
+	  Assignment *a = (Assignment *) sarr->get_stmt ();
+
+	  s_write_expr (w, a->get_lval ());
+	  s_write_expr (w, a->get_rval ());
+	}
     }
   else   // Arrow is dynamic
     {
       DynamicArrow *darr = (DynamicArrow *) arr;
-      xmlNodePtr target = xml_of_expr (darr->get_target ());
-      xarrow = xmlNewChild (root, NULL, BAD_CAST "jump", NULL);
-      xmlAddChild (xarrow, target);
+
+      s_start_element (w, "jump");
+      s_add_prop (w, "id", arr->get_origin());
+      s_write_expr (w, darr->get_target ());
     }
 
   Expr *guard_expr = arr->get_condition();
   if (!guard_expr->eval_level0()) {
-    xmlNodePtr guard = xmlNewChild(xarrow, NULL, BAD_CAST "guard", NULL);
-    xmlAddChild(guard, xml_of_expr(guard_expr));
+    s_start_element (w, "guard");
+    s_write_expr (w, guard_expr);
+    s_end_element (w);
   }
 
-  s_add_prop (xarrow, "id", arr->get_origin());
-
-  s_add_annotations (xarrow, arr);
+  s_add_annotations (w, arr);
+  s_end_element (w);
 }
 
 static void
-s_generate_code (xmlNodePtr root, const Microcode *prg)
+s_generate_code (XmlWriter w, const Microcode *prg)
 {
-  xmlNodePtr code = xmlNewNode (NULL, BAD_CAST "code");
-  xmlAddChild (root, code);
-
+  s_start_element (w, "code");
   for (Microcode::const_node_iterator n = prg->begin_nodes ();
        n != prg->end_nodes (); n++)
     {
       vector<StmtArrow *> *succs = (*n)->get_successors();
       for (int i = 0; i < (int) succs->size(); i++)
-	xml_of_stmtarrow (code, (*succs)[i]);
+	s_write_stmtarrow (w, (*succs)[i]);
   }
+  s_end_element (w);
 }
 
 struct CmpRegisterDesc
@@ -518,7 +451,7 @@ struct CmpRegisterDesc
 };
 
 static void
-s_declare_registers (xmlNodePtr root, const MicrocodeArchitecture *mcarch)
+s_declare_registers (XmlWriter w, const MicrocodeArchitecture *mcarch)
 {
   const RegisterSpecs *regs[] = {
     mcarch->get_reference_arch ()->get_registers (),
@@ -543,9 +476,10 @@ s_declare_registers (xmlNodePtr root, const MicrocodeArchitecture *mcarch)
   for (list<const RegisterDesc *>::iterator r = reglist.begin();
        r != reglist.end (); r++)
     {
-      xmlNodePtr node = xmlNewChild (root, NULL, BAD_CAST "vardecl", NULL);
-      s_add_prop (node, "id", (*r)->get_label ());
-      s_add_prop (node, "size", (*r)->get_register_size ());
+      s_start_element (w, "vardecl");
+      s_add_prop (w, "id", (*r)->get_label ());
+      s_add_prop (w, "size", (*r)->get_register_size ());
+      s_end_element (w);
     }
 }
 
@@ -577,17 +511,21 @@ xml_of_microcode (ostream &out,
 			     &s_xml_output_close_callback,
 			     &out,
 			     NULL);
-
-  xmlDocPtr doc = xmlNewDoc (BAD_CAST "1.0");
-  xmlCreateIntSubset (doc, BAD_CAST "program", NULL, BAD_CAST "insight.dtd");
-  xmlNodePtr root = xmlNewNode (NULL, BAD_CAST "program");
-  xmlDocSetRootElement (doc, root);
+  XmlWriter w = xmlNewTextWriter (xout);
+
+  xmlTextWriterSetIndent (w, 1);
+  xmlTextWriterSetIndentString (w, BAD_CAST "  ");
+  xmlTextWriterStartDocument (w, "1.0", "UTF-8", NULL);
+  /* xmlTextWriterWriteDTD breaks the declaration on two lines when
+   * indenting; it is written as the tree serializer does. */
+  xmlTextWriterWriteRaw (w, BAD_CAST "<!DOCTYPE program SYSTEM \"insight.dtd\">\n");
+  s_start_element (w, "program");
   if (mcarch)
-    s_declare_registers (root, mcarch);
-  s_generate_code (root, prg);
-  s_generate_annotations_for_nodes (root, prg);
-  xmlThrDefIndentTreeOutput (1);
-  xmlSaveFormatFileTo (xout, doc, "UTF-8", 1);
-  xmlFreeDoc (doc);
+    s_declare_registers (w, mcarch);
+  s_generate_code (w, prg);
+  s_generate_annotations_for_nodes (w, prg);
+  s_end_element (w);
+  xmlTextWriterEndDocument (w);
+  /* Also flushes and closes the output buffer. */
+  xmlFreeTextWriter (w);
 }
-
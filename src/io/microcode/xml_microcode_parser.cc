@@ -37,7 +37,7 @@
 #include <iostream>
 
 #include <libxml2/libxml/tree.h>
-#include <libxml2/libxml/parser.h>
+#include <libxml2/libxml/xmlreader.h>
 
 #include <kernel/Microcode.hh>
 #include <kernel/Expressions.hh>
@@ -98,25 +98,6 @@ int parse_hexadecimal(char *str)
   return v;
 }
 
-static pair<xmlDocPtr, xmlNodePtr>
-s_xml_get_root_from_file (const string filename)
-  throw (XmlParserException)
-{
-  xmlKeepBlanksDefault (0);
-  xmlDocPtr doc = xmlParseFile (filename.c_str ());
-  if (doc == NULL)
-    throw XmlParserException ("while loading file.");
-
-  xmlNodePtr root = xmlDocGetRootElement (doc);
-  if (root == NULL)
-    {
-      xmlFreeDoc (doc);
-      throw XmlParserException ("empty XML document.");
-    }
-
-  return pair<xmlDocPtr, xmlNodePtr> (doc, root);
-}
-
 static bool
 s_xml_has_attribute (xmlNodePtr node, const xmlChar *id)
 {
@@ -804,10 +785,13 @@ s_xml_parse_jump (xmlNodePtr node, ParserData &data, Expr *guard)
 	  RAISE_ERROR (data);
 	}
       StmtArrow *sa = data.mc->add_jump (origin, e, guard);
-      if (node->children->next != NULL)
+      for (xmlNodePtr child = node->children->next; child;
+	   child = child->next)
 	{
+	  if (xmlStrcmp (child->name, BAD_CAST "annotations") != 0)
+	    continue;
 	  DynamicArrow *da = dynamic_cast<DynamicArrow *> (sa);
-	  s_annotate_arrow (node->children->next, da, data);
+	  s_annotate_arrow (child, da, data);
 	}
     }
   return true;
@@ -855,37 +839,79 @@ s_MicrocodeNode_of_xml (xmlNodePtr node, ParserData &data)
 }
 
 static void
-s_prefix_run (xmlNodePtr node, ParserData &data)
+s_declare_register (xmlNodePtr n, ParserData &data)
+  throw (XmlParserException)
 {
-  xmlNodePtr n;
+  string regname = s_xml_get_attribute (n, BAD_CAST "id", data);
+  int size = s_xml_get_int_attribute (n, BAD_CAST "size", data);
+  if (data.mcArch->get_reference_arch ()->has_register (regname))
+    {
+      const RegisterDesc *rdesc =
+	data.mcArch->get_reference_arch ()->get_register (regname);
+      assert (rdesc->get_register_size () == size);
+    }
+  else if (! data.mcArch->has_tmp_register (regname))
+    data.mcArch->add_tmp_register (regname, size);
+}
 
-  for (n = node; n != NULL; n = n->next)
+/*
+ * The document is read with the streaming API of libxml2. Only the subtree
+ * of the current register declaration, arrow or node annotations is built;
+ * it is released by the reader once it has been translated. Memory used by
+ * the parser is thus bounded by the size of the largest of these subtrees.
+ */
+static void
+s_stream_run (xmlTextReaderPtr reader, ParserData &data)
+  throw (XmlParserException)
+{
+  string section;
+  int ret = xmlTextReaderRead (reader);
+
+  if (ret == 0)
+    throw XmlParserException ("empty XML document.");
+
+  while (ret == 1)
     {
-      if (xmlStrcmp(n->name, (const xmlChar *) "vardecl") == 0)
+      int depth = xmlTextReaderDepth (reader);
+      const xmlChar *name = xmlTextReaderConstName (reader);
+
+      if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT ||
+	  depth == 0)
 	{
-	  string regname = s_xml_get_attribute (n, BAD_CAST "id", data);
-	  int size = s_xml_get_int_attribute (n, BAD_CAST "size", data);
-	  if (data.mcArch->get_reference_arch ()->has_register (regname))
-	    {
-	      const RegisterDesc *rdesc =
-		data.mcArch->get_reference_arch ()->get_register (regname);
-	      assert (rdesc->get_register_size () == size);
-	    }
-	  else if (! data.mcArch->has_tmp_register (regname))
-	    data.mcArch->add_tmp_register (regname, size);
+	  ret = xmlTextReaderRead (reader);
+	  continue;
 	}
-      else if (xmlStrcmp(n->name, BAD_CAST "nodes-annotations") == 0)
+
+      if (depth == 1 && (xmlStrcmp (name, BAD_CAST "code") == 0 ||
+			 xmlStrcmp (name, BAD_CAST "nodes-annotations") == 0))
 	{
-	  for (xmlNodePtr child = n->children; child; child = child->next)
-	    s_annotate_node (child, data);
+	  section = (const char *) name;
+	  ret = xmlTextReaderRead (reader);
+	  continue;
 	}
-      else
+
+      xmlNodePtr n = xmlTextReaderExpand (reader);
+      if (n == NULL)
+	break;
+
+      if (depth == 1)
 	{
-	  assert (xmlStrcmp(n->name, (const xmlChar *) "code") == 0);
-	  for (xmlNodePtr child = n->children; child; child = child->next)
-	    s_MicrocodeNode_of_xml (child, data);
+	  if (xmlStrcmp (n->name, BAD_CAST "vardecl") != 0)
+	    {
+	      data.error (n) << "unexpected element '" << n->name << "'.";
+	      RAISE_ERROR (data);
+	    }
+	  s_declare_register (n, data);
 	}
+      else if (section == "code")
+	s_MicrocodeNode_of_xml (n, data);
+      else
+	s_annotate_node (n, data);
+      ret = xmlTextReaderNext (reader);
     }
+
+  if (ret != 0)
+    throw XmlParserException ("while loading file.");
 }
 
 /*****************************************************************************/
@@ -894,22 +920,23 @@ Microcode *
 xml_parse_mc_program(const string &filename, MicrocodeArchitecture *arch)
   throw (XmlParserException)
 {
-  pair<xmlDocPtr, xmlNodePtr> xml_doc_handler =
-    s_xml_get_root_from_file (filename.c_str ());
+  xmlTextReaderPtr reader =
+    xmlReaderForFile (filename.c_str (), NULL, XML_PARSE_NOBLANKS);
+  if (reader == NULL)
+    throw XmlParserException ("while loading file.");
   ParserData data (new Microcode (), arch, filename);
 
   try
     {
-      xmlNodePtr root = xml_doc_handler.second;
-      s_prefix_run (root->children, data);
+      s_stream_run (reader, data);
     }
   catch (XmlParserException)
     {
-      delete xml_doc_handler.first;
+      xmlFreeTextReader (reader);
       delete data.mc;
       throw;
     }
-  xmlFreeDoc (xml_doc_handler.first);
+  xmlFreeTextReader (reader);
 
   data.mc->regular_form ();
 
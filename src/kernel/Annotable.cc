@@ -31,44 +31,135 @@
 #include <kernel/Annotable.hh>
 
 #include <algorithm>
-#include <sstream>
+#include <deque>
+#include <limits>
+#include <ostream>
 #include <string>
-#include <typeinfo>
+#include <utils/unordered11.hh>
 
 #include <assert.h>
 
-Annotable::Annotable(const AnnotationMap *o)
+/*****************************************************************************/
+// Interned annotation ids
+/*****************************************************************************/
+
+struct s_id_registry
 {
-  if (o != NULL)
-    copy_from_map(*o);
+  /* a deque keeps references returned by get_name () valid */
+  std::deque<std::string> names;
+  std::unordered_map<std::string, uint16_t> indexes;
+};
+
+/* Annotation ids are static members defined in various units, so the
+ * registry must be built on first use. */
+static s_id_registry &
+s_get_registry ()
+{
+  static s_id_registry *registry = NULL;
+
+  if (registry == NULL)
+    {
+      registry = new s_id_registry ();
+      registry->names.push_back ("");
+      registry->indexes[""] = 0;
+    }
+
+  return *registry;
 }
 
-Annotable::Annotable(const Annotable &o)
+static uint16_t
+s_intern (const std::string &name)
+{
+  s_id_registry &r = s_get_registry ();
+  std::unordered_map<std::string, uint16_t>::const_iterator i =
+    r.indexes.find (name);
+
+  if (i != r.indexes.end ())
+    return i->second;
+
+  assert (r.names.size () <= std::numeric_limits<uint16_t>::max ());
+  uint16_t result = r.names.size ();
+  r.names.push_back (name);
+  r.indexes[name] = result;
+
+  return result;
+}
+
+Annotable::AnnotationId::AnnotationId ()
+  : index (0)
+{
+}
+
+Annotable::AnnotationId::AnnotationId (const std::string &name)
+  : index (s_intern (name))
+{
+}
+
+Annotable::AnnotationId::AnnotationId (const char *name)
+  : index (s_intern (name))
+{
+}
+
+const std::string &
+Annotable::AnnotationId::get_name () const
+{
+  return s_get_registry ().names[index];
+}
+
+bool
+Annotable::AnnotationId::operator< (const AnnotationId &o) const
+{
+  return get_name () < o.get_name ();
+}
+
+std::ostream &
+operator<< (std::ostream &out, const Annotable::AnnotationId &id)
 {
-  copy_from_map(o.amap);
+  return out << id.get_name ();
+}
+
+/*****************************************************************************/
+// Annotable
+/*****************************************************************************/
+
+Annotable::Annotable(const Annotable *o)
+  : entries(NULL), nb_entries(0), capacity(0)
+{
+  if (o != NULL)
+    copy_from(*o);
 }
 
-Annotable::Annotable(AnnotationMap &o)
+Annotable::Annotable(const Annotable &o)
+  : entries(NULL), nb_entries(0), capacity(0)
 {
-  copy_from_map(o);
+  copy_from(o);
 }
 
 Annotable::~Annotable()
 {
-  for (AnnotationMap::iterator it = amap.begin(); it != amap.end(); it++)
-    {
-      delete it->second;
-    }
+  for (uint16_t i = 0; i < nb_entries; i++)
+    delete entries[i].second;
+  delete[] entries;
 }
 
 void
-Annotable::copy_from_map(const AnnotationMap &o) {
-  for (AnnotationMap::const_iterator it = o.begin(); it != o.end(); it++)
+Annotable::copy_from(const Annotable &o) {
+  for (annotation_iterator it = o.begin_annotations();
+       it != o.end_annotations(); it++)
     {
-      amap[it->first] = (Annotation *)it->second->clone();
+      add_annotation(it->first, (Annotation *)it->second->clone());
     }
 }
 
+Annotable::AnnotationEntry *
+Annotable::find(const AnnotationId &id) const
+{
+  for (uint16_t i = 0; i < nb_entries; i++)
+    if (entries[i].first == id)
+      return &entries[i];
+  return NULL;
+}
+
 void Annotable::del_annotation(const char *id)
 {
   AnnotationId tmp(id);
@@ -77,24 +168,36 @@ void Annotable::del_annotation(const char *id)
 
 void Annotable::del_annotation(const AnnotationId &id)
 {
-  assert(this->has_annotation(id));
-  delete amap[id];
-  amap.erase(id);
+  AnnotationEntry *e = find(id);
+
+  assert(e != NULL);
+  delete e->second;
+  *e = entries[--nb_entries];
+}
+
+Annotable::annotation_iterator
+Annotable::begin_annotations() const
+{
+  return entries;
 }
 
+Annotable::annotation_iterator
+Annotable::end_annotations() const
+{
+  return entries + nb_entries;
+}
 
-const Annotable::AnnotationMap *
-Annotable::get_annotations() const
+std::size_t
+Annotable::get_number_of_annotations() const
 {
-  return &amap;
+  return nb_entries;
 }
 
 Annotation *Annotable::get_annotation (const AnnotationId &id) const
 {
-  if (!has_annotation (id))
-    return NULL;
+  AnnotationEntry *e = find(id);
 
-  return amap.find (id)->second;
+  return e == NULL ? NULL : e->second;
 }
 
 Annotation *Annotable::get_annotation(const char *id) const
@@ -106,14 +209,10 @@ Annotation *Annotable::get_annotation(const char *id) const
 std::vector<Annotable::AnnotationId> *
 Annotable::get_sorted_annotation_ids() const {
   std::vector<Annotable::AnnotationId> *annotation_ids =
-    new std::vector<Annotable::AnnotationId>(amap.size());
-  int idx = 0;
+    new std::vector<Annotable::AnnotationId>(nb_entries);
 
-  for (Annotable::AnnotationMap::const_iterator i = amap.begin ();
-       i != amap.end (); i++)
-    {
-      (*annotation_ids)[idx++] = i->first;
-    }
+  for (uint16_t i = 0; i < nb_entries; i++)
+    (*annotation_ids)[i] = entries[i].first;
 
   sort(annotation_ids->begin(), annotation_ids->end());
 
@@ -122,7 +221,24 @@ Annotable::get_sorted_annotation_ids() const {
 
 void Annotable::add_annotation(const AnnotationId &id, Annotation *a)
 {
-  amap[id] = a;
+  AnnotationEntry *e = find(id);
+
+  if (e != NULL)
+    {
+      e->second = a;
+      return;
+    }
+
+  if (nb_entries == capacity)
+    {
+      assert (capacity < std::numeric_limits<uint16_t>::max () / 2);
+      capacity = capacity == 0 ? 2 : 2 * capacity;
+      AnnotationEntry *tmp = new AnnotationEntry[capacity];
+      std::copy (entries, entries + nb_entries, tmp);
+      delete[] entries;
+      entries = tmp;
+    }
+  entries[nb_entries++] = AnnotationEntry(id, a);
 }
 
 void Annotable::add_annotation(const char *id, Annotation *a)
@@ -134,8 +250,7 @@ void Annotable::add_annotation(const char *id, Annotation *a)
 
 bool Annotable::has_annotation(const AnnotationId &id) const
 {
-
-  return amap.find(id) != amap.end();
+  return find(id) != NULL;
 }
 
 
@@ -147,7 +262,7 @@ bool Annotable::has_annotation(const char *id) const
 
 bool Annotable::is_annotated() const
 {
-  return amap.size() > 0;
+  return nb_entries > 0;
 }
 
 void
@@ -30,11 +30,13 @@
 #ifndef KERNEL_ANNOTABLE_HH
 #define KERNEL_ANNOTABLE_HH
 
+#include <iosfwd>
+#include <stdint.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <kernel/Annotation.hh>
-#include <utils/unordered11.hh>
 
 /* ***************************************************/
 /**
@@ -44,21 +46,49 @@
 class Annotable
 {
 public:
-  typedef std::string AnnotationId;
-  typedef std::unordered_map<AnnotationId,Annotation*> AnnotationMap;
+  /*! \brief Kind of an annotation. Names are interned into small
+   * integers the first time they are seen, so that comparing two ids
+   * does not involve the string. Ids are meant to be created once
+   * (see the static ID member of each annotation class); building
+   * one from a string costs a hash lookup. Interning is not
+   * thread-safe. */
+  class AnnotationId
+  {
+  public:
+    AnnotationId ();
+    AnnotationId (const std::string &name);
+    AnnotationId (const char *name);
 
-  Annotable(const AnnotationMap *o = 0);
-  Annotable(AnnotationMap &o);
+    const std::string &get_name () const;
+    uint16_t get_index () const { return index; }
+    operator const std::string &() const { return get_name (); }
+
+    bool operator== (const AnnotationId &o) const { return index == o.index; }
+    bool operator!= (const AnnotationId &o) const { return index != o.index; }
+    /*! \brief alphabetical order of names */
+    bool operator< (const AnnotationId &o) const;
+
+  private:
+    uint16_t index;
+  };
+
+  typedef std::pair<AnnotationId, Annotation *> AnnotationEntry;
+  typedef const AnnotationEntry *annotation_iterator;
+
+  /*! \brief Copy the annotations of o if it is not NULL */
+  Annotable(const Annotable *o = 0);
 
   /*! \brief Copy constructor */
   Annotable(const Annotable &o);
   /*! \brief Destructor */
   virtual ~Annotable();
 
-  /*! \brief get annotations. Renamed this method in order to
-   * lower the number of name conflicts on methods such as begin().
-   * That's why the inheritance on std::unordered_map is private */
-  const AnnotationMap *get_annotations() const;
+  /*! \brief iterate over annotations, in no particular order. Named
+   * this way in order to lower the number of name conflicts with
+   * sub-classes. */
+  annotation_iterator begin_annotations() const;
+  annotation_iterator end_annotations() const;
+  std::size_t get_number_of_annotations() const;
   /*! \brief get a specific annotation. */
   Annotation *get_annotation(const AnnotationId &id) const;
   /*! \brief get a specific annotation. */
@@ -86,9 +116,20 @@ public:
   void output_annotations (std::ostream &) const;
 
 private:
-  void copy_from_map(const AnnotationMap &o);
+  Annotable &operator=(const Annotable &);
+
+  void copy_from(const Annotable &o);
+  AnnotationEntry *find(const AnnotationId &id) const;
 
-  AnnotationMap amap;
+  /*! \brief Nodes carry a couple of annotations and most arrows
+   * none, so entries are kept in a small array searched linearly;
+   * nothing is allocated until the first annotation is added. */
+  AnnotationEntry *entries;
+  uint16_t nb_entries;
+  uint16_t capacity;
 };
 
+std::ostream &
+operator<< (std::ostream &out, const Annotable::AnnotationId &id);
+
 #endif /* KERNEL_ANNOTABLE_HH */
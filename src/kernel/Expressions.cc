@@ -1245,6 +1245,12 @@ Expr::init (const ConfigTable &cfg)
   ExprSolver::init (cfg);
 }
 
+std::size_t
+Expr::get_store_size ()
+{
+  return expr_store == NULL ? 0 : expr_store->size ();
+}
+
 void
 Expr::terminate ()
 {
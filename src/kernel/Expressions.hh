@@ -108,6 +108,9 @@ public:
   static void init (const ConfigTable &cfg);
   static void terminate ();
 
+  /*! \brief Number of distinct expressions currently alive. */
+  static std::size_t get_store_size ();
+
   virtual void acceptVisitor (ExprVisitor &visitor);
   virtual void acceptVisitor (ConstExprVisitor &visitor) const;
   virtual void acceptVisitor (ExprVisitor *visitor) = 0;
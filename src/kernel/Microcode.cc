@@ -37,6 +37,7 @@
 #include <vector>
 #include <algorithm>
 #include <kernel/annotations/NextInstAnnotation.hh>
+#include <kernel/microcode/FrozenMicrocode.hh>
 #include <decoders/DecoderFactory.hh>
 #include <utils/Option.hh>
 #include <utils/logs.hh>
@@ -200,10 +201,8 @@ static void
 s_copy_annotations (Annotable *dst, const Annotable *src, address_t shift,
 		    bool fold)
 {
-  const Annotable::AnnotationMap *annotations = src->get_annotations ();
-
-  for(Annotable::AnnotationMap::const_iterator i = annotations->begin ();
-      i != annotations->end (); i++)
+  for (Annotable::annotation_iterator i = src->begin_annotations ();
+       i != src->end_annotations (); i++)
     {
       const NextInstAnnotation *maa =
 	dynamic_cast<const NextInstAnnotation *>(i ->second);
@@ -295,6 +294,12 @@ Microcode::merge (const Microcode *other, address_t shift, bool fold)
     }
 }
 
+FrozenMicrocode *
+Microcode::freeze () const
+{
+  return new FrozenMicrocode (this);
+}
+
 void
 Microcode::output_text (ostream & out) const
 {
@@ -334,7 +339,7 @@ make_static (Microcode *mc, DynamicArrow *da)
 	new StaticArrow(da->get_src(),
 			tgt,
 			da->get_stmt()->clone(),
-			da->get_annotations(),
+			da,
 			da->get_condition()->ref());
       return Option<StaticArrow*>(static_arrow);
     }
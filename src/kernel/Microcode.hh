@@ -41,6 +41,7 @@
 
 class MCPath;
 class Expr;
+class FrozenMicrocode;
 
 /*****************************************************************************/
 /*! \brief This class defines the concept of Microcode Program.
@@ -123,6 +124,11 @@ public:
 
   void merge (const Microcode *other, address_t shift, bool fold = false);
 
+  /*! \brief Build an immutable, compact copy of the program for
+   * analyses that only read the graph (see FrozenMicrocode). The
+   * caller owns the result. */
+  FrozenMicrocode *freeze () const;
+
 /*****************************************************************************/
 
   /* GraphInterface interface for navigation in the microcode.
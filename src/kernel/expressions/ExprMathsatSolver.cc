@@ -34,6 +34,7 @@
 #include <kernel/expressions/ExprVisitor.hh>
 #include <kernel/expressions/exprutils.hh>
 #include <utils/logs.hh>
+#include <utils/stats.hh>
 #include <vector>
 #include <map>
 #include <utils/unordered11.hh>
@@ -44,6 +45,8 @@ using namespace std;
 using namespace exprutils;
 
 static const std::string MEMORY_VAR = "MEM";
+static stats::Timer CHECK_SAT_TIMER ("solver.check_sat");
+static stats::Timer GET_VALUE_TIMER ("solver.get_value_of");
 static const std::string SOLVER_NAME = "mathsat";
 
 static const std::string PROP_PREFIX = "kernel.expr.solver." + SOLVER_NAME;
@@ -649,6 +652,8 @@ ExprMathsatSolver::check_sat ()
   ExprSolver::Result result;
   msat_env env = envstack.top ();
 
+  stats::Scope scope (CHECK_SAT_TIMER);
+  number_of_calls++;
   switch (msat_solve (env))
     {
     case MSAT_SAT: result = ExprSolver::SAT; break;
@@ -686,6 +691,7 @@ Constant *
 ExprMathsatSolver::get_value_of (const Expr *e)
   throw (UnexpectedResponseException)
 {
+  stats::Scope scope (GET_VALUE_TIMER);
   msat_env env = envstack.top ();
   msat_term msat_e =
     Expr2MathsatVisitor::translate (env, e, MEMORY_VAR,
@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ExprPortfolioSolver.hh"
+
+#include <utils/logs.hh>
+#include <utils/unordered11.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/wait.h>
+
+using namespace std;
+typedef ExprSolver::UnexpectedResponseException UnexpectedResponseException;
+
+static const std::string SOLVER_NAME = "portfolio";
+
+static const std::string PROP_PREFIX = "kernel.expr.solver." + SOLVER_NAME;
+const std::string ExprPortfolioSolver::COMMANDS_PROP =
+  PROP_PREFIX + ".commands";
+const std::string ExprPortfolioSolver::TIMEOUT_PROP = PROP_PREFIX + ".timeout";
+
+static const ConfigTable *CONFIG;
+static stats::Timer CHECK_SAT_TIMER ("solver.check_sat");
+static stats::Counter TIMEOUTS ("solver.portfolio.timeouts");
+static stats::Counter RESTARTS ("solver.portfolio.restarts");
+
+const string &
+ExprPortfolioSolver::ident ()
+{
+  return SOLVER_NAME;
+}
+
+void
+ExprPortfolioSolver::init (const ConfigTable &cfg)
+{
+  CONFIG = &cfg;
+}
+
+void
+ExprPortfolioSolver::terminate ()
+{
+  CONFIG = NULL;
+}
+
+/* Non-empty fields of s separated by sep. */
+static vector<string>
+s_split (const string &s, char sep)
+{
+  vector<string> result;
+  string::size_type start = 0;
+
+  while (start <= s.size ())
+    {
+      string::size_type end = s.find (sep, start);
+      if (end == string::npos)
+	end = s.size ();
+
+      string field = s.substr (start, end - start);
+      string::size_type first = field.find_first_not_of (" \t");
+      if (first != string::npos)
+	{
+	  string::size_type last = field.find_last_not_of (" \t");
+	  result.push_back (field.substr (first, last - first + 1));
+	}
+      start = end + 1;
+    }
+
+  return result;
+}
+
+static vector<string>
+s_solver_commands ()
+{
+  string commands = CONFIG->get (ExprPortfolioSolver::COMMANDS_PROP);
+  vector<string> result = s_split (commands, ';');
+
+  if (result.empty ())
+    {
+#if HAVE_Z3_SOLVER
+      result.push_back ("z3 -smt2 -in");
+#endif
+#if HAVE_MATHSAT_SOLVER
+      result.push_back ("mathsat");
+#endif
+    }
+
+  return result;
+}
+
+/* The counters of wins exist as long as the program, as static counters
+ * do, and are shared by the solvers with the same command line. */
+static stats::Counter *
+s_wins_counter (const string &cmd)
+{
+  static unordered_map<string, stats::Counter *> counters;
+  unordered_map<string, stats::Counter *>::iterator i = counters.find (cmd);
+
+  if (i != counters.end ())
+    return i->second;
+
+  string *name = new string ("solver.portfolio.wins." + cmd);
+  stats::Counter *result = new stats::Counter (name->c_str ());
+  counters[cmd] = result;
+
+  return result;
+}
+
+ExprPortfolioSolver::ExprPortfolioSolver (const MicrocodeArchitecture *mca,
+					  long timeout)
+  : ExprSolver (mca), members (), scopes (1), winner (NULL), grace (0),
+    restart_time (0), timeout (timeout)
+{
+}
+
+ExprSolver *
+ExprPortfolioSolver::create (const MicrocodeArchitecture *mca)
+  throw (UnexpectedResponseException, UnknownSolverException)
+{
+  ExprPortfolioSolver *result =
+    new ExprPortfolioSolver (mca, CONFIG->get_integer (TIMEOUT_PROP, 0));
+  vector<string> commands = s_solver_commands ();
+  bool started = false;
+
+  result->members.resize (commands.size ());
+  for (size_t i = 0; i < commands.size (); i++)
+    {
+      Member &m = result->members[i];
+      vector<string> words = s_split (commands[i], ' ');
+
+      m.command = words[0];
+      m.args.assign (words.begin () + 1, words.end ());
+      m.solver = NULL;
+      m.busy = false;
+      m.failed = false;
+      m.wins = s_wins_counter (commands[i]);
+      if (result->start (m))
+	started = true;
+      else
+	m.failed = true;
+    }
+
+  if (! started)
+    {
+      delete result;
+      result = NULL;
+    }
+
+  return result;
+}
+
+ExprPortfolioSolver::~ExprPortfolioSolver ()
+{
+  for (size_t i = 0; i < members.size (); i++)
+    stop (members[i]);
+
+  for (size_t i = 0; i < scopes.size (); i++)
+    for (size_t k = 0; k < scopes[i].size (); k++)
+      scopes[i][k].first->deref ();
+}
+
+/* Run the solver of m and give it the assertions of all the scopes. */
+bool
+ExprPortfolioSolver::start (Member &m)
+{
+  unsigned long long start = stats::now ();
+
+  m.solver = ExprProcessSolver::create (mca, m.command, m.args);
+  m.busy = false;
+  if (m.solver == NULL)
+    return false;
+
+  try
+    {
+      for (size_t i = 0; i < scopes.size (); i++)
+	{
+	  if (i > 0)
+	    m.solver->push ();
+	  for (size_t k = 0; k < scopes[i].size (); k++)
+	    {
+	      if (scopes[i][k].second)
+		m.solver->declare_variable (scopes[i][k].first);
+	      m.solver->add_assertion (scopes[i][k].first);
+	    }
+	}
+    }
+  catch (UnexpectedResponseException &e)
+    {
+      logs::warning << "solver '" << m.command << "' stopped: "
+		    << e.what () << endl;
+      stop (m);
+      return false;
+    }
+  restart_time = (restart_time + stats::now () - start) / 2;
+
+  return true;
+}
+
+void
+ExprPortfolioSolver::stop (Member &m)
+{
+  if (m.solver == NULL)
+    return;
+
+  pid_t pid = m.solver->childpid;
+  if (winner == m.solver)
+    winner = NULL;
+  kill (pid, SIGKILL);
+  delete m.solver;
+  waitpid (pid, NULL, 0);
+  m.solver = NULL;
+  m.busy = false;
+}
+
+/* The solvers still busy with the last check are given as much time as
+ * the winner took to answer, or as a restart takes if it is longer; the
+ * others are killed. */
+void
+ExprPortfolioSolver::settle ()
+{
+  unsigned long long deadline = stats::now () + max (grace, restart_time);
+
+  for (size_t i = 0; i < members.size (); i++)
+    {
+      Member &m = members[i];
+
+      if (! m.busy)
+	continue;
+
+      unsigned long long now = stats::now ();
+      struct pollfd pfd;
+      pfd.fd = m.solver->input_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int ms = now < deadline ? (deadline - now) / 1000000 : 0;
+
+      if (poll (&pfd, 1, ms) > 0)
+	{
+	  string res = m.solver->get_result ();
+	  m.busy = false;
+	  if (res != "sat" && res != "unsat" && res != "unknown")
+	    stop (m);
+	}
+      else
+	{
+	  stop (m);
+	  RESTARTS.inc ();
+	}
+    }
+}
+
+/* Restart the solvers that have been stopped. */
+void
+ExprPortfolioSolver::revive ()
+  throw (UnexpectedResponseException)
+{
+  bool alive = false;
+
+  for (size_t i = 0; i < members.size (); i++)
+    {
+      Member &m = members[i];
+
+      if (m.solver == NULL && ! m.failed && ! start (m))
+	m.failed = true;
+      alive = alive || m.solver != NULL;
+    }
+
+  if (! alive)
+    throw UnexpectedResponseException ("portfolio: no solver is running");
+}
+
+void
+ExprPortfolioSolver::forward_assertion (const Expr *e, bool declare)
+{
+  scopes.back ().push_back (make_pair (e->ref (), declare));
+
+  for (size_t i = 0; i < members.size (); i++)
+    {
+      Member &m = members[i];
+
+      if (m.solver == NULL)
+	continue;
+
+      try
+	{
+	  if (declare)
+	    m.solver->declare_variable (e);
+	  m.solver->add_assertion (e);
+	}
+      catch (UnexpectedResponseException &ex)
+	{
+	  logs::warning << "solver '" << m.command << "' stopped: "
+			<< ex.what () << endl;
+	  stop (m);
+	}
+    }
+}
+
+ExprSolver::Result
+ExprPortfolioSolver::check_sat (const Expr *e, bool preserve)
+  throw (UnexpectedResponseException)
+{
+  if (debug_traces)
+    BEGIN_DBG_BLOCK ("check_sat : " + e->to_string ());
+  if (preserve)
+    push ();
+
+  settle ();
+  forward_assertion (e, true);
+  revive ();
+  ExprSolver::Result result = race ();
+
+  if (preserve)
+    pop ();
+  if (debug_traces)
+    END_DBG_BLOCK ();
+
+  return result;
+}
+
+ExprSolver::Result
+ExprPortfolioSolver::check_sat ()
+  throw (UnexpectedResponseException)
+{
+  settle ();
+  revive ();
+
+  return race ();
+}
+
+/* Send the check to every solver and wait for the first definitive
+ * answer. The protocol with the solvers is synchronous, so nothing is
+ * left in the buffers of their outputs when the check is sent and the
+ * answers can be waited for on the file descriptors. */
+ExprSolver::Result
+ExprPortfolioSolver::race ()
+  throw (UnexpectedResponseException)
+{
+  stats::Scope scope (CHECK_SAT_TIMER);
+  unsigned long long start = stats::now ();
+  unsigned long long deadline = start + timeout * 1000000ULL;
+  ExprSolver::Result result = UNKNOWN;
+  bool answered = false;
+  bool timed_out = false;
+
+  number_of_calls++;
+  winner = NULL;
+  for (size_t i = 0; i < members.size (); i++)
+    {
+      Member &m = members[i];
+
+      if (m.solver == NULL)
+	continue;
+      if (debug_traces)
+	logs::debug << m.command << ": (check-sat)" << endl;
+      *m.solver->out << "(check-sat)" << endl;
+      m.busy = true;
+    }
+
+  while (winner == NULL)
+    {
+      vector<struct pollfd> fds;
+      vector<size_t> owners;
+
+      for (size_t i = 0; i < members.size (); i++)
+	{
+	  if (! members[i].busy)
+	    continue;
+
+	  struct pollfd pfd;
+	  pfd.fd = members[i].solver->input_fd;
+	  pfd.events = POLLIN;
+	  pfd.revents = 0;
+	  fds.push_back (pfd);
+	  owners.push_back (i);
+	}
+      if (fds.empty ())
+	break;
+
+      int ms = -1;
+      if (timeout > 0)
+	{
+	  unsigned long long now = stats::now ();
+	  ms = now < deadline ? (deadline - now + 999999) / 1000000 : 0;
+	}
+
+      int n = poll (&fds[0], fds.size (), ms);
+      if (n < 0 && errno == EINTR)
+	continue;
+      if (n < 0)
+	throw UnexpectedResponseException (string ("check-sat: ") +
+					   strerror (errno));
+      if (n == 0)
+	{
+	  TIMEOUTS.inc ();
+	  timed_out = true;
+	  if (debug_traces)
+	    logs::debug << "timeout" << endl;
+	  break;
+	}
+
+      for (size_t k = 0; k < fds.size () && winner == NULL; k++)
+	{
+	  if (fds[k].revents == 0)
+	    continue;
+
+	  Member &m = members[owners[k]];
+	  string res = m.solver->get_result ();
+	  m.busy = false;
+	  if (debug_traces)
+	    logs::debug << m.command << ": " << res << endl;
+	  if (res == "sat" || res == "unsat")
+	    {
+	      result = (res == "sat") ? ExprSolver::SAT : ExprSolver::UNSAT;
+	      winner = m.solver;
+	      m.wins->inc ();
+	    }
+	  else if (res != "unknown")
+	    {
+	      logs::warning << "solver '" << m.command << "' stopped: "
+			    << "check-sat: " << res << endl;
+	      stop (m);
+	      continue;
+	    }
+	  answered = true;
+	}
+    }
+
+  grace = (winner != NULL) ? stats::now () - start : 0;
+  if (winner == NULL && ! answered && ! timed_out)
+    throw UnexpectedResponseException ("check-sat: no solver answered");
+
+  return result;
+}
+
+void
+ExprPortfolioSolver::add_assertion (const Expr *e)
+  throw (UnexpectedResponseException)
+{
+  settle ();
+  forward_assertion (e, false);
+  revive ();
+}
+
+void
+ExprPortfolioSolver::push ()
+  throw (UnexpectedResponseException)
+{
+  settle ();
+  scopes.push_back (Scope ());
+  for (size_t i = 0; i < members.size (); i++)
+    {
+      Member &m = members[i];
+
+      if (m.solver == NULL)
+	continue;
+
+      try
+	{
+	  m.solver->push ();
+	}
+      catch (UnexpectedResponseException &)
+	{
+	  stop (m);
+	}
+    }
+  revive ();
+}
+
+void
+ExprPortfolioSolver::pop ()
+  throw (UnexpectedResponseException)
+{
+  if (scopes.size () == 1)
+    throw UnexpectedResponseException ("pop: no scope to pop");
+
+  settle ();
+  for (size_t k = 0; k < scopes.back ().size (); k++)
+    scopes.back ()[k].first->deref ();
+  scopes.pop_back ();
+
+  for (size_t i = 0; i < members.size (); i++)
+    {
+      Member &m = members[i];
+
+      if (m.solver == NULL)
+	continue;
+
+      try
+	{
+	  m.solver->pop ();
+	}
+      catch (UnexpectedResponseException &)
+	{
+	  stop (m);
+	}
+    }
+  revive ();
+}
+
+Constant *
+ExprPortfolioSolver::get_value_of (const Expr *e)
+  throw (UnexpectedResponseException)
+{
+  if (winner == NULL)
+    throw UnexpectedResponseException ("get_value_of: no model for '" +
+				       e->to_string () + "'");
+
+  return winner->get_value_of (e);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef KERNEL_EXPRESSIONS_EXPRPORTFOLIOSOLVER_HH
+# define KERNEL_EXPRESSIONS_EXPRPORTFOLIOSOLVER_HH
+
+# include <string>
+# include <utility>
+# include <vector>
+# include <kernel/expressions/ExprSolver.hh>
+# include <kernel/expressions/ExprProcessSolver.hh>
+# include <utils/stats.hh>
+
+/*! \brief Several solvers run as processes (see ExprProcessSolver) that
+ *  are given the same assertions. Each check is sent to all of them and
+ *  the first definitive answer is kept; it gives the model used by
+ *  get_value_of (). With a timeout, a check without answer in time is
+ *  UNKNOWN.
+ *
+ *  The solvers that have not answered yet are waited for, at the next
+ *  operation, as long as the winner took or as a restart takes; then
+ *  they are killed. A killed or crashed solver is restarted and given
+ *  the current assertions again, which are kept with their scopes for
+ *  this purpose. */
+class ExprPortfolioSolver : public ExprSolver
+{
+public:
+  /*! \brief Command lines of the solvers separated by ';', e.g.
+   *  "z3 -smt2 -in; mathsat". */
+  static const std::string COMMANDS_PROP;
+  /*! \brief Time given to each check in milliseconds; 0 means no limit. */
+  static const std::string TIMEOUT_PROP;
+
+  static const std::string &ident ();
+  static void init (const ConfigTable &cfg);
+  static void terminate ();
+
+  static ExprSolver *
+  create (const MicrocodeArchitecture *mca)
+    throw (UnexpectedResponseException, UnknownSolverException);
+
+  virtual ~ExprPortfolioSolver ();
+
+  virtual Result check_sat (const Expr *e, bool preserve)
+    throw (UnexpectedResponseException);
+
+  virtual Result check_sat ()
+    throw (UnexpectedResponseException);
+  virtual void add_assertion (const Expr *e)
+    throw (UnexpectedResponseException);
+
+  virtual void push ()
+    throw (UnexpectedResponseException);
+  virtual void pop ()
+    throw (UnexpectedResponseException);
+  virtual Constant *get_value_of (const Expr *var)
+    throw (UnexpectedResponseException);
+
+private:
+  struct Member {
+    std::string command;
+    std::vector<std::string> args;
+    ExprProcessSolver *solver;
+    /* a check has been sent and its answer is not read yet */
+    bool busy;
+    /* the solver could not be restarted; it is not used anymore */
+    bool failed;
+    stats::Counter *wins;
+  };
+
+  /* Assertions of a scope; the flag is set for those whose variables are
+   * declared to the solvers (see ExprProcessSolver::check_sat ()). */
+  typedef std::vector<std::pair<Expr *, bool> > Scope;
+
+  std::vector<Member> members;
+  std::vector<Scope> scopes;
+  ExprProcessSolver *winner;
+  unsigned long long grace;
+  unsigned long long restart_time;
+  long timeout;
+
+  ExprPortfolioSolver (const MicrocodeArchitecture *mca, long timeout);
+
+  bool start (Member &m);
+  void stop (Member &m);
+  void settle ();
+  void revive () throw (UnexpectedResponseException);
+  void forward_assertion (const Expr *e, bool declare);
+  Result race () throw (UnexpectedResponseException);
+};
+
+#endif /* ! KERNEL_EXPRESSIONS_EXPRPORTFOLIOSOLVER_HH */
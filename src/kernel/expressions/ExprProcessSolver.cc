@@ -35,8 +35,10 @@
 #include <io/expressions/expr-parser.hh>
 #include <utils/FileStreamBuffer.hh>
 #include <utils/logs.hh>
+#include <utils/stats.hh>
 #include <utils/unordered11.hh>
 
+#include <algorithm>
 #include <csignal>
 #include <cstdio>
 #include <cstring>
@@ -60,6 +62,8 @@ const std::string ExprProcessSolver::COMMAND_PROP = PROP_PREFIX + ".command";
 const std::string ExprProcessSolver::ARGS_PROP = PROP_PREFIX + ".args";
 
 static const ConfigTable *CONFIG;
+static stats::Timer CHECK_SAT_TIMER ("solver.check_sat");
+static stats::Timer GET_VALUE_TIMER ("solver.get_value_of");
 
 const string &
 ExprProcessSolver::ident ()
@@ -129,26 +133,36 @@ s_create_pipe (const std::string &cmd, const vector<string> &args,
 
 ExprProcessSolver::ExprProcessSolver (const MicrocodeArchitecture *mca,
 				      const string &cmd,
-				      istream *r, ostream *w, pid_t cpid)
-  : ExprSolver (mca), command (cmd), in (r), out (w), childpid (cpid)
+				      istream *r, ostream *w, pid_t cpid,
+				      int ifd)
+  : ExprSolver (mca), command (cmd), in (r), out (w), childpid (cpid),
+    input_fd (ifd), declared (1)
 {
 }
 
 ExprSolver *
 ExprProcessSolver::create (const MicrocodeArchitecture *mca)
   throw (UnexpectedResponseException, UnknownSolverException)
+{
+  return create (mca, s_solver_command (), s_solver_args ());
+}
+
+ExprProcessSolver *
+ExprProcessSolver::create (const MicrocodeArchitecture *mca,
+			   const std::string &cmd,
+			   const std::vector<std::string> &args)
+  throw (UnexpectedResponseException, UnknownSolverException)
 {
   pid_t cpid = 0;
   FILE *pipestreams[2] = {NULL, NULL};
   ExprProcessSolver *result = NULL;
-  const std::string &cmd = s_solver_command ();
-  const std::vector<std::string> &args = s_solver_args ();
 
   if (s_create_pipe (cmd, args, pipestreams, &cpid))
     {
       istream *i = new istream (new file_buffer (pipestreams[0]));
       ostream *o = new ostream (new file_buffer (pipestreams[1]));
-      result = new ExprProcessSolver (mca, cmd, i, o, cpid);
+      result = new ExprProcessSolver (mca, cmd, i, o, cpid,
+				      fileno (pipestreams[0]));
       try
 	{
 	  if (! result->init ())
@@ -204,7 +218,10 @@ ExprProcessSolver::check_sat (const Expr *e, bool preserve)
 
   if (read_status ())
     {
+      unsigned long long start = stats::now ();
+      number_of_calls++;
       string res = exec_command ("(check-sat)");
+      CHECK_SAT_TIMER.add (stats::now () - start);
       if (res == "sat")
 	result = ExprSolver::SAT;
       else if (res == "unsat")
@@ -229,6 +246,7 @@ void
 ExprProcessSolver::add_assertion (const Expr *e)
   throw (UnexpectedResponseException)
 {
+  declare_variable (e);
   if (debug_traces)
     {
       logs::debug << "(assert ";
@@ -254,7 +272,10 @@ ExprProcessSolver::check_sat ()
 {
   ExprSolver::Result result = UNKNOWN;
 
+  unsigned long long start = stats::now ();
+  number_of_calls++;
   string res = exec_command ("(check-sat)");
+  CHECK_SAT_TIMER.add (stats::now () - start);
   if (res == "sat")
     result = ExprSolver::SAT;
   else if (res == "unsat")
@@ -267,6 +288,62 @@ ExprProcessSolver::check_sat ()
   return result;
 }
 
+/* Checks written at once; their answers must fit in the pipe from the
+ * solver, otherwise both processes would wait for the other to read. */
+static const std::size_t MAX_PIPELINED_CHECKS = 256;
+
+void
+ExprProcessSolver::check_sat_batch (const std::vector<Expr *> &es,
+				    std::vector<Result> &results)
+  throw (UnexpectedResponseException)
+{
+  results.clear ();
+
+  for (std::size_t first = 0; first < es.size ();
+       first += MAX_PIPELINED_CHECKS)
+    {
+      std::size_t last = std::min (es.size (), first + MAX_PIPELINED_CHECKS);
+      for (std::size_t i = first; i < last; i++)
+	declare_variable (es[i]);
+
+      unsigned long long start = stats::now ();
+      for (std::size_t i = first; i < last; i++)
+	{
+	  ostringstream oss;
+	  oss << "(push 1) (assert ";
+	  smtlib_writer (oss, es[i], MEMORY_VAR, mca->get_address_size (),
+			 mca->get_endian (), true);
+	  oss << ") (check-sat) (pop 1)";
+	  if (debug_traces)
+	    logs::debug << oss.str () << endl;
+	  *out << oss.str () << endl;
+	}
+      out->flush ();
+
+      for (std::size_t i = first; i < last; i++)
+	{
+	  if (! read_status () || ! read_status ())
+	    throw UnexpectedResponseException ("check-sat: failure on " +
+					       es[i]->to_string ());
+	  string res = get_result ();
+	  if (debug_traces)
+	    logs::debug << res << endl;
+	  if (res == "sat")
+	    results.push_back (ExprSolver::SAT);
+	  else if (res == "unsat")
+	    results.push_back (ExprSolver::UNSAT);
+	  else if (res == "unknown")
+	    results.push_back (ExprSolver::UNKNOWN);
+	  else
+	    throw UnexpectedResponseException ("check-sat: " + res);
+	  if (! read_status ())
+	    throw UnexpectedResponseException ("pop: failure");
+	}
+      number_of_calls += last - first;
+      CHECK_SAT_TIMER.add (stats::now () - start);
+    }
+}
+
 bool
 ExprProcessSolver::init () throw (UnexpectedResponseException)
 {
@@ -331,6 +408,20 @@ ExprProcessSolver::read_status (bool allow_unsupported)
   throw UnexpectedResponseException ("read-status: " + st);
 }
 
+bool
+ExprProcessSolver::declare (const std::string &id, const std::string &sort)
+{
+  for (size_t i = 0; i < declared.size (); i++)
+    if (declared[i].find (id) != declared[i].end ())
+      return true;
+
+  if (! send_command ("(declare-fun " + id + " () " + sort + ") "))
+    return false;
+  declared.back ().insert (id);
+
+  return true;
+}
+
 bool
 ExprProcessSolver::declare_variable (const Expr *e)
 {
@@ -338,11 +429,9 @@ ExprProcessSolver::declare_variable (const Expr *e)
   {
     ostringstream oss;
 
-    oss << "(declare-fun " << MEMORY_VAR << " () (Array "
-	<< "(_ BitVec " << mca->get_address_size () << " ) "
-       << "(_ BitVec 8 ) "
-	<< ")) ";
-    if (! send_command (oss.str ()))
+    oss << "(Array (_ BitVec " << mca->get_address_size () << " ) "
+	<< "(_ BitVec 8 ) )";
+    if (! declare (MEMORY_VAR, oss.str ()))
       return false;
   }
 
@@ -353,15 +442,12 @@ ExprProcessSolver::declare_variable (const Expr *e)
       const Variable *v = dynamic_cast<const Variable *>(*i);
       ostringstream oss;
       assert (v != NULL);
-      oss << "(declare-fun " << v->get_id () << " () "
-	  << "(_ BitVec " << v->get_bv_size () << ") "
-	  << ") ";
-      if (! send_command (oss.str ()))
+      oss << "(_ BitVec " << v->get_bv_size () << ")";
+      if (! declare (v->get_id (), oss.str ()))
 	return false;
     }
 
   vars = collect_subterms_of_type<ExprSet, RegisterExpr> (e, true);
-  unordered_set<const RegisterDesc *> cache;
   for (ExprSet::const_iterator i = vars.begin (); i != vars.end (); i++)
     {
       const RegisterExpr *reg = dynamic_cast<const RegisterExpr *>(*i);
@@ -370,17 +456,11 @@ ExprProcessSolver::declare_variable (const Expr *e)
 
       const RegisterDesc *regdesc = reg->get_descriptor ();
 
-      if (! (cache.find (regdesc) == cache.end ()))
-	continue;
-
       assert (! regdesc->is_alias ());
       ostringstream oss;
-      oss << "(declare-fun " << regdesc->get_label () << " () "
-	  << "(_ BitVec " << regdesc->get_register_size () << ") "
-	  << ") ";
-      if (! send_command (oss.str ()))
+      oss << "(_ BitVec " << regdesc->get_register_size () << ")";
+      if (! declare (regdesc->get_label (), oss.str ()))
 	return false;
-      cache.insert (regdesc);
     }
   return true;
 }
@@ -400,6 +480,7 @@ ExprProcessSolver::push ()
 {
   if (! send_command ("(push 1)"))
     throw UnexpectedResponseException ("push: failure");
+  declared.push_back (set<string> ());
 }
 
 void
@@ -408,6 +489,8 @@ ExprProcessSolver::pop ()
 {
   if (! send_command ("(pop 1)"))
     throw UnexpectedResponseException ("pop: failure");
+  if (declared.size () > 1)
+    declared.pop_back ();
 }
 
 static bool
@@ -532,6 +615,7 @@ Constant *
 ExprProcessSolver::get_value_of (const Expr *e)
   throw (UnexpectedResponseException)
 {
+  stats::Scope scope (GET_VALUE_TIMER);
   Constant *result = NULL;
   ostringstream oss;
   oss << "(get-value (";
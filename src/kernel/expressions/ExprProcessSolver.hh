@@ -33,6 +33,8 @@
 
 # include <csignal>
 # include <iostream>
+# include <set>
+# include <string>
 # include <vector>
 # include <kernel/expressions/ExprSolver.hh>
 
@@ -43,9 +45,20 @@ protected:
   std::istream *in;
   std::ostream *out;
   pid_t childpid;
+  int input_fd;
+  /* Symbols declared to the solver, by scope. A symbol that is visible
+   * cannot be declared again, even in a nested scope. */
+  std::vector<std::set<std::string> > declared;
 
   ExprProcessSolver (const MicrocodeArchitecture *mca, const std::string &cmd,
-		     std::istream *r, std::ostream *w, pid_t cpid);
+		     std::istream *r, std::ostream *w, pid_t cpid, int ifd);
+
+  static ExprProcessSolver *
+  create (const MicrocodeArchitecture *mca, const std::string &cmd,
+	  const std::vector<std::string> &args)
+    throw (UnexpectedResponseException, UnknownSolverException);
+
+  friend class ExprPortfolioSolver;
 
 public:
 
@@ -70,6 +83,12 @@ public:
   virtual void add_assertion (const Expr *e)
     throw (UnexpectedResponseException);
 
+  /*! \brief The checks are written to the solver without waiting for
+   *  their answers, which are read afterwards. */
+  virtual void check_sat_batch (const std::vector<Expr *> &es,
+				std::vector<Result> &results)
+    throw (UnexpectedResponseException);
+
   virtual void push ()
     throw (UnexpectedResponseException);
   virtual void pop ()
@@ -86,6 +105,7 @@ protected:
   std::string exec_command (const std::string &s);
   std::string exec_command (const char *s);
   bool declare_variable (const Expr *e);
+  bool declare (const std::string &id, const std::string &sort);
   std::string get_result ();
 
 };
@@ -32,9 +32,13 @@
 
 #include <utils/logs.hh>
 #include <kernel/expressions/ExprProcessSolver.hh>
+#include <kernel/expressions/ExprPortfolioSolver.hh>
 #include <kernel/expressions/ExprMathsatSolver.hh>
+#include <kernel/expressions/ExprZ3Solver.hh>
+#include <algorithm>
 #include <vector>
 #include <cassert>
+#include <utils/unordered11.hh>
 
 using namespace std;
 
@@ -59,7 +63,11 @@ static SolverModule modules[] = {
 #if INTEGRATED_MATHSAT_SOLVER
   SOLVER_MODULE (ExprMathsatSolver),
 #endif
-  SOLVER_MODULE (ExprProcessSolver)
+#if INTEGRATED_Z3_SOLVER
+  SOLVER_MODULE (ExprZ3Solver),
+#endif
+  SOLVER_MODULE (ExprProcessSolver),
+  SOLVER_MODULE (ExprPortfolioSolver)
 };
 
 static size_t nb_modules = sizeof (modules)/sizeof(modules[0]);
@@ -84,6 +92,7 @@ static SolverModule *default_solver ()
 }
 
 bool ExprSolver::debug_traces = false;
+std::size_t ExprSolver::number_of_calls = 0;
 
 
 void
@@ -92,6 +101,7 @@ ExprSolver::init (const ConfigTable &cfg)
 {
   CONFIG = &cfg;
   debug_traces = cfg.get_boolean (DEBUG_TRACES_PROP);
+  number_of_calls = 0;
 
   for (size_t i = 0; i < nb_modules; i++)
     modules[i].init (cfg);
@@ -111,6 +121,12 @@ ExprSolver::create_default_solver (const MicrocodeArchitecture *mca)
   return default_solver ()->instantiate (mca);
 }
 
+std::size_t
+ExprSolver::get_number_of_calls ()
+{
+  return number_of_calls;
+}
+
 ExprSolver::ExprSolver (const MicrocodeArchitecture *mca) : mca (mca)
 {
 }
@@ -145,12 +161,310 @@ ExprSolver::evaluate (const Expr *e, const Expr *context)
   return result;
 }
 
+/* Number of values looked for one by one before bounding the set. */
+static const std::size_t NB_SAMPLES = 8;
+/* Number of sub-ranges checked at each step of the search for a bound. */
+static const uword_t NB_RANGE_SPLITS = 16;
+/* Number of candidate values checked at once. */
+static const std::size_t CANDIDATES_BATCH = 64;
+
+static uword_t
+s_mask (int size)
+{
+  return size >= 64 ? ~(uword_t) 0 : (((uword_t) 1) << size) - 1;
+}
+
+static uword_t
+s_gcd (uword_t a, uword_t b)
+{
+  while (b != 0)
+    {
+      uword_t r = a % b;
+      a = b;
+      b = r;
+    }
+
+  return a;
+}
+
+static Expr *
+s_in_range (const Variable *var, uword_t min, uword_t max)
+{
+  int size = var->get_bv_size ();
+  Expr *in1 = BinaryApp::create (BV_OP_LEQ_U, Constant::create (min, 0, size),
+				 var->ref (), 0, 1);
+  Expr *in2 = BinaryApp::create (BV_OP_LEQ_U, var->ref (),
+				 Constant::create (max, 0, size), 0, 1);
+
+  return Expr::createLAnd (in1, in2);
+}
+
+/* Look for values of var one by one, excluding each of them from the next
+ * checks, until there is no more or result has nb_values elements.
+ * Returns true if all the values have been found. */
+static bool
+s_enumerate (ExprSolver *solver, const Variable *var, std::size_t nb_values,
+	     std::vector<constant_t> &result)
+{
+  while (result.size () < nb_values)
+    {
+      if (solver->check_sat () != ExprSolver::SAT)
+	return true;
+
+      Constant *c = solver->get_value_of (var);
+      result.push_back (c->get_val ());
+      Expr *nc = Expr::createDisequality (var->ref (), c->ref ());
+      solver->add_assertion (nc);
+      nc->deref ();
+      c->deref ();
+    }
+
+  return false;
+}
+
+/* Lowest (or greatest) value of var in [min, max]. The range is split in
+ * NB_RANGE_SPLITS parts checked at once; the search goes on in the first
+ * (or last) part that is not unsatisfiable. If this part is unknown to
+ * the solver, the search gives up and returns max (or min), which is a
+ * value of var. */
+static uword_t
+s_bound (ExprSolver *solver, const Variable *var, uword_t min, uword_t max,
+	 bool lowest)
+{
+  std::vector<Expr *> ranges;
+  std::vector<uword_t> starts;
+  std::vector<ExprSolver::Result> results;
+  uword_t known = lowest ? max : min;
+
+  while (min < max)
+    {
+      uword_t width = (max - min) / NB_RANGE_SPLITS + 1;
+
+      for (uword_t s = min; ; s += width)
+	{
+	  uword_t e = (max - s < width) ? max : s + width - 1;
+
+	  starts.push_back (s);
+	  ranges.push_back (s_in_range (var, s, e));
+	  if (e == max)
+	    break;
+	}
+
+      solver->check_sat_batch (ranges, results);
+      std::size_t k = lowest ? 0 : results.size () - 1;
+      while (results[k] == ExprSolver::UNSAT &&
+	     (lowest ? k + 1 < results.size () : k > 0))
+	k += lowest ? 1 : -1;
+
+      if (k + 1 < starts.size ())
+	max = starts[k + 1] - 1;
+      min = starts[k];
+
+      for (std::size_t i = 0; i < ranges.size (); i++)
+	ranges[i]->deref ();
+      ranges.clear ();
+      starts.clear ();
+
+      if (results[k] == ExprSolver::UNKNOWN)
+	return known;
+    }
+
+  return min;
+}
+
+/* Greatest stride such that every value of var is min plus a multiple of
+ * it; stride is a first guess that divides the differences between the
+ * known values. If the solver cannot tell whether some value is off the
+ * stride, nothing is proven and the stride is 1. */
+static uword_t
+s_refine_stride (ExprSolver *solver, const Variable *var, uword_t min,
+		 uword_t stride)
+{
+  int size = var->get_bv_size ();
+
+  while (stride > 1)
+    {
+      Expr *offset =
+	BinaryApp::create (BV_OP_SUB, var->ref (),
+			   Constant::create (min, 0, size), 0, size);
+      Expr *rem =
+	BinaryApp::create (BV_OP_MODULO, offset,
+			   Constant::create (stride, 0, size), 0, size);
+      Expr *off_stride =
+	Expr::createDisequality (rem, Constant::create (0, 0, size));
+
+      solver->push ();
+      solver->add_assertion (off_stride);
+      off_stride->deref ();
+      ExprSolver::Result res = solver->check_sat ();
+      if (res == ExprSolver::SAT)
+	{
+	  Constant *c = solver->get_value_of (var);
+	  uword_t v = ((uword_t) c->get_val ()) & s_mask (size);
+	  c->deref ();
+	  stride = s_gcd (stride, (v - min) & s_mask (size));
+	}
+      solver->pop ();
+
+      if (res == ExprSolver::UNKNOWN)
+	stride = 1;
+      if (res != ExprSolver::SAT)
+	break;
+    }
+
+  return stride;
+}
+
+/* Check the candidates min + k * stride, for k from first to last and
+ * except those in skip, by batches until result has nb_values elements.
+ * When a batch contains no value of var, the candidates up to the lowest
+ * value greater than them are skipped. Gives up and returns false as soon
+ * as less than a quarter of the candidates checked so far are values of
+ * var; hence at most 4 * nb_values + CANDIDATES_BATCH candidates are
+ * checked. The last candidate is expected to be a value of var. */
+static bool
+s_check_candidates (ExprSolver *solver, const Variable *var, uword_t min,
+		    uword_t stride, uword_t first, uword_t last,
+		    const std::unordered_set<uword_t> &skip,
+		    std::size_t nb_values, std::vector<constant_t> &result)
+{
+  int size = var->get_bv_size ();
+  uword_t mask = s_mask (size);
+  std::vector<Expr *> checks;
+  std::vector<uword_t> candidates;
+  std::vector<ExprSolver::Result> results;
+  std::size_t nb_checked = 0;
+  std::size_t nb_found = 0;
+  uword_t k = first;
+  bool done = (first > last);
+
+  while (result.size () < nb_values && ! done)
+    {
+      for (; candidates.size () < CANDIDATES_BATCH && ! done; k++)
+	{
+	  uword_t v = (min + k * stride) & mask;
+	  done = (k == last);
+	  if (skip.find (v) != skip.end ())
+	    continue;
+	  candidates.push_back (v);
+	  checks.push_back (Expr::createEquality (var->ref (),
+						  Constant::create (v, 0,
+								    size)));
+	}
+      if (checks.empty ())
+	break;
+
+      solver->check_sat_batch (checks, results);
+      std::size_t nb_batch_found = 0;
+      for (std::size_t i = 0; i < results.size (); i++)
+	{
+	  if (results[i] == ExprSolver::SAT && result.size () < nb_values)
+	    {
+	      result.push_back ((constant_t) candidates[i]);
+	      nb_batch_found++;
+	    }
+	  checks[i]->deref ();
+	}
+      nb_checked += candidates.size ();
+      nb_found += nb_batch_found;
+      checks.clear ();
+      candidates.clear ();
+
+      if (4 * nb_found < nb_checked)
+	return false;
+
+      if (nb_batch_found == 0 && ! done)
+	{
+	  // skip the gap up to the next value
+	  uword_t from = (min + k * stride) & mask;
+	  uword_t to = (min + last * stride) & mask;
+	  uword_t next = s_bound (solver, var, from, to, true);
+	  uword_t gap = (next - from) & mask;
+	  k += gap / stride + (gap % stride == 0 ? 0 : 1);
+	  done = (k > last);
+	}
+    }
+
+  return true;
+}
+
+/* The values of var are enumerated by batches of candidates when they
+ * are stride-regular: the stride is guessed from the values already in
+ * result, the candidates between them are checked and, if enough of them
+ * are values, the bounds of the set are searched and the candidates
+ * outside the known values are checked. Returns false if the values turn
+ * out to be sparse; the values found so far are then excluded from the
+ * assertions. */
+static bool
+s_enumerate_range (ExprSolver *solver, const Variable *var,
+		   std::size_t nb_values, std::vector<constant_t> &result)
+{
+  int size = var->get_bv_size ();
+  uword_t mask = s_mask (size);
+  std::size_t nb_samples = result.size ();
+  std::unordered_set<uword_t> known;
+  uword_t min = mask;
+  uword_t max = 0;
+
+  for (std::size_t i = 0; i < nb_samples; i++)
+    {
+      uword_t v = ((uword_t) result[i]) & mask;
+      known.insert (v);
+      min = std::min (min, v);
+      max = std::max (max, v);
+    }
+
+  uword_t stride = 0;
+  for (std::size_t i = 0; i < nb_samples; i++)
+    stride = s_gcd (stride, (((uword_t) result[i]) & mask) - min);
+  stride = s_refine_stride (solver, var, min, stride == 0 ? mask : stride);
+
+  // candidates between the known values
+  bool regular =
+    s_check_candidates (solver, var, min, stride, 1, (max - min) / stride,
+			known, nb_values, result);
+
+  if (regular && result.size () < nb_values)
+    {
+      for (std::size_t i = nb_samples; i < result.size (); i++)
+	known.insert (((uword_t) result[i]) & mask);
+
+      // candidates above the known values, then below them
+      uword_t hi = s_bound (solver, var, max, mask, false);
+      regular = s_check_candidates (solver, var, max, stride, 1,
+				    (hi - max) / stride, known, nb_values,
+				    result);
+      if (regular && result.size () < nb_values)
+	{
+	  uword_t lo = s_bound (solver, var, 0, min, true);
+	  if (lo < min)
+	    regular = s_check_candidates (solver, var, lo, stride, 0,
+					  (min - lo) / stride - 1, known,
+					  nb_values, result);
+	}
+    }
+
+  if (! regular)
+    {
+      for (std::size_t i = nb_samples; i < result.size (); i++)
+	{
+	  Expr *nc = Expr::createDisequality (var->ref (),
+					      Constant::create (result[i], 0,
+								size));
+	  solver->add_assertion (nc);
+	  nc->deref ();
+	}
+    }
+
+  return regular;
+}
+
 std::vector<constant_t> *
 ExprSolver::evaluate (const Expr *e, const Expr *context, int nb_values)
   throw (UnexpectedResponseException)
 {
   std::vector<constant_t> *result = new std::vector<constant_t> ();
-  if (nb_values == 0)
+  if (nb_values <= 0)
     return result;
 
   if (debug_traces)
@@ -164,30 +478,38 @@ ExprSolver::evaluate (const Expr *e, const Expr *context, int nb_values)
   push ();
   if (check_sat (phi, false) == SAT)
     {
-      phi->deref ();
-      while (nb_values > 0 && check_sat () == SAT)
-	{
-	  Constant *c = get_value_of (var);
-	  if (debug_traces)
-	    logs::debug << "value = " << *c << std::endl;
+      std::size_t n = nb_values;
+      bool done = s_enumerate (this, var, std::min (n, NB_SAMPLES), *result);
 
-	  result->push_back (c->get_val ());
-	  Expr *nc = Expr::createDisequality (var->ref (), c->ref ());
-	  add_assertion (nc);
-	  nc->deref ();
-	  c->deref ();
-	  nb_values--;
-	}
-    }
-  else
-    {
-      phi->deref ();
+      if (! done && result->size () < n && check_sat () == SAT &&
+	  ! s_enumerate_range (this, var, n, *result))
+	s_enumerate (this, var, n, *result);
     }
+  phi->deref ();
 
   pop ();
   var->deref ();
   if (debug_traces)
-    END_DBG_BLOCK ();
+    {
+      for (std::size_t i = 0; i < result->size (); i++)
+	logs::debug << "value = " << result->at (i) << std::endl;
+      END_DBG_BLOCK ();
+    }
 
   return result;
 }
+
+void
+ExprSolver::check_sat_batch (const std::vector<Expr *> &es,
+			     std::vector<Result> &results)
+  throw (UnexpectedResponseException)
+{
+  results.clear ();
+  for (std::size_t i = 0; i < es.size (); i++)
+    {
+      push ();
+      add_assertion (es[i]);
+      results.push_back (check_sat ());
+      pop ();
+    }
+}
@@ -70,6 +70,10 @@ public:
   static ExprSolver *create_default_solver (const MicrocodeArchitecture *mca)
     throw (UnexpectedResponseException, UnknownSolverException);
 
+  /*! \brief Number of satisfiability checks submitted to solvers since
+   *  the last call to init (). */
+  static std::size_t get_number_of_calls ();
+
   enum Result { SAT, UNSAT, UNKNOWN };
 
   virtual ~ExprSolver ();
@@ -86,10 +90,23 @@ public:
   virtual Constant *evaluate (const Expr *e, const Expr *context)
     throw (UnexpectedResponseException);
 
+  /*! \brief Values that e may take under context, at most nb_values of
+   *  them. A few values are first looked for one by one; if there are
+   *  more and they are stride-regular, the candidates between the bounds
+   *  of the set are checked by batches with check_sat_batch (). Sparse
+   *  sets are enumerated one value at a time. */
   virtual std::vector<constant_t> *
   evaluate (const Expr *e, const Expr *context, int nb_values)
     throw (UnexpectedResponseException);
 
+  /*! \brief Check the satisfiability of each expression of es with the
+   *  current assertions, independently of the others; the assertions are
+   *  left unchanged. The variables of es must be known by the solver,
+   *  i.e. they appear in a previous assertion. */
+  virtual void check_sat_batch (const std::vector<Expr *> &es,
+				std::vector<Result> &results)
+    throw (UnexpectedResponseException);
+
   virtual void push ()
     throw (UnexpectedResponseException) = 0;
   virtual void pop ()
@@ -103,6 +120,7 @@ protected:
   const MicrocodeArchitecture *mca;
 
   static bool debug_traces;
+  static std::size_t number_of_calls;
 };
 
 #endif /* ! KERNEL_EXPRESSIONS_EXPRSOLVER_HH */
@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ExprZ3Solver.hh"
+
+#if INTEGRATED_Z3_SOLVER
+#include <kernel/expressions/ExprVisitor.hh>
+#include <kernel/expressions/exprutils.hh>
+#include <utils/logs.hh>
+#include <utils/stats.hh>
+#include <vector>
+#include <cassert>
+
+using namespace std;
+
+static const std::string MEMORY_VAR = "MEM";
+static stats::Timer CHECK_SAT_TIMER ("solver.check_sat");
+static stats::Timer GET_VALUE_TIMER ("solver.get_value_of");
+static const std::string SOLVER_NAME = "z3";
+
+/* Beyond this number of cached terms the cache is emptied before the next
+ * translation. */
+static const std::size_t MAX_CACHED_TERMS = 1 << 16;
+
+typedef ExprSolver::UnexpectedResponseException UnexpectedResponseException;
+
+/* The terms follow the SMT-LIB output of smtlib_writer (). The context
+ * counts the references to terms; each term built by the visitor is
+ * referenced until the end of the translation. */
+class Expr2Z3Visitor : public ConstExprVisitor
+{
+  Z3_context ctx;
+  ExprZ3Solver::TermCache &terms;
+  int addrsize;
+  Architecture::endianness_t endian;
+  vector<Z3_ast> trail;
+  Z3_ast result;
+
+public:
+  Expr2Z3Visitor (Z3_context ctx, ExprZ3Solver::TermCache &terms, int bpa,
+		  Architecture::endianness_t e)
+    : ConstExprVisitor (), ctx (ctx), terms (terms), addrsize (bpa),
+      endian (e), trail (), result (NULL) { }
+
+  ~Expr2Z3Visitor () {
+    for (vector<Z3_ast>::size_type i = 0; i < trail.size (); i++)
+      Z3_dec_ref (ctx, trail[i]);
+  }
+
+  Z3_ast get_result () const {
+    return result;
+  }
+
+  Z3_ast keep (Z3_ast a) {
+    Z3_error_code err = Z3_get_error_code (ctx);
+
+    if (a == NULL || err != Z3_OK)
+      throw UnexpectedResponseException (string ("z3: ") +
+					 Z3_get_error_msg (ctx, err));
+    Z3_inc_ref (ctx, a);
+    trail.push_back (a);
+
+    return a;
+  }
+
+  Z3_ast translate (const Expr *e) {
+    e->acceptVisitor (this);
+    return result;
+  }
+
+  bool lookup (const Expr *e) {
+    ExprZ3Solver::TermCache::const_iterator i =
+      terms.find (const_cast<Expr *> (e));
+
+    if (i == terms.end ())
+      return false;
+    result = i->second;
+
+    return true;
+  }
+
+  void store (const Expr *e) {
+    Z3_inc_ref (ctx, result);
+    terms[const_cast<Expr *> (e)->ref ()] = result;
+  }
+
+  Z3_sort bv_sort (int size) {
+    return Z3_mk_bv_sort (ctx, size);
+  }
+
+  Z3_ast make_constant (word_t val, int bv_size) {
+    return keep (Z3_mk_unsigned_int64 (ctx, val, bv_sort (bv_size)));
+  }
+
+  Z3_ast make_variable (const std::string &id, Z3_sort sort) {
+    Z3_symbol s = Z3_mk_string_symbol (ctx, id.c_str ());
+    return keep (Z3_mk_const (ctx, s, sort));
+  }
+
+  void extract_bv_window (const Expr *e) {
+    result = keep (Z3_mk_extract (ctx,
+				  e->get_bv_offset () + e->get_bv_size () - 1,
+				  e->get_bv_offset (), result));
+  }
+
+  Z3_ast extend (Z3_ast a, int ext, bool with_sign) {
+    if (ext <= 0)
+      return a;
+    if (with_sign)
+      return keep (Z3_mk_sign_ext (ctx, ext, a));
+    return keep (Z3_mk_zero_ext (ctx, ext, a));
+  }
+
+  void output_boolean (const Expr *e) {
+    Z3_ast t = translate (e);
+
+    if (e->get_bv_size () == 1)
+      result = keep (Z3_mk_eq (ctx, t, make_constant (1, 1)));
+    else
+      {
+	t = keep (Z3_mk_eq (ctx, t, make_constant (0, e->get_bv_size ())));
+	result = keep (Z3_mk_not (ctx, t));
+      }
+  }
+
+  virtual void visit (const Constant *c) {
+    if (lookup (c))
+      return;
+    result = make_constant (c->get_val (), c->get_bv_size ());
+    store (c);
+  }
+
+  virtual void visit (const RandomValue *) {
+    logs::error << "RandomValue should not be sent to SMT solver." << endl;
+    abort ();
+  }
+
+  virtual void visit (const Variable *v) {
+    if (lookup (v))
+      return;
+    result = make_variable (v->get_id (), bv_sort (v->get_bv_size ()));
+    store (v);
+  }
+
+  virtual void visit (const UnaryApp *e) {
+    if (lookup (e))
+      return;
+
+    bool extract = (e->get_bv_offset () != 0 ||
+		    e->get_bv_size () != e->get_arg1 ()->get_bv_size ());
+    Z3_ast arg = translate (e->get_arg1 ());
+
+    if (e->get_op () == BV_OP_NOT)
+      result = keep (Z3_mk_bvnot (ctx, arg));
+    else
+      {
+	assert (e->get_op () == BV_OP_NEG);
+	result = keep (Z3_mk_bvneg (ctx, arg));
+	result = extend (result,
+			 e->get_bv_size () - e->get_arg1 ()->get_bv_size (),
+			 true);
+      }
+    if (extract)
+      extract_bv_window (e);
+    store (e);
+  }
+
+  bool need_extract (const BinaryApp *e) {
+    bool result = true;
+
+    if (e->get_op () == BV_OP_CONCAT)
+      {
+	result = (e->get_bv_offset () != 0 ||
+		  (e->get_bv_size () < e->get_arg1 ()->get_bv_size () +
+		   e->get_arg2 ()->get_bv_size ()));
+      }
+    else if (e->get_op () != BV_OP_EXTEND_U && e->get_op () != BV_OP_EXTEND_S)
+      result = (e->get_bv_offset () != 0 ||
+		e->get_bv_size () != e->get_arg1 ()->get_bv_size ());
+    return result;
+  }
+
+  static Z3_ast Z3_mk_bvneq (Z3_context c, Z3_ast t1, Z3_ast t2) {
+    Z3_ast args[2] = { t1, t2 };
+    return Z3_mk_distinct (c, 2, args);
+  }
+
+  virtual void visit (const BinaryApp *e) {
+    if (lookup (e))
+      return;
+
+    typedef Z3_ast (*binary_operator) (Z3_context, Z3_ast, Z3_ast);
+    typedef Z3_ast (*binary_operator_int) (Z3_context, unsigned, Z3_ast);
+    binary_operator zop = NULL;
+    binary_operator_int zopi = NULL;
+    BinaryOp op = e->get_op ();
+    bool extract = need_extract (e);
+    bool ext = false;
+    bool ite = false;
+    bool with_sign = false;
+
+    switch (op)
+      {
+      case BV_OP_AND: zop = Z3_mk_bvand; goto output_binary_1;
+      case BV_OP_OR: zop = Z3_mk_bvor; goto output_binary_1;
+      case BV_OP_MUL_S: with_sign = true;
+      case BV_OP_MUL_U: zop = Z3_mk_bvmul; ext = true; goto output_binary_1;
+      case BV_OP_ADD: zop = Z3_mk_bvadd; ext = true; goto output_binary_1;
+      case BV_OP_SUB: zop = Z3_mk_bvsub; ext = true; goto output_binary_1;
+      case BV_OP_LSH: zop = Z3_mk_bvshl; goto output_binary_1;
+      case BV_OP_RSH_U: zop = Z3_mk_bvlshr; goto output_binary_1;
+      case BV_OP_RSH_S: zop = Z3_mk_bvashr; goto output_binary_1;
+      case BV_OP_MODULO:
+	zop = Z3_mk_bvurem; goto output_binary_1; // to be fix with signed mod.
+      case BV_OP_DIV_S: zop = Z3_mk_bvsdiv; goto output_binary_1;
+      case BV_OP_DIV_U: zop = Z3_mk_bvudiv; goto output_binary_1;
+      case BV_OP_CONCAT: zop = Z3_mk_concat; goto output_binary_1;
+      case BV_OP_XOR: zop = Z3_mk_bvxor; goto output_binary_1;
+
+      case BV_OP_NEQ: zop = Z3_mk_bvneq;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_EQ: zop = Z3_mk_eq;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_GEQ_U: zop = Z3_mk_bvuge;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_GEQ_S: zop = Z3_mk_bvsge;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_LT_U: zop = Z3_mk_bvult;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_LT_S: zop = Z3_mk_bvslt;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_GT_U: zop = Z3_mk_bvugt;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_GT_S: zop = Z3_mk_bvsgt;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_LEQ_U: zop = Z3_mk_bvule;
+	extract = false; ite = true; goto output_binary_1;
+      case BV_OP_LEQ_S: zop = Z3_mk_bvsle;
+	extract = false; ite = true; goto output_binary_1;
+
+      output_binary_1:
+	{
+	  Z3_ast arg1 = translate (e->get_arg1 ());
+	  Z3_ast arg2 = translate (e->get_arg2 ());
+
+	  if (ext)
+	    {
+	      int size = e->get_bv_size ();
+	      arg1 = extend (arg1, size - e->get_arg1 ()->get_bv_size (),
+			     with_sign);
+	      arg2 = extend (arg2, size - e->get_arg2 ()->get_bv_size (),
+			     with_sign);
+	    }
+	  result = keep (zop (ctx, arg1, arg2));
+	  if (extract)
+	    extract_bv_window (e);
+	  if (ite)
+	    {
+	      Z3_ast T = make_constant (1, 1);
+	      Z3_ast F = make_constant (0, 1);
+	      result = keep (Z3_mk_ite (ctx, result, T, F));
+	    }
+	}
+	break;
+
+      case BV_OP_ROR: zopi = Z3_mk_rotate_right; goto output_binary_2;
+      case BV_OP_ROL: zopi = Z3_mk_rotate_left; goto output_binary_2;
+      case BV_OP_EXTEND_U: zopi = Z3_mk_zero_ext; goto output_binary_2;
+      case BV_OP_EXTEND_S: zopi = Z3_mk_sign_ext; goto output_binary_2;
+      output_binary_2:
+	{
+	  Constant *c = dynamic_cast <Constant *> (e->get_arg2 ());
+	  if (c == NULL)
+	    throw UnexpectedResponseException ("z3: unsupported expression " +
+					       e->to_string ());
+	  word_t val = c->get_val ();
+	  if (op == BV_OP_EXTEND_U || op == BV_OP_EXTEND_S)
+	    val = c->get_val () - e->get_arg1 ()->get_bv_size ();
+	  Z3_ast arg = translate (e->get_arg1 ());
+	  result = keep (zopi (ctx, val, arg));
+	}
+
+	if (extract)
+	  extract_bv_window (e);
+	break;
+
+      case BV_OP_POW:
+      default:
+	throw UnexpectedResponseException ("z3: unsupported expression " +
+					   e->to_string ());
+      }
+    store (e);
+  }
+
+  virtual void visit (const TernaryApp *e) {
+    if (lookup (e))
+      return;
+
+    assert (e->get_op () == BV_OP_EXTRACT);
+    Constant *expr_offset = dynamic_cast <Constant *> (e->get_arg2 ());
+    Constant *expr_size = dynamic_cast <Constant *> (e->get_arg3 ());
+
+    if (expr_offset == NULL || expr_size == NULL)
+      throw UnexpectedResponseException ("z3: unsupported expression " +
+					 e->to_string ());
+
+    constant_t offset = expr_offset->get_val ();
+    constant_t size = expr_size->get_val ();
+    Z3_ast arg = translate (e->get_arg1 ());
+
+    result = keep (Z3_mk_extract (ctx, offset + size - 1, offset, arg));
+    if (offset != e->get_bv_offset () || size != e->get_bv_size ())
+      extract_bv_window (e);
+    store (e);
+  }
+
+  virtual void visit (const MemCell *e) {
+    if (lookup (e))
+      return;
+
+    if (e->get_bv_size () == 8 && e->get_bv_offset () == 0)
+      {
+	// to be fixed !!!
+	Z3_ast addr =
+	  extend (translate (e->get_addr ()),
+		  addrsize - e->get_addr ()->get_bv_size (), false);
+	Z3_sort memaddr = bv_sort (addrsize);
+	Z3_sort byte = bv_sort (8);
+	Z3_ast mem = make_variable (MEMORY_VAR,
+				    Z3_mk_array_sort (ctx, memaddr, byte));
+	result = keep (Z3_mk_select (ctx, mem, addr));
+      }
+    else
+      {
+	int nb_bytes = (e->get_bv_offset () + e->get_bv_size ()) / 8;
+	if (e->get_bv_size () % 8 != 0)
+	  nb_bytes++;
+	Expr *addr = e->get_addr ()->ref ();
+	Expr *bv = MemCell::create (addr->ref (), 0, 8);
+
+	for (int i = 1; i < nb_bytes; i++)
+	  {
+	    Expr *a = BinaryApp::create (BV_OP_ADD, addr->ref (), i);
+	    Expr *byte = MemCell::create (a, 0, 8);
+	    Expr *tmp;
+	    Expr *aux[2];
+	    if (endian == Architecture::LittleEndian)
+	      {
+		aux[0] = byte;
+		aux[1] = bv;
+	      }
+	    else
+	      {
+		aux[0] = bv;
+		aux[1] = byte;
+	      }
+	    tmp = BinaryApp::create (BV_OP_CONCAT, aux[0], aux[1],
+				     0, 8 * (i + 1));
+	    bv = tmp;
+	  }
+	addr->deref ();
+	bv = Expr::createExtract (bv, e->get_bv_offset (), e->get_bv_size ());
+	try
+	  {
+	    translate (bv);
+	  }
+	catch (UnexpectedResponseException &)
+	  {
+	    bv->deref ();
+	    throw;
+	  }
+	bv->deref ();
+      }
+    store (e);
+  }
+
+  virtual void visit (const RegisterExpr *e) {
+    if (lookup (e))
+      return;
+
+    const RegisterDesc *rd = e->get_descriptor ();
+
+    result = make_variable (rd->get_label (),
+			    bv_sort (rd->get_register_size ()));
+    if (! (e->get_bv_offset () == 0 &&
+	   e->get_bv_size () == rd->get_register_size ()))
+      extract_bv_window (e);
+    store (e);
+  }
+
+  virtual void visit (const QuantifiedExpr *e) {
+    throw UnexpectedResponseException ("z3: unsupported expression " +
+				       e->to_string ());
+  }
+};
+
+ExprZ3Solver::ExprZ3Solver (const MicrocodeArchitecture *mca)
+  : ExprSolver (mca), ctx (NULL), solver (NULL), terms ()
+{
+  Z3_config cfg = Z3_mk_config ();
+  Z3_set_param_value (cfg, "model", "true");
+  ctx = Z3_mk_context_rc (cfg);
+  Z3_del_config (cfg);
+
+  /* errors are checked after the calls instead of aborting */
+  Z3_set_error_handler (ctx, NULL);
+  solver = Z3_mk_solver_for_logic (ctx, Z3_mk_string_symbol (ctx,
+							     "QF_AUFBV"));
+  Z3_solver_inc_ref (ctx, solver);
+}
+
+ExprZ3Solver::~ExprZ3Solver ()
+{
+  clear_terms ();
+  Z3_solver_dec_ref (ctx, solver);
+  Z3_del_context (ctx);
+}
+
+const std::string &
+ExprZ3Solver::ident ()
+{
+  return SOLVER_NAME;
+}
+
+void
+ExprZ3Solver::init (const ConfigTable &)
+  throw (UnknownSolverException)
+{
+}
+
+void
+ExprZ3Solver::terminate ()
+{
+}
+
+ExprSolver *
+ExprZ3Solver::create (const MicrocodeArchitecture *mca)
+  throw (UnexpectedResponseException, UnknownSolverException)
+{
+  return new ExprZ3Solver (mca);
+}
+
+void
+ExprZ3Solver::clear_terms ()
+{
+  for (TermCache::iterator i = terms.begin (); i != terms.end (); i++)
+    {
+      Z3_dec_ref (ctx, i->second);
+      i->first->deref ();
+    }
+  terms.clear ();
+}
+
+void
+ExprZ3Solver::check_error (const std::string &where)
+  throw (UnexpectedResponseException)
+{
+  Z3_error_code err = Z3_get_error_code (ctx);
+
+  if (err != Z3_OK)
+    throw UnexpectedResponseException (where + ": " +
+				       Z3_get_error_msg (ctx, err));
+}
+
+/* The result is referenced; the caller has to release it. */
+Z3_ast
+ExprZ3Solver::translate (const Expr *ep, bool as_boolean)
+  throw (UnexpectedResponseException)
+{
+  if (terms.size () > MAX_CACHED_TERMS)
+    clear_terms ();
+
+  Expr2Z3Visitor e2z (ctx, terms, mca->get_address_size (),
+		      mca->get_endian ());
+  Expr *e = ep->ref ();
+  exprutils::simplify (&e);
+
+  try
+    {
+      if (as_boolean)
+	e2z.output_boolean (e);
+      else
+	e2z.translate (e);
+    }
+  catch (UnexpectedResponseException &)
+    {
+      e->deref ();
+      throw;
+    }
+  e->deref ();
+
+  Z3_ast result = e2z.get_result ();
+  Z3_inc_ref (ctx, result);
+
+  return result;
+}
+
+void
+ExprZ3Solver::add_assertion (const Expr *e)
+  throw (UnexpectedResponseException)
+{
+  Z3_ast formula = translate (e, true);
+
+  Z3_solver_assert (ctx, solver, formula);
+  if (debug_traces)
+    logs::debug << "(assert " << Z3_ast_to_string (ctx, formula) << ") "
+		<< endl;
+  Z3_dec_ref (ctx, formula);
+  check_error ("error while adding assertion " + e->to_string ());
+}
+
+ExprSolver::Result
+ExprZ3Solver::check_sat (const Expr *e, bool preserve)
+    throw (UnexpectedResponseException)
+{
+  if (debug_traces)
+    BEGIN_DBG_BLOCK ("check_sat : " + e->to_string ());
+  if (preserve)
+    push ();
+
+  add_assertion (e);
+  ExprSolver::Result result = check_sat ();
+  if (preserve)
+    pop ();
+
+  if (debug_traces)
+    END_DBG_BLOCK ();
+
+  return result;
+}
+
+ExprSolver::Result
+ExprZ3Solver::check_sat ()
+  throw (UnexpectedResponseException)
+{
+  ExprSolver::Result result;
+
+  stats::Scope scope (CHECK_SAT_TIMER);
+  number_of_calls++;
+  switch (Z3_solver_check (ctx, solver))
+    {
+    case Z3_L_TRUE: result = ExprSolver::SAT; break;
+    case Z3_L_FALSE: result = ExprSolver::UNSAT; break;
+    default: result = ExprSolver::UNKNOWN; break;
+    }
+  check_error ("check-sat");
+  if (debug_traces)
+    logs::debug << (result == SAT ? "sat" : result == UNSAT ? "unsat" :
+		    "unknown") << endl;
+
+  return result;
+}
+
+void
+ExprZ3Solver::push ()
+  throw (UnexpectedResponseException)
+{
+  Z3_solver_push (ctx, solver);
+  check_error ("push");
+}
+
+void
+ExprZ3Solver::pop ()
+  throw (UnexpectedResponseException)
+{
+  Z3_solver_pop (ctx, solver, 1);
+  check_error ("pop");
+}
+
+Constant *
+ExprZ3Solver::get_value_of (const Expr *e)
+  throw (UnexpectedResponseException)
+{
+  stats::Scope scope (GET_VALUE_TIMER);
+  Z3_model model = Z3_solver_get_model (ctx, solver);
+  check_error ("get_value_of");
+  Z3_model_inc_ref (ctx, model);
+
+  Z3_ast t;
+  try
+    {
+      t = translate (e, false);
+    }
+  catch (UnexpectedResponseException &)
+    {
+      Z3_model_dec_ref (ctx, model);
+      throw;
+    }
+
+  Z3_ast val = NULL;
+  uint64_t v = 0;
+  bool ok = Z3_model_eval (ctx, model, t, true, &val);
+  if (ok)
+    {
+      Z3_inc_ref (ctx, val);
+      ok = Z3_get_numeral_uint64 (ctx, val, &v);
+    }
+
+  string msg;
+  if (! ok)
+    {
+      msg = "get_value_of: z3 return value is not a number for '" +
+	e->to_string () + "'";
+      if (val != NULL)
+	msg += string (": ") + Z3_ast_to_string (ctx, val);
+    }
+  if (val != NULL)
+    Z3_dec_ref (ctx, val);
+  Z3_dec_ref (ctx, t);
+  Z3_model_dec_ref (ctx, model);
+  if (! ok)
+    throw UnexpectedResponseException (msg);
+
+  return Constant::create (v, 0, e->get_bv_size ());
+}
+
+#endif
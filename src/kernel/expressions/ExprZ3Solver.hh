@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef KERNEL_EXPRESSIONS_EXPRZ3SOLVER_HH
+# define KERNEL_EXPRESSIONS_EXPRZ3SOLVER_HH
+
+# include <config.h>
+
+# if INTEGRATED_Z3_SOLVER
+#  include <z3.h>
+#  include <kernel/expressions/ExprSolver.hh>
+#  include <utils/unordered11.hh>
+
+/*! Z3 used through its C API in the process of Insight. Expressions are
+ * translated once: the terms of the subexpressions are kept in a cache
+ * indexed by the (hash-consed) expressions, and variables, registers and
+ * the memory are z3 constants that need no declaration. */
+class ExprZ3Solver : public ExprSolver
+{
+private:
+  typedef std::unordered_map<Expr *, Z3_ast> TermCache;
+
+  Z3_context ctx;
+  Z3_solver solver;
+  TermCache terms;
+
+  ExprZ3Solver (const MicrocodeArchitecture *mca);
+
+  Z3_ast translate (const Expr *e, bool as_boolean)
+    throw (UnexpectedResponseException);
+  void clear_terms ();
+  void check_error (const std::string &where)
+    throw (UnexpectedResponseException);
+
+  friend class Expr2Z3Visitor;
+
+public:
+
+  static const std::string &ident ();
+
+  static void init (const ConfigTable &cfg)
+    throw (UnknownSolverException);
+
+  static void terminate ();
+
+  static ExprSolver *create (const MicrocodeArchitecture *mca)
+    throw (UnexpectedResponseException, UnknownSolverException);
+
+  virtual ~ExprZ3Solver ();
+
+  virtual void add_assertion (const Expr *e)
+    throw (UnexpectedResponseException);
+
+  virtual Result check_sat (const Expr *e, bool preserve)
+    throw (UnexpectedResponseException);
+
+  virtual Result check_sat ()
+    throw (UnexpectedResponseException);
+
+  virtual void push ()
+    throw (UnexpectedResponseException);
+
+  virtual void pop ()
+    throw (UnexpectedResponseException);
+
+  virtual Constant *get_value_of (const Expr *var)
+    throw (UnexpectedResponseException);
+};
+
+# endif /* INTEGRATED_Z3_SOLVER */
+
+#endif /* ! KERNEL_EXPRESSIONS_EXPRZ3SOLVER_HH */
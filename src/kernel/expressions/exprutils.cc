@@ -37,6 +37,7 @@
 #include <kernel/expressions/BottomUpApplyVisitor.hh>
 #include <kernel/expressions/BottomUpRewritePatternRule.hh>
 #include <kernel/Expressions.hh>
+#include <utils/unordered11.hh>
 
 using namespace exprutils;
 
@@ -199,3 +200,164 @@ exprutils::collect_memcell_indexes (const Expr *e)
 
   return result;
 }
+
+/* The atoms of an expression: its variables, registers and memory cells.
+ * Shared subterms are visited once. A cell at a constant address is
+ * represented by the byte cells it covers, which are kept in cells, and
+ * cells at addresses that are not constants, and formulas with
+ * quantifiers, are represented by NULL. */
+class AtomCollector : public ConstExprVisitor
+{
+public:
+  std::unordered_set<const Expr *> visited;
+  std::vector<const Expr *> atoms;
+  std::vector<Expr *> &cells;
+  bool memory;
+
+  AtomCollector (std::vector<Expr *> &cells)
+    : ConstExprVisitor (), visited (), atoms (), cells (cells),
+      memory (false) { }
+
+  void collect (const Expr *e) {
+    if (visited.insert (e).second)
+      e->acceptVisitor (*this);
+  }
+
+  virtual void visit (const RandomValue *e) { atoms.push_back (e); }
+  virtual void visit (const Variable *e) { atoms.push_back (e); }
+  virtual void visit (const RegisterExpr *e) { atoms.push_back (e); }
+  virtual void visit (const QuantifiedExpr *) { atoms.push_back (NULL); }
+  virtual void visit (const UnaryApp *e) { collect (e->get_arg1 ()); }
+
+  virtual void visit (const BinaryApp *e) {
+    collect (e->get_arg1 ());
+    collect (e->get_arg2 ());
+  }
+
+  virtual void visit (const TernaryApp *e) {
+    collect (e->get_arg1 ());
+    collect (e->get_arg2 ());
+    collect (e->get_arg3 ());
+  }
+
+  virtual void visit (const MemCell *e) {
+    const Constant *a = dynamic_cast<const Constant *> (e->get_addr ());
+
+    memory = true;
+    if (a != NULL)
+      {
+	int last = (e->get_bv_offset () + e->get_bv_size () - 1) / 8;
+
+	for (int i = e->get_bv_offset () / 8; i <= last; i++)
+	  {
+	    Constant *ba =
+	      Constant::create (a->get_val () + i, 0, a->get_bv_size ());
+	    cells.push_back (MemCell::create (ba, 0, 8));
+	    atoms.push_back (cells.back ());
+	  }
+      }
+    else
+      {
+	atoms.push_back (NULL);
+	collect (e->get_addr ());
+      }
+  }
+};
+
+static void
+s_flatten_conjunction (const Expr *cond, std::vector<const Expr *> &result)
+{
+  const BinaryApp *ba = dynamic_cast<const BinaryApp *> (cond);
+
+  if (ba != NULL && ba->get_op () == BV_OP_AND && ba->get_bv_size () == 1)
+    {
+      s_flatten_conjunction (ba->get_arg1 (), result);
+      s_flatten_conjunction (ba->get_arg2 (), result);
+    }
+  else if (! cond->is_TrueFormula ())
+    result.push_back (cond);
+}
+
+static std::size_t
+s_find (std::vector<std::size_t> &classes, std::size_t i)
+{
+  while (classes[i] != i)
+    i = classes[i] = classes[classes[i]];
+  return i;
+}
+
+Expr *
+exprutils::slice_conjunction (const Expr *cond, const Expr *e)
+{
+  std::vector<const Expr *> conjuncts;
+  s_flatten_conjunction (cond, conjuncts);
+
+  /* conjuncts that share an atom are in the same class */
+  std::vector<std::size_t> classes (conjuncts.size ());
+  std::vector<bool> ground (conjuncts.size (), false);
+  std::vector<bool> memory (conjuncts.size (), false);
+  std::unordered_map<const Expr *, std::size_t> owner;
+  std::vector<Expr *> cells;
+
+  for (std::size_t i = 0; i < conjuncts.size (); i++)
+    {
+      AtomCollector c (cells);
+      c.collect (conjuncts[i]);
+      classes[i] = i;
+      ground[i] = c.atoms.empty ();
+      memory[i] = c.memory;
+      for (std::size_t k = 0; k < c.atoms.size (); k++)
+	{
+	  std::unordered_map<const Expr *, std::size_t>::iterator o =
+	    owner.find (c.atoms[k]);
+	  if (o == owner.end ())
+	    owner[c.atoms[k]] = i;
+	  else
+	    classes[s_find (classes, i)] = s_find (classes, o->second);
+	}
+    }
+
+  /* a cell at an unknown address may be any of the other cells */
+  std::unordered_map<const Expr *, std::size_t>::iterator any =
+    owner.find (NULL);
+  if (any != owner.end ())
+    {
+      for (std::size_t i = 0; i < conjuncts.size (); i++)
+	if (memory[i])
+	  classes[s_find (classes, i)] = s_find (classes, any->second);
+    }
+
+  AtomCollector c (cells);
+  c.collect (e);
+  std::unordered_set<std::size_t> relevant;
+  for (std::size_t k = 0; k < c.atoms.size (); k++)
+    {
+      if (c.atoms[k] == NULL)
+	{
+	  for (std::size_t i = 0; i < conjuncts.size (); i++)
+	    if (memory[i])
+	      relevant.insert (s_find (classes, i));
+	}
+      std::unordered_map<const Expr *, std::size_t>::iterator o =
+	owner.find (c.atoms[k]);
+      if (o != owner.end ())
+	relevant.insert (s_find (classes, o->second));
+    }
+  for (std::size_t k = 0; k < cells.size (); k++)
+    cells[k]->deref ();
+
+  Expr *result = NULL;
+  for (std::size_t i = conjuncts.size (); i > 0; i--)
+    {
+      if (! ground[i - 1] &&
+	  relevant.find (s_find (classes, i - 1)) == relevant.end ())
+	continue;
+      Expr *a = conjuncts[i - 1]->ref ();
+      result = (result == NULL ? a : Expr::createLAnd (a, result));
+    }
+
+  if (result == NULL)
+    result = Constant::True ();
+
+  return result;
+}
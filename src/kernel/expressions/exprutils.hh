@@ -94,6 +94,16 @@ namespace exprutils
 
   extern std::vector<const Expr *> *
   collect_memcell_indexes (const Expr *e);
+
+  /* The conjuncts of cond that share a variable, a register or a memory
+   * cell with e, directly or through other conjuncts of the result.
+   * Memory cells share a byte when their addresses are constants, and a
+   * cell at an address that is not a constant is assumed to alias every
+   * other cell. If cond is satisfiable, e && cond is satisfiable
+   * if and only if e && slice_conjunction (cond, e) is, and both give
+   * the same values to the atoms of e. */
+  extern Expr *
+  slice_conjunction (const Expr *cond, const Expr *e);
 }
 
 # include <kernel/expressions/exprutils.ii>
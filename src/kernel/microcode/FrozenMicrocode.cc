@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FrozenMicrocode.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+
+using namespace std;
+
+const FrozenMicrocode::node_id FrozenMicrocode::NO_NODE;
+
+struct s_lt_address
+{
+  bool operator() (const MicrocodeAddress &a1,
+		   const MicrocodeAddress &a2) const {
+    return a1.lessThan (a2);
+  }
+};
+
+struct s_lt_first
+{
+  template<typename T>
+  bool operator() (const pair<uint32_t, T> &p, uint32_t id) const {
+    return p.first < id;
+  }
+};
+
+static Expr *
+s_ref (const Expr *e)
+{
+  return e == NULL ? NULL : e->ref ();
+}
+
+static void
+s_deref (Expr *e)
+{
+  if (e != NULL)
+    e->deref ();
+}
+
+FrozenMicrocode::FrozenMicrocode (const Microcode *mc)
+{
+  vector<MicrocodeNode *> nodes (mc->begin_nodes (), mc->end_nodes ());
+  sort (nodes.begin (), nodes.end (), MicrocodeNode::lt_node ());
+
+  size_t nb_arrows = 0;
+  addresses.reserve (nodes.size ());
+  for (vector<MicrocodeNode *>::const_iterator n = nodes.begin ();
+       n != nodes.end (); n++)
+    {
+      addresses.push_back ((*n)->get_loc ());
+      nb_arrows += (*n)->get_successors ()->size ();
+    }
+  assert (nb_arrows < (size_t) NO_NODE);
+
+  entry_point = find_node (mc->entry_point ());
+
+  succ_offsets.reserve (nodes.size () + 1);
+  arrows.reserve (nb_arrows);
+  pred_offsets.assign (nodes.size () + 1, 0);
+
+  for (node_id i = 0; i < nodes.size (); i++)
+    {
+      succ_offsets.push_back (arrows.size ());
+      MicrocodeNode_iterate_successors (*nodes[i], succ)
+	{
+	  StmtArrow *a = *succ;
+	  Statement *st = a->get_stmt ();
+	  Arrow r;
+
+	  r.src = i;
+	  r.tgt = NO_NODE;
+	  if (a->is_static ())
+	    r.tgt = find_node (((StaticArrow *) a)->get_target ());
+	  r.guard = s_ref (a->get_condition ());
+	  r.e1 = r.e2 = NULL;
+
+	  if (st->is_Assignment ())
+	    {
+	      Assignment *as = (Assignment *) st;
+	      r.kind = ASSIGNMENT;
+	      r.e1 = s_ref (as->get_lval ());
+	      r.e2 = s_ref (as->get_rval ());
+	    }
+	  else if (st->is_Jump ())
+	    {
+	      r.kind = JUMP;
+	      r.e1 = s_ref (((Jump *) st)->get_target ());
+	    }
+	  else if (st->is_External ())
+	    {
+	      r.kind = EXTERNAL;
+	      externals.push_back (make_pair (arrows.size (),
+					      ((External *) st)->get_id ()));
+	    }
+	  else
+	    {
+	      r.kind = SKIP;
+	    }
+
+	  if (a->is_annotated ())
+	    arrow_annotations.push_back (make_pair (arrows.size (),
+						    new Annotable (*a)));
+	  if (r.tgt != NO_NODE)
+	    pred_offsets[r.tgt + 1]++;
+	  arrows.push_back (r);
+	}
+
+      if (nodes[i]->is_annotated ())
+	node_annotations.push_back (make_pair (i, new Annotable (*nodes[i])));
+    }
+  succ_offsets.push_back (arrows.size ());
+
+  for (size_t i = 1; i < pred_offsets.size (); i++)
+    pred_offsets[i] += pred_offsets[i - 1];
+
+  vector<uint32_t> fill (pred_offsets.begin (), pred_offsets.end () - 1);
+  pred_arrows.resize (pred_offsets.back ());
+  for (arrow_id a = 0; a < arrows.size (); a++)
+    if (arrows[a].tgt != NO_NODE)
+      pred_arrows[fill[arrows[a].tgt]++] = a;
+}
+
+FrozenMicrocode::~FrozenMicrocode ()
+{
+  for (vector<Arrow>::iterator a = arrows.begin (); a != arrows.end (); a++)
+    {
+      s_deref (a->guard);
+      s_deref (a->e1);
+      s_deref (a->e2);
+    }
+  for (annotations_type::iterator i = node_annotations.begin ();
+       i != node_annotations.end (); i++)
+    delete i->second;
+  for (annotations_type::iterator i = arrow_annotations.begin ();
+       i != arrow_annotations.end (); i++)
+    delete i->second;
+}
+
+size_t
+FrozenMicrocode::get_number_of_nodes () const
+{
+  return addresses.size ();
+}
+
+size_t
+FrozenMicrocode::get_number_of_arrows () const
+{
+  return arrows.size ();
+}
+
+FrozenMicrocode::node_id
+FrozenMicrocode::get_entry_point () const
+{
+  return entry_point;
+}
+
+FrozenMicrocode::node_id
+FrozenMicrocode::find_node (const MicrocodeAddress &a) const
+{
+  vector<MicrocodeAddress>::const_iterator i =
+    lower_bound (addresses.begin (), addresses.end (), a, s_lt_address ());
+
+  if (i == addresses.end () || ! i->equals (a))
+    return NO_NODE;
+  return i - addresses.begin ();
+}
+
+const MicrocodeAddress &
+FrozenMicrocode::get_address (node_id n) const
+{
+  assert (n < addresses.size ());
+  return addresses[n];
+}
+
+FrozenMicrocode::arrow_iterator
+FrozenMicrocode::successors_begin (node_id n) const
+{
+  assert (n < addresses.size ());
+  return arrows.data () + succ_offsets[n];
+}
+
+FrozenMicrocode::arrow_iterator
+FrozenMicrocode::successors_end (node_id n) const
+{
+  assert (n < addresses.size ());
+  return arrows.data () + succ_offsets[n + 1];
+}
+
+size_t
+FrozenMicrocode::get_number_of_successors (node_id n) const
+{
+  return successors_end (n) - successors_begin (n);
+}
+
+FrozenMicrocode::pred_iterator
+FrozenMicrocode::predecessors_begin (node_id n) const
+{
+  assert (n < addresses.size ());
+  return pred_arrows.data () + pred_offsets[n];
+}
+
+FrozenMicrocode::pred_iterator
+FrozenMicrocode::predecessors_end (node_id n) const
+{
+  assert (n < addresses.size ());
+  return pred_arrows.data () + pred_offsets[n + 1];
+}
+
+size_t
+FrozenMicrocode::get_number_of_predecessors (node_id n) const
+{
+  return predecessors_end (n) - predecessors_begin (n);
+}
+
+const FrozenMicrocode::Arrow &
+FrozenMicrocode::get_arrow (arrow_id a) const
+{
+  assert (a < arrows.size ());
+  return arrows[a];
+}
+
+FrozenMicrocode::arrow_id
+FrozenMicrocode::get_arrow_id (const Arrow &a) const
+{
+  assert (arrows.data () <= &a && &a < arrows.data () + arrows.size ());
+  return &a - arrows.data ();
+}
+
+bool
+FrozenMicrocode::is_dynamic (const Arrow &a) const
+{
+  return a.tgt == NO_NODE;
+}
+
+const LValue *
+FrozenMicrocode::get_lval (const Arrow &a) const
+{
+  assert (a.kind == ASSIGNMENT);
+  return (const LValue *) a.e1;
+}
+
+const Expr *
+FrozenMicrocode::get_rval (const Arrow &a) const
+{
+  assert (a.kind == ASSIGNMENT);
+  return a.e2;
+}
+
+const Expr *
+FrozenMicrocode::get_jump_target (const Arrow &a) const
+{
+  assert (a.kind == JUMP);
+  return a.e1;
+}
+
+const string &
+FrozenMicrocode::get_external_id (const Arrow &a) const
+{
+  assert (a.kind == EXTERNAL);
+  vector<pair<arrow_id, string> >::const_iterator i =
+    lower_bound (externals.begin (), externals.end (), get_arrow_id (a),
+		 s_lt_first ());
+  assert (i != externals.end () && i->first == get_arrow_id (a));
+
+  return i->second;
+}
+
+const Annotable *
+FrozenMicrocode::s_find (const annotations_type &v, uint32_t id)
+{
+  annotations_type::const_iterator i =
+    lower_bound (v.begin (), v.end (), id, s_lt_first ());
+
+  if (i == v.end () || i->first != id)
+    return NULL;
+  return i->second;
+}
+
+const Annotable *
+FrozenMicrocode::get_node_annotations (node_id n) const
+{
+  return s_find (node_annotations, n);
+}
+
+const Annotable *
+FrozenMicrocode::get_arrow_annotations (arrow_id a) const
+{
+  return s_find (arrow_annotations, a);
+}
+
+size_t
+FrozenMicrocode::get_memory_size () const
+{
+  return (sizeof (*this) +
+	  addresses.capacity () * sizeof (MicrocodeAddress) +
+	  succ_offsets.capacity () * sizeof (uint32_t) +
+	  arrows.capacity () * sizeof (Arrow) +
+	  pred_offsets.capacity () * sizeof (uint32_t) +
+	  pred_arrows.capacity () * sizeof (arrow_id) +
+	  externals.capacity () * sizeof (externals[0]) +
+	  node_annotations.capacity () * sizeof (node_annotations[0]) +
+	  arrow_annotations.capacity () * sizeof (arrow_annotations[0]));
+}
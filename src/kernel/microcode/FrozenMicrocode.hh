@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef KERNEL_MICROCODE_FROZEN_MICROCODE_HH
+#define KERNEL_MICROCODE_FROZEN_MICROCODE_HH
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <kernel/Annotable.hh>
+#include <kernel/microcode/MicrocodeAddress.hh>
+
+class Expr;
+class LValue;
+class Microcode;
+
+/*****************************************************************************/
+/*! \brief Immutable view of a Microcode program.
+ *
+ *  Nodes are sorted by address and identified by their index. Arrows
+ *  are stored contiguously, grouped by source node, so that the
+ *  successors of node n are the arrows [succ_offsets[n],
+ *  succ_offsets[n+1]) (compressed sparse rows). Predecessors are
+ *  indexed the same way through a second array of arrow ids. The
+ *  view holds its own references on expressions and its own copies of
+ *  annotations; thus the Microcode it has been built from may be
+ *  deleted. */
+/*****************************************************************************/
+class FrozenMicrocode
+{
+public:
+  typedef uint32_t node_id;
+  typedef uint32_t arrow_id;
+
+  /*! \brief Target of dynamic arrows and result of unsuccessful
+   * lookups. */
+  static const node_id NO_NODE = (node_id) -1;
+
+  enum StatementKind { ASSIGNMENT, SKIP, JUMP, EXTERNAL };
+
+  struct Arrow
+  {
+    node_id src;
+    /*! \brief NO_NODE for dynamic jumps */
+    node_id tgt;
+    StatementKind kind;
+    Expr *guard;
+    /*! \brief lvalue of an assignment, target of a jump */
+    Expr *e1;
+    /*! \brief rvalue of an assignment */
+    Expr *e2;
+  };
+
+  typedef const Arrow *arrow_iterator;
+  typedef const arrow_id *pred_iterator;
+
+  FrozenMicrocode (const Microcode *mc);
+  ~FrozenMicrocode ();
+
+  std::size_t get_number_of_nodes () const;
+  std::size_t get_number_of_arrows () const;
+
+  /*! \brief id of the entry point, NO_NODE if the program has none */
+  node_id get_entry_point () const;
+
+  /*! \brief binary search in the address index; NO_NODE if there is
+   * no node at address a. */
+  node_id find_node (const MicrocodeAddress &a) const;
+  const MicrocodeAddress &get_address (node_id n) const;
+
+  arrow_iterator successors_begin (node_id n) const;
+  arrow_iterator successors_end (node_id n) const;
+  std::size_t get_number_of_successors (node_id n) const;
+  pred_iterator predecessors_begin (node_id n) const;
+  pred_iterator predecessors_end (node_id n) const;
+  std::size_t get_number_of_predecessors (node_id n) const;
+
+  const Arrow &get_arrow (arrow_id a) const;
+  arrow_id get_arrow_id (const Arrow &a) const;
+  bool is_dynamic (const Arrow &a) const;
+  const LValue *get_lval (const Arrow &a) const;
+  const Expr *get_rval (const Arrow &a) const;
+  const Expr *get_jump_target (const Arrow &a) const;
+  const std::string &get_external_id (const Arrow &a) const;
+
+  /*! \brief annotations of the node or of the arrow; NULL if it has
+   * none. */
+  const Annotable *get_node_annotations (node_id n) const;
+  const Annotable *get_arrow_annotations (arrow_id a) const;
+
+  /*! \brief number of bytes used by the view, expressions and
+   * annotations excluded. */
+  std::size_t get_memory_size () const;
+
+private:
+  FrozenMicrocode (const FrozenMicrocode &);
+  FrozenMicrocode &operator= (const FrozenMicrocode &);
+
+  typedef std::vector<std::pair<uint32_t, Annotable *> > annotations_type;
+
+  static const Annotable *s_find (const annotations_type &v, uint32_t id);
+
+  node_id entry_point;
+  std::vector<MicrocodeAddress> addresses;
+  std::vector<uint32_t> succ_offsets;
+  std::vector<Arrow> arrows;
+  std::vector<uint32_t> pred_offsets;
+  std::vector<arrow_id> pred_arrows;
+  std::vector<std::pair<arrow_id, std::string> > externals;
+  annotations_type node_annotations;
+  annotations_type arrow_annotations;
+};
+
+#endif /* KERNEL_MICROCODE_FROZEN_MICROCODE_HH */
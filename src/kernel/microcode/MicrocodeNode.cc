@@ -275,7 +275,7 @@ bool MicrocodeNode::operator<(const MicrocodeNode &e) const
 /**********************************************************************/
 
 StmtArrow::StmtArrow(MicrocodeNode *src, Statement *stmt,
-		     const AnnotationMap *annotations, Expr *condition) :
+		     const Annotable *annotations, Expr *condition) :
   Annotable(annotations),
   src(src),
   stmt(stmt),
@@ -397,7 +397,7 @@ string DynamicArrow::pp () const
 }
 
 StaticArrow::StaticArrow(MicrocodeNode * src, MicrocodeNode * tgt,
-			 Statement *stmt, const AnnotationMap *annotations,
+			 Statement *stmt, const Annotable *annotations,
 			 Expr *condition) :
   StmtArrow(src, stmt, annotations, condition),
   tgt(tgt)
@@ -474,7 +474,7 @@ string StaticArrow::pp() const
 
 DynamicArrow::DynamicArrow(MicrocodeNode *src,
 			   Expr *target, Statement *stmt,
-			   const AnnotationMap *annotations, Expr *condition) :
+			   const Annotable *annotations, Expr *condition) :
   StmtArrow(src, stmt, annotations, condition),
   target(target)
 {
@@ -148,7 +148,7 @@ protected:
 public:
   StmtArrow(MicrocodeNode * origin,
             Statement *stmt,
-            const AnnotationMap * annotations = 0,
+            const Annotable * annotations = 0,
             Expr * condition = 0);
 
   StmtArrow(const StmtArrow & arr);
@@ -201,7 +201,7 @@ public:
   StaticArrow(MicrocodeNode *src,
               MicrocodeNode *tgt,
               Statement *stmt,
-              const AnnotationMap *annotations = 0,
+              const Annotable *annotations = 0,
               Expr *condition = 0);
 
   StaticArrow(const StaticArrow &other);
@@ -237,7 +237,7 @@ public:
   DynamicArrow(MicrocodeNode *origin,
                Expr *target,
                Statement *stmt,
-               const AnnotationMap *annotations = 0,
+               const Annotable *annotations = 0,
                Expr *condition = 0);
 
   DynamicArrow(const DynamicArrow &other);
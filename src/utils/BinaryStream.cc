@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "BinaryStream.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+BinaryWriter::BinaryWriter (ostream &out) : out (out)
+{
+}
+
+BinaryWriter::~BinaryWriter ()
+{
+}
+
+void
+BinaryWriter::write_byte (uint8_t b)
+{
+  out.put ((char) b);
+}
+
+void
+BinaryWriter::write_bool (bool b)
+{
+  write_byte (b ? 1 : 0);
+}
+
+void
+BinaryWriter::write_uint (uint64_t v)
+{
+  while (v >= 0x80)
+    {
+      write_byte ((uint8_t) (v & 0x7f) | 0x80);
+      v >>= 7;
+    }
+  write_byte ((uint8_t) v);
+}
+
+void
+BinaryWriter::write_int (int64_t v)
+{
+  write_uint (((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+void
+BinaryWriter::write_string (const string &s)
+{
+  write_uint (s.size ());
+  out.write (s.data (), s.size ());
+}
+
+void
+BinaryWriter::write_bytes (const void *buf, size_t len)
+{
+  out.write ((const char *) buf, len);
+}
+
+ostream &
+BinaryWriter::get_stream () const
+{
+  return out;
+}
+
+BinaryReader::BinaryReader (const char *data, size_t size)
+  : data ((const uint8_t *) data), size (size), pos (0)
+{
+}
+
+BinaryReader::~BinaryReader ()
+{
+}
+
+uint8_t
+BinaryReader::read_byte ()
+  throw (Exception)
+{
+  if (pos >= size)
+    throw Exception ("unexpected end of binary data");
+
+  return data[pos++];
+}
+
+bool
+BinaryReader::read_bool ()
+  throw (Exception)
+{
+  uint8_t b = read_byte ();
+
+  if (b > 1)
+    throw Exception ("invalid boolean in binary data");
+
+  return b == 1;
+}
+
+uint64_t
+BinaryReader::read_uint ()
+  throw (Exception)
+{
+  uint64_t result = 0;
+
+  for (int shift = 0; shift < 64; shift += 7)
+    {
+      uint8_t b = read_byte ();
+
+      result |= (uint64_t) (b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+	return result;
+    }
+  throw Exception ("integer overflow in binary data");
+}
+
+int64_t
+BinaryReader::read_int ()
+  throw (Exception)
+{
+  uint64_t v = read_uint ();
+
+  return (int64_t) ((v >> 1) ^ (~(v & 1) + 1));
+}
+
+string
+BinaryReader::read_string ()
+  throw (Exception)
+{
+  uint64_t len = read_uint ();
+
+  if (len > size - pos)
+    throw Exception ("unexpected end of binary data");
+
+  string result ((const char *) data + pos, len);
+  pos += len;
+
+  return result;
+}
+
+void
+BinaryReader::read_bytes (void *buf, size_t len)
+  throw (Exception)
+{
+  if (len > size - pos)
+    throw Exception ("unexpected end of binary data");
+  memcpy (buf, data + pos, len);
+  pos += len;
+}
+
+size_t
+BinaryReader::get_position () const
+{
+  return pos;
+}
+
+bool
+BinaryReader::at_end () const
+{
+  return pos == size;
+}
+
+MappedFile::MappedFile (const string &filename)
+  throw (BinaryReader::Exception)
+  : data (NULL), size (0)
+{
+  int fd = open (filename.c_str (), O_RDONLY);
+  struct stat st;
+
+  if (fd < 0)
+    throw BinaryReader::Exception ("can't open '" + filename + "': " +
+				   strerror (errno));
+  if (fstat (fd, &st) < 0)
+    {
+      string why = strerror (errno);
+      close (fd);
+      throw BinaryReader::Exception ("can't stat '" + filename + "': " + why);
+    }
+
+  size = st.st_size;
+  /* mmap refuses empty mappings; an empty file is left to the reader
+   * which will report it as truncated. */
+  if (size > 0)
+    {
+      data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+	{
+	  string why = strerror (errno);
+	  data = NULL;
+	  close (fd);
+	  throw BinaryReader::Exception ("can't map '" + filename + "': " +
+					 why);
+	}
+    }
+  close (fd);
+}
+
+MappedFile::~MappedFile ()
+{
+  if (data != NULL)
+    munmap (data, size);
+}
+
+const char *
+MappedFile::get_data () const
+{
+  return (const char *) data;
+}
+
+size_t
+MappedFile::get_size () const
+{
+  return size;
+}
+
+bool
+read_binary_file (const string &filename, string &result)
+{
+  ifstream in (filename.c_str (), ios::in | ios::binary);
+
+  if (! in.is_open ())
+    return false;
+
+  ostringstream oss;
+  oss << in.rdbuf ();
+  result = oss.str ();
+
+  return ! in.bad ();
+}
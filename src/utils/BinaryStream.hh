@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef UTILS_BINARYSTREAM_HH
+# define UTILS_BINARYSTREAM_HH
+
+# include <inttypes.h>
+# include <cstddef>
+# include <iostream>
+# include <stdexcept>
+# include <string>
+
+/*! \brief Output of integers and strings in a compact, machine-independent
+ *  binary form. Unsigned integers are LEB128-encoded; signed ones are first
+ *  zigzag-mapped so that small negative values stay short. */
+class BinaryWriter
+{
+public:
+  BinaryWriter (std::ostream &out);
+  virtual ~BinaryWriter ();
+
+  void write_byte (uint8_t b);
+  void write_bool (bool b);
+  void write_uint (uint64_t v);
+  void write_int (int64_t v);
+  void write_string (const std::string &s);
+  void write_bytes (const void *buf, std::size_t len);
+
+  std::ostream &get_stream () const;
+
+protected:
+  std::ostream &out;
+};
+
+/*! \brief Reader of the data produced by BinaryWriter. The reader works on
+ *  a memory buffer that must outlive it; every access is bounds-checked and
+ *  a malformed or truncated input raises a BinaryReader::Exception. */
+class BinaryReader
+{
+public:
+  class Exception : public std::runtime_error {
+  public:
+    Exception (const std::string &why) : std::runtime_error (why) { }
+  };
+
+  BinaryReader (const char *data, std::size_t size);
+  virtual ~BinaryReader ();
+
+  uint8_t read_byte () throw (Exception);
+  bool read_bool () throw (Exception);
+  uint64_t read_uint () throw (Exception);
+  int64_t read_int () throw (Exception);
+  std::string read_string () throw (Exception);
+  void read_bytes (void *buf, std::size_t len) throw (Exception);
+
+  std::size_t get_position () const;
+  bool at_end () const;
+
+private:
+  const uint8_t *data;
+  std::size_t size;
+  std::size_t pos;
+};
+
+/*! \brief Read-only mapping of a whole file in memory. Pages are loaded on
+ *  demand by the system, so large files are read without being copied. */
+class MappedFile
+{
+public:
+  MappedFile (const std::string &filename) throw (BinaryReader::Exception);
+  ~MappedFile ();
+
+  const char *get_data () const;
+  std::size_t get_size () const;
+
+private:
+  MappedFile (const MappedFile &);
+  MappedFile &operator= (const MappedFile &);
+
+  void *data;
+  std::size_t size;
+};
+
+/*! \brief Load the whole content of the file 'filename' into 'result'.
+ *  Return false if the file cannot be read. */
+extern bool
+read_binary_file (const std::string &filename, std::string &result);
+
+#endif /* ! UTILS_BINARYSTREAM_HH */
@@ -0,0 +1,136 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef UTILS_PAGEDMAP_HH
+#define UTILS_PAGEDMAP_HH
+
+#include <stdint.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <kernel/Architecture.hh>
+
+/**
+ * \brief Map from addresses to values stored by pages of PAGE_SIZE
+ *  consecutive addresses.
+ *
+ *  Copies share their pages; a page is copied only when one of its
+ *  values is set while it is shared (copy-on-write). Copying a map hence
+ *  costs the size of its page table, and each copy only owns the pages
+ *  written since then. Values are enumerated by increasing addresses.
+ */
+template <typename V>
+class PagedMap
+{
+public:
+  static const int PAGE_BITS = 8;
+  static const address_t PAGE_SIZE = 1 << PAGE_BITS;
+
+  class const_iterator;
+
+  PagedMap ();
+  PagedMap (const PagedMap<V> &other);
+  PagedMap<V> &operator= (const PagedMap<V> &other);
+  ~PagedMap ();
+
+  /** \brief The value at address a or NULL if a is not defined. */
+  const V *find (address_t a) const;
+
+  /** \brief Set the value at address a. If a was already defined, its
+   *  former value is copied into *old (if old is not NULL) and true is
+   *  returned. */
+  bool put (address_t a, const V &v, V *old = NULL);
+
+  /** \brief Undefine all addresses. */
+  void clear ();
+
+  /** \brief Number of defined addresses. */
+  std::size_t size () const;
+
+  /** \brief Number of pages, and number of them that are shared with
+   *  other maps. */
+  std::size_t get_number_of_pages () const;
+  std::size_t get_number_of_shared_pages () const;
+
+  const_iterator begin () const;
+  const_iterator end () const;
+
+private:
+  struct Page
+  {
+    Page ();
+    Page (const Page &other);
+
+    int refcount;
+    uint64_t defined[PAGE_SIZE / 64];
+    V values[PAGE_SIZE];
+
+    bool is_defined (address_t offset) const;
+  };
+
+  typedef std::vector<std::pair<address_t, Page *> > PageTable;
+
+  /* index in pages of the page of a, or of the place where it goes */
+  std::size_t lookup (address_t page) const;
+  void release ();
+
+  PageTable pages;
+  std::size_t nb_values;
+
+public:
+  class const_iterator
+  {
+  public:
+    typedef std::pair<address_t, V> value_type;
+
+    const_iterator ();
+    const_iterator (const PageTable *pages, std::size_t page, address_t offset);
+
+    const value_type &operator* () const;
+    const value_type *operator-> () const;
+    const_iterator &operator++ ();
+    const_iterator operator++ (int);
+    bool operator== (const const_iterator &other) const;
+    bool operator!= (const const_iterator &other) const;
+
+  private:
+    /* move to the first defined address from the current position */
+    void skip_undefined ();
+
+    const PageTable *pages;
+    std::size_t page;
+    address_t offset;
+    value_type current;
+  };
+};
+
+#include <utils/PagedMap.ii>
+
+#endif /* ! UTILS_PAGEDMAP_HH */
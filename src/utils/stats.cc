@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stats.hh"
+
+#include <ctime>
+#include <iomanip>
+#include <map>
+
+using namespace std;
+
+/* Maximal number of samples kept by a series */
+#define SERIES_MAX_SIZE 4096
+
+static vector<stats::Counter *> &
+s_counters ()
+{
+  static vector<stats::Counter *> result;
+
+  return result;
+}
+
+static vector<stats::Timer *> &
+s_timers ()
+{
+  static vector<stats::Timer *> result;
+
+  return result;
+}
+
+static vector<stats::Series *> &
+s_series ()
+{
+  static vector<stats::Series *> result;
+
+  return result;
+}
+
+static unsigned long long
+s_time_of (const stats::Counter *)
+{
+  return 0;
+}
+
+static unsigned long long
+s_time_of (const stats::Timer *t)
+{
+  return t->get_time ();
+}
+
+unsigned long long
+stats::now ()
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const unsigned long long ORIGIN = stats::now ();
+
+stats::Counter::Counter (const char *name)
+  : name (name), count (0)
+{
+  s_counters ().push_back (this);
+}
+
+stats::Timer::Timer (const char *name)
+  : name (name), count (0), time (0)
+{
+  s_timers ().push_back (this);
+}
+
+stats::Series::Series (const char *name, const char *cols)
+  : name (name), columns (), samples (), period (1), skipped (0)
+{
+  string c (cols);
+  string::size_type pos = 0;
+  string::size_type comma;
+
+  while ((comma = c.find (',', pos)) != string::npos)
+    {
+      columns.push_back (c.substr (pos, comma - pos));
+      pos = comma + 1;
+    }
+  columns.push_back (c.substr (pos));
+  s_series ().push_back (this);
+}
+
+void
+stats::Series::add (const vector<double> &values)
+{
+  if (++skipped < period)
+    return;
+  skipped = 0;
+
+  if (samples.size () == SERIES_MAX_SIZE)
+    {
+      for (size_t i = 0; i < SERIES_MAX_SIZE / 2; i++)
+	samples[i] = samples[2 * i + 1];
+      samples.resize (SERIES_MAX_SIZE / 2);
+      period *= 2;
+    }
+
+  samples.push_back (vector<double> ());
+  samples.back ().push_back ((now () - ORIGIN) / 1e9);
+  samples.back ().insert (samples.back ().end (), values.begin (),
+			  values.end ());
+}
+
+/* Counters and timers declared in templates exist once per instantiation;
+ * those sharing a name are summed up in the output. */
+template<typename T>
+static void
+s_merge (const vector<T *> &items, vector<string> &names,
+	 map<string, pair<unsigned long long, unsigned long long> > &values)
+{
+  for (typename vector<T *>::const_iterator i = items.begin ();
+       i != items.end (); i++)
+    {
+      string name ((*i)->get_name ());
+
+      if (values.find (name) == values.end ())
+	names.push_back (name);
+      values[name].first += (*i)->get_count ();
+      values[name].second += s_time_of (*i);
+    }
+}
+
+void
+stats::output_json (ostream &out)
+{
+  ios::fmtflags flags = out.flags ();
+  vector<string> names;
+  map<string, pair<unsigned long long, unsigned long long> > values;
+
+  s_merge (s_counters (), names, values);
+  out << dec << "{" << endl << "  \"counters\": {";
+  for (size_t i = 0; i < names.size (); i++)
+    out << (i == 0 ? "" : ",") << endl
+	<< "    \"" << names[i] << "\": " << values[names[i]].first;
+
+  names.clear ();
+  values.clear ();
+  s_merge (s_timers (), names, values);
+  out << endl << "  }," << endl << "  \"timers\": {";
+  for (size_t i = 0; i < names.size (); i++)
+    out << (i == 0 ? "" : ",") << endl
+	<< "    \"" << names[i] << "\": { \"calls\": "
+	<< values[names[i]].first << ", \"seconds\": " << fixed
+	<< setprecision (6) << values[names[i]].second / 1e9 << " }";
+
+  map<string, vector<const Series *> > series;
+  names.clear ();
+  for (size_t i = 0; i < s_series ().size (); i++)
+    {
+      const Series *s = s_series ()[i];
+
+      if (series.find (s->get_name ()) == series.end ())
+	names.push_back (s->get_name ());
+      series[s->get_name ()].push_back (s);
+    }
+
+  out << endl << "  }," << endl << "  \"series\": {";
+  for (size_t i = 0; i < names.size (); i++)
+    {
+      const vector<const Series *> &parts = series[names[i]];
+      const vector<string> &columns = parts.front ()->get_columns ();
+      bool first = true;
+
+      out << (i == 0 ? "" : ",") << endl
+	  << "    \"" << names[i] << "\": {" << endl
+	  << "      \"columns\": [\"seconds\"";
+      for (size_t c = 0; c < columns.size (); c++)
+	out << ", \"" << columns[c] << "\"";
+      out << "]," << endl << "      \"samples\": [";
+      for (size_t p = 0; p < parts.size (); p++)
+	{
+	  const vector<vector<double> > &samples = parts[p]->get_samples ();
+
+	  for (size_t j = 0; j < samples.size (); j++)
+	    {
+	      out << (first ? "" : ",") << endl << "        [";
+	      first = false;
+	      for (size_t c = 0; c < samples[j].size (); c++)
+		out << (c == 0 ? "" : ", ") << setprecision (c == 0 ? 6 : 0)
+		    << samples[j][c];
+	      out << "]";
+	    }
+	}
+      out << endl << "      ]" << endl << "    }";
+    }
+  out << endl << "  }" << endl << "}" << endl;
+  out.flags (flags);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UTILS_STATS_HH
+# define UTILS_STATS_HH
+
+# include <cstddef>
+# include <iostream>
+# include <string>
+# include <vector>
+
+/*! \brief Always-on profiling counters. Counters and timers are meant to be
+ *  declared as static objects; they register themselves when constructed
+ *  and their values are dumped altogether by output_json (). The cost of a
+ *  measure is an increment or two reads of a monotonic clock. */
+namespace stats
+{
+  /*! \brief Current value of a monotonic clock in nanoseconds. */
+  extern unsigned long long now ();
+
+  class Counter {
+  public:
+    Counter (const char *name);
+
+    void inc () { count++; }
+    void add (unsigned long long n) { count += n; }
+
+    const char *get_name () const { return name; }
+    unsigned long long get_count () const { return count; }
+
+  private:
+    const char *name;
+    unsigned long long count;
+  };
+
+  /*! \brief Number of calls of a code section and time spent in it. */
+  class Timer {
+  public:
+    Timer (const char *name);
+
+    void add (unsigned long long nanoseconds) {
+      count++;
+      time += nanoseconds;
+    }
+
+    const char *get_name () const { return name; }
+    unsigned long long get_count () const { return count; }
+    unsigned long long get_time () const { return time; }
+
+  private:
+    const char *name;
+    unsigned long long count;
+    unsigned long long time;
+  };
+
+  /*! \brief Measure the lifetime of the object with a Timer. */
+  class Scope {
+  public:
+    Scope (Timer &timer) : timer (timer), start (now ()) { }
+    ~Scope () { timer.add (now () - start); }
+
+  private:
+    Timer &timer;
+    unsigned long long start;
+  };
+
+  /*! \brief Time series of some values indexed by the time elapsed since
+   *  the start of the program. To bound the memory used by long runs,
+   *  the series keeps one sample out of two each time it is full and
+   *  then ignores one sample out of two from then on. */
+  class Series {
+  public:
+    /*! \brief 'columns' is the comma-separated list of the names of the
+     *  values of each sample. */
+    Series (const char *name, const char *columns);
+
+    void add (const std::vector<double> &values);
+
+    const char *get_name () const { return name; }
+    const std::vector<std::string> &get_columns () const { return columns; }
+    const std::vector<std::vector<double> > &get_samples () const {
+      return samples;
+    }
+
+  private:
+    const char *name;
+    std::vector<std::string> columns;
+    std::vector<std::vector<double> > samples;
+    std::size_t period;
+    std::size_t skipped;
+  };
+
+  /*! \brief Write every counter, timer and series in JSON format. As for
+   *  timers, the samples of series sharing a name are put together. */
+  extern void output_json (std::ostream &out);
+}
+
+#endif /* ! UTILS_STATS_HH */
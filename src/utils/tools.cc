@@ -34,6 +34,8 @@
 #include <sstream>
 #include <string>
 
+#include <sys/resource.h>
+
 using namespace std;
 
 string itos(int i)
@@ -42,3 +44,31 @@ string itos(int i)
   s << i;
   return s.str();
 }
+
+size_t hash_mix(size_t h)
+{
+  /* Finalizer of MurmurHash3 (64-bit version, truncated if needed). */
+  unsigned long long x = h;
+
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+
+  return (size_t) x;
+}
+
+size_t get_max_rss_kb()
+{
+  struct rusage ru;
+
+  if (getrusage (RUSAGE_SELF, &ru) != 0)
+    return 0;
+#ifdef __APPLE__
+  /* Darwin reports the size in bytes */
+  return ru.ru_maxrss / 1024;
+#else
+  return ru.ru_maxrss;
+#endif
+}
@@ -31,6 +31,7 @@
 #ifndef UTILS_TOOLS_H
 #define UTILS_TOOLS_H
 
+#include <cstddef>
 #include <string>
 
 #define STATIC_ARRAY_COUNT(array) (sizeof (array) / sizeof (array)[0])
@@ -38,4 +39,13 @@
 /** \brief Convert an int to a string (cf. 'itoa()') */
 std::string itos(int i);
 
+/** \brief Scramble the bits of a hash value. Used to build hash values
+ *  that are combined by addition (e.g. incremental hashes of maps) where
+ *  two cells differing only slightly must not cancel each other. */
+std::size_t hash_mix(std::size_t h);
+
+/** \brief Peak resident set size of the process in kilobytes, or 0 if it
+ *  can not be obtained. */
+std::size_t get_max_rss_kb();
+
 #endif /* UTILS_TOOLS_H */
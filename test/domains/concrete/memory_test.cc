@@ -124,8 +124,132 @@ ATF_TEST_CASE_BODY(concretememory_memcells)
   insight::terminate ();
 }
 
+ATF_TEST_CASE(concretememory_hashcode)
+ATF_TEST_CASE_HEAD(concretememory_hashcode)
+{
+  set_md_var("descr",
+	     "Check the incremental hash of ConcreteMemory objects");
+}
+ATF_TEST_CASE_BODY(concretememory_hashcode)
+{
+  ConfigTable ct;
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+
+  const Architecture * arch_x86 =
+    Architecture::getArchitecture(Architecture::X86_32);
+  const RegisterDesc * eax = arch_x86->get_register("eax");
+  const RegisterDesc * ebx = arch_x86->get_register("ebx");
+
+  ConcreteMemory * m1 = new ConcreteMemory();
+  ConcreteMemory * m2 = new ConcreteMemory();
+
+  /* Same contents written in different orders */
+  m1->put(ConcreteAddress(1024), ConcreteValue(32, 6235),
+	  Architecture::LittleEndian);
+  m1->put(ConcreteAddress(2048), ConcreteValue(16, 42),
+	  Architecture::LittleEndian);
+  m1->put(eax, ConcreteValue(32, 1));
+  m1->put(ebx, ConcreteValue(32, 2));
+
+  m2->put(ebx, ConcreteValue(32, 2));
+  m2->put(ConcreteAddress(2048), ConcreteValue(16, 42),
+	  Architecture::LittleEndian);
+  m2->put(eax, ConcreteValue(32, 1));
+  m2->put(ConcreteAddress(1024), ConcreteValue(32, 6235),
+	  Architecture::LittleEndian);
+
+  ATF_REQUIRE_EQ(m1->hashcode(), m2->hashcode());
+  ATF_REQUIRE(m1->equals(*m2));
+
+  /* Overwriting a cell or a register updates the hash */
+  m2->put(ConcreteAddress(1024), ConcreteValue(8, 0),
+	  Architecture::LittleEndian);
+  m2->put(eax, ConcreteValue(32, 3));
+  ATF_REQUIRE(! m1->equals(*m2));
+
+  /* Restoring the original values gives back the original hash */
+  m2->put(ConcreteAddress(1024), ConcreteValue(32, 6235),
+	  Architecture::LittleEndian);
+  m2->put(eax, ConcreteValue(32, 1));
+  ATF_REQUIRE_EQ(m1->hashcode(), m2->hashcode());
+
+  /* Copies share the same hash */
+  ConcreteMemory * m3 = m1->clone();
+  ATF_REQUIRE_EQ(m1->hashcode(), m3->hashcode());
+  m3->clear(ebx);
+  ATF_REQUIRE(! m1->equals(*m3));
+
+  delete m1;
+  delete m2;
+  delete m3;
+
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(concretememory_clone)
+ATF_TEST_CASE_HEAD(concretememory_clone)
+{
+  set_md_var("descr",
+	     "Check that clones of a ConcreteMemory do not see the writes "
+	     "of each other");
+}
+ATF_TEST_CASE_BODY(concretememory_clone)
+{
+  ConfigTable ct;
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+
+  ConcreteMemory * m1 = new ConcreteMemory();
+
+  /* Cells in two pages */
+  for (address_t a = 0; a < 1024; a += 4)
+    m1->put(ConcreteAddress(0x10000 + a), ConcreteValue(32, a),
+	    Architecture::LittleEndian);
+
+  ConcreteMemory * m2 = m1->clone();
+  ATF_REQUIRE(m1->equals(*m2));
+
+  m2->put(ConcreteAddress(0x10004), ConcreteValue(32, 7),
+	  Architecture::LittleEndian);
+  m2->put(ConcreteAddress(0x20000), ConcreteValue(8, 1),
+	  Architecture::LittleEndian);
+  ATF_REQUIRE(m1->get(ConcreteAddress(0x10004), 4,
+		      Architecture::LittleEndian).get() == 4);
+  ATF_REQUIRE(! m1->is_defined(ConcreteAddress(0x20000)));
+  ATF_REQUIRE(m2->get(ConcreteAddress(0x10004), 4,
+		      Architecture::LittleEndian).get() == 7);
+
+  m1->put(ConcreteAddress(0x10200), ConcreteValue(32, 9),
+	  Architecture::LittleEndian);
+  ATF_REQUIRE(m2->get(ConcreteAddress(0x10200), 4,
+		      Architecture::LittleEndian).get() == 0x200);
+
+  /* Cells are enumerated by increasing addresses */
+  address_t last = 0;
+  int nb_cells = 0;
+  for (ConcreteMemory::const_memcell_iterator i = m2->begin ();
+       i != m2->end (); i++, nb_cells++)
+    {
+      ATF_REQUIRE(nb_cells == 0 || last < i->first);
+      last = i->first;
+    }
+  ATF_REQUIRE_EQ(nb_cells, 1025);
+
+  delete m1;
+  ATF_REQUIRE(m2->get(ConcreteAddress(0x10008), 4,
+		      Architecture::LittleEndian).get() == 8);
+  delete m2;
+
+  insight::terminate ();
+}
+
 ATF_INIT_TEST_CASES(tcs)
 {
   ATF_ADD_TEST_CASE(tcs, concretememory_registers);
   ATF_ADD_TEST_CASE(tcs, concretememory_memcells);
+  ATF_ADD_TEST_CASE(tcs, concretememory_hashcode);
+  ATF_ADD_TEST_CASE(tcs, concretememory_clone);
 }
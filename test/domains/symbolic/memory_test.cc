@@ -159,8 +159,141 @@ ATF_TEST_CASE_BODY(memcells)
   insight::terminate ();
 }
 
+ATF_TEST_CASE(words)
+ATF_TEST_CASE_HEAD(words)
+{
+  set_md_var("descr",
+	     "Check that a SymbolicMemory object returns the written values");
+}
+
+ATF_TEST_CASE_BODY(words)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+  {
+    ConcreteMemory *cm = new ConcreteMemory;
+    SymbolicMemory *memory = new SymbolicMemory (cm);
+    Expr *x = Variable::create ("x", 32);
+
+    for (int k = 0; k < 2; k++)
+      {
+	Architecture::endianness_t e =
+	  (k == 0 ? Architecture::LittleEndian : Architecture::BigEndian);
+	ConcreteAddress addr (1024);
+
+	/* an aligned read returns the written expression itself */
+	memory->put (addr, SymbolicValue (x), e);
+	ATF_REQUIRE_EQ (memory->get (addr, 4, e).get_Expr (), x);
+
+	/* a partial overwrite only splits the overlapped bytes */
+	memory->put (ConcreteAddress (1025), SymbolicValue (8, 0xAB), e);
+	ATF_REQUIRE_EQ (s_get_simplified (memory, ConcreteAddress (1025), 1, e),
+			0xAB);
+	Expr *v = memory->get (ConcreteAddress (1026), 2, e).get_Expr ()->ref ();
+	Expr *expected = Expr::createExtract (x->ref (), k == 0 ? 16 : 0, 16);
+	exprutils::simplify (&v);
+	exprutils::simplify (&expected);
+	ATF_REQUIRE_EQ (v, expected);
+	v->deref ();
+	expected->deref ();
+      }
+
+    x->deref ();
+    delete memory;
+    delete cm;
+  }
+  insight::terminate ();
+}
+
+/* The value of v when the variable p is a. */
+static word_t
+s_get_through (const Expr *v, const Expr *p, address_t a)
+{
+  Expr *ea = Constant::create (a, 0, p->get_bv_size ());
+  Expr *val = exprutils::replace_variable (v, (const Variable *) p, ea);
+  exprutils::simplify (&val);
+  ATF_REQUIRE (val->is_Constant ());
+  word_t result = dynamic_cast<const Constant *>(val)->get_val ();
+  val->deref ();
+  ea->deref ();
+
+  return result;
+}
+
+ATF_TEST_CASE(symbolic_writes)
+ATF_TEST_CASE_HEAD(symbolic_writes)
+{
+  set_md_var("descr",
+	     "Check the writes at symbolic addresses of a SymbolicMemory object");
+}
+
+ATF_TEST_CASE_BODY(symbolic_writes)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+  {
+    ConcreteMemory *cm = new ConcreteMemory;
+    SymbolicMemory *memory = new SymbolicMemory (cm);
+    Architecture::endianness_t e = Architecture::LittleEndian;
+    Expr *p = Variable::create ("p", 32);
+    Expr *cst = Constant::create (1026, 0, 32);
+
+    memory->put (ConcreteAddress (1024), SymbolicValue (32, 0x11223344), e);
+    ATF_REQUIRE (! memory->has_symbolic_writes ());
+
+    /* a write whose address is a constant is folded into the cells */
+    memory->put_symbolic (cst, SymbolicValue (8, 0xAB), e);
+    ATF_REQUIRE (memory->has_symbolic_writes ());
+    ATF_REQUIRE_EQ (s_get_simplified (memory, ConcreteAddress (1026), 1, e),
+		    0xAB);
+    ATF_REQUIRE_EQ (s_get_simplified (memory, ConcreteAddress (1024), 2, e),
+		    0x3344);
+
+    /* cells that p may address depend on p */
+    memory->put_symbolic (p, SymbolicValue (16, 0xCDEF), e);
+    Expr *v = memory->get (ConcreteAddress (1024), 1, e).get_Expr ()->ref ();
+    exprutils::simplify (&v);
+    ATF_REQUIRE (! v->is_Constant ());
+    v->deref ();
+
+    /* unless they are written afterwards */
+    SymbolicMemory *clone = memory->clone ();
+    memory->put (ConcreteAddress (1025), SymbolicValue (8, 0x77), e);
+    ATF_REQUIRE_EQ (s_get_simplified (memory, ConcreteAddress (1025), 1, e),
+		    0x77);
+    ATF_REQUIRE (! memory->equals (*clone));
+
+    /* reading through p returns the last value written at p, unless p
+     * is the address of a cell written afterwards */
+    v = memory->get_symbolic (p, 2, e).get_Expr ()->ref ();
+    exprutils::simplify (&v);
+    ATF_REQUIRE (! v->is_Constant ());
+    ATF_REQUIRE_EQ (s_get_through (v, p, 2000), 0xCDEF);
+    ATF_REQUIRE_EQ (s_get_through (v, p, 1025), 0xCD77);
+    ATF_REQUIRE_EQ (s_get_through (v, p, 1024), 0x77EF);
+    v->deref ();
+
+    p->deref ();
+    cst->deref ();
+    delete clone;
+    delete memory;
+    delete cm;
+  }
+  insight::terminate ();
+}
+
 ATF_INIT_TEST_CASES(tcs)
 {
   ATF_ADD_TEST_CASE(tcs, registers);
   ATF_ADD_TEST_CASE(tcs, memcells);
+  ATF_ADD_TEST_CASE(tcs, words);
+  ATF_ADD_TEST_CASE(tcs, symbolic_writes);
 }
@@ -0,0 +1,249 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sstream>
+
+#include <kernel/Architecture.hh>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+#include <kernel/insight.hh>
+#include <kernel/annotations/AsmAnnotation.hh>
+#include <io/expressions/expr-binary.hh>
+#include <io/microcode/binary-microcode.hh>
+#include <io/microcode/mc-writer.hh>
+#include <utils/logs.hh>
+
+using namespace std;
+
+static void
+s_init ()
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+}
+
+static Expr *
+s_reg (const MicrocodeArchitecture &ma, const string &label)
+{
+  return RegisterExpr::create (ma.get_register (label));
+}
+
+ATF_TEST_CASE(expr_dag_sharing)
+
+ATF_TEST_CASE_HEAD(expr_dag_sharing)
+{
+  set_md_var ("descr",
+	      "Check that shared sub-expressions are written only once");
+}
+
+ATF_TEST_CASE_BODY(expr_dag_sharing)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Expr *m = BinaryApp::create (BV_OP_MUL_U, s_reg (ma, "eax"),
+				 s_reg (ma, "ebx"));
+    Expr *e = BinaryApp::create (BV_OP_ADD, m, m->ref ());
+
+    ostringstream oss;
+    ExprBinaryWriter out (oss);
+    out.write_expr (e);
+    out.write_expr (NULL);
+    out.write_expr (e);
+    /* eax, ebx, MUL and ADD */
+    ATF_REQUIRE_EQ (out.get_number_of_exprs (), 4U);
+
+    string data = oss.str ();
+    ExprBinaryReader in (data.data (), data.size (), &ma);
+    Expr *e1 = in.read_expr ();
+    Expr *e2 = in.read_expr ();
+    Expr *e3 = in.read_expr ();
+
+    ATF_REQUIRE_EQ (e1, e);
+    ATF_REQUIRE (e2 == NULL);
+    ATF_REQUIRE_EQ (e3, e);
+    ATF_REQUIRE (in.at_end ());
+    e->deref ();
+    e1->deref ();
+    e3->deref ();
+  }
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(expr_truncated_input)
+
+ATF_TEST_CASE_HEAD(expr_truncated_input)
+{
+  set_md_var ("descr", "Check that a truncated stream is rejected");
+}
+
+ATF_TEST_CASE_BODY(expr_truncated_input)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Expr *e = UnaryApp::create (BV_OP_NOT,
+				MemCell::create (s_reg (ma, "esp"), 0, 32));
+
+    ostringstream oss;
+    ExprBinaryWriter out (oss);
+    out.write_expr (e);
+    e->deref ();
+
+    string data = oss.str ();
+    ExprBinaryReader in (data.data (), data.size () - 1, &ma);
+    ATF_REQUIRE_THROW (BinaryReader::Exception, in.read_expr ());
+  }
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(microcode_round_trip)
+
+ATF_TEST_CASE_HEAD(microcode_round_trip)
+{
+  set_md_var ("descr",
+	      "Check that a program is unchanged by its binary encoding");
+}
+
+ATF_TEST_CASE_BODY(microcode_round_trip)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    MicrocodeAddress a (0x1000);
+    Expr *val = BinaryApp::create (BV_OP_ADD, s_reg (ma, "eax"),
+				   Constant::create (4, 0, 32));
+    LValue *lv = MemCell::create (s_reg (ma, "esp"), 0, 32);
+    Expr *tgt = s_reg (ma, "ebx");
+
+    mc->add_assignment (a, lv, val);
+    mc->add_jump (a, tgt);
+    mc->get_node (MicrocodeAddress (0x1000))
+      ->add_annotation (AsmAnnotation::ID, new AsmAnnotation ("push eax"));
+    mc->set_entry_point (MicrocodeAddress (0x1000));
+
+    ostringstream oss;
+    ExprBinaryWriter out (oss);
+    binary_of_microcode (out, mc, &ma);
+
+    string data = oss.str ();
+    ExprBinaryReader in (data.data (), data.size (), &ma);
+    Microcode *mc2 = new Microcode ();
+    binary_parse_microcode (in, mc2);
+    ATF_REQUIRE (in.at_end ());
+
+    ostringstream expected;
+    ostringstream result;
+    mc->sort ();
+    mc2->sort ();
+    mc_writer (expected, mc);
+    mc_writer (result, mc2);
+    ATF_REQUIRE_EQ (result.str (), expected.str ());
+    ATF_REQUIRE (mc2->get_node (MicrocodeAddress (0x1000))
+		 ->has_annotation (AsmAnnotation::ID));
+
+    delete mc;
+    delete mc2;
+  }
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(microcode_file_round_trip)
+
+ATF_TEST_CASE_HEAD(microcode_file_round_trip)
+{
+  set_md_var ("descr",
+	      "Check that a program is unchanged when saved into a binary "
+	      "microcode file and mapped back");
+}
+
+ATF_TEST_CASE_BODY(microcode_file_round_trip)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    Expr *sum = BinaryApp::create (BV_OP_ADD, s_reg (ma, "eax"),
+				   Constant::create (4, 0, 32));
+    MicrocodeAddress a (0x1000);
+
+    mc->add_assignment (a, (LValue *) s_reg (ma, "ecx"), sum->ref ());
+    mc->add_assignment (a, MemCell::create (sum, 0, 32), s_reg (ma, "ecx"));
+    mc->add_skip (a, MicrocodeAddress (0x1004));
+    mc->get_node (MicrocodeAddress (0x1000))
+      ->add_annotation (AsmAnnotation::ID, new AsmAnnotation ("add"));
+    mc->set_entry_point (MicrocodeAddress (0x1000));
+
+    string filename = "microcode.bin";
+    {
+      ofstream out (filename.c_str (), ios::out | ios::binary);
+      binary_file_of_microcode (out, mc, &ma);
+    }
+    ATF_REQUIRE (is_binary_microcode_file (filename));
+
+    Microcode *mc2 = binary_file_parse_microcode (filename, &ma);
+    ostringstream expected;
+    ostringstream result;
+    mc->sort ();
+    mc2->sort ();
+    mc_writer (expected, mc);
+    mc_writer (result, mc2);
+    ATF_REQUIRE_EQ (result.str (), expected.str ());
+    ATF_REQUIRE (mc2->get_node (MicrocodeAddress (0x1000))
+		 ->has_annotation (AsmAnnotation::ID));
+    delete mc2;
+
+    MicrocodeArchitecture msp (Architecture::getArchitecture (Architecture::MSP430));
+    ATF_REQUIRE_THROW (BinaryReader::Exception,
+		       binary_file_parse_microcode (filename, &msp));
+    remove (filename.c_str ());
+    ATF_REQUIRE_THROW (BinaryReader::Exception,
+		       binary_file_parse_microcode (filename, &ma));
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, expr_dag_sharing);
+  ATF_ADD_TEST_CASE(tcs, expr_truncated_input);
+  ATF_ADD_TEST_CASE(tcs, microcode_round_trip);
+  ATF_ADD_TEST_CASE(tcs, microcode_file_round_trip);
+}
@@ -206,6 +206,75 @@ s_check_expr_to_smtlib (const string &, const string &expr,
 ALL_X86_CC
 #undef X86_32_CC
 
+static string
+s_smtlib (const Expr *e)
+{
+  ostringstream oss;
+
+  smtlib_writer (oss, e, "memory", 32, Architecture::LittleEndian, true);
+
+  return oss.str ();
+}
+
+ATF_TEST_CASE(smtlib_shared_subterms)
+
+ATF_TEST_CASE_HEAD(smtlib_shared_subterms)
+{
+  set_md_var ("descr",
+	      "Check that shared subterms are bound once, before the shared "
+	      "terms using them");
+}
+
+ATF_TEST_CASE_BODY(smtlib_shared_subterms)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Expr *eax = RegisterExpr::create (ma.get_register ("eax"));
+    Expr *ebx = RegisterExpr::create (ma.get_register ("ebx"));
+    Expr *ecx = RegisterExpr::create (ma.get_register ("ecx"));
+
+    /* (eax + ebx) is shared by y and by the formula */
+    Expr *x = BinaryApp::create (BV_OP_ADD, eax->ref (), ebx->ref ());
+    Expr *y = BinaryApp::create (BV_OP_MUL_U, x->ref (), ecx->ref ());
+    Expr *e =
+      BinaryApp::create (BV_OP_EQ,
+			 BinaryApp::create (BV_OP_ADD, y->ref (), x->ref ()),
+			 BinaryApp::create (BV_OP_SUB, y->ref (), x->ref ()),
+			 0, 1);
+    ATF_REQUIRE_EQ (s_smtlib (e),
+		    "(let ((_$4 (bvadd eax ebx))) "
+		    "(let ((_$3 (bvmul _$4 ecx))) "
+		    "(= (ite (= (bvadd _$3 _$4) (bvsub _$3 _$4)) #b1 #b0) "
+		    "#b1)))");
+    e->deref ();
+
+    /* the address of a 32 bits cell is written once per byte */
+    e = BinaryApp::create (BV_OP_EQ, MemCell::create (x->ref (), 0, 32),
+			   y->ref (), 0, 1);
+    ATF_REQUIRE_EQ (s_smtlib (e),
+		    "(let ((_$3 (bvadd eax ebx))) "
+		    "(= (ite (= ((_ extract 31 0) "
+		    "(concat (select memory (bvadd _$3 #x00000003)) "
+		    "(concat (select memory (bvadd _$3 #x00000002)) "
+		    "(concat (select memory (bvadd _$3 #x00000001)) "
+		    "(select memory _$3))))) (bvmul _$3 ecx)) #b1 #b0) #b1))");
+    e->deref ();
+
+    x->deref ();
+    y->deref ();
+    eax->deref ();
+    ebx->deref ();
+    ecx->deref ();
+  }
+  insight::terminate ();
+}
+
 #if 1
 #define X86_32_CC(id, e, expout) \
   ATF_ADD_TEST_CASE(tcs, smtlib_ ## id)
@@ -214,6 +283,7 @@ ALL_X86_CC
 ATF_INIT_TEST_CASES(tcs)
 {
   ALL_X86_CC
+  ATF_ADD_TEST_CASE(tcs, smtlib_shared_subterms);
 }
 #else
 
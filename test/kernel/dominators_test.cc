@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+
+#include <kernel/Architecture.hh>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+#include <kernel/insight.hh>
+#include <analyses/BasicBlockGraph.hh>
+#include <analyses/Dominators.hh>
+#include <analyses/LoopNestingForest.hh>
+#include <utils/logs.hh>
+
+using namespace std;
+
+typedef BasicBlockGraph::block_id block_id;
+
+ATF_TEST_CASE(dominators)
+
+ATF_TEST_CASE_HEAD(dominators)
+{
+  set_md_var ("descr",
+	      "Check basic blocks, dominators, post-dominators and loops of "
+	      "a program with nested loops");
+}
+
+ATF_TEST_CASE_BODY(dominators)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+  insight::init (ct);
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    Expr *zf = RegisterExpr::create (ma.get_register ("zf"));
+    Expr *nzf = UnaryApp::create (BV_OP_NOT, zf->ref ());
+
+    /*   A = 0 -> B, E
+     *   B = 1; 2 -> B, C
+     *   C = 3 -> C, D
+     *   D = 4 -> B, E
+     *   E = 5 -> jmp *ebx */
+    mc->add_skip (MicrocodeAddress (0), MicrocodeAddress (1), zf->ref ());
+    mc->add_skip (MicrocodeAddress (0), MicrocodeAddress (5), nzf->ref ());
+    mc->add_skip (MicrocodeAddress (1), MicrocodeAddress (2));
+    mc->add_skip (MicrocodeAddress (2), MicrocodeAddress (1), zf->ref ());
+    mc->add_skip (MicrocodeAddress (2), MicrocodeAddress (3), nzf->ref ());
+    mc->add_skip (MicrocodeAddress (3), MicrocodeAddress (3), zf->ref ());
+    mc->add_skip (MicrocodeAddress (3), MicrocodeAddress (4), nzf->ref ());
+    mc->add_skip (MicrocodeAddress (4), MicrocodeAddress (1), zf);
+    mc->add_skip (MicrocodeAddress (4), MicrocodeAddress (5), nzf);
+    mc->add_jump (MicrocodeAddress (5),
+		  RegisterExpr::create (ma.get_register ("ebx")));
+
+    BasicBlockGraph g (mc, MicrocodeAddress (0));
+    block_id A = g.get_block (mc->get_node (MicrocodeAddress (0)));
+    block_id B = g.get_block (mc->get_node (MicrocodeAddress (1)));
+    block_id C = g.get_block (mc->get_node (MicrocodeAddress (3)));
+    block_id D = g.get_block (mc->get_node (MicrocodeAddress (4)));
+    block_id E = g.get_block (mc->get_node (MicrocodeAddress (5)));
+
+    ATF_REQUIRE_EQ (g.get_number_of_blocks (), 5U);
+    ATF_REQUIRE_EQ (g.get_number_of_edges (), 8U);
+    ATF_REQUIRE_EQ (A, 0U);
+    ATF_REQUIRE_EQ (g.get_block (mc->get_node (MicrocodeAddress (2))), B);
+    ATF_REQUIRE (g.get_exit_node (B)->get_loc ().equals (MicrocodeAddress (2)));
+
+    DominatorTree dom (g);
+    ATF_REQUIRE_EQ (dom.get_immediate_dominator (A),
+		    DominatorTree::NO_BLOCK);
+    ATF_REQUIRE_EQ (dom.get_immediate_dominator (B), A);
+    ATF_REQUIRE_EQ (dom.get_immediate_dominator (C), B);
+    ATF_REQUIRE_EQ (dom.get_immediate_dominator (D), C);
+    ATF_REQUIRE_EQ (dom.get_immediate_dominator (E), A);
+    ATF_REQUIRE (dom.dominates (B, D));
+    ATF_REQUIRE (! dom.dominates (D, B));
+    ATF_REQUIRE (! dom.dominates (B, E));
+
+    DominatorTree pdom (g, true);
+    ATF_REQUIRE_EQ (pdom.get_immediate_dominator (E),
+		    DominatorTree::NO_BLOCK);
+    ATF_REQUIRE_EQ (pdom.get_immediate_dominator (A), E);
+    ATF_REQUIRE_EQ (pdom.get_immediate_dominator (B), C);
+    ATF_REQUIRE_EQ (pdom.get_immediate_dominator (C), D);
+    ATF_REQUIRE_EQ (pdom.get_immediate_dominator (D), E);
+    ATF_REQUIRE (pdom.dominates (E, B));
+
+    LoopNestingForest loops (g, dom);
+    ATF_REQUIRE_EQ (loops.get_number_of_loops (), 2U);
+    LoopNestingForest::loop_id inner = loops.get_loop (C);
+    LoopNestingForest::loop_id outer = loops.get_loop (B);
+    ATF_REQUIRE_EQ (loops.get_header (inner), C);
+    ATF_REQUIRE_EQ (loops.get_header (outer), B);
+    ATF_REQUIRE_EQ (loops.get_parent (inner), outer);
+    ATF_REQUIRE_EQ (loops.get_loop (D), outer);
+    ATF_REQUIRE_EQ (loops.get_loop (A), LoopNestingForest::NO_LOOP);
+    ATF_REQUIRE_EQ (loops.get_loop_depth (C), 2);
+    ATF_REQUIRE_EQ (loops.get_loop_depth (E), 0);
+    ATF_REQUIRE (loops.contains (outer, C));
+    ATF_REQUIRE (loops.is_back_edge (D, B));
+    ATF_REQUIRE (! loops.is_back_edge (A, B));
+
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, dominators);
+}
@@ -32,16 +32,24 @@
 #endif
 
 #include <atf-c++.hpp>
+#include <cstdlib>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <set>
+#include <vector>
+#include <algorithm>
 
 #include <config.h>
 #include <utils/logs.hh>
 #include <kernel/Architecture.hh>
 #include <kernel/Expressions.hh>
 #include <kernel/expressions/ExprSolver.hh>
+#include <kernel/expressions/ExprPortfolioSolver.hh>
+#include <kernel/expressions/exprutils.hh>
 #include <kernel/insight.hh>
 #include <io/expressions/expr-parser.hh>
+#include <utils/stats.hh>
 
 using namespace std;
 
@@ -58,7 +66,19 @@ using namespace std;
 	     "15{0;32}")					    \
   EVAL_TEST (E2, "(MUL_S %eax{0;8} %ebx{0;8}){0;16}", \
     "(AND (EQ %eax{0;32} 0x4{0;32}) (EQ %ebx{0;32} 0xFE{0;32})){0;1}", \
-	     "0xFFF8{0;16}")
+	     "0xFFF8{0;16}")					    \
+  \
+  VALUES_TEST (DENSE, "(MUL_U 4{0;32} Y{0;32}){0;32}",		    \
+	       "(LEQ_U Y{0;32} 255{0;32})", 256, 0, 1020)		    \
+  VALUES_TEST (SPARSE, "(MUL_U Y{0;32} Y{0;32}){0;32}",		    \
+	       "(LEQ_U Y{0;32} 40{0;32})", 41, 0, 1600)		    \
+  VALUES_TEST (WRAP, "(SUB (MUL_U 4{0;32} Y{0;32}){0;32} 8{0;32}){0;32}", \
+	       "(LEQ_U Y{0;32} 255{0;32})", 256, 0, 0xFFFFFFFC)	    \
+  VALUES_TEST (OUTLIER, "(MUL_U 4{0;32} Y{0;32}){0;32}",		    \
+	       "(OR (LEQ_U Y{0;32} 255{0;32}) "				    \
+	       "(EQ Y{0;32} 0x1000000{0;32})){0;1}", 257, 0, 0x4000000) \
+  VALUES_TEST (UNBOUNDED, "Y{0;32}", "(EQ Y{0;32} Y{0;32})",	    \
+	       1000, 0, 0xFFFFFFFF)
 
 #define SOLVER_TEST(id, e, res)     \
 ATF_TEST_CASE(id)		    \
@@ -88,6 +108,20 @@ ATF_TEST_CASE_BODY(id)			\
   s_check_evaluation (# id, e, cond, res);	\
 }
 
+#define VALUES_TEST(id, e, cond, nb, min, max)	\
+ATF_TEST_CASE(id)		    \
+\
+ATF_TEST_CASE_HEAD(id)			\
+{ \
+  set_md_var ("descr", \
+	      "Check expression solver against the set of values of " e); \
+} \
+\
+ATF_TEST_CASE_BODY(id)			\
+{ \
+  s_check_values (# id, e, cond, nb, min, max);	\
+}
+
 static void
 s_check_tautology (const string &, const string &expr,
 		   ExprSolver::Result res)
@@ -169,9 +203,372 @@ s_check_evaluation (const string &, const string &expr, const string &cond,
   insight::terminate ();
 }
 
+/* At most NB_VALUES values are asked for; the set must contain nb
+ * distinct values, all between min and max. */
+static const int NB_VALUES = 1000;
+
+static void
+s_check_values (const string &, const string &expr, const string &cond,
+		size_t nb, constant_t min, constant_t max)
+{
+  ConfigTable cfg;
+
+  fstream config (INSIGHT_CONFIG_FILE, fstream::in);
+  ATF_REQUIRE  (config.is_open ());
+  cfg.load (config);
+  config.close();
+
+  cfg.set (logs::STDIO_ENABLED_PROP, true);
+  cfg.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (cfg);
+  const Architecture *x86_32 =
+    Architecture::getArchitecture (Architecture::X86_32);
+  MicrocodeArchitecture ma (x86_32);
+
+  Expr *e = expr_parser (expr, &ma);
+  ATF_REQUIRE (e != NULL);
+  Expr *c = expr_parser (cond, &ma);
+  ATF_REQUIRE (c != NULL);
+
+  ExprSolver *s = ExprSolver::create_default_solver (&ma);
+
+  vector<constant_t> *values = s->evaluate (e, c, NB_VALUES);
+  set<constant_t> distinct;
+  constant_t vmin = max;
+  constant_t vmax = min;
+  for (size_t i = 0; i < values->size (); i++)
+    {
+      constant_t v = values->at (i) & 0xFFFFFFFF;
+      distinct.insert (v);
+      vmin = std::min (vmin, v);
+      vmax = std::max (vmax, v);
+    }
+
+  ATF_REQUIRE_EQ (values->size (), nb);
+  ATF_REQUIRE_EQ (distinct.size (), nb);
+  ATF_REQUIRE (min <= vmin && vmax <= max);
+  delete values;
+  e->deref ();
+  c->deref ();
+  delete s;
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(BATCH)
+
+ATF_TEST_CASE_HEAD(BATCH)
+{
+  set_md_var ("descr", "Check independent satisfiability checks.");
+}
+
+ATF_TEST_CASE_BODY(BATCH)
+{
+  static const char *checks[] = {
+    "(EQ Y{0;32} 3{0;32})", "(EQ Y{0;32} 12{0;32})",
+    "(LEQ_U 9{0;32} Y{0;32})", "(LT_U 9{0;32} Y{0;32})"
+  };
+  static const ExprSolver::Result expected[] = {
+    ExprSolver::SAT, ExprSolver::UNSAT, ExprSolver::SAT, ExprSolver::UNSAT
+  };
+  static const size_t nb_checks = sizeof (checks) / sizeof (checks[0]);
+  ConfigTable cfg;
+
+  fstream config (INSIGHT_CONFIG_FILE, fstream::in);
+  ATF_REQUIRE  (config.is_open ());
+  cfg.load (config);
+  config.close();
+
+  cfg.set (logs::STDIO_ENABLED_PROP, true);
+  cfg.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (cfg);
+  const Architecture *x86_32 =
+    Architecture::getArchitecture (Architecture::X86_32);
+  MicrocodeArchitecture ma (x86_32);
+
+  Expr *c = expr_parser ("(LEQ_U Y{0;32} 9{0;32})", &ma);
+  ATF_REQUIRE (c != NULL);
+  vector<Expr *> es;
+  for (size_t i = 0; i < nb_checks; i++)
+    {
+      Expr *e = expr_parser (checks[i], &ma);
+      ATF_REQUIRE (e != NULL);
+      es.push_back (e);
+    }
+
+  ExprSolver *s = ExprSolver::create_default_solver (&ma);
+  vector<ExprSolver::Result> results;
+
+  s->add_assertion (c);
+  s->check_sat_batch (es, results);
+  ATF_REQUIRE_EQ (results.size (), nb_checks);
+  for (size_t i = 0; i < nb_checks; i++)
+    ATF_REQUIRE_EQ (results[i], expected[i]);
+  // the assertions are left unchanged
+  ATF_REQUIRE_EQ (s->check_sat (), ExprSolver::SAT);
+
+  for (size_t i = 0; i < nb_checks; i++)
+    es[i]->deref ();
+  c->deref ();
+  delete s;
+  insight::terminate ();
+}
+
+/* A solver that cannot tell whether an assertion with a modulo holds:
+ * the checks made while such an assertion is in scope are UNKNOWN. The
+ * other checks are forwarded to the default solver, which is asked first
+ * for a model where 'hint' holds. */
+class NoModuloSolver : public ExprSolver
+{
+public:
+  NoModuloSolver (const MicrocodeArchitecture *mca, const Expr *hint)
+    : ExprSolver (mca), solver (ExprSolver::create_default_solver (mca)),
+      hint (hint->ref ()), hinted (false), depth (0), modulo_depth (-1) {
+  }
+
+  virtual ~NoModuloSolver () {
+    unhint ();
+    hint->deref ();
+    delete solver;
+  }
+
+  virtual void add_assertion (const Expr *e)
+    throw (UnexpectedResponseException) {
+    std::vector<const BinaryApp *> apps =
+      exprutils::collect_subterms_of_type<std::vector<const BinaryApp *>,
+					  BinaryApp> (e, true);
+    for (size_t i = 0; i < apps.size () && modulo_depth < 0; i++)
+      if (apps[i]->get_op () == BV_OP_MODULO)
+	modulo_depth = depth;
+    unhint ();
+    solver->add_assertion (e);
+  }
+
+  virtual Result check_sat (const Expr *e, bool preserve)
+    throw (UnexpectedResponseException) {
+    unhint ();
+    return solver->check_sat (e, preserve);
+  }
+
+  virtual Result check_sat ()
+    throw (UnexpectedResponseException) {
+    unhint ();
+    if (modulo_depth >= 0)
+      return UNKNOWN;
+
+    solver->push ();
+    solver->add_assertion (hint);
+    hinted = true;
+    if (solver->check_sat () == SAT)
+      return SAT;
+    unhint ();
+
+    return solver->check_sat ();
+  }
+
+  virtual void push ()
+    throw (UnexpectedResponseException) {
+    unhint ();
+    depth++;
+    solver->push ();
+  }
+
+  virtual void pop ()
+    throw (UnexpectedResponseException) {
+    unhint ();
+    depth--;
+    if (modulo_depth > depth)
+      modulo_depth = -1;
+    solver->pop ();
+  }
+
+  virtual Constant *get_value_of (const Expr *var)
+    throw (UnexpectedResponseException) {
+    return solver->get_value_of (var);
+  }
+
+private:
+  /* Remove the hint left by the last check. */
+  void unhint () {
+    if (hinted)
+      solver->pop ();
+    hinted = false;
+  }
+
+  ExprSolver *solver;
+  Expr *hint;
+  bool hinted;
+  int depth;
+  int modulo_depth;
+};
+
+ATF_TEST_CASE(UNKNOWN_STRIDE)
+
+ATF_TEST_CASE_HEAD(UNKNOWN_STRIDE)
+{
+  set_md_var ("descr", "Check that a stride is not assumed when the solver "
+	      "cannot prove it.");
+}
+
+ATF_TEST_CASE_BODY(UNKNOWN_STRIDE)
+{
+  ConfigTable cfg;
+
+  fstream config (INSIGHT_CONFIG_FILE, fstream::in);
+  ATF_REQUIRE  (config.is_open ());
+  cfg.load (config);
+  config.close();
+
+  cfg.set (logs::STDIO_ENABLED_PROP, true);
+  cfg.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (cfg);
+  const Architecture *x86_32 =
+    Architecture::getArchitecture (Architecture::X86_32);
+  MicrocodeArchitecture ma (x86_32);
+
+  // the multiples of 4 up to 1020; the first values found are multiples
+  // of 8, and the solver cannot check that there are no others
+  Expr *e = expr_parser ("Y{0;32}", &ma);
+  ATF_REQUIRE (e != NULL);
+  Expr *c = expr_parser ("(AND (EQ (AND Y{0;32} 3{0;32}){0;32} 0{0;32}) "
+			 "(LEQ_U Y{0;32} 1020{0;32}))", &ma);
+  ATF_REQUIRE (c != NULL);
+  Expr *hint = expr_parser ("(EQ (AND Y{0;32} 7{0;32}){0;32} 0{0;32})", &ma);
+  ATF_REQUIRE (hint != NULL);
+
+  ExprSolver *s = new NoModuloSolver (&ma, hint);
+  vector<constant_t> *values = s->evaluate (e, c, NB_VALUES);
+  set<constant_t> distinct;
+  for (size_t i = 0; i < values->size (); i++)
+    distinct.insert (values->at (i) & 0xFFFFFFFF);
+
+  ATF_REQUIRE_EQ (values->size (), (size_t) 256);
+  ATF_REQUIRE_EQ (distinct.size (), (size_t) 256);
+  ATF_REQUIRE (distinct.find (4) != distinct.end ());
+  delete values;
+  e->deref ();
+  c->deref ();
+  hint->deref ();
+  delete s;
+  insight::terminate ();
+}
+
+#if HAVE_Z3_SOLVER
+/* Value of the counter 'name' in the output of stats::output_json (). */
+static unsigned long long
+s_get_counter (const string &name)
+{
+  ostringstream out;
+  stats::output_json (out);
+  string json = out.str ();
+  string key = "\"" + name + "\": ";
+  string::size_type pos = json.find (key);
+  ATF_REQUIRE (pos != string::npos);
+
+  return strtoull (json.c_str () + pos + key.size (), NULL, 10);
+}
+
+/* Satisfiability of e under the assertions of s; the value of Y in the
+ * model, if any, must be y. */
+static ExprSolver::Result
+s_check_under (ExprSolver *s, const Expr *e, constant_t y)
+{
+  s->push ();
+  s->add_assertion (e);
+  ExprSolver::Result result = s->check_sat ();
+  if (result == ExprSolver::SAT)
+    {
+      Expr *Y = Variable::create ("Y", 32);
+      Constant *val = s->get_value_of (Y);
+      ATF_REQUIRE (val != NULL);
+      ATF_REQUIRE_EQ (val->get_val (), y);
+      val->deref ();
+      Y->deref ();
+    }
+  s->pop ();
+
+  return result;
+}
+
+ATF_TEST_CASE(PORTFOLIO)
+
+ATF_TEST_CASE_HEAD(PORTFOLIO)
+{
+  set_md_var ("descr", "Check a portfolio made of a single z3 process.");
+}
+
+ATF_TEST_CASE_BODY(PORTFOLIO)
+{
+  ConfigTable cfg;
+
+  fstream config (INSIGHT_CONFIG_FILE, fstream::in);
+  ATF_REQUIRE  (config.is_open ());
+  cfg.load (config);
+  config.close();
+
+  cfg.set (logs::STDIO_ENABLED_PROP, true);
+  cfg.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+  cfg.set (ExprSolver::SOLVER_NAME_PROP, ExprPortfolioSolver::ident ());
+  cfg.set (ExprPortfolioSolver::COMMANDS_PROP, "z3 -smt2 -in");
+  cfg.set (ExprPortfolioSolver::TIMEOUT_PROP, 500);
+
+  insight::init (cfg);
+  const Architecture *x86_32 =
+    Architecture::getArchitecture (Architecture::X86_32);
+  MicrocodeArchitecture ma (x86_32);
+
+  Expr *c = expr_parser ("(LEQ_U Y{0;32} 9{0;32})", &ma);
+  ATF_REQUIRE (c != NULL);
+  Expr *sat = expr_parser ("(EQ Y{0;32} 3{0;32})", &ma);
+  ATF_REQUIRE (sat != NULL);
+  Expr *unsat = expr_parser ("(EQ Y{0;32} 12{0;32})", &ma);
+  ATF_REQUIRE (unsat != NULL);
+  // show that a 62-bit prime has no 32-bit factors
+  Expr *hard =
+    expr_parser ("(AND (AND (EQ (MUL_U X{0;64} Z{0;64}){0;64} "
+		 "0x3FFFFFFFFFFFFFC7{0;64}) "
+		 "(AND (LT_U 1{0;64} X{0;64}) (LT_U 1{0;64} Z{0;64}))) "
+		 "(AND (LT_U X{0;64} 0x100000000{0;64}) "
+		 "(LT_U Z{0;64} 0x100000000{0;64})))", &ma);
+  ATF_REQUIRE (hard != NULL);
+
+  ExprSolver *s = ExprSolver::create_default_solver (&ma);
+  ATF_REQUIRE (s != NULL);
+
+  s->add_assertion (c);
+  ATF_REQUIRE_EQ (s_check_under (s, sat, 3), ExprSolver::SAT);
+  ATF_REQUIRE_EQ (s_check_under (s, unsat, 0), ExprSolver::UNSAT);
+
+  unsigned long long timeouts =
+    s_get_counter ("solver.portfolio.timeouts");
+  unsigned long long restarts =
+    s_get_counter ("solver.portfolio.restarts");
+  ATF_REQUIRE_EQ (s->check_sat (hard, true), ExprSolver::UNKNOWN);
+  ATF_REQUIRE_EQ (s_get_counter ("solver.portfolio.timeouts"),
+		  timeouts + 1);
+
+  // the solver still busy with the previous check has been killed and
+  // restarted with the variables and the assertions of the outer scope
+  ATF_REQUIRE_EQ (s_check_under (s, unsat, 0), ExprSolver::UNSAT);
+  ATF_REQUIRE_EQ (s_get_counter ("solver.portfolio.restarts"),
+		  restarts + 1);
+  ATF_REQUIRE_EQ (s_check_under (s, sat, 3), ExprSolver::SAT);
+
+  hard->deref ();
+  unsat->deref ();
+  sat->deref ();
+  c->deref ();
+  delete s;
+  insight::terminate ();
+}
+#endif /* HAVE_Z3_SOLVER */
+
 ALL_TESTS
 #undef SOLVER_TEST
 #undef EVAL_TEST
+#undef VALUES_TEST
 
 #define SOLVER_TEST(id, e, expout) \
   ATF_ADD_TEST_CASE(tcs, id);
@@ -179,9 +576,17 @@ ALL_TESTS
 #define EVAL_TEST(id, e, cond, res)	\
   ATF_ADD_TEST_CASE(tcs, id);
 
+#define VALUES_TEST(id, e, cond, nb, min, max)	\
+  ATF_ADD_TEST_CASE(tcs, id);
+
 ATF_INIT_TEST_CASES(tcs)
 {
   ALL_TESTS
+  ATF_ADD_TEST_CASE(tcs, BATCH);
+  ATF_ADD_TEST_CASE(tcs, UNKNOWN_STRIDE);
+#if HAVE_Z3_SOLVER
+  ATF_ADD_TEST_CASE(tcs, PORTFOLIO);
+#endif
 }
 #else
 ATF_TEST_CASE(NO_SMT_SOLVER)
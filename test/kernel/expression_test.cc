@@ -306,6 +306,72 @@ ATF_TEST_CASE_BODY(check_pattern_matching)
 
 
 
+  insight::terminate ();
+}
+
+			/* --------------- */
+
+ATF_TEST_CASE (check_slicing)
+
+ATF_TEST_CASE_HEAD (check_slicing)
+{
+  set_md_var ("descr", "check the slicing of conjunctions");
+}
+
+ATF_TEST_CASE_BODY(check_slicing)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+
+  insight::init (ct);
+
+  Expr *cond =
+    s_parse_expr ("(AND (AND (EQ X" DEFBV " 0x1" DEFBV "){0;1} "
+		  "(EQ Y" DEFBV " (ADD Z" DEFBV " 0x2" DEFBV ")" DEFBV
+		  "){0;1}){0;1} "
+		  "(AND (LT_U Z" DEFBV " 0x10" DEFBV "){0;1} "
+		  "(NOT (EQ T" DEFBV " 0x3" DEFBV "){0;1}){0;1}){0;1}){0;1}");
+
+  /* Y is related to Z but not to X or T */
+  Expr *e = s_parse_expr ("(EQ Y" DEFBV " 0x5" DEFBV "){0;1}");
+  Expr *F = exprutils::slice_conjunction (cond, e);
+  Expr *G =
+    s_parse_expr ("(AND (EQ Y" DEFBV " (ADD Z" DEFBV " 0x2" DEFBV ")" DEFBV
+		  "){0;1} (LT_U Z" DEFBV " 0x10" DEFBV "){0;1}){0;1}");
+  ATF_REQUIRE_EQ (F, G);
+  F->deref ();
+  G->deref ();
+  e->deref ();
+
+  /* nothing is related to U */
+  e = s_parse_expr ("(EQ U" DEFBV " 0x5" DEFBV "){0;1}");
+  F = exprutils::slice_conjunction (cond, e);
+  ATF_REQUIRE (F->is_TrueFormula ());
+  F->deref ();
+  e->deref ();
+  cond->deref ();
+
+  /* cells overlap [0x1002]{0;8} and any cell may be [X] */
+  cond = s_parse_expr ("(AND (EQ [0x1000" DEFBV "]" DEFBV " 0x5" DEFBV
+		       "){0;1} (EQ [0x2000" DEFBV "]" DEFBV " T" DEFBV
+		       "){0;1}){0;1}");
+  e = s_parse_expr ("(EQ [0x1002" DEFBV "]{0;8} 0x0{0;8}){0;1}");
+  F = exprutils::slice_conjunction (cond, e);
+  G = s_parse_expr ("(EQ [0x1000" DEFBV "]" DEFBV " 0x5" DEFBV "){0;1}");
+  ATF_REQUIRE_EQ (F, G);
+  F->deref ();
+  G->deref ();
+  e->deref ();
+
+  e = s_parse_expr ("(EQ [X" DEFBV "]" DEFBV " 0x5" DEFBV "){0;1}");
+  F = exprutils::slice_conjunction (cond, e);
+  ATF_REQUIRE_EQ (F, cond);
+  F->deref ();
+  e->deref ();
+  cond->deref ();
+
   insight::terminate ();
 }
 
@@ -314,4 +380,5 @@ ATF_INIT_TEST_CASES(tcs)
   ATF_ADD_TEST_CASE(tcs, check_tautologies);
   ATF_ADD_TEST_CASE(tcs, check_replacement);
   ATF_ADD_TEST_CASE(tcs, check_pattern_matching);
+  ATF_ADD_TEST_CASE(tcs, check_slicing);
 }
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+
+#include <kernel/Architecture.hh>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+#include <kernel/insight.hh>
+#include <kernel/annotations/AsmAnnotation.hh>
+#include <kernel/microcode/FrozenMicrocode.hh>
+#include <utils/logs.hh>
+
+using namespace std;
+
+ATF_TEST_CASE(frozen_microcode)
+
+ATF_TEST_CASE_HEAD(frozen_microcode)
+{
+  set_md_var ("descr",
+	      "Check that a frozen program has the same graph as the "
+	      "original one and outlives it");
+}
+
+ATF_TEST_CASE_BODY(frozen_microcode)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+  insight::init (ct);
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    Expr *zero = RegisterExpr::create (ma.get_register ("zf"));
+    Expr *one = Constant::create (1, 0, 32);
+    Expr *ecx = RegisterExpr::create (ma.get_register ("ecx"));
+
+    /* 0x1008 <- 0x1004 <- 0x1000 -> 0x1008, then a dynamic jump */
+    mc->add_skip (MicrocodeAddress (0x1000), MicrocodeAddress (0x1008),
+		  zero->ref ());
+    mc->add_skip (MicrocodeAddress (0x1000), MicrocodeAddress (0x1004),
+		  UnaryApp::create (BV_OP_NOT, zero));
+    mc->add_assignment (MicrocodeAddress (0x1004),
+			(LValue *) RegisterExpr::create (ma.get_register ("ebx")),
+			one->ref (), MicrocodeAddress (0x1008));
+    mc->add_jump (MicrocodeAddress (0x1008), ecx->ref ());
+    mc->get_node (MicrocodeAddress (0x1004))
+      ->add_annotation (AsmAnnotation::ID, new AsmAnnotation ("mov"));
+    mc->set_entry_point (MicrocodeAddress (0x1000));
+
+    FrozenMicrocode *fmc = mc->freeze ();
+    delete mc;
+
+    ATF_REQUIRE_EQ (fmc->get_number_of_nodes (), 3U);
+    ATF_REQUIRE_EQ (fmc->get_number_of_arrows (), 4U);
+    FrozenMicrocode::node_id n0 = fmc->get_entry_point ();
+    FrozenMicrocode::node_id n1 = fmc->find_node (MicrocodeAddress (0x1004));
+    FrozenMicrocode::node_id n2 = fmc->find_node (MicrocodeAddress (0x1008));
+    ATF_REQUIRE_EQ (n0, 0U);
+    ATF_REQUIRE_EQ (n1, 1U);
+    ATF_REQUIRE_EQ (n2, 2U);
+    ATF_REQUIRE_EQ (fmc->find_node (MicrocodeAddress (0x1002)),
+		    FrozenMicrocode::NO_NODE);
+
+    ATF_REQUIRE_EQ (fmc->get_number_of_successors (n0), 2U);
+    ATF_REQUIRE_EQ (fmc->get_number_of_predecessors (n0), 0U);
+    ATF_REQUIRE_EQ (fmc->get_number_of_predecessors (n2), 2U);
+    ATF_REQUIRE_EQ (fmc->get_number_of_predecessors (n1), 1U);
+    const FrozenMicrocode::Arrow &a =
+      fmc->get_arrow (*fmc->predecessors_begin (n1));
+    ATF_REQUIRE_EQ (a.src, n0);
+    ATF_REQUIRE_EQ (a.kind, FrozenMicrocode::SKIP);
+
+    const FrozenMicrocode::Arrow &as = *fmc->successors_begin (n1);
+    ATF_REQUIRE_EQ (as.kind, FrozenMicrocode::ASSIGNMENT);
+    ATF_REQUIRE_EQ (as.tgt, n2);
+    ATF_REQUIRE_EQ (fmc->get_rval (as), one);
+
+    const FrozenMicrocode::Arrow &j = *fmc->successors_begin (n2);
+    ATF_REQUIRE (fmc->is_dynamic (j));
+    ATF_REQUIRE_EQ (fmc->get_jump_target (j), ecx);
+
+    ATF_REQUIRE (fmc->get_node_annotations (n0) == NULL);
+    ATF_REQUIRE (fmc->get_node_annotations (n1)
+		 ->has_annotation (AsmAnnotation::ID));
+    delete fmc;
+    one->deref ();
+    ecx->deref ();
+  }
+  insight::terminate ();
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, frozen_microcode);
+}
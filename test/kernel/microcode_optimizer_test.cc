@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+
+#include <kernel/Architecture.hh>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+#include <kernel/insight.hh>
+#include <analyses/MicrocodeOptimizer.hh>
+#include <utils/logs.hh>
+
+using namespace std;
+
+static Expr *
+s_reg (const MicrocodeArchitecture &ma, const string &label)
+{
+  return RegisterExpr::create (ma.get_register (label));
+}
+
+ATF_TEST_CASE(microcode_optimizer)
+
+ATF_TEST_CASE_HEAD(microcode_optimizer)
+{
+  set_md_var ("descr",
+	      "Check that dead flags and temporaries are removed and that "
+	      "instruction boundaries are kept");
+}
+
+ATF_TEST_CASE_BODY(microcode_optimizer)
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+  insight::init (ct);
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    ma.add_tmp_register ("tmpr0", 32);
+    Microcode *mc = new Microcode ();
+    Expr *sum = BinaryApp::create (BV_OP_ADD, s_reg (ma, "eax"),
+				   s_reg (ma, "ebx"));
+    Expr *tmp = s_reg (ma, "tmpr0");
+
+    /* add eax, ebx: tmpr0 := eax + ebx; cf := tmpr0[0]; eax := tmpr0 */
+    MicrocodeAddress a (0x1000);
+    mc->add_assignment (a, (LValue *) tmp->ref (), sum->ref ());
+    mc->add_assignment (a, (LValue *) s_reg (ma, "cf"),
+			tmp->extract_bit_vector (0, 1));
+    mc->add_assignment (a, (LValue *) s_reg (ma, "eax"), tmp->ref (),
+			MicrocodeAddress (0x1002));
+    /* cf := eax[31]; jmp *ebx */
+    a = MicrocodeAddress (0x1002);
+    mc->add_assignment (a, (LValue *) s_reg (ma, "cf"),
+			RegisterExpr::create (ma.get_register ("eax"), 31, 1));
+    mc->add_jump (a, s_reg (ma, "ebx"));
+    mc->set_entry_point (MicrocodeAddress (0x1000));
+
+    MicrocodeOptimizerReport report;
+    Microcode *opt = microcode_optimize (mc, &ma, &report);
+
+    ATF_REQUIRE_EQ (report.nb_dead_assignments, 2U);
+    ATF_REQUIRE_EQ (report.nb_propagated_values, 1U);
+    ATF_REQUIRE_EQ (report.nb_removed_arrows, 1U);
+    ATF_REQUIRE_EQ (opt->get_number_of_nodes (),
+		    mc->get_number_of_nodes () - 1);
+
+    /* eax := eax + ebx reaches the second instruction */
+    MicrocodeNode *n = opt->get_node (MicrocodeAddress (0x1000));
+    ATF_REQUIRE_EQ (n->get_successors ()->size (), 1U);
+    ATF_REQUIRE ((*n->get_successors ())[0]->get_stmt ()->is_Skip ());
+    n = opt->get_target ((*n->get_successors ())[0]);
+    ATF_REQUIRE (n != NULL);
+    StmtArrow *arrow = (*n->get_successors ())[0];
+    ATF_REQUIRE (arrow->get_stmt ()->is_Assignment ());
+    ATF_REQUIRE_EQ (((Assignment *) arrow->get_stmt ())->get_rval (), sum);
+    n = opt->get_target (arrow);
+    ATF_REQUIRE (n != NULL);
+    ATF_REQUIRE (n->get_loc ().equals (MicrocodeAddress (0x1002)));
+
+    /* cf is live at the dynamic jump */
+    arrow = (*n->get_successors ())[0];
+    ATF_REQUIRE (arrow->get_stmt ()->is_Assignment ());
+
+    sum->deref ();
+    tmp->deref ();
+    delete opt;
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, microcode_optimizer);
+}
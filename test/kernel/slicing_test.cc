@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+
+#include <algorithm>
+#include <kernel/Architecture.hh>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+#include <kernel/insight.hh>
+#include <analyses/slicing/Slicing.hh>
+#include <utils/logs.hh>
+
+using namespace std;
+
+static void
+s_init ()
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+  insight::init (ct);
+  DataDependency::ConsiderJumpCondMode (true);
+  DataDependency::OnlySimpleSetsMode (true);
+}
+
+static LValue *
+s_reg (const MicrocodeArchitecture &ma, const string &label)
+{
+  return RegisterExpr::create (ma.get_register (label));
+}
+
+static LValue *
+s_cell (address_t a)
+{
+  return MemCell::create (Constant::create (a, 0, 32), 0, 32);
+}
+
+/* true if deps is exactly { e1, e2 } (e2 may be NULL); deps is
+ * released. */
+static bool
+s_deps_are (vector<Expr *> deps, const Expr *e1, const Expr *e2)
+{
+  size_t n = (e2 == NULL) ? 1 : 2;
+  bool result = (deps.size () == n &&
+		 find (deps.begin (), deps.end (), e1) != deps.end () &&
+		 (e2 == NULL || find (deps.begin (), deps.end (), e2) !=
+		  deps.end ()));
+
+  for (size_t i = 0; i < deps.size (); i++)
+    deps[i]->deref ();
+
+  return result;
+}
+
+ATF_TEST_CASE(slicing_simple_sets)
+
+ATF_TEST_CASE_HEAD(slicing_simple_sets)
+{
+  set_md_var ("descr",
+	      "Check the dependencies of registers and cells at constant "
+	      "addresses along a loop");
+}
+
+ATF_TEST_CASE_BODY(slicing_simple_sets)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    LValue *eax = s_reg (ma, "eax");
+    LValue *ebx = s_reg (ma, "ebx");
+    LValue *ecx = s_reg (ma, "ecx");
+    LValue *in = s_cell (0x2000);
+    LValue *out = s_cell (0x2004);
+
+    /* ebx := [0x2000]; do { ecx := ebx + eax; eax := ecx } while (zf);
+     * [0x2004] := eax; edx := 0 */
+    mc->add_assignment (MicrocodeAddress (0x1000), (LValue *) ebx->ref (),
+			in->ref (), MicrocodeAddress (0x1001));
+    mc->add_assignment (MicrocodeAddress (0x1001), (LValue *) ecx->ref (),
+			BinaryApp::create (BV_OP_ADD, ebx->ref (), eax->ref ()),
+			MicrocodeAddress (0x1002));
+    mc->add_assignment (MicrocodeAddress (0x1002), (LValue *) eax->ref (),
+			ecx->ref (), MicrocodeAddress (0x1003));
+    mc->add_skip (MicrocodeAddress (0x1003), MicrocodeAddress (0x1001),
+		  s_reg (ma, "zf"));
+    mc->add_skip (MicrocodeAddress (0x1003), MicrocodeAddress (0x1004),
+		  UnaryApp::create (BV_OP_NOT, s_reg (ma, "zf")));
+    mc->add_assignment (MicrocodeAddress (0x1004), (LValue *) out->ref (),
+			eax->ref (), MicrocodeAddress (0x1005));
+    mc->add_assignment (MicrocodeAddress (0x1005), s_reg (ma, "edx"),
+			Constant::create (0, 0, 32), MicrocodeAddress (0x1006));
+    mc->set_entry_point (MicrocodeAddress (0x1000));
+
+    {
+      list<LocatedLValue> seeds;
+      seeds.push_back (LocatedLValue (MicrocodeAddress (0x1006), out));
+      DataDependency dd (mc, seeds);
+      dd.ComputeFixpoint (100);
+
+      ATF_REQUIRE (s_deps_are (dd.get_simple_dependencies (MicrocodeAddress (0x1005), 0),
+			       out, NULL));
+      ATF_REQUIRE (s_deps_are (dd.get_simple_dependencies (MicrocodeAddress (0x1003), 0),
+			       eax, ebx));
+      ATF_REQUIRE (s_deps_are (dd.get_simple_dependencies (MicrocodeAddress (0x1002), 0),
+			       ecx, ebx));
+      ATF_REQUIRE (s_deps_are (dd.get_simple_dependencies (MicrocodeAddress (0x1000), 0),
+			       eax, in));
+    }
+
+    /* every assignment but the one of edx */
+    vector<StmtArrow *> slice =
+      DataDependency::slice_it (mc, MicrocodeAddress (0x1006), out);
+    ATF_REQUIRE_EQ (slice.size (), 4U);
+
+    eax->deref ();
+    ebx->deref ();
+    ecx->deref ();
+    in->deref ();
+    out->deref ();
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(slicing_symbolic_cell)
+
+ATF_TEST_CASE_HEAD(slicing_symbolic_cell)
+{
+  set_md_var ("descr",
+	      "Check that a cell at a symbolic address is still tracked");
+}
+
+ATF_TEST_CASE_BODY(slicing_symbolic_cell)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    LValue *eax = s_reg (ma, "eax");
+    LValue *top = MemCell::create (s_reg (ma, "esp"), 0, 32);
+
+    /* ecx := [esp]; eax := ecx */
+    mc->add_assignment (MicrocodeAddress (0x1000), s_reg (ma, "ecx"),
+			top->ref (), MicrocodeAddress (0x1001));
+    mc->add_assignment (MicrocodeAddress (0x1001), (LValue *) eax->ref (),
+			s_reg (ma, "ecx"), MicrocodeAddress (0x1002));
+    mc->set_entry_point (MicrocodeAddress (0x1000));
+
+    list<LocatedLValue> seeds;
+    seeds.push_back (LocatedLValue (MicrocodeAddress (0x1002), eax));
+    DataDependency dd (mc, seeds);
+    dd.ComputeFixpoint (100);
+
+    ATF_REQUIRE (s_deps_are (dd.get_simple_dependencies (MicrocodeAddress (0x1000), 0),
+			     top, NULL));
+    eax->deref ();
+    top->deref ();
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, slicing_simple_sets);
+  ATF_ADD_TEST_CASE(tcs, slicing_symbolic_cell);
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+
+#include <set>
+#include <kernel/Architecture.hh>
+#include <kernel/Expressions.hh>
+#include <kernel/Microcode.hh>
+#include <kernel/insight.hh>
+#include <kernel/expressions/exprutils.hh>
+#include <analyses/Wp.hh>
+#include <utils/logs.hh>
+
+using namespace std;
+
+static void
+s_init ()
+{
+  ConfigTable ct;
+  ct.set (logs::DEBUG_ENABLED_PROP, false);
+  ct.set (logs::STDIO_ENABLED_PROP, true);
+  ct.set (Expr::NON_EMPTY_STORE_ABORT_PROP, true);
+  insight::init (ct);
+}
+
+static LValue *
+s_reg (const MicrocodeArchitecture &ma, const string &label)
+{
+  return RegisterExpr::create (ma.get_register (label));
+}
+
+static LValue *
+s_stack (const MicrocodeArchitecture &ma, int offset)
+{
+  return MemCell::create (BinaryApp::create (BV_OP_ADD, s_reg (ma, "esp"),
+					     Constant::create (offset, 0, 32)),
+			  0, 32);
+}
+
+ATF_TEST_CASE(wp_vc_memory)
+
+ATF_TEST_CASE_HEAD(wp_vc_memory)
+{
+  set_md_var ("descr",
+	      "Check that values written in memory are read back");
+}
+
+ATF_TEST_CASE_BODY(wp_vc_memory)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+
+    /* [esp + 4] := eax; [esp + 8] := ecx; ebx := [esp + 4] */
+    mc->add_assignment (MicrocodeAddress (0x10), s_stack (ma, 4),
+			s_reg (ma, "eax"), MicrocodeAddress (0x11));
+    mc->add_assignment (MicrocodeAddress (0x11), s_stack (ma, 8),
+			s_reg (ma, "ecx"), MicrocodeAddress (0x12));
+    mc->add_assignment (MicrocodeAddress (0x12), s_reg (ma, "ebx"),
+			s_stack (ma, 4), MicrocodeAddress (0x13));
+
+    Expr *post = Expr::createEquality (s_reg (ma, "ebx"), s_reg (ma, "eax"));
+    Expr *vc = verification_condition (mc, MicrocodeAddress (0x10),
+				       MicrocodeAddress (0x13), post);
+    ATF_REQUIRE_EQ (vc->to_string (), "(EQ %eax{0;32} %eax{0;32}){0;1}");
+
+    vc->deref ();
+    post->deref ();
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(wp_vc_linear_size)
+
+ATF_TEST_CASE_HEAD(wp_vc_linear_size)
+{
+  set_md_var ("descr",
+	      "Check that the paths through a sequence of branches are not "
+	      "enumerated");
+}
+
+ATF_TEST_CASE_BODY(wp_vc_linear_size)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    const char *regs[] = { "eax", "ebx", "ecx", "edx" };
+    const int N = 32;
+
+    /* N branches: if (r1 < i) r2 := r2 + r1 else r3 := r3 ^ r4; that is
+     * 2^N paths */
+    for (int i = 0; i < N; i++)
+      {
+	Expr *c = BinaryApp::create (BV_OP_LT_U, s_reg (ma, regs[i % 4]),
+				     Constant::create (i, 0, 32), 0, 1);
+	const char *r2 = regs[(i + 1) % 4];
+	const char *r3 = regs[(i + 2) % 4];
+	const char *r4 = regs[(i + 3) % 4];
+	mc->add_assignment (MicrocodeAddress (0x10 + i), s_reg (ma, r2),
+			    BinaryApp::create (BV_OP_ADD, s_reg (ma, r2),
+					       s_reg (ma, regs[i % 4])),
+			    MicrocodeAddress (0x10 + i + 1), c->ref ());
+	mc->add_assignment (MicrocodeAddress (0x10 + i), s_reg (ma, r3),
+			    BinaryApp::create (BV_OP_XOR, s_reg (ma, r3),
+					       s_reg (ma, r4)),
+			    MicrocodeAddress (0x10 + i + 1),
+			    Expr::createLNot (c));
+      }
+
+    Expr *post = Expr::createDisequality (s_reg (ma, "eax"),
+					  s_reg (ma, "ebx"));
+    Expr *vc = verification_condition (mc, MicrocodeAddress (0x10),
+				       MicrocodeAddress (0x10 + N), post);
+
+    /* one variable per assignment and, at each join, one for the
+     * reachability and at most two for the registers */
+    typedef set<const Expr *> ExprSet;
+    ExprSet vars =
+      exprutils::collect_subterms_of_type<ExprSet, Variable> (vc, true);
+    ATF_REQUIRE (vars.size () >= (size_t) 2 * N);
+    ATF_REQUIRE (vars.size () <= (size_t) 5 * N);
+
+    vc->deref ();
+    post->deref ();
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_TEST_CASE(wp_vc_cycle)
+
+ATF_TEST_CASE_HEAD(wp_vc_cycle)
+{
+  set_md_var ("descr",
+	      "Check that cycles between entry and final are rejected");
+}
+
+ATF_TEST_CASE_BODY(wp_vc_cycle)
+{
+  s_init ();
+  {
+    MicrocodeArchitecture ma (Architecture::getArchitecture (Architecture::X86_32));
+    Microcode *mc = new Microcode ();
+    Expr *c = Expr::createEquality (s_reg (ma, "eax"), Constant::zero (32));
+
+    /* do eax := eax - 1 while (eax != 0) */
+    mc->add_assignment (MicrocodeAddress (0x10), s_reg (ma, "eax"),
+			BinaryApp::create (BV_OP_SUB, s_reg (ma, "eax"),
+					   Constant::one (32)),
+			MicrocodeAddress (0x11));
+    mc->add_skip (MicrocodeAddress (0x11), MicrocodeAddress (0x10),
+		  Expr::createLNot (c->ref ()));
+    mc->add_skip (MicrocodeAddress (0x11), MicrocodeAddress (0x12), c);
+
+    Expr *post = Expr::createEquality (s_reg (ma, "eax"),
+				       Constant::zero (32));
+    ATF_REQUIRE_THROW (WpException,
+		       verification_condition (mc, MicrocodeAddress (0x10),
+					       MicrocodeAddress (0x12), post));
+
+    /* final is not reachable: nothing to prove */
+    Expr *vc = verification_condition (mc, MicrocodeAddress (0x12),
+				       MicrocodeAddress (0x10), post);
+    ATF_REQUIRE (vc->is_TrueFormula ());
+
+    vc->deref ();
+    post->deref ();
+    delete mc;
+  }
+  insight::terminate ();
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, wp_vc_memory);
+  ATF_ADD_TEST_CASE(tcs, wp_vc_linear_size);
+  ATF_ADD_TEST_CASE(tcs, wp_vc_cycle);
+}
@@ -0,0 +1,38 @@
+# switch on an unknown value of %eax compiled into a jump table of 256
+# entries; the dynamic jump has 256 targets.
+	.altmacro
+	.set	NB_CASES, 256
+
+	.macro	case n
+case\n:
+	mov	$\n, %ebx
+	jmp	end
+	.endm
+
+	.macro	entry n
+	.long	case\n
+	.endm
+
+start:
+	cmp	$NB_CASES - 1, %eax
+	ja	default
+	jmp	*table(,%eax,4)
+
+	.set	i, 0
+	.rept	NB_CASES
+	case	%i
+	.set	i, i + 1
+	.endr
+
+default:
+	mov	$-1, %ebx
+end:
+	jmp	end
+
+	.p2align 2
+table:
+	.set	i, 0
+	.rept	NB_CASES
+	entry	%i
+	.set	i, i + 1
+	.endr
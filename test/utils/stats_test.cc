@@ -0,0 +1,92 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <atf-c++.hpp>
+#include <sstream>
+#include <string>
+#include <utils/stats.hh>
+
+using namespace std;
+
+ATF_TEST_CASE(merge)
+ATF_TEST_CASE_HEAD(merge)
+{
+  set_md_var("descr", "Check that timers sharing a name are summed up.");
+}
+ATF_TEST_CASE_BODY(merge)
+{
+  static stats::Timer t1 ("test.timer");
+  static stats::Timer t2 ("test.timer");
+  static stats::Counter c ("test.counter");
+
+  t1.add (1000000000ULL);
+  t2.add (500000000ULL);
+  c.add (3);
+
+  ostringstream oss;
+  stats::output_json (oss);
+  string json = oss.str ();
+
+  ATF_REQUIRE (json.find ("\"test.timer\": { \"calls\": 2, "
+			  "\"seconds\": 1.500000 }") != string::npos);
+  ATF_REQUIRE (json.find ("\"test.counter\": 3") != string::npos);
+  ATF_REQUIRE_EQ (json.find ("\"test.timer\""), json.rfind ("\"test.timer\""));
+}
+
+ATF_TEST_CASE(series)
+ATF_TEST_CASE_HEAD(series)
+{
+  set_md_var("descr", "Check that series keep a bounded number of samples.");
+}
+ATF_TEST_CASE_BODY(series)
+{
+  static stats::Series s ("test.series", "index,square");
+
+  ATF_REQUIRE_EQ (s.get_columns ().size (), 2U);
+  for (int i = 0; i < 100000; i++)
+    {
+      vector<double> sample;
+      sample.push_back (i);
+      sample.push_back ((double) i * i);
+      s.add (sample);
+    }
+
+  ATF_REQUIRE (s.get_samples ().size () <= 4096);
+  ATF_REQUIRE (s.get_samples ().size () >= 2048);
+  for (size_t i = 1; i < s.get_samples ().size (); i++)
+    ATF_REQUIRE (s.get_samples ()[i - 1][1] < s.get_samples ()[i][1]);
+  ATF_REQUIRE_EQ (s.get_samples ().back ().size (), 3U);
+}
+
+ATF_INIT_TEST_CASES(tcs)
+{
+  ATF_ADD_TEST_CASE(tcs, merge);
+  ATF_ADD_TEST_CASE(tcs, series);
+}
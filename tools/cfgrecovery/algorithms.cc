@@ -34,6 +34,7 @@
 #include <signal.h>
 
 #include <analyses/cfgrecovery/AlgorithmFactory.hh>
+#include <utils/BinaryStream.hh>
 
 using namespace std;
 
@@ -47,6 +48,20 @@ static const string SIMULATOR_WARN_UNSOLVED_DYNAMIC_JUMPS =
   "disas.simulator.warn-unsolved-dynamic-jumps";
 static const string SIMULATOR_WARN_SKIPPED_DYNAMIC_JUMPS =
   "disas.simulator.warn-skipped-dynamic-jumps";
+static const string SIMULATOR_CHECKPOINT_FILE =
+  "disas.simulator.checkpoint-file";
+static const string SIMULATOR_CHECKPOINT_PERIOD =
+  "disas.simulator.checkpoint-period";
+static const string SIMULATOR_BUDGET_TIME =
+  "disas.simulator.budget.time";
+static const string SIMULATOR_BUDGET_STATES =
+  "disas.simulator.budget.states";
+static const string SIMULATOR_BUDGET_EXPRESSIONS =
+  "disas.simulator.budget.expressions";
+static const string SIMULATOR_BUDGET_RSS =
+  "disas.simulator.budget.rss";
+static const string SIMULATOR_BUDGET_SOLVER_CALLS =
+  "disas.simulator.budget.solver-calls";
 static const string SIMULATOR_DEBUG_SHOW_STATES =
   "disas.simulator.debug.show-states";
 static const string SIMULATOR_DEBUG_SHOW_STATE_SPACE_SIZE =
@@ -58,6 +73,8 @@ static const string SYMSIM_DYNAMIC_JUMP_THRESHOLD =
   "disas.symsim.dynamic-jump-threshold";
 static const string SYMSIM_MAP_DYNAMIC_JUMP_TO_MEMORY =
   "disas.symsim.map-dynamic-jump-to-memory";
+static const string SYMSIM_MEMORY_MODEL =
+  "disas.symsim.memory-model";
 
 typedef AlgorithmFactory::Algorithm * (AlgorithmFactory::* FactoryMethod) ();
 
@@ -154,10 +171,27 @@ s_generic_call (const list<ConcreteAddress >&entrypoint,
 		    << "to " << dec << max_nb_visits << " visits."
 		    << endl;
     }
+  /* When an analysis is resumed, its new checkpoints replace the one it
+   * has been restarted from unless another file is given. */
+  string checkpoint_file =
+    CFGRECOVERY_CONFIG->get (SIMULATOR_CHECKPOINT_FILE,
+			     resume_filename ? resume_filename : "");
+  int checkpoint_period =
+    CFGRECOVERY_CONFIG->get_integer (SIMULATOR_CHECKPOINT_PERIOD, 0);
+
   int djmpth =
     CFGRECOVERY_CONFIG->get_integer (SYMSIM_DYNAMIC_JUMP_THRESHOLD);
   bool djmp2mem =
     CFGRECOVERY_CONFIG->get_boolean (SYMSIM_MAP_DYNAMIC_JUMP_TO_MEMORY);
+  string memory_model =
+    CFGRECOVERY_CONFIG->get (SYMSIM_MEMORY_MODEL, "cells");
+
+  if (memory_model != "cells" && memory_model != "arrays")
+    {
+      logs::warning << "warning: unknown memory model '" << memory_model
+		    << "', using 'cells'." << endl;
+      memory_model = "cells";
+    }
 
   F.set_memory (memory);
   F.set_decoder (decoder);
@@ -168,7 +202,16 @@ s_generic_call (const list<ConcreteAddress >&entrypoint,
   F.set_warn_skipped_dynamic_jumps (warn_skipped_jumps);
   F.set_map_dynamic_jumps_to_memory (djmp2mem);
   F.set_dynamic_jumps_threshold (djmpth);
+  F.set_array_memory_model (memory_model == "arrays");
   F.set_max_number_of_visits_per_address (max_nb_visits);
+  F.set_checkpoint_filename (checkpoint_file);
+  F.set_checkpoint_period (checkpoint_period);
+  F.set_max_time (CFGRECOVERY_CONFIG->get_integer (SIMULATOR_BUDGET_TIME, 0));
+  F.set_max_states (CFGRECOVERY_CONFIG->get_integer (SIMULATOR_BUDGET_STATES,
+						     0));
+  F.set_max_expressions (CFGRECOVERY_CONFIG->get_integer (SIMULATOR_BUDGET_EXPRESSIONS, 0));
+  F.set_max_rss (CFGRECOVERY_CONFIG->get_integer (SIMULATOR_BUDGET_RSS, 0));
+  F.set_max_solver_calls (CFGRECOVERY_CONFIG->get_integer (SIMULATOR_BUDGET_SOLVER_CALLS, 0));
 
   running_algorithm = (F.* build) ();
   if (signal (SIGINT, &s_sigint_handler) == SIG_ERR)
@@ -176,12 +219,26 @@ s_generic_call (const list<ConcreteAddress >&entrypoint,
 
   try
     {
-      logs::warning << "Starting the analysis, hit Ctrl-C to interrupt..."
-		    << endl;
+      logs::warning << "Starting the analysis, hit Ctrl-C to interrupt";
+      if (! checkpoint_file.empty ())
+	logs::warning << " and save a checkpoint into '" << checkpoint_file
+		      << "'";
+      logs::warning << "..." << endl;
 
-      running_algorithm->compute (entrypoint, result);
+      if (resume_filename != NULL)
+	running_algorithm->resume (resume_filename, entrypoint, resume_stubs,
+				   result);
+      else
+	running_algorithm->compute (entrypoint, result);
+      delete running_algorithm;
+      running_algorithm = NULL;
+    }
+  catch (BinaryReader::Exception &e)
+    {
       delete running_algorithm;
       running_algorithm = NULL;
+      throw AlgorithmFactory::Exception (string ("invalid checkpoint: ") +
+					 e.what ());
     }
   catch (Decoder::Exception &)
     {
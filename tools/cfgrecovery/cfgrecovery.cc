@@ -49,14 +49,19 @@
 #include <kernel/expressions/ExprSolver.hh>
 #include <kernel/expressions/ExprProcessSolver.hh>
 
+#include <analyses/MicrocodeOptimizer.hh>
+
 #include <io/binary/BinutilsBinaryLoader.hh>
 
+#include <io/microcode/binary-microcode.hh>
 #include <io/microcode/asm-writer.hh>
 #include <io/microcode/dot-writer.hh>
 #include <io/microcode/mc-writer.hh>
 #include <io/microcode/xml_microcode_generator.hh>
 #include <io/microcode/xml_microcode_parser.hh>
 
+#include <utils/stats.hh>
+
 
 #include <config.h>
 
@@ -67,7 +72,8 @@ using namespace std;
   FORMAT(OF_ASM_DOT, "asm-dot", "assembler code on a dot graph") \
   FORMAT(OF_MC, "mc", "microcode") \
   FORMAT(OF_MC_DOT, "mc-dot", "microcode on a dot graph") \
-  FORMAT(OF_XML, "mc-xml", "microcode in XML format")
+  FORMAT(OF_XML, "mc-xml", "microcode in XML format") \
+  FORMAT(OF_BIN, "mc-bin", "microcode in binary format")
 
 #define FORMAT(id,name,desc) id,
 enum OutputFormatID  { OUTPUT_FORMATS OF_UNKNOWN };
@@ -101,7 +107,8 @@ enum Solvers {
   NO_SOLVER = 0,
   MATHSAT_API = 1,
   MATHSAT_SOLVER = 2,
-  Z3_SOLVER = 3
+  Z3_SOLVER = 3,
+  Z3_API = 4
 };
 
 /* Global options */
@@ -111,8 +118,40 @@ const ConfigTable *CFGRECOVERY_CONFIG = &CONFIG;
 static int asm_with_bytes = 0;
 static int asm_with_holes = 0;
 static int asm_with_symbols = 0;
+static int asm_sections = 0;
 static int sink_nodes = 0;
+static int optimize_program = 0;
 static bool no_stub = false;
+const char *resume_filename = NULL;
+Microcode *resume_stubs = NULL;
+
+/* Identifiers of the options that have no short form */
+enum {
+  OPT_RESUME = 256,
+  OPT_CHECKPOINT,
+  OPT_MAX_TIME,
+  OPT_MAX_STATES,
+  OPT_MAX_EXPRS,
+  OPT_MAX_RSS,
+  OPT_MAX_SOLVER_CALLS,
+  OPT_STATS
+};
+
+/* Budgets given on the command line; they override the configuration */
+struct budget_option {
+  int opt;
+  const char *name;
+  const char *key;
+  const char *value;
+} budget_options[] = {
+  { OPT_MAX_TIME, "max-time", "disas.simulator.budget.time", NULL },
+  { OPT_MAX_STATES, "max-states", "disas.simulator.budget.states", NULL },
+  { OPT_MAX_EXPRS, "max-exprs", "disas.simulator.budget.expressions", NULL },
+  { OPT_MAX_RSS, "max-rss", "disas.simulator.budget.rss", NULL },
+  { OPT_MAX_SOLVER_CALLS, "max-solver-calls",
+    "disas.simulator.budget.solver-calls", NULL },
+  { 0, NULL, NULL, NULL }
+};
 
 struct disassembler {
   const char *name;
@@ -161,7 +200,9 @@ usage (int status)
 	   << "  -c, --config FILE\t\tset config file (default: ~/" << CFGRECOVERY_CONFIG_FILENAME << ")" << endl
 	   << "  -C, --create-config[=FILE]\tcreate a config file (default: ~/"
 	   << CFGRECOVERY_CONFIG_FILENAME << ")" << endl
-	   << "  -i, --input FILE\t\tload an XML file FILE from previous analysis" << endl
+	   << "  -i, --input FILE\t\tload an XML or binary file FILE from previous analysis" << endl
+	   << "      --checkpoint FILE\t\tsave the state of the analysis into FILE" << endl
+	   << "      --resume FILE\t\tresume the analysis saved in checkpoint FILE" << endl
 	   << "  -d, --disas TYPE\t\tselect disassembler TYPE (default: linear)" << endl
 	   << "  -l, --list\t\t\tdisplay all available disassembler methods" << endl
 	   << "  -f, --formats FMT\t\tset disassembler output format:" << endl
@@ -186,8 +227,19 @@ usage (int status)
 	   << "  --asm-with-bytes\t\tdisplay the opcode bytes" << endl
 	   << "  --asm-with-holes\t\tdo not skip the empty gaps in memory"  << endl
 	   << "  --asm-with-symbols\t\tdisplay symbols whenever possible" << endl
+	   << "  --asm-sections\t\twith -o FILE, write the code of each section"
+	   << endl
+	   << "\t\t\t\tinto FILE.SECTION" << endl
+	   << "analysis budgets (partial results are output when exceeded):" << endl
+	   << "  --max-time SECS\t\tstop the analysis after SECS seconds" << endl
+	   << "  --max-states N\t\tstop the analysis after N states" << endl
+	   << "  --max-exprs N\t\tstop when N expressions are alive" << endl
+	   << "  --max-rss MB\t\t\tstop when memory usage reaches MB megabytes" << endl
+	   << "  --max-solver-calls N\t\tstop after N calls to the SMT solver" << endl
 	   << "miscellaneous options:" << endl
-	   << "   --sink-nodes\t\t\tlist sink nodes" << endl;
+	   << "   --optimize\t\t\tremove dead flags and temporaries from the output" << endl
+	   << "   --sink-nodes\t\t\tlist sink nodes" << endl
+	   << "   --stats FILE\t\t\twrite profiling counters to FILE (JSON)" << endl;
     }
 
   exit (status);
@@ -214,6 +266,7 @@ struct CtrlCHandler : public Microcode::ArrowCreationCallback {
   const MicrocodeArchitecture *mcarch;
   std::string exec_filename;
   std::list<ConcreteAddress> entrypoints;
+  std::list<BinaryLoader::section_t> sections;
 
   void write_microcode (Microcode *mc, OutputFormatID fmt, ostream &output) {
     mc->sort ();
@@ -243,6 +296,9 @@ struct CtrlCHandler : public Microcode::ArrowCreationCallback {
       case OF_XML:
 	xml_of_microcode (output, mc, mcarch);
 	break;
+      case OF_BIN:
+	binary_file_of_microcode (output, mc, mcarch);
+	break;
 
       default:
 	cerr << "internal error. unknown format specified for output." << endl;
@@ -250,6 +306,13 @@ struct CtrlCHandler : public Microcode::ArrowCreationCallback {
       }
   }
 
+  int write_asm_sections (Microcode *mc, const std::string &prefix) {
+    mc->sort ();
+    return asm_sections_writer (prefix, mc, memory, symboltable, sections,
+				asm_with_bytes, asm_with_holes,
+				asm_with_symbols);
+  }
+
   virtual void add_node (Microcode *mc, StmtArrow *) {
     if (output_program)
       {
@@ -279,6 +342,11 @@ solver_lookup()
   return MATHSAT_API;
 #endif
 
+#if INTEGRATED_Z3_SOLVER
+  /* Check if Z3 library is linked */
+  return Z3_API;
+#endif
+
   string delimiter = ":";
   string path = string(getenv("PATH"));
   size_t start_pos = 0, end_pos = 0;
@@ -327,6 +395,12 @@ set_solver_config(ConfigTable *cfg)
       break;
 #endif
 
+#if INTEGRATED_Z3_SOLVER
+    case Z3_API:
+      cfg->set (ExprSolver::SOLVER_NAME_PROP, "z3");
+      break;
+#endif
+
     case MATHSAT_SOLVER:
       cfg->set (ExprSolver::SOLVER_NAME_PROP, "process");
       cfg->set (ExprProcessSolver::COMMAND_PROP, "mathsat");
@@ -354,6 +428,8 @@ main (int argc, char *argv[])
   int optc;
   const char *output_filename = NULL;
   const char *input_filename = NULL;
+  const char *checkpoint_filename = NULL;
+  const char *stats_filename = NULL;
   const char *architecture = NULL;
   const char *target = NULL;
   const char *endianness = NULL;
@@ -363,7 +439,7 @@ main (int argc, char *argv[])
 
   bool display_symbols = false;
 
-  /* Default output format (asm, _mc_, mc-dot, asm-dot, mc-xml) */
+  /* Default output format (asm, _mc_, mc-dot, asm-dot, mc-xml, mc-bin) */
   list<const OutputFormat *> output_formats;
 
   /* Short options string */
@@ -392,7 +468,17 @@ main (int argc, char *argv[])
     {"asm-with-bytes", no_argument, &asm_with_bytes, 1 },
     {"asm-with-holes", no_argument, &asm_with_holes, 1 },
     {"asm-with-symbols", no_argument, &asm_with_symbols, 1 },
+    {"asm-sections", no_argument, &asm_sections, 1 },
     {"sink-nodes", no_argument, &sink_nodes, 1 },
+    {"optimize", no_argument, &optimize_program, 1 },
+    {"checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+    {"resume", required_argument, NULL, OPT_RESUME },
+    {"max-time", required_argument, NULL, OPT_MAX_TIME },
+    {"max-states", required_argument, NULL, OPT_MAX_STATES },
+    {"max-exprs", required_argument, NULL, OPT_MAX_EXPRS },
+    {"max-rss", required_argument, NULL, OPT_MAX_RSS },
+    {"max-solver-calls", required_argument, NULL, OPT_MAX_SOLVER_CALLS },
+    {"stats", required_argument, NULL, OPT_STATS },
     {NULL, 0, NULL, 0}
   };
 
@@ -440,6 +526,7 @@ main (int argc, char *argv[])
 
 	  CONFIG.set (string("disas.symsim.map-dynamic-jump-to-memory"), false);
 	  CONFIG.set (string("disas.symsim.dynamic-jump-threshold"), 1000);
+	  CONFIG.set (string("disas.symsim.memory-model"), string("cells"));
 
 	  CONFIG.set (string("disas.simulator.init-sp"), string("0xffffff00"));
 	  CONFIG.set (string("disas.simulator.nb-visits-per-address"), 5);
@@ -556,6 +643,39 @@ main (int argc, char *argv[])
 	input_filename = optarg;
 	break;
 
+      case OPT_CHECKPOINT:	/* Checkpoint file name */
+	checkpoint_filename = optarg;
+	break;
+
+      case OPT_RESUME:		/* Checkpoint to resume from */
+	resume_filename = optarg;
+	break;
+
+      case OPT_STATS:		/* Profiling counters output */
+	stats_filename = optarg;
+	break;
+
+      case OPT_MAX_TIME:	/* Analysis budgets */
+      case OPT_MAX_STATES:
+      case OPT_MAX_EXPRS:
+      case OPT_MAX_RSS:
+      case OPT_MAX_SOLVER_CALLS:
+	{
+	  struct budget_option *b = budget_options;
+	  char *end;
+
+	  while (b->opt != optc)
+	    b++;
+	  if (strtol (optarg, &end, 0) < 0 || *optarg == '\0' || *end != '\0')
+	    {
+	      cerr << prog_name << ": error: invalid value '" << optarg
+		   << "' for option '--" << b->name << "'" << endl;
+	      usage (EXIT_FAILURE);
+	    }
+	  b->value = optarg;
+	}
+	break;
+
       case 'h':		/* Display usage and exit */
 	usage (EXIT_SUCCESS);
 	break;
@@ -587,6 +707,20 @@ main (int argc, char *argv[])
       usage (EXIT_FAILURE);
     }
 
+  if (input_filename != NULL && resume_filename != NULL)
+    {
+      cerr << prog_name << ": error: options '--input' and '--resume' are "
+	   << "mutually exclusive" << endl;
+      usage (EXIT_FAILURE);
+    }
+
+  if (asm_sections && output_filename == NULL)
+    {
+      cerr << prog_name << ": error: option '--asm-sections' requires "
+	   << "'-o FILE'" << endl;
+      usage (EXIT_FAILURE);
+    }
+
   /* Starting insight and initializing the needed objects */
   set_solver_config(&CONFIG);
 
@@ -608,6 +742,13 @@ main (int argc, char *argv[])
       f.close();
     }
 
+  if (checkpoint_filename != NULL)
+    CONFIG.set (string ("disas.simulator.checkpoint-file"),
+		string (checkpoint_filename));
+  for (struct budget_option *b = budget_options; b->opt != 0; b++)
+    if (b->value != NULL)
+      CONFIG.set (string (b->key), (int) strtol (b->value, NULL, 0));
+
   insight::init (CONFIG);
 
   ConcreteMemory *memory = new ConcreteMemory ();
@@ -660,6 +801,7 @@ main (int argc, char *argv[])
 			<< loader->get_entrypoint() << endl;
 	entrypoints.push_back (ConcreteAddress(loader->get_entrypoint()));
       }
+    CTRL_C_HANDLER.sections = loader->get_sections ();
     delete loader;
   } catch (Architecture::UnsupportedArch &e) {
     logs::error << execfile_name << ": " << e.what() << endl;
@@ -727,11 +869,37 @@ main (int argc, char *argv[])
 
   if (input_filename != NULL)
     {
-      mc = xml_parse_mc_program (input_filename, arch);
+      if (! is_binary_microcode_file (input_filename))
+	mc = xml_parse_mc_program (input_filename, arch);
+      else
+	{
+	  try
+	    {
+	      mc = binary_file_parse_microcode (input_filename, arch);
+	    }
+	  catch (BinaryReader::Exception &e)
+	    {
+	      logs::error << "error: '" << input_filename << "': " << e.what ()
+			  << endl;
+	      exit (EXIT_FAILURE);
+	    }
+	}
 #ifdef DEBUG
       mc->check ();
 #endif /* DEBUG */
     }
+  else if (resume_filename != NULL)
+    {
+      /* Stubs are saved with the program in the checkpoint; they are
+       * built again to patch the memory and to be added to the program if
+       * the checkpoint lacks them. */
+      mc = new Microcode ();
+      if (stubfactory)
+	{
+	  resume_stubs = new Microcode ();
+	  stubfactory->add_stubs (memory, arch, resume_stubs, symboltable);
+	}
+    }
   else
     {
       mc = new Microcode ();
@@ -773,6 +941,34 @@ main (int argc, char *argv[])
       logs::error << e.what() << endl;
     }
 
+  /* Liveness needs the whole program: a flag is only dead once the
+   * instructions that may follow are known. Hence the optimizer runs on
+   * the recovered program and not on each block as it is decoded. */
+  if (mc != NULL && optimize_program)
+    {
+      MicrocodeOptimizerReport report;
+      Microcode *opt = microcode_optimize (mc, arch, &report);
+
+      if (verbosity > 0)
+	logs::display << "Optimizer: " << dec << report.nb_dead_assignments
+		      << " dead assignments, " << report.nb_propagated_values
+		      << " propagated values, " << report.nb_removed_arrows
+		      << " removed arrows" << endl;
+      delete mc;
+      mc = opt;
+    }
+
+  if (stats_filename != NULL)
+    {
+      ofstream stats_file (stats_filename);
+
+      if (stats_file.is_open ())
+	stats::output_json (stats_file);
+      else
+	logs::error << prog_name << ": error: cannot open '" << stats_filename
+		    << "': " << strerror (errno) << endl;
+    }
+
   if (mc == NULL)
     exit (EXIT_FAILURE);
 
@@ -795,6 +991,22 @@ main (int argc, char *argv[])
       for (list<const OutputFormat *>::iterator i = output_formats.begin ();
 	   i != output_formats.end (); i++)
 	{
+	  if ((*i)->id == OF_ASM && asm_sections)
+	    {
+	      try
+		{
+		  int nb = CTRL_C_HANDLER.write_asm_sections (mc,
+							      output_filename);
+		  if (verbosity > 0)
+		    logs::display << nb << " section files written" << endl;
+		}
+	      catch (std::runtime_error &e)
+		{
+		  logs::error << prog_name << ": " << e.what () << endl;
+		}
+	      continue;
+	    }
+
 	  ofstream output (output_filename);
 	  if (! output.is_open ())
 	    {
@@ -841,6 +1053,8 @@ main (int argc, char *argv[])
 
   delete mc;
   delete decoder;
+  if (resume_stubs)
+    delete resume_stubs;
 
  end:
   if (stubfactory)
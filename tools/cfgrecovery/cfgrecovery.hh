@@ -35,6 +35,8 @@
 #include <string>
 #include <utils/ConfigTable.hh>
 
+class Microcode;
+
 #define CFG_RECOVERY_VERSION    "0.1.0"
 
 /* global variables */
@@ -44,6 +46,8 @@ const std::string prog_name = "cfgrecovery";  /* program name  */
 extern int verbosity;	                       /* verbosity level */
 extern std::ostream * output;                  /* output stream */
 extern std::ofstream output_file;              /* output file */
+extern const char *resume_filename;            /* checkpoint to resume */
+extern Microcode *resume_stubs;                /* stubs of resumed analysis */
 
 extern const ConfigTable *CFGRECOVERY_CONFIG;
 const std::string CFGRECOVERY_CONFIG_FILENAME = ".cfgrecovery";
@@ -0,0 +1,49 @@
+#
+# Measure the cost of stop conditions on Simulator.cont.
+#
+# Usage: pynsight bench_stop_conditions.py [-n N] [-w REG] [-s STEPS] binary
+#
+# The program is run from its entrypoint, first without stop condition,
+# then with N breakpoints set on addresses that are never reached and,
+# if a register is given with -w, with N more watchpoints on this
+# register. The register must be defined at the entrypoint.
+#
+import insight
+import argparse
+import time
+
+parser = argparse.ArgumentParser(prog="bench_stop_conditions")
+parser.add_argument('-n', '--number', help='number of stop conditions',
+                    dest="number", default=1000, type=int)
+parser.add_argument('-s', '--max-steps', help='number of steps to run',
+                    dest="max_steps", default=100000, type=int)
+parser.add_argument('-w', '--watch', help='register read by watchpoints',
+                    dest="watch", default=None, metavar="register")
+parser.add_argument('-d', '--domain', help='simulation domain',
+                    dest="domain", default="concrete")
+parser.add_argument('inputfile', help='binary file')
+args = parser.parse_args()
+
+program = insight.io.load_bfd(args.inputfile)
+simulator = program.simulator(args.domain)
+unreached = program.info()["entrypoint"] + (1 << 20)
+
+
+def measure(label):
+    simulator.run()
+    start = time.time()
+    (reason, steps, info) = simulator.cont(max_steps=args.max_steps)
+    elapsed = time.time() - start
+    print "%-24s %8d steps %8.3fs %10.0f instr/s (%s)" % \
+        (label, steps, elapsed, steps / max(elapsed, 1e-6), reason)
+
+measure("no stop condition")
+for i in range(args.number):
+    simulator.add_breakpoint(unreached + i)
+measure("%d breakpoints" % args.number)
+
+if args.watch is not None:
+    for i in range(args.number):
+        simulator.add_watchpoint("(EQ %%%s 0x%x{0;32}){0;1}" %
+                                 (args.watch, unreached + i))
+    measure("+ %d watchpoints" % args.number)
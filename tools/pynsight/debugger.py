@@ -282,8 +282,10 @@ def cont(a=0, show_arrows=True):
     """
     Continue simulation of the program.
 
-    The simulation is continued until a choice point is encountered. Actual-
-    ly 'step' function is iterated until a simulation exception is raised.
+    The simulation is continued until a choice point, a sink node or a stop
+    condition is encountered or until a simulation exception is raised. The
+    loop runs in the simulator without the Python interpreter lock, which is
+    only taken back to call the callables of Python watchpoints.
 
     If in the current state several arrows are enabled then 'a' is the index
     of the arrow used as the first micro-step.
@@ -299,9 +301,13 @@ def cont(a=0, show_arrows=True):
         return
     __record(pc(), cont, a)
     try:
-        simulator.step(a)
-        while True:
-            simulator.step()
+        (reason, steps, info) = simulator.cont(arrow=a)
+        if reason == "stop-condition":
+            print "stop condition {} reached: {}".format(*info)
+        elif reason == "sink-node":
+            print "sink node reached after(0x{:x}, {})".format(*info)
+        elif reason == "choice":
+            print "stop in a configuration with several output arrows"
     except:
         simulation_error()
     exec_hooks(cont)
@@ -1282,19 +1288,19 @@ def unset_compare_state():
         return
     simulator.unset_compare_state()
 
-def compare_states():
+def compare_states(id=None):
     """
     Compare current state with the one marked for comparison.
 
     The function display the registers and memory cells that differ between
     the compared states i.e. the current one and the one marked for using
-    'set_compare_state' function.
+    'set_compare_state' function or, if 'id' is given, the snapshot 'id'.
     """
     global simulator
     if simulator is None:
         print "program is not running"
         return
-    diffs = simulator.compare_states()
+    diffs = simulator.compare_states(id)
     if diffs is None:
         return
     print "state comparison:"
@@ -1304,6 +1310,138 @@ def compare_states():
         else:
             print "0x{:x}".format (loc), v1, v2
 
+def trace(on=True, capacity=0, period=1000, filename=None):
+    """
+    Start or stop the recording of the microsteps.
+
+    Each microstep is recorded with the value it writes; the records can
+    be listed with 'history' and the simulation can go back to the state
+    before any of them with 'seek', without running the program again.
+
+    Parameters:
+    - on       : start a new trace if True, stop the current one otherwise.
+    - capacity : maximal number of records (0 means no limit); the oldest
+                 ones are dropped.
+    - period   : number of records between two copies of the state; a
+                 smaller period makes 'seek' faster but uses more memory.
+    - filename : if not 'None', the records are also written into this
+                 file.
+    """
+    global simulator
+    if simulator is None:
+        print "program is not running"
+        return
+    if on:
+        simulator.trace_start(capacity=capacity, period=period,
+                              file=filename)
+    else:
+        simulator.trace_stop()
+
+
+def history(n=10, pc=None, reg=None, addr=None):
+    """
+    Display the last records of the trace.
+
+    If one of 'pc', 'reg' or 'addr' is given, only the records of the
+    microsteps at this address, or writing this register or this memory
+    byte, are displayed.
+
+    Parameters:
+    - n    : the number of records to display.
+    - pc   : the address of the instructions.
+    - reg  : the name of a register.
+    - addr : the address of a byte of memory.
+    """
+    global simulator
+    if simulator is None or simulator.trace_range() is None:
+        print "no trace is recorded"
+        return
+    (begin, end, position) = simulator.trace_range()
+    records = []
+    i = position - 1
+    while len(records) < n and i >= begin:
+        i = simulator.trace_find(pc=pc, register=reg, address=addr, start=i,
+                                 backward=True)
+        if i is None:
+            break
+        records.insert(0, simulator.trace_get(i))
+        i -= 1
+    for (i, (g, l), a, lvalue, value) in records:
+        if lvalue is None:
+            what = ""
+        elif isinstance(lvalue, str):
+            what = "{} := 0x{:x}".format(lvalue, value)
+        else:
+            what = "[0x{:x}]{{{}}} := 0x{:x}".format(lvalue[0], lvalue[1],
+                                                       value)
+        print "{:8d} 0x{:x}.{:d} ({:d}) {}".format(i, g, l, a, what)
+
+
+def seek(i):
+    """
+    Go back to the state before the record 'i' of the trace.
+
+    The records that follow are kept until the simulation goes on; it then
+    replaces them.
+
+    Parameters:
+    - i : the index of a record as displayed by 'history'.
+    """
+    global simulator
+    if simulator is None:
+        print "program is not running"
+        return
+    simulator.trace_seek(i)
+    arrows()
+
+
+def snapshot():
+    """
+    Keep a copy of the current state and return its identifier.
+
+    Snapshots share the memory pages that are not modified afterwards so
+    many of them can be kept; they are used with 'restore' and
+    'compare_states'.
+    """
+    global simulator
+    if simulator is None:
+        print "program is not running"
+        return
+    return simulator.snapshot()
+
+
+def restore(id, drop=False):
+    """
+    Go back to the state of a snapshot.
+
+    Parameters:
+    - id   : the identifier returned by 'snapshot'.
+    - drop : if True, the snapshot is forgotten.
+    """
+    global simulator
+    if simulator is None:
+        print "program is not running"
+        return
+    simulator.restore(id)
+    if drop:
+        simulator.drop_snapshot(id)
+    arrows()
+
+
+def reverse_step(n=1):
+    """
+    Go back 'n' instructions. The trace must have been started (see
+    'trace') before these instructions were executed.
+    """
+    global simulator
+    if simulator is None or simulator.trace_range() is None:
+        print "no trace is recorded"
+        return
+    if simulator.reverse_step(n) < n:
+        print "beginning of the trace reached"
+    arrows()
+
+
 def __record(addr, fun, arg, reset = False):
     global recorder;
     if reset:
@@ -27,8 +27,10 @@
  * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include <algorithm>
 #include <stdexcept>
 #include <fstream>
+#include <signal.h>
 #include <kernel/annotations/AsmAnnotation.hh>
 #include <kernel/annotations/StubAnnotation.hh>
 #include <kernel/annotations/NextInstAnnotation.hh>
@@ -36,7 +38,9 @@
 #include <io/binary/BinutilsBinaryLoader.hh>
 #include <io/expressions/expr-parser.hh>
 #include <decoders/binutils/BinutilsDecoder.hh>
+#include <kernel/expressions/exprutils.hh>
 #include <utils/tools.hh>
+#include <utils/unordered11.hh>
 
 #include <kernel/microcode/MicrocodeArchitecture.hh>
 #include <kernel/SymbolTable.hh>
@@ -46,7 +50,9 @@
 #include <io/microcode/xml_microcode_generator.hh>
 
 #include "gengen.hh"
+#include "trace.hh"
 #include "pynsight.hh"
+#include <pythread.h>
 
 using std::vector;
 using std::list;
@@ -54,6 +60,8 @@ using std::string;
 using std::map;
 using pynsight::Program;
 using pynsight::GenericGenerator;
+using pynsight::Trace;
+using pynsight::TraceRecord;
 
 class GenericInsightSimulator;
 
@@ -95,6 +103,7 @@ public:
   virtual ~Breakpoint ();
 
   virtual bool stop (GenericInsightSimulator *S);
+  virtual const MicrocodeAddress &get_address () const;
   virtual void set_cond (const Expr *e);
   virtual void reset_cond ();
   virtual void output_text (std::ostream &out) const;
@@ -112,13 +121,19 @@ public:
   virtual ~Watchpoint ();
 
   virtual bool stop (GenericInsightSimulator *S);
+  virtual const Expr *get_cond () const;
   virtual void output_text (std::ostream &out) const;
   virtual bool equals (const StopCondition *other) const;
   virtual void reset (GenericInsightSimulator *S);
 
+  /* true if the watchpoint has to be evaluated at the next check */
+  bool is_pending () const { return pending; }
+  void set_pending (bool p) { pending = p; }
+
 private:
   Expr *cond;
   bool last_value;
+  bool pending;
 };
 
 class PyWatchpoint : public StopCondition
@@ -138,6 +153,32 @@ private:
 
 typedef std::set<StopCondition *> StopConditionSet;
 
+/*! Why the simulation stopped. The stepping functions below fill it
+ * instead of raising Python exceptions so that they can run without the
+ * GIL; s_stop_reason_error () turns it into an exception afterwards. */
+struct StopReason
+{
+  enum Kind {
+    RUNNING,
+    MAX_STEPS,
+    INTERRUPTED,
+    STOP_CONDITION,
+    SINK_NODE,
+    NOT_DETERMINISTIC,
+    JUMP_TO_INVALID_ADDRESS,
+    UNDEFINED_VALUE,
+    CODE_CHANGED,
+    INFEASIBLE_ASSUMPTION
+  };
+
+  StopReason () : kind (RUNNING), addr (), sc (NULL), message () { }
+
+  Kind kind;
+  MicrocodeAddress addr;
+  const StopCondition *sc;
+  string message;
+};
+
 struct CmpMicrocodeAddress
 {
   bool operator() (const MicrocodeAddress &a1, const MicrocodeAddress &a2) const
@@ -146,6 +187,22 @@ struct CmpMicrocodeAddress
   }
 };
 
+struct HashMicrocodeAddress
+{
+  size_t operator() (const MicrocodeAddress &a) const
+  {
+    return a.hashcode ();
+  }
+};
+
+struct EqMicrocodeAddress
+{
+  bool operator() (const MicrocodeAddress &a1, const MicrocodeAddress &a2) const
+  {
+    return a1.equals (a2);
+  }
+};
+
 class GenericInsightSimulator : public pynsight::MicrocodeReference {
 public:
   typedef vector<StmtArrow *> ArrowVector;
@@ -173,7 +230,11 @@ public:
   virtual bool has_state () = 0;
   virtual void *get_state () = 0;
 
-  virtual void *trigger_arrow (void *from, StmtArrow *a) = 0;
+  virtual void *trigger_arrow (void *from, StmtArrow *a,
+			       StopReason &reason) = 0;
+  virtual bool microstep (StmtArrow *a, StopReason &reason);
+  virtual size_t cont (size_t max_steps, unsigned int aindex,
+		       StopReason &reason);
 
   virtual string get_memory (address_t addr);
   virtual string get_memory (void *p, address_t addr) = 0;
@@ -218,7 +279,48 @@ public:
   virtual void reset_stop_conditions ();
   virtual bool del_stop_condition (int id);
 
+  /* Watchpoints are only evaluated when an lvalue they read has been
+   * written. mark_written () records the lvalue assigned by the arrow a
+   * that has just been triggered; mark_all_written () is used when the
+   * state has been changed in some other way. */
+  virtual void mark_written (const StmtArrow *a);
+  virtual void mark_all_written ();
+
+  /* When a trace is started, each micro-step is appended to it with the
+   * value it wrote. Every period records, and after the records from
+   * which the next state cannot be rebuilt (guarded arrows, values or
+   * addresses that are not constants), a copy of the state is kept
+   * as a checkpoint; get_trace_state () rebuilds the state before any
+   * record from the previous checkpoint. With a capacity, the oldest
+   * records are dropped, up to a checkpoint. */
+  virtual void start_trace (size_t capacity, size_t period, FILE *out);
+  virtual void stop_trace ();
+  virtual const Trace *get_trace () const;
+  virtual size_t get_trace_position () const;
+  virtual void *get_trace_state (size_t i);
+  virtual void set_trace_position (size_t i);
+  /* called when the state has been changed out of a micro-step */
+  virtual void trace_state_changed ();
+
+  /* Snapshots are copies of the state kept by id. The memories of the
+   * copies share their pages with the original, so a snapshot costs its
+   * registers and the pages written after it was taken. get_snapshot ()
+   * returns a new copy of the snapshot or NULL. */
+  virtual unsigned long take_snapshot ();
+  virtual void *get_snapshot (unsigned long id);
+  virtual bool drop_snapshot (unsigned long id);
+  virtual void drop_snapshots ();
+
+  virtual void *copy_state (void *s, const MicrocodeAddress &pc) = 0;
+  virtual void set_register (void *p, const RegisterDesc *reg,
+			     word_t value) = 0;
+  virtual void write_memory (void *p, address_t addr,
+			     const ConcreteValue &value) = 0;
+
   virtual Option<ConcreteValue> eval (const Expr *e) const = 0;
+  /* Value of e only if it is a constant in the current state, without
+   * asking the solver for it. */
+  virtual Option<ConcreteValue> eval_constant (const Expr *e) const = 0;
   virtual Option<bool> eval_condition (const Expr *e) const = 0;
   virtual Option<string> get_instruction (address_t addr);
 
@@ -230,7 +332,7 @@ public:
   virtual void *assume (void *p, const Expr *e) const = 0;
   virtual bool assume (const Expr *e);
   virtual void add_assumption (const MicrocodeAddress &ma, const Expr *e);
-  virtual bool apply_assumption ();
+  virtual bool apply_assumption (StopReason &reason);
   virtual bool detach_assumption (const MicrocodeAddress &addr);
   virtual const AssumptionMap &get_assumptions () const;
 
@@ -239,12 +341,57 @@ public:
   virtual GenericGenerator *compare_states (void *s1, void *s2) const = 0;
 
 protected:
+  typedef vector<Watchpoint *> WatchpointVector;
+  typedef std::unordered_map<MicrocodeAddress, vector<Breakpoint *>,
+			     HashMicrocodeAddress,
+			     EqMicrocodeAddress> BreakpointIndex;
+  typedef std::unordered_map<string, WatchpointVector> RegisterIndex;
+  typedef std::unordered_map<address_t, WatchpointVector> MemoryIndex;
+
   Program *prg;
   Microcode *mc;
   MicrocodeArchitecture *march;
   ArrowVector *arrows;
   StopConditionSet *stop_conditions;
   AssumptionMap assumptions;
+
+  /* stop conditions of stop_conditions sorted by what they depend on */
+  BreakpointIndex breakpoints;
+  WatchpointVector watchpoints;
+  /* watchpoints reading a register, indexed by its label */
+  RegisterIndex register_watchpoints;
+  /* watchpoints reading a byte at a constant address */
+  MemoryIndex memory_watchpoints;
+  /* watchpoints reading the memory, and those reading it at an address
+   * that is not a constant */
+  WatchpointVector memory_readers;
+  WatchpointVector any_address_watchpoints;
+  WatchpointVector pending_watchpoints;
+  /* evaluated after each micro-step (e.g. PyWatchpoint) */
+  vector<StopCondition *> other_stop_conditions;
+
+  Trace *trace;
+  size_t trace_capacity;
+  size_t trace_period;
+  /* the current state is the one before this record */
+  size_t trace_position;
+  /* pc of the state before the record trace->end () */
+  MicrocodeAddress trace_end_pc;
+  /* copies of the states before some records, by index */
+  map<size_t, void *> trace_checkpoints;
+
+  map<unsigned long, void *> snapshots;
+  unsigned long next_snapshot;
+
+private:
+  void add_watchpoint (Watchpoint *wp);
+  void remove_watchpoint (Watchpoint *wp);
+  void mark_pending (const WatchpointVector &wps);
+
+  void trace_arrow (const StmtArrow *a, TraceRecord &r);
+  void trace_written (const StmtArrow *a, TraceRecord &r);
+  void truncate_trace ();
+  void add_trace_checkpoint ();
 };
 
 template <typename Stepper>
@@ -266,10 +413,13 @@ public:
 
   virtual bool has_state ();
   virtual void *get_state ();
-  virtual void *trigger_arrow (void *from, StmtArrow *a);
+  virtual void *trigger_arrow (void *from, StmtArrow *a, StopReason &reason);
+  virtual void *copy_state (void *s, const MicrocodeAddress &pc);
 
   virtual void set_memory (void *p, address_t addr, const Value &value);
   virtual void set_memory (void *p, address_t addr, uint8_t value);
+  virtual void write_memory (void *p, address_t addr,
+			     const ConcreteValue &value);
   virtual string get_memory (void *p, address_t addr);
   virtual Value get_memory_value (void *p, address_t addr);
   virtual bool check_memory_range (void *s, address_t addr, size_t len);
@@ -297,6 +447,7 @@ public:
   virtual MicrocodeAddress get_pc ();
 
   virtual Option<ConcreteValue> eval (const Expr *e) const;
+  virtual Option<ConcreteValue> eval_constant (const Expr *e) const;
   virtual Option<bool> eval_condition (const Expr *e) const;
   virtual Stepper *get_stepper ();
 
@@ -340,6 +491,9 @@ private:
 struct Simulator {
   PyObject_HEAD
   GenericInsightSimulator *gsim;
+  /* set while cont () runs without the GIL, with the thread running it */
+  bool in_cont;
+  long cont_thread;
 };
 
 class AbstractCodeException : public Decoder::Exception
@@ -361,6 +515,9 @@ s_Simulator_microstep (PyObject *self, PyObject *args);
 static PyObject *
 s_Simulator_step (PyObject *self, PyObject *args);
 
+static PyObject *
+s_Simulator_cont (PyObject *self, PyObject *args, PyObject *kwds);
+
 static PyObject *
 s_Simulator_state (PyObject *self, PyObject *args);
 
@@ -446,7 +603,46 @@ static PyObject *
 s_Simulator_unset_compare_state (PyObject *self, PyObject *);
 
 static PyObject *
-s_Simulator_compare_states (PyObject *self, PyObject *);
+s_Simulator_compare_states (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_trace_start (PyObject *self, PyObject *args, PyObject *kwds);
+
+static PyObject *
+s_Simulator_trace_stop (PyObject *self, PyObject *);
+
+static PyObject *
+s_Simulator_trace_range (PyObject *self, PyObject *);
+
+static PyObject *
+s_Simulator_trace_get (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_trace_records (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_trace_find (PyObject *self, PyObject *args, PyObject *kwds);
+
+static PyObject *
+s_Simulator_trace_state (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_trace_seek (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_snapshot (PyObject *self, PyObject *);
+
+static PyObject *
+s_Simulator_restore (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_drop_snapshot (PyObject *self, PyObject *args);
+
+static PyObject *
+s_Simulator_reverse_step (PyObject *self, PyObject *args);
+
+static bool
+s_try_set_state (GenericInsightSimulator *S, void *s);
 
 static PyTypeObject SimulatorType = {
   PyObject_HEAD_INIT(NULL)
@@ -481,6 +677,9 @@ static PyMethodDef SimulatorMethods[] = {
    "\n" },
  { "step", s_Simulator_step, METH_VARARGS,
    "\n" },
+ { "cont",
+   (PyCFunction) s_Simulator_cont, METH_VARARGS|METH_KEYWORDS,
+   "\n" },
  { "state", s_Simulator_state, METH_NOARGS,
    "\n" },
  { "set_memory", s_Simulator_set_memory, METH_VARARGS,
@@ -533,13 +732,45 @@ static PyMethodDef SimulatorMethods[] = {
  { "get_assumptions", s_Simulator_get_assumptions, METH_NOARGS, "\n" },
  { "set_compare_state", s_Simulator_set_compare_state, METH_NOARGS, "\n" },
  { "unset_compare_state", s_Simulator_unset_compare_state, METH_NOARGS, "\n" },
- { "compare_states", s_Simulator_compare_states, METH_NOARGS, "\n" },
+ { "compare_states", s_Simulator_compare_states, METH_VARARGS,
+   "Compare the current state with the reference state or, if an id is "
+   "given, with this snapshot.\n" },
+ { "trace_start",
+   (PyCFunction) s_Simulator_trace_start, METH_VARARGS|METH_KEYWORDS,
+   "Record the micro-steps; keep at most 'capacity' records (0 for no "
+   "limit), a checkpoint every 'period' records, and append the records "
+   "to 'file' if given.\n" },
+ { "trace_stop", s_Simulator_trace_stop, METH_NOARGS, "\n" },
+ { "trace_range", s_Simulator_trace_range, METH_NOARGS,
+   "Returns (begin, end, position) of the trace or None.\n" },
+ { "trace_get", s_Simulator_trace_get, METH_VARARGS,
+   "Returns the record i as (i, pc, arrow, lvalue, value).\n" },
+ { "trace_records", s_Simulator_trace_records, METH_VARARGS,
+   "Iterate over the records from start to end.\n" },
+ { "trace_find",
+   (PyCFunction) s_Simulator_trace_find, METH_VARARGS|METH_KEYWORDS,
+   "Index of the first record matching pc, register and address.\n" },
+ { "trace_state", s_Simulator_trace_state, METH_VARARGS,
+   "Returns the state before the record i.\n" },
+ { "trace_seek", s_Simulator_trace_seek, METH_VARARGS,
+   "Go back to the state before the record i.\n" },
+ { "snapshot", s_Simulator_snapshot, METH_NOARGS,
+   "Keep a copy of the current state and return its id.\n" },
+ { "restore", s_Simulator_restore, METH_VARARGS,
+   "Set the current state to a copy of the snapshot id.\n" },
+ { "drop_snapshot", s_Simulator_drop_snapshot, METH_VARARGS,
+   "Forget the snapshot id.\n" },
+ { "reverse_step", s_Simulator_reverse_step, METH_VARARGS,
+   "Go back n instructions (1 by default) in the trace; returns the "
+   "number of instructions actually undone.\n" },
  { NULL, NULL, 0, NULL }
 };
 
 static bool
 s_init ()
 {
+  // cont () releases the GIL and PyWatchpoints take it back.
+  PyEval_InitThreads ();
   SimulatorType.tp_methods = SimulatorMethods;
   if (PyType_Ready (&SimulatorType) < 0)
     return false;
@@ -564,6 +795,8 @@ pynsight::simulator (Program *P, SimulationDomain dom)
 
   PyObject_Init ((PyObject *) S, &SimulatorType);
 
+  S->in_cont = false;
+  S->cont_thread = 0;
   if (dom == pynsight::SIM_SYMBOLIC)
     S->gsim = new InsightSimulator<SymbolicStepper> (P);
   else
@@ -596,12 +829,32 @@ s_CodeChangedException (CodeChangedException &e)
   PyErr_SetObject (pynsight::CodeChangedException, ma);
 }
 
+/* While cont () runs, the simulator can only be read, and only by the
+ * callbacks of its stop conditions, which run in the same thread. */
+static bool
+s_check_not_running (PyObject *self, bool read_only)
+{
+  Simulator *S = (Simulator *) self;
+
+  if (S->in_cont &&
+      (! read_only || S->cont_thread != PyThread_get_thread_ident ()))
+    {
+      PyErr_SetString (PyExc_RuntimeError, "simulator is running");
+      return false;
+    }
+
+  return true;
+}
+
 static PyObject *
 s_Simulator_run (PyObject *p, PyObject *args)
 {
   GenericInsightSimulator *S = ((Simulator *) p)->gsim;
   unsigned long start;
 
+  if (! s_check_not_running (p, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "k", &start))
     {
       PyErr_Clear ();
@@ -632,6 +885,7 @@ s_Simulator_run (PyObject *p, PyObject *args)
     {
       s_CodeChangedException (e);
     }
+  S->trace_state_changed ();
   S->delete_state (is);
 
   return result;
@@ -649,6 +903,52 @@ s_StopConditionReached (const StopCondition *sc)
   return NULL;
 }
 
+/* Raise the exception corresponding to reason; returns false if one is
+ * raised, possibly by the callback of a PyWatchpoint. */
+static bool
+s_stop_reason_error (const StopReason &reason)
+{
+  if (PyErr_Occurred ())
+    return false;
+
+  switch (reason.kind)
+    {
+    case StopReason::RUNNING:
+    case StopReason::MAX_STEPS:
+      return true;
+    case StopReason::INTERRUPTED:
+      PyErr_SetNone (PyExc_KeyboardInterrupt);
+      break;
+    case StopReason::STOP_CONDITION:
+      s_StopConditionReached (reason.sc);
+      break;
+    case StopReason::SINK_NODE:
+      PyErr_SetObject (pynsight::SinkNodeReached,
+		       s_PyMicrocodeAddress (reason.addr));
+      break;
+    case StopReason::NOT_DETERMINISTIC:
+      PyErr_SetNone (pynsight::NotDeterministicBehaviorError);
+      break;
+    case StopReason::JUMP_TO_INVALID_ADDRESS:
+      PyErr_SetObject (pynsight::JumpToInvalidAddress,
+		       s_PyMicrocodeAddress (reason.addr));
+      break;
+    case StopReason::UNDEFINED_VALUE:
+      PyErr_SetString (pynsight::UndefinedValueError,
+		       reason.message.c_str ());
+      break;
+    case StopReason::CODE_CHANGED:
+      PyErr_SetObject (pynsight::CodeChangedException,
+		       s_PyMicrocodeAddress (reason.addr));
+      break;
+    case StopReason::INFEASIBLE_ASSUMPTION:
+      PyErr_SetNone (PyExc_ValueError);
+      break;
+    }
+
+  return false;
+}
+
 static bool
 s_check_state (GenericInsightSimulator *S)
 {
@@ -663,38 +963,11 @@ s_check_state (GenericInsightSimulator *S)
 static bool
 s_trigger_arrow (GenericInsightSimulator *S, StmtArrow *a)
 {
-  void *st = S->get_state ();
-  void *newst = S->trigger_arrow (st, a);
-
-  if (newst != NULL)
-    {
-      try {
-	S->set_state (newst);
-
-	if (S->get_number_of_arrows () == 0)
-	  {
-	    MicrocodeAddress a = S->get_pc (st);
-	    PyErr_SetObject (pynsight::SinkNodeReached,
-			     s_PyMicrocodeAddress (a));
-	  }
-	else if (! PyErr_Occurred ())
-	  {
-	    if (S->apply_assumption ())
-	      {
-		const StopCondition *bp = S->check_stop_conditions ();
-		if (bp != NULL)
-		  s_StopConditionReached (bp);
-	      }
-	  }
-      } catch (CodeChangedException &e) {
-	s_CodeChangedException (e);
-      }
+  StopReason reason;
 
-      S->delete_state (newst);
-    }
-  S->delete_state (st);
+  S->microstep (a, reason);
 
-  return ! PyErr_Occurred ();
+  return s_stop_reason_error (reason);
 }
 
 static bool
@@ -718,6 +991,9 @@ s_Simulator_microstep (PyObject *self, PyObject *args)
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
   unsigned int aindex = 0;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) || ! PyArg_ParseTuple (args, "I", &aindex))
     return NULL;
 
@@ -734,12 +1010,16 @@ s_Simulator_step (PyObject *self, PyObject *args)
 {
   PyObject *result = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
-  MicrocodeAddress ep = S->get_pc ();
   int aindex = -1;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) || ! PyArg_ParseTuple (args, "|I", &aindex))
     return NULL;
 
+  MicrocodeAddress ep = S->get_pc ();
+
   if (S->get_number_of_arrows () > 1)
     {
       if (aindex >= 0)
@@ -779,12 +1059,110 @@ s_Simulator_step (PyObject *self, PyObject *args)
   return result;
 }
 
+static volatile sig_atomic_t s_interrupted = 0;
+
+static void
+s_interrupt (int)
+{
+  s_interrupted = 1;
+}
+
+static PyObject *
+s_Simulator_cont (PyObject *self, PyObject *args, PyObject *kwds)
+{
+  static const char *kwlists[] = { "max_steps", "arrow", NULL };
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  PyObject *maxobj = Py_None;
+  unsigned int aindex = 0;
+
+  if (! s_check_not_running (self, false))
+    return NULL;
+
+  if (! s_check_state (S) ||
+      ! PyArg_ParseTupleAndKeywords (args, kwds, "|OI", (char **) kwlists,
+				     &maxobj, &aindex))
+    return NULL;
+
+  size_t max_steps = (size_t) -1;
+  if (maxobj != Py_None)
+    {
+      long m = PyInt_AsLong (maxobj);
+      if (m == -1 && PyErr_Occurred ())
+	return NULL;
+      if (m < 0)
+	{
+	  PyErr_SetString (PyExc_ValueError, "negative number of steps");
+	  return NULL;
+	}
+      max_steps = m;
+    }
+
+  if (S->get_number_of_arrows () > 1 && aindex >= S->get_number_of_arrows ())
+    {
+      PyErr_SetString (PyExc_IndexError, "invalid microcode-arrow index");
+      return NULL;
+    }
+
+  // The Python handler of SIGINT can not run while the GIL is released;
+  // the loop polls s_interrupted instead.
+  StopReason reason;
+  size_t steps;
+  PyOS_sighandler_t sigint = PyOS_getsig (SIGINT);
+
+  s_interrupted = 0;
+  if (sigint != SIG_IGN)
+    PyOS_setsig (SIGINT, s_interrupt);
+  ((Simulator *) self)->in_cont = true;
+  ((Simulator *) self)->cont_thread = PyThread_get_thread_ident ();
+  Py_BEGIN_ALLOW_THREADS
+  steps = S->cont (max_steps, aindex, reason);
+  Py_END_ALLOW_THREADS
+  ((Simulator *) self)->in_cont = false;
+  if (sigint != SIG_IGN)
+    PyOS_setsig (SIGINT, sigint);
+
+  if (PyErr_Occurred ())
+    return NULL;
+
+  const char *kind;
+  PyObject *info;
+
+  switch (reason.kind)
+    {
+    case StopReason::MAX_STEPS:
+      kind = "max-steps";
+      info = pynsight::None ();
+      break;
+    case StopReason::STOP_CONDITION:
+      kind = "stop-condition";
+      info = Py_BuildValue ("(k,s)", reason.sc->get_id (),
+			    reason.sc->to_string ().c_str ());
+      break;
+    case StopReason::SINK_NODE:
+      kind = "sink-node";
+      info = s_PyMicrocodeAddress (reason.addr);
+      break;
+    case StopReason::NOT_DETERMINISTIC:
+      kind = "choice";
+      info = pynsight::None ();
+      break;
+    default:
+      s_stop_reason_error (reason);
+      return NULL;
+    }
+
+  return Py_BuildValue ("(s,k,N)", kind, (unsigned long) steps, info);
+}
+
 static PyObject *
 s_Simulator_state (PyObject *self, PyObject *)
 {
   PyObject *result;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   if (! S->has_state ())
     result = pynsight::None ();
   else
@@ -805,6 +1183,9 @@ s_Simulator_set_memory (PyObject *self, PyObject *args)
   unsigned char byte;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) || ! PyArg_ParseTuple (args, "kb", &addr, &byte))
     return NULL;
 
@@ -827,6 +1208,9 @@ s_Simulator_unset_memory (PyObject *self, PyObject *args, PyObject *kwds)
   unsigned char keep;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) ||
       !PyArg_ParseTupleAndKeywords (args, kwds, "kkb", (char **) kwlists,
 				    &addr, &len, &keep))
@@ -855,6 +1239,9 @@ s_Simulator_get_memory (PyObject *self, PyObject *args)
   PyObject *result = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   if (! s_check_state (S) || !PyArg_ParseTuple (args, "k|k", &addr, &len))
     return NULL;
 
@@ -893,6 +1280,9 @@ s_Simulator_concretize_memory (PyObject *self, PyObject *args)
   PyObject *result = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) || !PyArg_ParseTuple (args, "k|k", &addr, &len))
     return NULL;
 
@@ -913,6 +1303,9 @@ s_Simulator_set_register (PyObject *self, PyObject *args)
   unsigned long regval;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) || !PyArg_ParseTuple (args, "sk", &regname, &regval))
     return NULL;
 
@@ -943,6 +1336,9 @@ s_Simulator_unset_register (PyObject *self, PyObject *args, PyObject *kwds)
   unsigned char keep;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) ||
       !PyArg_ParseTupleAndKeywords (args, kwds, "sb", (char **) kwlists,
 				    &regname, &keep))
@@ -971,6 +1367,9 @@ s_Simulator_get_register (PyObject *self, PyObject *args)
   const char *regname;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   if (! s_check_state (S) || !PyArg_ParseTuple (args, "s", &regname))
     return NULL;
 
@@ -998,6 +1397,9 @@ s_Simulator_concretize_register (PyObject *self, PyObject *args)
   const char *regname;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S) || !PyArg_ParseTuple (args, "s", &regname))
     return NULL;
 
@@ -1028,6 +1430,9 @@ s_Simulator_get_pc (PyObject *self, PyObject *)
   PyObject *result = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   if (s_check_state (S))
     {
       MicrocodeAddress a = S->get_pc ();
@@ -1069,6 +1474,9 @@ s_Simulator_get_arrows (PyObject *self, PyObject *)
 {
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   return pynsight::generic_generator_new (new ArrowsIterator (S));
 }
 
@@ -1104,6 +1512,9 @@ s_Simulator_get_breakpoints (PyObject *self, PyObject *)
 {
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   return pynsight::generic_generator_new (new StopConditionsIterator (S));
 }
 
@@ -1114,6 +1525,9 @@ s_Simulator_add_breakpoint (PyObject *self, PyObject *args)
   unsigned long laddr = 0;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "k|k", &gaddr, &laddr))
     return NULL;
 
@@ -1135,6 +1549,9 @@ s_Simulator_set_cond (PyObject *self, PyObject *args)
   const char *condition = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "k|z", &id, &condition))
     return NULL;
 
@@ -1172,6 +1589,9 @@ s_Simulator_add_watchpoint (PyObject *self, PyObject *args)
   const char *condition = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "s", &condition))
     return NULL;
 
@@ -1195,6 +1615,9 @@ s_Simulator_add_pywatchpoint (PyObject *self, PyObject *args)
   PyObject *callable = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "O", &callable))
     return NULL;
   assert (PyCallable_Check (callable));
@@ -1218,6 +1641,9 @@ s_Simulator_del_breakpoint (PyObject *self, PyObject *args)
   unsigned long id = 0;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "k", &id))
     return NULL;
 
@@ -1233,6 +1659,9 @@ s_Simulator_eval (PyObject *self, PyObject *args)
   const char *condition = NULL;
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "s", &condition))
     return NULL;
 
@@ -1288,6 +1717,9 @@ s_Simulator_load_mc (PyObject *self, PyObject *args)
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
   const char *filename;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "s", &filename))
     return NULL;
 
@@ -1302,6 +1734,9 @@ s_Simulator_save_mc (PyObject *self, PyObject *args)
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
   const char *filename;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "s", &filename))
     return NULL;
 
@@ -1318,6 +1753,9 @@ s_Simulator_load_stub (PyObject *self, PyObject *args)
   unsigned long addr;
   int fold = 0;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! PyArg_ParseTuple (args, "sk|i", &filename, &addr, &fold))
     return NULL;
 
@@ -1333,6 +1771,9 @@ s_Simulator_assume (PyObject *self, PyObject *args)
   const char *constraint;
   unsigned long g, l = 0;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (! s_check_state (S))
     return NULL;
 
@@ -1354,7 +1795,9 @@ s_Simulator_assume (PyObject *self, PyObject *args)
 
   if (ma.equals (S->get_pc ()))
     {
-      if (S->apply_assumption ())
+      StopReason reason;
+      S->apply_assumption (reason);
+      if (s_stop_reason_error (reason))
 	result = pynsight::None ();
     }
   else
@@ -1372,6 +1815,9 @@ s_Simulator_remove_assumption (PyObject *self, PyObject *args)
   PyObject *result = NULL;
   unsigned long g, l = 0;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   if (PyArg_ParseTuple (args, "k|k", &g, &l))
     {
       MicrocodeAddress ma (g,l);
@@ -1418,6 +1864,9 @@ s_Simulator_get_assumptions (PyObject *self, PyObject *)
 {
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, true))
+    return NULL;
+
   return pynsight::generic_generator_new (new AssumptionsIterator (S));
 }
 
@@ -1426,6 +1875,9 @@ s_Simulator_set_compare_state (PyObject *self, PyObject *)
 {
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   S->set_compare_state (true);
 
   return pynsight::None ();
@@ -1436,17 +1888,48 @@ s_Simulator_unset_compare_state (PyObject *self, PyObject *)
 {
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
+  if (! s_check_not_running (self, false))
+    return NULL;
+
   S->set_compare_state (false);
 
   return pynsight::None ();
 }
 
 static PyObject *
-s_Simulator_compare_states (PyObject *self, PyObject *)
+s_Simulator_compare_states (PyObject *self, PyObject *args)
 {
   GenericInsightSimulator *S = ((Simulator *) self)->gsim;
-  GenericGenerator *gg = S->compare_states ();
+  PyObject *id = Py_None;
+  GenericGenerator *gg;
   PyObject *result;
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "|O", &id))
+    return NULL;
+
+  if (id == Py_None)
+    gg = S->compare_states ();
+  else
+    {
+      unsigned long i = PyInt_AsUnsignedLongMask (id);
+      if (PyErr_Occurred () || ! s_check_state (S))
+	return NULL;
+
+      void *snapshot = S->get_snapshot (i);
+      if (snapshot == NULL)
+	{
+	  PyErr_SetString (PyExc_LookupError, "unknown snapshot");
+	  return NULL;
+	}
+      void *s = S->get_state ();
+      gg = S->compare_states (snapshot, s);
+      S->delete_state (s);
+      S->delete_state (snapshot);
+    }
+
   if (gg != NULL)
     result = generic_generator_new (gg);
   else
@@ -1454,297 +1937,1205 @@ s_Simulator_compare_states (PyObject *self, PyObject *)
   return result;
 }
 
-/*****************************************************************************
- *
- * GenericInsightSimulator
- *
- *****************************************************************************/
-
-GenericInsightSimulator::GenericInsightSimulator (Program *P)
+static PyObject *
+s_Simulator_trace_start (PyObject *self, PyObject *args, PyObject *kwds)
 {
-  prg = P;
-  Py_INCREF (P);
-  mc = new Microcode ();
-  march = new MicrocodeArchitecture (P->loader->get_architecture ());
-  arrows = new ArrowVector ();
-  stop_conditions = new StopConditionSet;
-  if (prg->stubfactory)
-    prg->stubfactory->add_stubs (prg->concrete_memory, march, mc,
-				 prg->symbol_table);
-}
+  static const char *kwlists[] = { "capacity", "period", "file", NULL };
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long capacity = 0;
+  unsigned long period = 1000;
+  const char *filename = NULL;
 
-GenericInsightSimulator::~GenericInsightSimulator ()
-{
-  Py_DECREF (prg);
-  delete mc;
-  delete march;
+  if (! s_check_not_running (self, false))
+    return NULL;
 
-  delete arrows;
-  for (StopConditionSet::iterator i = stop_conditions->begin ();
-       i != stop_conditions->end (); i++) {
-    delete (*i);
-  }
-  delete stop_conditions;
+  if (! PyArg_ParseTupleAndKeywords (args, kwds, "|kkz", (char **) kwlists,
+				     &capacity, &period, &filename))
+    return NULL;
 
-  for (AssumptionMap::iterator i = assumptions.begin ();
-       i != assumptions.end (); i++) {
-    i->second->deref ();
-  }
-}
+  FILE *out = NULL;
+  if (filename != NULL)
+    {
+      out = fopen (filename, "wb");
+      if (out == NULL)
+	return PyErr_SetFromErrnoWithFilename (PyExc_IOError,
+					       (char *) filename);
+    }
+  S->start_trace (capacity, period, out);
 
-MicrocodeArchitecture *
-GenericInsightSimulator::get_march () const
-{
-  return march;
+  return pynsight::None ();
 }
 
-const Microcode *
-GenericInsightSimulator::get_microcode () const
+static PyObject *
+s_Simulator_trace_stop (PyObject *self, PyObject *)
 {
-  return mc;
-}
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
 
-Program *
-GenericInsightSimulator::get_program () const
-{
-  return prg;
-}
+  if (! s_check_not_running (self, false))
+    return NULL;
 
+  S->stop_trace ();
 
-void
-GenericInsightSimulator::clear_arrows ()
-{
-  arrows->clear ();
+  return pynsight::None ();
+}
+
+static bool
+s_check_trace (GenericInsightSimulator *S)
+{
+  if (S->get_trace () == NULL)
+    {
+      PyErr_SetString (PyExc_RuntimeError, "no trace is recorded");
+      return false;
+    }
+  return true;
+}
+
+static bool
+s_check_trace_index (GenericInsightSimulator *S, unsigned long i, bool end_ok)
+{
+  if (! s_check_trace (S))
+    return false;
+
+  const Trace *T = S->get_trace ();
+  if (i < T->begin () || i > T->end () || (i == T->end () && ! end_ok))
+    {
+      PyErr_SetString (PyExc_IndexError, "trace index out of range");
+      return false;
+    }
+  return true;
+}
+
+static PyObject *
+s_Simulator_trace_range (PyObject *self, PyObject *)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  const Trace *T = S->get_trace ();
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (T == NULL)
+    return pynsight::None ();
+
+  return Py_BuildValue ("(k,k,k)", (unsigned long) T->begin (),
+			(unsigned long) T->end (),
+			(unsigned long) S->get_trace_position ());
+}
+
+static PyObject *
+s_PyTraceRecord (const Trace *T, size_t i)
+{
+  const TraceRecord &r = T->at (i);
+  PyObject *lvalue;
+  PyObject *value;
+
+  if (r.kind == TraceRecord::REGISTER)
+    {
+      const RegisterDesc *reg = T->get_register (r.where);
+
+      if (reg->get_window_size () == reg->get_register_size ())
+	lvalue = Py_BuildValue ("s", reg->get_label ().c_str ());
+      else
+	{
+	  std::ostringstream oss;
+	  reg->output_text (oss);
+	  lvalue = Py_BuildValue ("s", oss.str ().c_str ());
+	}
+    }
+  else if (r.kind == TraceRecord::MEMORY)
+    lvalue = Py_BuildValue ("(k,k)", (unsigned long) r.where,
+			    (unsigned long) r.size / 8);
+  else
+    lvalue = pynsight::None ();
+
+  if (r.kind == TraceRecord::REGISTER || r.kind == TraceRecord::MEMORY)
+    value = PyLong_FromUnsignedLongLong (r.value);
+  else
+    value = pynsight::None ();
+
+  return Py_BuildValue ("(k,N,k,N,N)", (unsigned long) i,
+			s_PyMicrocodeAddress (r.get_pc ()),
+			(unsigned long) r.arrow, lvalue, value);
+}
+
+static PyObject *
+s_Simulator_trace_get (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long i;
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "k", &i) || ! s_check_trace_index (S, i, false))
+    return NULL;
+
+  return s_PyTraceRecord (S->get_trace (), i);
+}
+
+class TraceIterator : public pynsight::GenericGenerator
+{
+private:
+  GenericInsightSimulator *gsim;
+  size_t current;
+  size_t last;
+public:
+  TraceIterator (GenericInsightSimulator *gsim, size_t start, size_t end)
+    : gsim (gsim), current (start), last (end) { }
+
+  virtual ~TraceIterator () { }
+
+  PyObject *next () {
+    PyObject *result = NULL;
+    const Trace *T = gsim->get_trace ();
+
+    if (T != NULL && current < T->begin ())
+      current = T->begin ();
+    if (T == NULL || current >= T->end () || current >= last)
+      PyErr_SetNone (PyExc_StopIteration);
+    else
+      result = s_PyTraceRecord (T, current++);
+
+    return result;
+  }
+};
+
+static PyObject *
+s_Simulator_trace_records (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long start = 0;
+  unsigned long end = (unsigned long) -1;
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "|kk", &start, &end) || ! s_check_trace (S))
+    return NULL;
+
+  return pynsight::generic_generator_new (new TraceIterator (S, start, end));
+}
+
+static PyObject *
+s_Simulator_trace_find (PyObject *self, PyObject *args, PyObject *kwds)
+{
+  static const char *kwlists[] = {
+    "pc", "register", "address", "start", "backward", NULL
+  };
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  PyObject *pcobj = Py_None;
+  const char *regname = NULL;
+  PyObject *addrobj = Py_None;
+  PyObject *startobj = Py_None;
+  unsigned char backward = 0;
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (! PyArg_ParseTupleAndKeywords (args, kwds, "|OzOOb", (char **) kwlists,
+				     &pcobj, &regname, &addrobj, &startobj,
+				     &backward) ||
+      ! s_check_trace (S))
+    return NULL;
+
+  const Trace *T = S->get_trace ();
+  Trace::Pattern p;
+  size_t i = backward ? T->end () : T->begin ();
+
+  if (pcobj != Py_None)
+    {
+      p.with_pc = true;
+      p.pc = PyInt_AsUnsignedLongMask (pcobj);
+    }
+  if (addrobj != Py_None)
+    {
+      p.with_address = true;
+      p.address = PyInt_AsUnsignedLongMask (addrobj);
+    }
+  if (startobj != Py_None)
+    i = PyInt_AsUnsignedLongMask (startobj);
+  if (PyErr_Occurred ())
+    return NULL;
+
+  if (regname != NULL)
+    {
+      try
+	{
+	  p.reg = S->get_march ()->get_register (regname);
+	}
+      catch (Architecture::RegisterDescNotFound &e)
+	{
+	  PyErr_SetString (PyExc_LookupError, "unknown register");
+	  return NULL;
+	}
+    }
+
+  if (! T->find (p, i, backward))
+    return pynsight::None ();
+
+  return Py_BuildValue ("k", (unsigned long) i);
+}
+
+static PyObject *
+s_Simulator_trace_state (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long i;
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "k", &i) || ! s_check_trace_index (S, i, true))
+    return NULL;
+
+  void *s = S->get_trace_state (i);
+  if (s == NULL)
+    {
+      PyErr_SetString (PyExc_IndexError, "no checkpoint before this record");
+      return NULL;
+    }
+
+  PyObject *result = Py_BuildValue ("s", S->state_to_string (s).c_str ());
+  S->delete_state (s);
+
+  return result;
+}
+
+static bool
+s_trace_seek (GenericInsightSimulator *S, size_t i)
+{
+  void *s = S->get_trace_state (i);
+  if (s == NULL)
+    {
+      PyErr_SetString (PyExc_IndexError, "no checkpoint before this record");
+      return false;
+    }
+
+  bool result = false;
+
+  // the trace is kept; it is truncated at i by the next micro-step
+  S->mark_all_written ();
+  try
+    {
+      S->set_state (s);
+      result = true;
+    }
+  catch (CodeChangedException &e)
+    {
+      s_CodeChangedException (e);
+    }
+  S->set_trace_position (i);
+  S->delete_state (s);
+
+  return result;
+}
+
+static PyObject *
+s_Simulator_trace_seek (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long i;
+
+  if (! s_check_not_running (self, false))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "k", &i) || ! s_check_trace_index (S, i, true))
+    return NULL;
+
+  if (! s_trace_seek (S, i))
+    return NULL;
+
+  return pynsight::None ();
+}
+
+static PyObject *
+s_Simulator_snapshot (PyObject *self, PyObject *)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+
+  if (! s_check_not_running (self, true))
+    return NULL;
+
+  if (! s_check_state (S))
+    return NULL;
+
+  return Py_BuildValue ("k", S->take_snapshot ());
+}
+
+static PyObject *
+s_Simulator_restore (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long id;
+
+  if (! s_check_not_running (self, false))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "k", &id))
+    return NULL;
+
+  // the snapshot is copied since the current state may be modified
+  void *s = S->get_snapshot (id);
+  if (s == NULL)
+    {
+      PyErr_SetString (PyExc_LookupError, "unknown snapshot");
+      return NULL;
+    }
+
+  bool ok = s_try_set_state (S, s);
+  S->delete_state (s);
+  if (! ok)
+    return NULL;
+
+  return pynsight::None ();
+}
+
+static PyObject *
+s_Simulator_drop_snapshot (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  unsigned long id;
+
+  if (! s_check_not_running (self, false))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "k", &id))
+    return NULL;
+
+  if (! S->drop_snapshot (id))
+    {
+      PyErr_SetString (PyExc_LookupError, "unknown snapshot");
+      return NULL;
+    }
+
+  return pynsight::None ();
+}
+
+/* Like step (), an instruction is a sequence of records with the same
+ * global pc. */
+static PyObject *
+s_Simulator_reverse_step (PyObject *self, PyObject *args)
+{
+  GenericInsightSimulator *S = ((Simulator *) self)->gsim;
+  const Trace *T = S->get_trace ();
+  unsigned long n = 1;
+
+  if (! s_check_not_running (self, false))
+    return NULL;
+
+  if (! PyArg_ParseTuple (args, "|k", &n))
+    return NULL;
+
+  if (T == NULL)
+    {
+      PyErr_SetString (PyExc_RuntimeError,
+		       "reverse execution needs a trace (see trace_start)");
+      return NULL;
+    }
+
+  size_t i = S->get_trace_position ();
+  unsigned long steps = 0;
+
+  while (steps < n && i > T->begin ())
+    {
+      i--;
+      while (i > T->begin () && T->at (i - 1).pc == T->at (i).pc)
+	i--;
+      steps++;
+    }
+
+  if (steps > 0 && ! s_trace_seek (S, i))
+    return NULL;
+
+  return Py_BuildValue ("k", steps);
+}
+
+/*****************************************************************************
+ *
+ * GenericInsightSimulator
+ *
+ *****************************************************************************/
+
+GenericInsightSimulator::GenericInsightSimulator (Program *P)
+{
+  prg = P;
+  Py_INCREF (P);
+  mc = new Microcode ();
+  march = new MicrocodeArchitecture (P->loader->get_architecture ());
+  arrows = new ArrowVector ();
+  stop_conditions = new StopConditionSet;
+  trace = NULL;
+  trace_capacity = 0;
+  trace_period = 0;
+  trace_position = 0;
+  next_snapshot = 0;
+  if (prg->stubfactory)
+    prg->stubfactory->add_stubs (prg->concrete_memory, march, mc,
+				 prg->symbol_table);
+}
+
+GenericInsightSimulator::~GenericInsightSimulator ()
+{
+  Py_DECREF (prg);
+  delete mc;
+  delete march;
+
+  delete arrows;
+  for (StopConditionSet::iterator i = stop_conditions->begin ();
+       i != stop_conditions->end (); i++) {
+    delete (*i);
+  }
+  delete stop_conditions;
+
+  for (AssumptionMap::iterator i = assumptions.begin ();
+       i != assumptions.end (); i++) {
+    i->second->deref ();
+  }
+}
+
+MicrocodeArchitecture *
+GenericInsightSimulator::get_march () const
+{
+  return march;
+}
+
+const Microcode *
+GenericInsightSimulator::get_microcode () const
+{
+  return mc;
+}
+
+Program *
+GenericInsightSimulator::get_program () const
+{
+  return prg;
+}
+
+
+void
+GenericInsightSimulator::clear_arrows ()
+{
+  arrows->clear ();
 }
 
 size_t
 GenericInsightSimulator::get_number_of_arrows () const
 {
-  return arrows->size ();
+  return arrows->size ();
+}
+
+StmtArrow *
+GenericInsightSimulator::get_arrow_at (size_t i) const
+{
+  assert (i < arrows->size ());
+  return arrows->at (i);
+}
+
+string
+GenericInsightSimulator::get_memory (address_t addr)
+{
+  void *s = get_state ();
+  assert (s != NULL);
+
+  string result = get_memory (s, addr);
+  delete_state (s);
+  return result;
+}
+
+bool
+GenericInsightSimulator::check_memory_range (address_t addr, size_t len)
+{
+  void *s = get_state ();
+  assert (s != NULL);
+  bool result = check_memory_range (s, addr, len);
+  delete_state (s);
+
+  return result;
+}
+
+static bool
+s_try_set_state (GenericInsightSimulator *S, void *s)
+{
+  bool result = true;
+
+  S->mark_all_written ();
+  try {
+    S->set_state (s);
+  } catch (CodeChangedException &e) {
+    s_CodeChangedException (e);
+    result = false;
+  }
+  S->trace_state_changed ();
+
+  return result;
+}
+
+bool
+GenericInsightSimulator::abstract_memory (address_t addr, size_t len,
+					  bool keep_in_ctx)
+{
+  void *s = get_state ();
+  void *ns = abstract_memory (s, addr, len, keep_in_ctx);
+  if (ns != NULL)
+    {
+      s_try_set_state (this, ns);
+      delete_state (ns);
+    }
+  delete_state (s);
+
+  return (ns != NULL) && !PyErr_Occurred ();
+}
+
+bool
+GenericInsightSimulator::concretize_memory (address_t addr, size_t len)
+{
+  void *s = get_state ();
+  void *ns = concretize_memory (s, addr, len);
+  if (ns != NULL)
+    {
+      s_try_set_state (this, ns);
+      delete_state (ns);
+    }
+  delete_state (s);
+
+  return (ns != NULL) && !PyErr_Occurred ();
 }
 
-StmtArrow *
-GenericInsightSimulator::get_arrow_at (size_t i) const
+bool
+GenericInsightSimulator::concretize_memory (address_t addr,
+					    const ConcreteValue *values,
+					    size_t len)
 {
-  assert (i < arrows->size ());
-  return arrows->at (i);
+  void *s = get_state ();
+  void *ns = concretize_memory (s, addr, values, len);
+  if (ns != NULL)
+    {
+      s_try_set_state (this, ns);
+      delete_state (ns);
+    }
+  delete_state (s);
+
+  return (ns != NULL) && !PyErr_Occurred ();
 }
 
 string
-GenericInsightSimulator::get_memory (address_t addr)
+GenericInsightSimulator::get_register (const RegisterDesc *reg)
 {
   void *s = get_state ();
-  assert (s != NULL);
-
-  string result = get_memory (s, addr);
+  string result = get_register (s, reg);
   delete_state (s);
+
   return result;
 }
 
 bool
-GenericInsightSimulator::check_memory_range (address_t addr, size_t len)
+GenericInsightSimulator::check_register (const RegisterDesc *reg)
 {
   void *s = get_state ();
-  assert (s != NULL);
-  bool result = check_memory_range (s, addr, len);
+  bool result = check_register (s, reg);
   delete_state (s);
 
   return result;
 }
 
-static bool
-s_try_set_state (GenericInsightSimulator *S, void *s)
+bool
+GenericInsightSimulator::abstract_register (const RegisterDesc *reg,
+					    bool keep_in_ctx)
 {
-  try {
-    S->set_state (s);
-    return true;
-  } catch (CodeChangedException &e) {
-    s_CodeChangedException (e);
-    return false;
-  }
+  void *s = get_state ();
+  void *ns = abstract_register (s, reg, keep_in_ctx);
+  if (ns != NULL)
+    {
+      s_try_set_state (this, ns);
+      delete_state (ns);
+    }
+  delete_state (s);
+  return (ns != NULL) && !PyErr_Occurred ();
 }
 
 bool
-GenericInsightSimulator::abstract_memory (address_t addr, size_t len,
-					  bool keep_in_ctx)
+GenericInsightSimulator::concretize_register (const RegisterDesc *reg)
 {
   void *s = get_state ();
-  void *ns = abstract_memory (s, addr, len, keep_in_ctx);
+  void *ns = concretize_register (s, reg);
+  if (ns != NULL)
+    {
+      s_try_set_state (this, ns);
+      delete_state (ns);
+    }
+  delete_state (s);
+  return (ns != NULL) && !PyErr_Occurred ();
+}
+
+bool
+GenericInsightSimulator::concretize_register (const RegisterDesc *reg,
+					      const ConcreteValue &v)
+{
+  void *s = get_state ();
+  void *ns = concretize_register (s, reg, v);
   if (ns != NULL)
     {
-      s_try_set_state (this, ns);
-      delete_state (ns);
+      s_try_set_state (this, ns);
+      delete_state (ns);
+    }
+  delete_state (s);
+  return (ns != NULL) && !PyErr_Occurred ();
+}
+
+const StopCondition *
+GenericInsightSimulator::add_stop_condition (StopCondition *sc)
+{
+  const StopCondition *result = NULL;
+  Breakpoint *bp = dynamic_cast<Breakpoint *> (sc);
+  Watchpoint *wp = dynamic_cast<Watchpoint *> (sc);
+
+  // equal stop conditions have the same type
+  if (bp != NULL)
+    {
+      vector<Breakpoint *> &bps = breakpoints[bp->get_address ()];
+      for (size_t i = 0; i < bps.size () && result == NULL; i++)
+	if (sc->equals (bps[i]))
+	  result = bps[i];
+      bps.push_back (bp);
+    }
+  else if (wp != NULL)
+    {
+      for (size_t i = 0; i < watchpoints.size () && result == NULL; i++)
+	if (sc->equals (watchpoints[i]))
+	  result = watchpoints[i];
+      add_watchpoint (wp);
+    }
+  else
+    {
+      for (size_t i = 0; i < other_stop_conditions.size () && result == NULL;
+	   i++)
+	if (sc->equals (other_stop_conditions[i]))
+	  result = other_stop_conditions[i];
+      other_stop_conditions.push_back (sc);
+    }
+  stop_conditions->insert (sc);
+
+  return result;
+}
+
+const StopConditionSet *
+GenericInsightSimulator::get_stop_conditions () const
+{
+  return stop_conditions;
+}
+
+StopCondition *
+GenericInsightSimulator::get_stop_condition (int id) const
+{
+  StopCondition *result = NULL;
+
+  for (StopConditionSet::iterator i = stop_conditions->begin ();
+       i != stop_conditions->end () && result == NULL; i++) {
+    if ((*i)->get_id () == id)
+      result = (*i);
+  }
+
+  return result;
+}
+
+const StopCondition *
+GenericInsightSimulator::check_stop_conditions ()
+{
+  if (! breakpoints.empty ())
+    {
+      BreakpointIndex::const_iterator i = breakpoints.find (get_pc ());
+
+      if (i != breakpoints.end ())
+	{
+	  for (size_t b = 0; b < i->second.size (); b++)
+	    if (i->second[b]->stop (this))
+	      return i->second[b];
+	}
+    }
+
+  // A watchpoint left pending when another one stops the simulation is
+  // evaluated at the next check.
+  while (! pending_watchpoints.empty ())
+    {
+      Watchpoint *wp = pending_watchpoints.back ();
+
+      pending_watchpoints.pop_back ();
+      wp->set_pending (false);
+      if (wp->stop (this))
+	return wp;
+    }
+
+  for (size_t i = 0; i < other_stop_conditions.size (); i++)
+    if (other_stop_conditions[i]->stop (this))
+      return other_stop_conditions[i];
+
+  return NULL;
+}
+
+void
+GenericInsightSimulator::reset_stop_conditions ()
+{
+  for (StopConditionSet::iterator i = stop_conditions->begin ();
+       i != stop_conditions->end (); i++)
+    (*i)->reset (this);
+
+  for (size_t i = 0; i < pending_watchpoints.size (); i++)
+    pending_watchpoints[i]->set_pending (false);
+  pending_watchpoints.clear ();
+}
+
+template <typename T> static void
+s_erase (vector<T *> &v, const T *e)
+{
+  v.erase (std::remove (v.begin (), v.end (), e), v.end ());
+}
+
+bool
+GenericInsightSimulator::del_stop_condition (int id)
+{
+  for (StopConditionSet::iterator i = stop_conditions->begin ();
+       i != stop_conditions->end (); i++) {
+    if ((*i)->get_id () == id)
+      {
+	Breakpoint *bp = dynamic_cast<Breakpoint *> (*i);
+	Watchpoint *wp = dynamic_cast<Watchpoint *> (*i);
+
+	if (bp != NULL)
+	  {
+	    BreakpointIndex::iterator b = breakpoints.find (bp->get_address ());
+	    s_erase (b->second, bp);
+	    if (b->second.empty ())
+	      breakpoints.erase (b);
+	  }
+	else if (wp != NULL)
+	  remove_watchpoint (wp);
+	else
+	  s_erase (other_stop_conditions, *i);
+	stop_conditions->erase (i);
+	return true;
+      }
+  }
+  return false;
+}
+
+void
+GenericInsightSimulator::add_watchpoint (Watchpoint *wp)
+{
+  typedef vector<const RegisterExpr *> RegisterVector;
+  typedef vector<const MemCell *> MemCellVector;
+  const Expr *cond = wp->get_cond ();
+  RegisterVector regs =
+    exprutils::collect_subterms_of_type<RegisterVector, RegisterExpr>
+    (cond, true);
+  MemCellVector cells =
+    exprutils::collect_subterms_of_type<MemCellVector, MemCell> (cond, true);
+  bool any_address = false;
+
+  for (RegisterVector::const_iterator i = regs.begin (); i != regs.end (); i++)
+    {
+      WatchpointVector &wps =
+	register_watchpoints[(*i)->get_descriptor ()->get_label ()];
+      if (wps.empty () || wps.back () != wp)
+	wps.push_back (wp);
+    }
+
+  for (MemCellVector::const_iterator i = cells.begin (); i != cells.end ();
+       i++)
+    {
+      const Constant *c = dynamic_cast<const Constant *> ((*i)->get_addr ());
+
+      if (c == NULL)
+	{
+	  any_address = true;
+	  continue;
+	}
+
+      address_t addr = c->get_val ();
+      int nb_bytes = ((*i)->get_bv_offset () + (*i)->get_bv_size () + 7) / 8;
+      for (int b = 0; b < nb_bytes; b++)
+	{
+	  WatchpointVector &wps = memory_watchpoints[addr + b];
+	  if (wps.empty () || wps.back () != wp)
+	    wps.push_back (wp);
+	}
+    }
+
+  if (! cells.empty ())
+    memory_readers.push_back (wp);
+  if (any_address)
+    any_address_watchpoints.push_back (wp);
+  watchpoints.push_back (wp);
+
+  // evaluated at the next check like before the indexing
+  WatchpointVector tmp (1, wp);
+  mark_pending (tmp);
+}
+
+void
+GenericInsightSimulator::remove_watchpoint (Watchpoint *wp)
+{
+  for (RegisterIndex::iterator i = register_watchpoints.begin ();
+       i != register_watchpoints.end (); i++)
+    s_erase (i->second, wp);
+  for (MemoryIndex::iterator i = memory_watchpoints.begin ();
+       i != memory_watchpoints.end (); i++)
+    s_erase (i->second, wp);
+  s_erase (memory_readers, wp);
+  s_erase (any_address_watchpoints, wp);
+  s_erase (pending_watchpoints, wp);
+  s_erase (watchpoints, wp);
+}
+
+void
+GenericInsightSimulator::mark_pending (const WatchpointVector &wps)
+{
+  for (WatchpointVector::const_iterator i = wps.begin (); i != wps.end (); i++)
+    {
+      if ((*i)->is_pending ())
+	continue;
+      (*i)->set_pending (true);
+      pending_watchpoints.push_back (*i);
+    }
+}
+
+void
+GenericInsightSimulator::mark_written (const StmtArrow *a)
+{
+  if (watchpoints.empty ())
+    return;
+
+  const Statement *stmt = a->get_stmt ();
+  const Assignment *assignment = dynamic_cast<const Assignment *> (stmt);
+
+  if (dynamic_cast<const External *> (stmt) != NULL)
+    {
+      mark_all_written ();
+      return;
+    }
+  if (assignment == NULL)
+    return;
+
+  const LValue *lv = assignment->get_lval ();
+  const RegisterExpr *reg = dynamic_cast<const RegisterExpr *> (lv);
+  const MemCell *cell = dynamic_cast<const MemCell *> (lv);
+
+  if (reg != NULL)
+    {
+      RegisterIndex::const_iterator i =
+	register_watchpoints.find (reg->get_descriptor ()->get_label ());
+      if (i != register_watchpoints.end ())
+	mark_pending (i->second);
+    }
+  else if (cell != NULL && ! memory_readers.empty ())
+    {
+      Option<ConcreteValue> addr;
+
+      try
+	{
+	  addr = eval_constant (cell->get_addr ());
+	}
+      catch (UndefinedValueException &)
+	{
+	}
+
+      if (! addr.hasValue ())
+	{
+	  mark_pending (memory_readers);
+	  return;
+	}
+
+      int nb_bytes = (cell->get_bv_offset () + cell->get_bv_size () + 7) / 8;
+      for (int b = 0; b < nb_bytes; b++)
+	{
+	  MemoryIndex::const_iterator i =
+	    memory_watchpoints.find (addr.getValue ().get () + b);
+	  if (i != memory_watchpoints.end ())
+	    mark_pending (i->second);
+	}
+      mark_pending (any_address_watchpoints);
+    }
+}
+
+void
+GenericInsightSimulator::mark_all_written ()
+{
+  mark_pending (watchpoints);
+}
+
+void
+GenericInsightSimulator::start_trace (size_t capacity, size_t period,
+				      FILE *out)
+{
+  stop_trace ();
+  trace = new Trace (out);
+  trace_capacity = capacity;
+  trace_period = period > 0 ? period : 1;
+  trace_position = 0;
+  trace_state_changed ();
+}
+
+void
+GenericInsightSimulator::stop_trace ()
+{
+  for (map<size_t, void *>::iterator i = trace_checkpoints.begin ();
+       i != trace_checkpoints.end (); i++)
+    delete_state (i->second);
+  trace_checkpoints.clear ();
+  delete trace;
+  trace = NULL;
+}
+
+const Trace *
+GenericInsightSimulator::get_trace () const
+{
+  return trace;
+}
+
+size_t
+GenericInsightSimulator::get_trace_position () const
+{
+  return trace_position;
+}
+
+void *
+GenericInsightSimulator::get_trace_state (size_t i)
+{
+  if (trace == NULL || i < trace->begin () || i > trace->end ())
+    return NULL;
+
+  map<size_t, void *>::const_iterator c = trace_checkpoints.upper_bound (i);
+  if (c == trace_checkpoints.begin ())
+    return NULL;
+  c--;
+
+  MicrocodeAddress pc = i < trace->end () ? trace->at (i).get_pc ()
+    : trace_end_pc;
+  void *result = copy_state (c->second, pc);
+
+  for (size_t k = c->first; k < i; k++)
+    {
+      const TraceRecord &r = trace->at (k);
+
+      // an OPAQUE record is always followed by a checkpoint
+      assert (r.kind != TraceRecord::OPAQUE);
+      if (r.kind == TraceRecord::REGISTER)
+	set_register (result, trace->get_register (r.where), r.value);
+      else if (r.kind == TraceRecord::MEMORY)
+	write_memory (result, r.where, ConcreteValue (r.size, r.value));
     }
-  delete_state (s);
 
-  return (ns != NULL) && !PyErr_Occurred ();
+  return result;
 }
 
-bool
-GenericInsightSimulator::concretize_memory (address_t addr, size_t len)
+void
+GenericInsightSimulator::set_trace_position (size_t i)
 {
-  void *s = get_state ();
-  void *ns = concretize_memory (s, addr, len);
-  if (ns != NULL)
-    {
-      s_try_set_state (this, ns);
-      delete_state (ns);
-    }
-  delete_state (s);
+  assert (trace != NULL && trace->begin () <= i && i <= trace->end ());
 
-  return (ns != NULL) && !PyErr_Occurred ();
+  trace_position = i;
 }
 
-bool
-GenericInsightSimulator::concretize_memory (address_t addr,
-					    const ConcreteValue *values,
-					    size_t len)
+void
+GenericInsightSimulator::trace_state_changed ()
 {
-  void *s = get_state ();
-  void *ns = concretize_memory (s, addr, values, len);
-  if (ns != NULL)
-    {
-      s_try_set_state (this, ns);
-      delete_state (ns);
-    }
-  delete_state (s);
+  if (trace == NULL || ! has_state ())
+    return;
 
-  return (ns != NULL) && !PyErr_Occurred ();
+  truncate_trace ();
+  trace_end_pc = get_pc ();
+  add_trace_checkpoint ();
 }
 
-string
-GenericInsightSimulator::get_register (const RegisterDesc *reg)
+unsigned long
+GenericInsightSimulator::take_snapshot ()
 {
   void *s = get_state ();
-  string result = get_register (s, reg);
+  unsigned long result = next_snapshot++;
+
+  snapshots[result] = copy_state (s, get_pc (s));
   delete_state (s);
 
   return result;
 }
 
-bool
-GenericInsightSimulator::check_register (const RegisterDesc *reg)
+void *
+GenericInsightSimulator::get_snapshot (unsigned long id)
 {
-  void *s = get_state ();
-  bool result = check_register (s, reg);
-  delete_state (s);
+  map<unsigned long, void *>::const_iterator i = snapshots.find (id);
 
-  return result;
+  if (i == snapshots.end ())
+    return NULL;
+
+  return copy_state (i->second, get_pc (i->second));
 }
 
 bool
-GenericInsightSimulator::abstract_register (const RegisterDesc *reg,
-					    bool keep_in_ctx)
+GenericInsightSimulator::drop_snapshot (unsigned long id)
 {
-  void *s = get_state ();
-  void *ns = abstract_register (s, reg, keep_in_ctx);
-  if (ns != NULL)
-    {
-      s_try_set_state (this, ns);
-      delete_state (ns);
-    }
-  delete_state (s);
-  return (ns != NULL) && !PyErr_Occurred ();
+  map<unsigned long, void *>::iterator i = snapshots.find (id);
+
+  if (i == snapshots.end ())
+    return false;
+  delete_state (i->second);
+  snapshots.erase (i);
+
+  return true;
 }
 
-bool
-GenericInsightSimulator::concretize_register (const RegisterDesc *reg)
+void
+GenericInsightSimulator::drop_snapshots ()
 {
-  void *s = get_state ();
-  void *ns = concretize_register (s, reg);
-  if (ns != NULL)
-    {
-      s_try_set_state (this, ns);
-      delete_state (ns);
-    }
-  delete_state (s);
-  return (ns != NULL) && !PyErr_Occurred ();
+  for (map<unsigned long, void *>::iterator i = snapshots.begin ();
+       i != snapshots.end (); i++)
+    delete_state (i->second);
+  snapshots.clear ();
 }
 
-bool
-GenericInsightSimulator::concretize_register (const RegisterDesc *reg,
-					      const ConcreteValue &v)
+static bool
+s_is_constant (const GenericInsightSimulator *sim, const Expr *e)
 {
-  void *s = get_state ();
-  void *ns = concretize_register (s, reg, v);
-  if (ns != NULL)
+  try
     {
-      s_try_set_state (this, ns);
-      delete_state (ns);
+      return sim->eval_constant (e).hasValue ();
     }
-  delete_state (s);
-  return (ns != NULL) && !PyErr_Occurred ();
+  catch (UndefinedValueException &)
+    {
+    }
+
+  return false;
 }
 
-const StopCondition *
-GenericInsightSimulator::add_stop_condition (StopCondition *sc)
+void
+GenericInsightSimulator::trace_arrow (const StmtArrow *a, TraceRecord &r)
 {
-  const StopCondition *result = NULL;
+  MicrocodeAddress pc = get_pc ();
+  const Assignment *assignment =
+    dynamic_cast<const Assignment *> (a->get_stmt ());
+
+  r.pc = pc.getGlobal ();
+  r.pc_local = pc.getLocal ();
+  r.arrow = std::find (arrows->begin (), arrows->end (), a) - arrows->begin ();
+  r.kind = TraceRecord::NO_WRITE;
+  r.size = 0;
+  r.where = 0;
+  r.value = 0;
+
+  // a guard that is not a constant restricts the state, e.g. the path
+  // condition of a symbolic state, in a way that is not replayed
+  if (dynamic_cast<const External *> (a->get_stmt ()) != NULL ||
+      (! a->get_condition ()->is_TrueFormula () &&
+       ! s_is_constant (this, a->get_condition ())))
+    r.kind = TraceRecord::OPAQUE;
+  if (assignment == NULL || r.kind == TraceRecord::OPAQUE)
+    return;
 
-  for (StopConditionSet::iterator i = stop_conditions->begin ();
-       i != stop_conditions->end () && result == NULL; i++) {
-    if (sc->equals (*i))
-      result = *i;
-  }
-  stop_conditions->insert (sc);
+  const LValue *lv = assignment->get_lval ();
+  const RegisterExpr *reg = dynamic_cast<const RegisterExpr *> (lv);
+  const MemCell *cell = dynamic_cast<const MemCell *> (lv);
 
-  return result;
-}
+  r.kind = TraceRecord::OPAQUE;
+  if (lv->get_bv_size () > 64)
+    return;
+  r.size = lv->get_bv_size ();
 
-const StopConditionSet *
-GenericInsightSimulator::get_stop_conditions () const
-{
-  return stop_conditions;
+  if (reg != NULL &&
+      reg->get_bv_size () == reg->get_descriptor ()->get_window_size ())
+    {
+      r.kind = TraceRecord::REGISTER;
+      r.where = trace->get_register_index (reg->get_descriptor ());
+    }
+  else if (cell != NULL && cell->get_bv_size () % 8 == 0)
+    {
+      // the address is evaluated before the cell is written
+      Option<ConcreteValue> addr;
+
+      try
+	{
+	  addr = eval (cell->get_addr ());
+	}
+      catch (UndefinedValueException &)
+	{
+	}
+
+      if (addr.hasValue ())
+	{
+	  r.kind = TraceRecord::MEMORY;
+	  r.where = addr.getValue ().get ();
+	}
+    }
 }
 
-StopCondition *
-GenericInsightSimulator::get_stop_condition (int id) const
+void
+GenericInsightSimulator::trace_written (const StmtArrow *a, TraceRecord &r)
 {
-  StopCondition *result = NULL;
+  if (r.kind == TraceRecord::REGISTER || r.kind == TraceRecord::MEMORY)
+    {
+      const Assignment *assignment = (const Assignment *) a->get_stmt ();
+      Option<ConcreteValue> value;
 
-  for (StopConditionSet::iterator i = stop_conditions->begin ();
-       i != stop_conditions->end () && result == NULL; i++) {
-    if ((*i)->get_id () == id)
-      result = (*i);
-  }
+      try
+	{
+	  value = eval_constant (assignment->get_lval ());
+	}
+      catch (UndefinedValueException &)
+	{
+	}
 
-  return result;
-}
+      if (value.hasValue ())
+	r.value = value.getValue ().get ();
+      else
+	r.kind = TraceRecord::OPAQUE;
+    }
 
-const StopCondition *
-GenericInsightSimulator::check_stop_conditions ()
-{
-  const StopCondition *result = NULL;
+  truncate_trace ();
+  trace->append (r);
+  trace_position = trace->end ();
+  trace_end_pc = get_pc ();
 
-  for (StopConditionSet::iterator i = stop_conditions->begin ();
-       i != stop_conditions->end () && result == NULL; i++) {
-    if ((*i)->stop(this))
-      result = (*i);
-  }
+  map<size_t, void *>::const_iterator last = trace_checkpoints.end ();
+  if (r.kind == TraceRecord::OPAQUE || trace_checkpoints.empty () ||
+      trace->end () - (--last)->first >= trace_period)
+    add_trace_checkpoint ();
 
-  return result;
+  if (trace_capacity > 0 && trace->end () - trace->begin () > trace_capacity)
+    {
+      // keep the checkpoint from which the first record is replayed
+      map<size_t, void *>::iterator c =
+	trace_checkpoints.upper_bound (trace->end () - trace_capacity);
+      c--;
+      for (map<size_t, void *>::iterator i = trace_checkpoints.begin ();
+	   i != c; i++)
+	delete_state (i->second);
+      trace_checkpoints.erase (trace_checkpoints.begin (), c);
+      trace->drop_front (c->first);
+    }
 }
 
 void
-GenericInsightSimulator::reset_stop_conditions ()
+GenericInsightSimulator::truncate_trace ()
 {
-  for (StopConditionSet::iterator i = stop_conditions->begin ();
-       i != stop_conditions->end (); i++)
-    (*i)->reset (this);
+  if (trace_position == trace->end ())
+    return;
+
+  trace->truncate (trace_position);
+  map<size_t, void *>::iterator c =
+    trace_checkpoints.upper_bound (trace_position);
+  for (map<size_t, void *>::iterator i = c; i != trace_checkpoints.end ();
+       i++)
+    delete_state (i->second);
+  trace_checkpoints.erase (c, trace_checkpoints.end ());
 }
 
-bool
-GenericInsightSimulator::del_stop_condition (int id)
+void
+GenericInsightSimulator::add_trace_checkpoint ()
 {
-  for (StopConditionSet::iterator i = stop_conditions->begin ();
-       i != stop_conditions->end (); i++) {
-    if ((*i)->get_id () == id)
-      {
-	stop_conditions->erase (i);
-	return true;
-      }
-  }
-  return false;
+  map<size_t, void *>::iterator c = trace_checkpoints.find (trace->end ());
+  void *s = get_state ();
+
+  if (c != trace_checkpoints.end ())
+    delete_state (c->second);
+  trace_checkpoints[trace->end ()] = copy_state (s, get_pc (s));
+  delete_state (s);
 }
 
 Option<string>
@@ -1860,14 +3251,134 @@ GenericInsightSimulator::add_assumption (const MicrocodeAddress &ma,
 }
 
 bool
-GenericInsightSimulator::apply_assumption ()
+GenericInsightSimulator::apply_assumption (StopReason &reason)
 {
   MicrocodeAddress pc = get_pc ();
   AssumptionMap::const_iterator i = assumptions.find (pc);
 
   if (i == assumptions.end ())
     return true;
-  return assume (i->second);
+
+  void *s = get_state ();
+  void *ns = assume (s, i->second);
+  if (ns == NULL)
+    reason.kind = StopReason::INFEASIBLE_ASSUMPTION;
+  else
+    {
+      /* the assumption may narrow any lvalue a watchpoint reads */
+      mark_all_written ();
+      try
+	{
+	  set_state (ns);
+	}
+      catch (CodeChangedException &e)
+	{
+	  reason.kind = StopReason::CODE_CHANGED;
+	  reason.addr = MicrocodeAddress (e.where ());
+	}
+      trace_state_changed ();
+      delete_state (ns);
+    }
+  delete_state (s);
+
+  return reason.kind == StopReason::RUNNING;
+}
+
+bool
+GenericInsightSimulator::microstep (StmtArrow *a, StopReason &reason)
+{
+  void *st = get_state ();
+  TraceRecord record;
+
+  if (trace != NULL)
+    trace_arrow (a, record);
+
+  void *newst = trigger_arrow (st, a, reason);
+
+  if (newst != NULL)
+    {
+      try
+	{
+	  set_state (newst);
+	  mark_written (a);
+	  if (trace != NULL)
+	    trace_written (a, record);
+
+	  if (get_number_of_arrows () == 0)
+	    {
+	      reason.kind = StopReason::SINK_NODE;
+	      reason.addr = get_pc (st);
+	    }
+	  else if (apply_assumption (reason))
+	    {
+	      const StopCondition *sc = check_stop_conditions ();
+	      if (sc != NULL)
+		{
+		  reason.kind = StopReason::STOP_CONDITION;
+		  reason.sc = sc;
+		}
+	    }
+	}
+      catch (CodeChangedException &e)
+	{
+	  mark_all_written ();
+	  if (trace != NULL)
+	    trace_written (a, record);
+	  reason.kind = StopReason::CODE_CHANGED;
+	  reason.addr = MicrocodeAddress (e.where ());
+	}
+      delete_state (newst);
+    }
+  else if (reason.kind == StopReason::RUNNING)
+    {
+      // the arrow has no successor
+      reason.kind = StopReason::SINK_NODE;
+      reason.addr = get_pc (st);
+    }
+  delete_state (st);
+
+  return reason.kind == StopReason::RUNNING;
+}
+
+size_t
+GenericInsightSimulator::cont (size_t max_steps, unsigned int aindex,
+			       StopReason &reason)
+{
+  size_t steps = 0;
+  address_t ep = get_pc ().getGlobal ();
+  StmtArrow *a = NULL;
+
+  if (get_number_of_arrows () > 1)
+    a = get_arrow_at (aindex);
+
+  while (reason.kind == StopReason::RUNNING)
+    {
+      if (steps == max_steps)
+	reason.kind = StopReason::MAX_STEPS;
+      else if (s_interrupted)
+	reason.kind = StopReason::INTERRUPTED;
+      else if (a == NULL && get_number_of_arrows () == 0)
+	{
+	  reason.kind = StopReason::SINK_NODE;
+	  reason.addr = get_pc ();
+	}
+      else if (a == NULL && get_number_of_arrows () > 1)
+	reason.kind = StopReason::NOT_DETERMINISTIC;
+      else
+	{
+	  microstep (a != NULL ? a : get_arrow_at (0), reason);
+	  a = NULL;
+
+	  address_t pc = get_pc ().getGlobal ();
+	  if (pc != ep)
+	    {
+	      steps++;
+	      ep = pc;
+	    }
+	}
+    }
+
+  return steps;
 }
 
 bool
@@ -1911,6 +3422,8 @@ InsightSimulator<Stepper>::InsightSimulator (Program *prg)
 template <typename Stepper>
 InsightSimulator<Stepper>::~InsightSimulator ()
 {
+  stop_trace ();
+  drop_snapshots ();
   delete stepper;
   if (current_state)
     current_state->deref ();
@@ -1964,7 +3477,8 @@ InsightSimulator<Stepper>::get_state ()
 }
 
 template <typename Stepper> void *
-InsightSimulator<Stepper>::trigger_arrow (void *from, StmtArrow *a)
+InsightSimulator<Stepper>::trigger_arrow (void *from, StmtArrow *a,
+					  StopReason &reason)
 {
   State *result = NULL;
   try
@@ -1992,23 +3506,32 @@ InsightSimulator<Stepper>::trigger_arrow (void *from, StmtArrow *a)
 	    }
 	  else
 	    {
-	      PyErr_SetObject (pynsight::JumpToInvalidAddress,
-			       s_PyMicrocodeAddress (tgt));
+	      reason.kind = StopReason::JUMP_TO_INVALID_ADDRESS;
+	      reason.addr = tgt;
 	      result = NULL;
 	    }
 	}
       else if (succs->size () != 0)
-	PyErr_SetNone (pynsight::NotDeterministicBehaviorError);
+	reason.kind = StopReason::NOT_DETERMINISTIC;
       stepper->destroy_state_set (succs);
     }
   catch (UndefinedValueException &e)
     {
-      PyErr_SetString (pynsight::UndefinedValueError, e.what ());
+      reason.kind = StopReason::UNDEFINED_VALUE;
+      reason.message = e.what ();
     }
 
   return result;
 }
 
+template <typename Stepper> void *
+InsightSimulator<Stepper>::copy_state (void *p, const MicrocodeAddress &pc)
+{
+  State *s = (State *) p;
+
+  return new State (new ProgramPoint (pc), s->get_Context ()->clone ());
+}
+
 template <typename Stepper> void
 InsightSimulator<Stepper>::set_memory (void *p, address_t addr,
 				       const typename Stepper::Value &value)
@@ -2026,6 +3549,16 @@ InsightSimulator<Stepper>::set_memory (void *p, address_t addr, uint8_t value)
   set_memory (p, addr, val);
 }
 
+template <typename Stepper> void
+InsightSimulator<Stepper>::write_memory (void *p, address_t addr,
+					 const ConcreteValue &value)
+{
+  typename Stepper::Value val (value.get_size (), value.get ());
+  typename Stepper::State *s = (typename Stepper::State *) p;
+  typename Stepper::Memory *mem = s->get_Context ()->get_memory ();
+  mem->put (addr, val, march->get_endian ());
+}
+
 template <typename Stepper> string
 InsightSimulator<Stepper>::get_memory (void *p, address_t addr)
 {
@@ -2373,6 +3906,29 @@ InsightSimulator<Stepper>::eval (const Expr *e) const
   return Option<ConcreteValue> (cv);
 }
 
+template <> Option<ConcreteValue>
+InsightSimulator<SymbolicStepper>::eval_constant (const Expr *e) const
+{
+  SymbolicStepper::Context *ctx =
+    ((State *) current_state)->get_Context ();
+  Expr *val = stepper->eval (ctx, e).get_Expr ()->ref ();
+  Option<ConcreteValue> result;
+
+  exprutils::simplify (&val);
+  if (val->is_Constant ())
+    result = ConcreteValue (val->get_bv_size (),
+			    ((const Constant *) val)->get_val ());
+  val->deref ();
+
+  return result;
+}
+
+template <> Option<ConcreteValue>
+InsightSimulator<ConcreteStepper>::eval_constant (const Expr *e) const
+{
+  return eval (e);
+}
+
 template <typename Stepper> Option<bool>
 InsightSimulator<Stepper>::eval_condition (const Expr *e) const
 {
@@ -2738,6 +4294,12 @@ Breakpoint::~Breakpoint ()
     cond->deref ();
 }
 
+const MicrocodeAddress &
+Breakpoint::get_address () const
+{
+  return addr;
+}
+
 bool
 Breakpoint::stop (GenericInsightSimulator *S)
 {
@@ -2790,7 +4352,7 @@ Breakpoint::equals (const StopCondition *other) const
 }
 
 Watchpoint::Watchpoint (const Expr *e)
-  : StopCondition (), cond (e->ref ()), last_value ()
+  : StopCondition (), cond (e->ref ()), last_value (), pending (false)
 {
 }
 
@@ -2813,6 +4375,12 @@ Watchpoint::stop (GenericInsightSimulator *S)
   return result;
 }
 
+const Expr *
+Watchpoint::get_cond () const
+{
+  return cond;
+}
+
 void
 Watchpoint::output_text (std::ostream &out) const
 {
@@ -2850,12 +4418,21 @@ PyWatchpoint::~PyWatchpoint ()
 bool
 PyWatchpoint::stop (GenericInsightSimulator *)
 {
+  // The GIL is not held when called from Simulator.cont (). An exception
+  // raised by the callback stops the simulation; it is reported once the
+  // GIL has been taken back.
+  PyGILState_STATE gil = PyGILState_Ensure ();
   PyObject *res = PyObject_CallObject (cb, NULL);
-  if (res == NULL)
-    return false;
-  hit ();
-  bool result = (res != Py_None);
-  Py_DECREF (res);
+  bool result = true;
+
+  if (res != NULL)
+    {
+      hit ();
+      result = (res != Py_None);
+      Py_DECREF (res);
+    }
+  PyGILState_Release (gil);
+
   return result;
 }
 
@@ -0,0 +1,230 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "trace.hh"
+
+#include <cassert>
+#include <cstring>
+#include <sstream>
+
+using namespace pynsight;
+
+MicrocodeAddress
+TraceRecord::get_pc () const
+{
+  return MicrocodeAddress (pc, pc_local);
+}
+
+Trace::Pattern::Pattern ()
+  : with_pc (false), pc (0), reg (NULL), with_address (false), address (0)
+{
+}
+
+Trace::Trace (FILE *out)
+  : records (), first (0), registers (), register_indices (), out (out)
+{
+  if (out != NULL)
+    {
+      char magic[16];
+      uint32_t header[2] = { FILE_VERSION, sizeof (TraceRecord) };
+
+      memset (magic, 0, sizeof (magic));
+      strcpy (magic, "INSIGHT-TRACE\n");
+      fwrite (magic, sizeof (magic), 1, out);
+      fwrite (header, sizeof (header), 1, out);
+    }
+}
+
+Trace::~Trace ()
+{
+  if (out != NULL)
+    fclose (out);
+}
+
+size_t
+Trace::begin () const
+{
+  return first;
+}
+
+size_t
+Trace::end () const
+{
+  return first + records.size ();
+}
+
+const TraceRecord &
+Trace::at (size_t i) const
+{
+  assert (begin () <= i && i < end ());
+
+  return records[i - first];
+}
+
+void
+Trace::append (const TraceRecord &r)
+{
+  records.push_back (r);
+  if (out != NULL)
+    write (r, "");
+}
+
+void
+Trace::truncate (size_t end)
+{
+  assert (first <= end && end <= this->end ());
+
+  records.resize (end - first);
+  if (out != NULL)
+    {
+      TraceRecord r;
+
+      memset (&r, 0, sizeof (r));
+      r.kind = TraceRecord::TRUNCATE;
+      r.where = end;
+      write (r, "");
+    }
+}
+
+void
+Trace::drop_front (size_t begin)
+{
+  assert (first <= begin && begin <= end ());
+
+  records.erase (records.begin (), records.begin () + (begin - first));
+  first = begin;
+}
+
+uint64_t
+Trace::get_register_index (const RegisterDesc *reg)
+{
+  std::unordered_map<const RegisterDesc *, uint64_t>::const_iterator i =
+    register_indices.find (reg);
+
+  if (i != register_indices.end ())
+    return i->second;
+
+  uint64_t result = registers.size ();
+  registers.push_back (reg);
+  register_indices[reg] = result;
+
+  if (out != NULL)
+    {
+      std::ostringstream oss;
+      TraceRecord r;
+
+      reg->output_text (oss);
+      memset (&r, 0, sizeof (r));
+      r.kind = TraceRecord::REGISTER_NAME;
+      r.size = oss.str ().size ();
+      r.where = result;
+      write (r, oss.str ());
+    }
+
+  return result;
+}
+
+const RegisterDesc *
+Trace::get_register (uint64_t index) const
+{
+  assert (index < registers.size ());
+
+  return registers[index];
+}
+
+bool
+Trace::matches (const Pattern &p, const TraceRecord &r) const
+{
+  if (p.with_pc && r.pc != p.pc)
+    return false;
+
+  if (p.reg != NULL)
+    {
+      if (r.kind != TraceRecord::REGISTER)
+	return false;
+
+      const RegisterDesc *reg = registers[r.where];
+      if (reg->get_label () != p.reg->get_label () ||
+	  reg->get_window_offset () + reg->get_window_size () <=
+	  p.reg->get_window_offset () ||
+	  p.reg->get_window_offset () + p.reg->get_window_size () <=
+	  reg->get_window_offset ())
+	return false;
+    }
+
+  if (p.with_address)
+    {
+      if (r.kind != TraceRecord::MEMORY ||
+	  p.address < r.where || r.where + r.size / 8 <= p.address)
+	return false;
+    }
+
+  return true;
+}
+
+bool
+Trace::find (const Pattern &p, size_t &i, bool backward) const
+{
+  if (backward)
+    {
+      if (i >= end ())
+	i = end ();
+      else
+	i++;
+      while (i > begin ())
+	{
+	  i--;
+	  if (matches (p, records[i - first]))
+	    return true;
+	}
+    }
+  else
+    {
+      if (i < begin ())
+	i = begin ();
+      for (; i < end (); i++)
+	if (matches (p, records[i - first]))
+	  return true;
+    }
+
+  return false;
+}
+
+void
+Trace::write (const TraceRecord &r, const std::string &extra)
+{
+  static const char padding[8] = { 0 };
+
+  fwrite (&r, sizeof (r), 1, out);
+  if (! extra.empty ())
+    {
+      fwrite (extra.data (), extra.size (), 1, out);
+      fwrite (padding, (8 - extra.size () % 8) % 8, 1, out);
+    }
+}
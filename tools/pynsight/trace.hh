@@ -0,0 +1,138 @@
+/*-
+ * Copyright (C) 2010-2014, Centre National de la Recherche Scientifique,
+ *                          Institut Polytechnique de Bordeaux,
+ *                          Universite de Bordeaux.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef TRACE_HH
+# define TRACE_HH
+
+# include <cstdio>
+# include <deque>
+# include <string>
+# include <vector>
+# include <stdint.h>
+
+# include <kernel/Architecture.hh>
+# include <kernel/microcode/MicrocodeAddress.hh>
+# include <utils/unordered11.hh>
+
+namespace pynsight {
+  /*! One micro-step of the simulator: the arrow triggered from pc and
+   * what its statement wrote. A record takes 32 bytes. */
+  struct TraceRecord {
+    enum Kind {
+      // skips and jumps
+      NO_WRITE = 0,
+      // where is the index of the register in the trace
+      REGISTER = 1,
+      // where is the address of the first byte
+      MEMORY = 2,
+      // the written lvalue or its value is not a known constant; the
+      // state that follows cannot be rebuilt from the record.
+      OPAQUE = 3,
+      // only in files: where is the index of a register whose name
+      // follows the record (size bytes, padded to a multiple of 8)
+      REGISTER_NAME = 4,
+      // only in files: the records from where are discarded
+      TRUNCATE = 5
+    };
+
+    uint64_t pc;
+    uint32_t pc_local;
+    /* index of the arrow among the enabled ones */
+    uint16_t arrow;
+    uint8_t kind;
+    /* width of the written value, in bits */
+    uint8_t size;
+    uint64_t where;
+    uint64_t value;
+
+    MicrocodeAddress get_pc () const;
+  };
+
+  /*! Records of the micro-steps of a simulation. Records are numbered
+   * from the start of the trace; when the oldest ones are dropped,
+   * begin () moves but the numbers of the others do not change.
+   *
+   * If a file is given, each record is also appended to it after a
+   * header made of the string "INSIGHT-TRACE\n", padded with zeros to
+   * 16 bytes, and of the version and the record size (32 bit words).
+   * Integers are in host byte order. */
+  class Trace {
+  public:
+    static const uint32_t FILE_VERSION = 1;
+
+    Trace (FILE *out);
+    ~Trace ();
+
+    size_t begin () const;
+    size_t end () const;
+    const TraceRecord &at (size_t i) const;
+
+    void append (const TraceRecord &r);
+    /*! Discard the records from index end. */
+    void truncate (size_t end);
+    /*! Discard the records before index begin. */
+    void drop_front (size_t begin);
+
+    uint64_t get_register_index (const RegisterDesc *reg);
+    const RegisterDesc *get_register (uint64_t index) const;
+
+    /*! What find () looks for; unset fields match any record. */
+    struct Pattern {
+      Pattern ();
+
+      bool with_pc;
+      address_t pc;
+      /* records writing a part of this register */
+      const RegisterDesc *reg;
+      bool with_address;
+      /* records writing this byte */
+      address_t address;
+    };
+
+    /*! Search from record i (included) toward the end or the beginning
+     * of the trace. Returns false if no record matches p. */
+    bool find (const Pattern &p, size_t &i, bool backward) const;
+
+  private:
+    Trace (const Trace &);
+    Trace &operator= (const Trace &);
+
+    bool matches (const Pattern &p, const TraceRecord &r) const;
+    void write (const TraceRecord &r, const std::string &extra);
+
+    std::deque<TraceRecord> records;
+    size_t first;
+    std::vector<const RegisterDesc *> registers;
+    std::unordered_map<const RegisterDesc *, uint64_t> register_indices;
+    FILE *out;
+  };
+}
+
+#endif /* ! TRACE_HH */